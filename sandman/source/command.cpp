@@ -2,22 +2,136 @@
 
 #include <unistd.h>
 #include <sys/reboot.h>
+#include <algorithm>
 #include <charconv>
 
 #include "control.h"
+#include "control_queue.h"
+#include "control_thread.h"
+#include "gpio.h"
 #include "input.h"
 #include "logger.h"
 #include "notification.h"
+#include "profiler.h"
 #include "reports.h"
 #include "routines.h"
+#include "socket_server.h"
 
 // Constants
 //
 
+// The maximum amount of time to wait for the reboot notification to finish (in milliseconds).
+static constexpr unsigned int kRebootDelayDurationMS{ 60'000u };
+
+// Types
+//
+
+// Places in the command grammar.
+enum CommandGrammarState
+{
+	kCommandGrammarStateStart = 0,	// Between commands.
+	kCommandGrammarStatePart,			// After a control, like "back".
+	kCommandGrammarStateDirection,	// After a direction, like "back up".
+	kCommandGrammarStateTo,				// After "to", like "back to".
+	kCommandGrammarStatePosition,		// After a position, like "back to 30".
+	kCommandGrammarStateRoutine,		// After "routine".
+	kCommandGrammarStateReboot,		// After "reboot".
+
+	kCommandGrammarStateCount
+};
+
+// What to do with a token in the command grammar.
+enum CommandGrammarStep
+{
+	kCommandGrammarStepSkip = 0,		// Ignore the token.
+	kCommandGrammarStepRestart,		// Give up on the current command and start over at the token.
+	kCommandGrammarStepContinue,		// Just move on to the next state.
+	kCommandGrammarStepPart,			// Remember which control the command is for.
+	kCommandGrammarStepMove,			// Add a move of the control in a direction.
+	kCommandGrammarStepDuration,		// Set the duration of the move that was just added.
+	kCommandGrammarStepPosition,		// Add a move of the control to a position.
+	kCommandGrammarStepStopAll,		// Add stopping all of the controls.
+	kCommandGrammarStepStatus,			// Add playing the status.
+	kCommandGrammarStepRoutineStart,	// Add starting the routine.
+	kCommandGrammarStepRoutineStop,	// Add stopping the routine.
+	kCommandGrammarStepReboot,			// Add rebooting.
+	kCommandGrammarStepRebootCancel,	// Add canceling a reboot.
+};
+
+// Where a token leads in the command grammar.
+struct CommandGrammarTransition
+{
+	// What to do with the token.
+	CommandGrammarStep m_step;
+
+	// The state to go to.
+	CommandGrammarState m_nextState;
+};
+
+// There is a column for each token type, starting with invalid.
+static constexpr int kCommandGrammarColumnCount{ CommandToken::kTypeCount -
+	CommandToken::kTypeInvalid };
+
+// The transitions for each state and token type.
+using CommandGrammarTable = std::array<std::array<CommandGrammarTransition,
+	kCommandGrammarColumnCount>, kCommandGrammarStateCount>;
+
+// A command that was parsed out of the tokens.
+struct CommandBatchItem
+{
+	// The type of the command.
+	CommandResultItem::Types m_type = CommandResultItem::kTypeStatus;
+
+	// The token for the control, for moves.
+	CommandToken::Types m_partType = CommandToken::kTypeInvalid;
+
+	// The direction, for moves in a direction.
+	Control::Actions m_action = Control::kActionStopped;
+
+	// The duration percent, for moves in a direction, or the position, for moves to a position.
+	unsigned int m_parameter = 100u;
+};
+
+// The commands parsed out of the tokens, which are carried out together.
+struct CommandBatch
+{
+	// The most commands that can be parsed out of one message. Any after this are ignored.
+	static constexpr unsigned int kCapacity{ ControlRequestBatch::kCapacity };
+
+	// The commands, in order.
+	std::array<CommandBatchItem, kCapacity> m_items;
+
+	// How many of the commands are valid.
+	unsigned int m_count = 0u;
+};
 
 // Locals
 //
 
+// Names for each result of parsing.
+static constexpr char const* const kCommandReturnTypeNames[] =
+{
+	"invalid",					// kInvalid
+	"success",					// kSuccess
+	"missing confirmation",	// kMissingConfirmation
+};
+
+// Names for each type of command that can be carried out.
+static constexpr char const* const kCommandResultItemTypeNames[] =
+{
+	"move",					// kTypeMove
+	"move to position",	// kTypeMoveToPosition
+	"stop all",				// kTypeStopAll
+	"status",				// kTypeStatus
+	"routine start",		// kTypeRoutineStart
+	"routine stop",		// kTypeRoutineStop
+	"reboot",				// kTypeReboot
+	"reboot canceled",	// kTypeRebootCanceled
+};
+
+static_assert(std::size(kCommandResultItemTypeNames) == CommandResultItem::kTypeRebootCanceled + 1,
+				  "Every type of command needs a name.");
+
 // Names for each command token.
 static constexpr char const* const kCommandTokenNames[] = 
 {
@@ -33,33 +147,211 @@ static constexpr char const* const kCommandTokenNames[] =
 	"reboot", 		// kTypeReboot
 	"yes", 			// kTypeYes
 	"no", 			// kTypeNo
+	"to",				// kTypeTo
+	"percent",		// kTypePercent
 	
 	"integer", 		// kTypeInteger
 };
 
-// A mapping between token names and token type.
-static std::map<std::string, CommandToken::Types> const s_commandTokenNameToTypeMap = 
+// A name that a token can be given by.
+struct CommandTokenName
+{
+	std::string_view m_name;
+	CommandToken::Types m_type;
+};
+
+// Every name a token can be given by, sorted by name so that it can be searched without building
+// anything at run time.
+static constexpr CommandTokenName kCommandTokenVocabulary[] =
 {
 	{ "back", 		CommandToken::kTypeBack }, 
-	{ "legs",		CommandToken::kTypeLegs },
+	{ "down",		CommandToken::kTypeLower },	// Alternative.
 	{ "elevation",	CommandToken::kTypeElevation },
-	{ "raise",		CommandToken::kTypeRaise },
-	{ "up",			CommandToken::kTypeRaise },	// Alternative.
+	{ "legs",		CommandToken::kTypeLegs },
 	{ "lower",		CommandToken::kTypeLower },
-	{ "down",		CommandToken::kTypeLower },	// Alternative.
-	{ "stop",		CommandToken::kTypeStop },
+	{ "no", 			CommandToken::kTypeNo },
+	{ "percent",	CommandToken::kTypePercent },
+	{ "raise",		CommandToken::kTypeRaise },
+	{ "reboot", 	CommandToken::kTypeReboot },
 	{ "routine",	CommandToken::kTypeRoutine },
 	{ "start",		CommandToken::kTypeStart },
 	{ "status",		CommandToken::kTypeStatus },
-	{ "reboot", 	CommandToken::kTypeReboot }, 
-	{ "yes", 		CommandToken::kTypeYes }, 
-	{ "no", 			CommandToken::kTypeNo },
+	{ "stop",		CommandToken::kTypeStop },
+	{ "to",			CommandToken::kTypeTo },
+	{ "up",			CommandToken::kTypeRaise },	// Alternative.
+	{ "yes", 		CommandToken::kTypeYes },
 
 	// "integer", 	kTypeInteger
 };
 
+// Determine whether the vocabulary is sorted and has every token's own name in it.
+//
+// Returns:	True if the vocabulary is valid, false otherwise.
+//
+static constexpr bool CommandIsVocabularyValid()
+{
+	for (std::size_t nameIndex = 1u; nameIndex < std::size(kCommandTokenVocabulary); nameIndex++)
+	{
+		if (kCommandTokenVocabulary[nameIndex - 1u].m_name >=
+			 kCommandTokenVocabulary[nameIndex].m_name)
+		{
+			return false;
+		}
+	}
+
+	for (int type = 0; type < CommandToken::kTypeNotParameterCount; type++)
+	{
+		bool found = false;
+
+		for (auto const& tokenName : kCommandTokenVocabulary)
+		{
+			found = found || ((tokenName.m_name == kCommandTokenNames[type]) &&
+				(tokenName.m_type == type));
+		}
+
+		if (found == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static_assert(CommandIsVocabularyValid() == true,
+				  "The vocabulary must be sorted and have every token's name in it.");
+
+// Get the length of the longest name in the vocabulary.
+//
+// Returns:	The length.
+//
+static constexpr std::size_t CommandGetMaxTokenNameLength()
+{
+	std::size_t maxLength = 0u;
+
+	for (auto const& tokenName : kCommandTokenVocabulary)
+	{
+		maxLength = std::max(maxLength, tokenName.m_name.size());
+	}
+
+	return maxLength;
+}
+
+// Any token string longer than this can't be a name.
+static constexpr std::size_t kCommandMaxTokenNameLength{ CommandGetMaxTokenNameLength() };
+
+// Get the column of the grammar table for a token type.
+//
+// type:	The token type.
+//
+// Returns:	The column.
+//
+static constexpr int CommandGetGrammarColumn(CommandToken::Types type)
+{
+	return type - CommandToken::kTypeInvalid;
+}
+
+// Build the command grammar.
+//
+// Returns:	The transitions for each state and token type.
+//
+static constexpr CommandGrammarTable CommandBuildGrammarTable()
+{
+	CommandGrammarTable table = {};
+
+	// Anything unexpected is ignored between commands, and gives up on a command in progress. A
+	// reboot is canceled by anything other than a confirmation.
+	for (int state = 0; state < kCommandGrammarStateCount; state++)
+	{
+		for (int column = 0; column < kCommandGrammarColumnCount; column++)
+		{
+			auto& transition = table[state][column];
+			transition.m_nextState = kCommandGrammarStateStart;
+
+			switch (state)
+			{
+				case kCommandGrammarStateStart:
+				{
+					transition.m_step = kCommandGrammarStepSkip;
+				}
+				break;
+
+				case kCommandGrammarStateReboot:
+				{
+					transition.m_step = kCommandGrammarStepRebootCancel;
+				}
+				break;
+
+				default:
+				{
+					transition.m_step = kCommandGrammarStepRestart;
+				}
+				break;
+			}
+		}
+	}
+
+	auto const setTransition = [&table](CommandGrammarState state, CommandToken::Types type,
+		CommandGrammarStep step, CommandGrammarState nextState)
+	{
+		table[state][CommandGetGrammarColumn(type)] = CommandGrammarTransition{ step, nextState };
+	};
+
+	// Moving a control, like "back up 50" or "legs to 30 percent".
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeBack, kCommandGrammarStepPart,
+					  kCommandGrammarStatePart);
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeLegs, kCommandGrammarStepPart,
+					  kCommandGrammarStatePart);
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeElevation, kCommandGrammarStepPart,
+					  kCommandGrammarStatePart);
+	setTransition(kCommandGrammarStatePart, CommandToken::kTypeRaise, kCommandGrammarStepMove,
+					  kCommandGrammarStateDirection);
+	setTransition(kCommandGrammarStatePart, CommandToken::kTypeLower, kCommandGrammarStepMove,
+					  kCommandGrammarStateDirection);
+	setTransition(kCommandGrammarStateDirection, CommandToken::kTypeInteger,
+					  kCommandGrammarStepDuration, kCommandGrammarStateStart);
+	setTransition(kCommandGrammarStatePart, CommandToken::kTypeTo, kCommandGrammarStepContinue,
+					  kCommandGrammarStateTo);
+	setTransition(kCommandGrammarStateTo, CommandToken::kTypeInteger, kCommandGrammarStepPosition,
+					  kCommandGrammarStatePosition);
+	setTransition(kCommandGrammarStatePosition, CommandToken::kTypePercent,
+					  kCommandGrammarStepContinue, kCommandGrammarStateStart);
+
+	// Stopping.
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeStop, kCommandGrammarStepStopAll,
+					  kCommandGrammarStateStart);
+
+	// Status.
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeStatus, kCommandGrammarStepStatus,
+					  kCommandGrammarStateStart);
+
+	// The routine, like "routine start".
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeRoutine,
+					  kCommandGrammarStepContinue, kCommandGrammarStateRoutine);
+	setTransition(kCommandGrammarStateRoutine, CommandToken::kTypeStart,
+					  kCommandGrammarStepRoutineStart, kCommandGrammarStateStart);
+	setTransition(kCommandGrammarStateRoutine, CommandToken::kTypeStop,
+					  kCommandGrammarStepRoutineStop, kCommandGrammarStateStart);
+
+	// Rebooting, which must be confirmed, like "reboot yes".
+	setTransition(kCommandGrammarStateStart, CommandToken::kTypeReboot,
+					  kCommandGrammarStepContinue, kCommandGrammarStateReboot);
+	setTransition(kCommandGrammarStateReboot, CommandToken::kTypeYes, kCommandGrammarStepReboot,
+					  kCommandGrammarStateStart);
+
+	return table;
+}
+
+// The command grammar.
+static constexpr CommandGrammarTable kCommandGrammarTable{ CommandBuildGrammarTable() };
+
 // Keep a handle to the input.
-static Input const* s_input = nullptr;
+static InputManager const* s_inputManager = nullptr;
+
+// The controls that the movement commands act on, looked up when the commands are initialized.
+static ControlHandle s_backControlHandle;
+static ControlHandle s_legsControlHandle;
+static ControlHandle s_elevationControlHandle;
 
 // Signals whether we are in the process of rebooting.
 static bool s_rebooting = false;
@@ -67,28 +359,87 @@ static bool s_rebooting = false;
 // Keep track of when we started the reboot process so we can time the delay.
 static Time s_rebootDelayStartTime;
 
+// Used to give up waiting on the reboot notification.
+static Scheduler* s_scheduler = nullptr;
+
+// The timer that will reboot regardless of the notification.
+static Scheduler::TimerID s_rebootTimerID = Scheduler::kInvalidTimerID;
+
 // Functions
 //
 
+// Actually perform the reboot.
+//
+// currentTime:	The time of the current tick.
+//
+static void CommandDoReboot(Time const& /* currentTime */)
+{
+	s_rebooting = false;
+	s_scheduler->CancelTimer(s_rebootTimerID);
+
+	Logger::WriteLine("Rebooting!");
+
+	sync();
+	reboot(RB_AUTOBOOT);
+}
+
+// Look up a control that commands can refer to.
+//
+// controlName:	The name of the control.
+//
+// Returns:	A handle to the control, which is invalid if there is no control with the name.
+//
+static ControlHandle CommandResolveControl(char const* controlName)
+{
+	auto const controlHandle = ControlHandle::Resolve(controlName);
+
+	if (controlHandle.IsValid() == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Commands refer to unknown control \""), controlName,
+								Shell::Yellow("\"."));
+	}
+
+	return controlHandle;
+}
+
 // Initialize the system.
 //
-// input:	The input device.
+// inputManager:	The input devices.
+// scheduler:		Used to give up waiting on the reboot notification.
 //
-void CommandInitialize(Input const& input)
+void CommandInitialize(InputManager const& inputManager, Scheduler& scheduler)
 {
-	s_input = &input;
+	s_inputManager = &inputManager;
+	s_scheduler = &scheduler;
+
+	// Look up the controls now, so parsing a command doesn't have to.
+	s_backControlHandle = CommandResolveControl("back");
+	s_legsControlHandle = CommandResolveControl("legs");
+	s_elevationControlHandle = CommandResolveControl("elev");
 }
 
 // Uninitialize the system.
 //
 void CommandUninitialize()
 {
-	s_input = nullptr;
+	if (s_scheduler != nullptr)
+	{
+		s_scheduler->CancelTimer(s_rebootTimerID);
+	}
+
+	s_inputManager = nullptr;
+	s_scheduler = nullptr;
+
+	s_backControlHandle = ControlHandle();
+	s_legsControlHandle = ControlHandle();
+	s_elevationControlHandle = ControlHandle();
 }
 
 // Process the system.
 //
-void CommandProcess()
+// currentTime:	The time of the current tick.
+//
+void CommandProcess(Time const& currentTime)
 {
 	// At the moment we only have per frame processing for rebooting.
 	if (s_rebooting == false)
@@ -96,259 +447,549 @@ void CommandProcess()
 		return;
 	}
 
-	// I don't really want to make a whole function for this, but will call it from multiple code 
-	// paths.
-	static constexpr auto DoReboot = []() -> void
-	{
-		s_rebooting = false;
-
-		Logger::WriteLine("Rebooting!");
-
-		sync();
-		reboot(RB_AUTOBOOT);
-	};
-
-	// If the notification is done, we can stop waiting.
+	// If the notification is done, we can stop waiting. Otherwise, the timer will reboot once we
+	// have waited long enough.
 	Time notificationFinishedTime;
 	NotificationGetLastPlayFinishedTime(notificationFinishedTime);
 
 	if (notificationFinishedTime > s_rebootDelayStartTime) 
 	{
-		DoReboot();
-		return;
+		CommandDoReboot(currentTime);
 	}
+}
 
-	// Wait for a maximum amount of time regardless.
-	Time rebootDelayCurrentTime;
-	TimerGetCurrent(rebootDelayCurrentTime);
-	
-	float const durationMS = TimerGetElapsedMilliseconds(s_rebootDelayStartTime, 
-																		  rebootDelayCurrentTime);
+// Get the control for a token.
+//
+// partType:	The token for the control.
+//
+// Returns:	The control, or null if there isn't one.
+//
+static Control* CommandGetControl(CommandToken::Types partType)
+{
+	switch (partType)
+	{
+		case CommandToken::kTypeBack:
+		{
+			return s_backControlHandle.GetControl();
+		}
 
-	auto const durationSeconds{static_cast<unsigned long>(durationMS) / 1'000};
+		case CommandToken::kTypeLegs:
+		{
+			return s_legsControlHandle.GetControl();
+		}
 
-	static constexpr unsigned long kDelayDurationSeconds{60u};
+		case CommandToken::kTypeElevation:
+		{
+			return s_elevationControlHandle.GetControl();
+		}
 
-	if (durationSeconds >= kDelayDurationSeconds)
-	{
-		DoReboot();
+		default:
+		{
+			Logger::WriteLine("Unrecognized token \"", kCommandTokenNames[partType],
+									"\" trying to process a control movement command.");
+		}
+		break;
 	}
+
+	return nullptr;
 }
 
-// Parse the command tokens into commands.
+// Add a command to a batch.
 //
-// commandTokens:	All of the potential tokens for the command.
+// batch:	(Input/Output) The batch.
+// type:		The type of the command.
 //
-// Returns:	A value signifying the result of the parsing.
+// Returns:	The command, or null if the batch is full.
 //
-CommandParseTokensReturnTypes CommandParseTokens(std::vector<CommandToken> const& commandTokens)
+static CommandBatchItem* CommandAddBatchItem(CommandBatch& batch, CommandResultItem::Types type)
 {
-	char const* confirmationText = nullptr;
-	return CommandParseTokens(confirmationText, commandTokens);
+	if (batch.m_count >= CommandBatch::kCapacity)
+	{
+		Logger::WriteLine("Ignoring a command because there are more than ", CommandBatch::kCapacity,
+								" in one message.");
+		return nullptr;
+	}
+
+	auto& item = batch.m_items[batch.m_count];
+	batch.m_count++;
+
+	item = CommandBatchItem();
+	item.m_type = type;
+	return &item;
 }
 
-// Parse the command tokens into commands.
+// Parse a list of command tokens into a batch of commands, following the command grammar.
 //
-// confirmationText:	(Output) In cases with missing confirmation, this is the confirmation 
-// 	 						prompt.
-// commandTokens:		All of the potential tokens for the command.
+// batch:			(Output) The commands, in order.
+// commandTokens:	All of the potential tokens for the commands.
+// tokenCount:		The number of tokens.
 //
-// Returns:	A value signifying the result of the parsing.
+// Returns:	The state of the grammar after the last token.
 //
-CommandParseTokensReturnTypes CommandParseTokens(char const*& confirmationText, 
-	std::vector<CommandToken> const& commandTokens)
+static CommandGrammarState CommandParseBatch(CommandBatch& batch, CommandToken const* commandTokens,
+	unsigned int tokenCount)
 {
-	// Parse command tokens.
-	auto const tokenCount = static_cast<unsigned int>(commandTokens.size());
-	for (unsigned int tokenIndex = 0; tokenIndex < tokenCount; tokenIndex++)
+	batch.m_count = 0u;
+
+	auto state = kCommandGrammarStateStart;
+	auto partType = CommandToken::kTypeInvalid;
+	CommandBatchItem* lastMoveItem = nullptr;
+
+	for (unsigned int tokenIndex = 0u; tokenIndex < tokenCount; tokenIndex++)
 	{
-		// Parse commands.
-		auto token = commandTokens[tokenIndex];
-		switch (token.m_type)
+		auto const& token = commandTokens[tokenIndex];
+		auto const& transition = kCommandGrammarTable[state][CommandGetGrammarColumn(token.m_type)];
+
+		state = transition.m_nextState;
+
+		switch (transition.m_step)
 		{
-			case CommandToken::kTypeBack:			// Fall through...
-			case CommandToken::kTypeLegs:			// Fall through...
-			case CommandToken::kTypeElevation:	
+			case kCommandGrammarStepSkip:
+			case kCommandGrammarStepContinue:
 			{
-				// Try to access the control corresponding to the command token.
-				Control* control = nullptr;
-				
-				switch (token.m_type)
-				{
-					case CommandToken::kTypeBack:
-					{
-						control = Control::GetByName("back");
-					}
-					break;
-					
-					case CommandToken::kTypeLegs:
-					{						
-						control = Control::GetByName("legs");
-					}
-					break;
-					
-					case CommandToken::kTypeElevation:
-					{
-						control = Control::GetByName("elev");
-					}
-					break;
-					
-					default:
-					{
-						Logger::WriteLine("Unrecognized token \"", kCommandTokenNames[token.m_type],
-												"\" trying to process a control movement "
-												"command.");
-					}
-					break;
-				}
-			
-				if (control == nullptr)
-				{
-					break;
-				}			
-			
-				// Next token.
-				tokenIndex++;
-				if (tokenIndex >= tokenCount)
-				{
-					break;
-				}
-				
-				token = commandTokens[tokenIndex];
-				
-				// Try to get the action which should be performed on the control.
-				auto action = Control::kActionStopped;
-				
-				if (token.m_type == CommandToken::kTypeRaise)
-				{
-					action = Control::kActionMovingUp;
-				}
-				else if (token.m_type == CommandToken::kTypeLower)
+			}
+			break;
+
+			case kCommandGrammarStepRestart:
+			{
+				// Look at the token again, as the start of a new command.
+				tokenIndex--;
+			}
+			break;
+
+			case kCommandGrammarStepPart:
+			{
+				partType = token.m_type;
+			}
+			break;
+
+			case kCommandGrammarStepMove:
+			{
+				lastMoveItem = CommandAddBatchItem(batch, CommandResultItem::kTypeMove);
+
+				if (lastMoveItem != nullptr)
 				{
-					action = Control::kActionMovingDown;
+					lastMoveItem->m_partType = partType;
+					lastMoveItem->m_action = (token.m_type == CommandToken::kTypeRaise) ?
+						Control::kActionMovingUp : Control::kActionMovingDown;
 				}
-				
-				if (action == Control::kActionStopped)
+			}
+			break;
+
+			case kCommandGrammarStepDuration:
+			{
+				if (lastMoveItem != nullptr)
 				{
-					break;
+					lastMoveItem->m_parameter = token.m_parameter;
 				}
-				
-				// Determine the duration percent.
-				unsigned int durationPercent = 100;
-				
-				// Peak at the next token.
-				auto const nextTokenIndex = tokenIndex + 1;
-				if (nextTokenIndex < tokenCount)
+			}
+			break;
+
+			case kCommandGrammarStepPosition:
+			{
+				auto* const item = CommandAddBatchItem(batch, CommandResultItem::kTypeMoveToPosition);
+
+				if (item != nullptr)
 				{
-					auto const nextToken = commandTokens[nextTokenIndex];
-					
-					if (nextToken.m_type == CommandToken::kTypeInteger)
-					{
-						durationPercent = nextToken.m_parameter;
-						
-						// Actually consume this token.
-						tokenIndex++;
-					}
+					item->m_partType = partType;
+					item->m_parameter = token.m_parameter;
 				}
-				
-				
-				control->SetDesiredAction(action, Control::kModeTimed, durationPercent);
+			}
+			break;
 
-				ReportsAddControlItem(control->GetName(), action, "command");
-				return CommandParseTokensReturnTypes::kSuccess;
+			case kCommandGrammarStepStopAll:
+			{
+				CommandAddBatchItem(batch, CommandResultItem::kTypeStopAll);
 			}
-			
-			case CommandToken::kTypeStop:
+			break;
+
+			case kCommandGrammarStepStatus:
 			{
-				// Stop controls.
-				ControlsStopAll();			
+				CommandAddBatchItem(batch, CommandResultItem::kTypeStatus);
+			}
+			break;
 
-				ReportsAddControlItem("all", Control::kActionStopped, "command");
-				return CommandParseTokensReturnTypes::kSuccess;
+			case kCommandGrammarStepRoutineStart:
+			{
+				CommandAddBatchItem(batch, CommandResultItem::kTypeRoutineStart);
+			}
+			break;
+
+			case kCommandGrammarStepRoutineStop:
+			{
+				CommandAddBatchItem(batch, CommandResultItem::kTypeRoutineStop);
+			}
+			break;
+
+			case kCommandGrammarStepReboot:
+			{
+				CommandAddBatchItem(batch, CommandResultItem::kTypeReboot);
 			}
-			
-			case CommandToken::kTypeRoutine:
+			break;
+
+			case kCommandGrammarStepRebootCancel:
 			{
-				// Next token.
-				tokenIndex++;
-				if (tokenIndex >= tokenCount)
+				CommandAddBatchItem(batch, CommandResultItem::kTypeRebootCanceled);
+			}
+			break;
+		}
+	}
+
+	return state;
+}
+
+// Play the status notifications and log the statistics.
+//
+static void CommandPlayStatus()
+{
+	// Play status notification.
+	NotificationPlay("running");
+
+	if (RoutineIsRunning() == true)
+	{
+		NotificationPlay("routine_running");
+	}
+
+	if ((s_inputManager != nullptr) && (s_inputManager->IsConnected() == true))
+	{
+		NotificationPlay("control_connected");
+	}
+
+	ReportsAddStatusItem();
+
+	// Log how long ticks have been taking, to help track down lag.
+	ProfilerLogStatistics();
+	ControlThreadLogStatistics();
+	ControlQueueLogStatistics();
+	ControlsLogStatistics();
+	SocketServerLogStatistics();
+	GPIOLogStatistics();
+
+	if (s_inputManager != nullptr)
+	{
+		s_inputManager->LogStatistics();
+	}
+}
+
+// Kick off the reboot, once the notification has played.
+//
+static void CommandStartReboot()
+{
+	s_rebooting = true;
+	TimerGetCurrent(s_rebootDelayStartTime);
+
+	// Wait for a maximum amount of time regardless.
+	if (s_scheduler != nullptr)
+	{
+		s_scheduler->CancelTimer(s_rebootTimerID);
+		s_rebootTimerID = s_scheduler->AddTimer(kRebootDelayDurationMS, CommandDoReboot);
+	}
+
+	Logger::WriteLine("Reboot starting!");
+	NotificationPlay("restarting");
+}
+
+// Report a command that was carried out.
+//
+// result:	(Input/Output) The result to add the command to.
+// item:		The command.
+// control:	The control, for moves, or null.
+//
+static void CommandAddResultItem(CommandResult& result, CommandBatchItem const& item,
+	Control const* control)
+{
+	// There is room for every command in a batch.
+	auto& resultItem = result.m_items[result.m_count];
+	result.m_count++;
+
+	resultItem.m_type = item.m_type;
+	resultItem.m_controlName = (control != nullptr) ? control->GetName() : nullptr;
+	resultItem.m_action = item.m_action;
+	resultItem.m_parameter = item.m_parameter;
+}
+
+// Carry out a batch of commands. The control requests are queued together, so that they are
+// applied in the same tick. Moves are only reported once they have been queued.
+//
+// result:	(Input/Output) The commands that were carried out are added to this.
+// batch:	The commands, in order.
+//
+// Returns:	True if any of the commands were carried out, false otherwise.
+//
+static bool CommandExecuteBatch(CommandResult& result, CommandBatch const& batch)
+{
+	ControlRequestBatch controlRequests;
+
+	// The control of each move that was requested, or null.
+	std::array<Control const*, CommandBatch::kCapacity> requestedControls{};
+
+	for (unsigned int itemIndex = 0u; itemIndex < batch.m_count; itemIndex++)
+	{
+		auto const& item = batch.m_items[itemIndex];
+
+		switch (item.m_type)
+		{
+			case CommandResultItem::kTypeMove:
+			{
+				auto const* control = CommandGetControl(item.m_partType);
+
+				if (control == nullptr)
 				{
 					break;
 				}
-				
-				token = commandTokens[tokenIndex];
-			
-				if (token.m_type == CommandToken::kTypeStart)
-				{
-					RoutineStart();
-					return CommandParseTokensReturnTypes::kSuccess;
-				}
-				else if (token.m_type == CommandToken::kTypeStop)
-				{
-					RoutineStop();
-					return CommandParseTokensReturnTypes::kSuccess;
-				}			
+
+				controlRequests.AddAction(*control, item.m_action, Control::kModeTimed,
+					item.m_parameter);
+				requestedControls[itemIndex] = control;
 			}
 			break;
-			
-			case CommandToken::kTypeStatus:
+
+			case CommandResultItem::kTypeMoveToPosition:
 			{
-				// Play status notification.
-				NotificationPlay("running");
-				
-				if (RoutineIsRunning() == true)
+				auto const* control = CommandGetControl(item.m_partType);
+
+				if (control == nullptr)
 				{
-					NotificationPlay("routine_running");
+					break;
 				}
-				
-				if ((s_input != nullptr) && (s_input->IsConnected() == true))
+
+				auto const targetPercent = item.m_parameter;
+
+				if (targetPercent > 100u)
 				{
-					NotificationPlay("control_connected");
+					Logger::WriteLine("Ignoring move to ", targetPercent,
+											" percent because it is out of range.");
+					break;
 				}
 
-				ReportsAddStatusItem();
-				return CommandParseTokensReturnTypes::kSuccess;
+				controlRequests.AddPosition(*control, targetPercent);
+				requestedControls[itemIndex] = control;
+			}
+			break;
+
+			case CommandResultItem::kTypeStopAll:
+			{
+				controlRequests.AddStopAll();
+			}
+			break;
+
+			default:
+			{
 			}
+			break;
+		}
+	}
+
+	// A stop is never dropped, even when the moves with it are.
+	auto const queued = controlRequests.Submit();
+
+	if (queued == false)
+	{
+		Logger::WriteLine(Shell::Red("Dropped a command because the controls are too far behind."));
+		result.m_controlRequestsDropped = true;
+	}
 
-			case CommandToken::kTypeReboot:
+	bool executed = false;
+
+	for (unsigned int itemIndex = 0u; itemIndex < batch.m_count; itemIndex++)
+	{
+		auto const& item = batch.m_items[itemIndex];
+		auto const* control = requestedControls[itemIndex];
+
+		switch (item.m_type)
+		{
+			case CommandResultItem::kTypeMove:
 			{
-				// Next token.
-				tokenIndex++;
-				if (tokenIndex >= tokenCount)
+				// A stop is kept even when the moves with it are dropped.
+				if ((control == nullptr) ||
+					 ((queued == false) && (item.m_action != Control::kActionStopped)))
 				{
-					confirmationText = "Are you sure you want to reboot?";
-					return CommandParseTokensReturnTypes::kMissingConfirmation;
+					break;
 				}
 
-				token = commandTokens[tokenIndex];
+				ReportsAddControlItem(control->GetName(), item.m_action, "command");
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
 
-				// Only a positive confirmation is accepted.
-				if (token.m_type != CommandToken::kTypeYes)
+			case CommandResultItem::kTypeMoveToPosition:
+			{
+				if ((control == nullptr) || (queued == false))
 				{
-					Logger::WriteLine("Ignoring reboot command because it was not followed by "
-											"a positive confirmation.");
-					NotificationPlay("canceled");
 					break;
 				}
 
-				// Kick off the reboot.
-				s_rebooting = true;
-				TimerGetCurrent(s_rebootDelayStartTime);
+				ReportsAddControlPositionItem(control->GetName(), item.m_parameter, "command");
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
 
-				Logger::WriteLine("Reboot starting!");
-				NotificationPlay("restarting");
+			case CommandResultItem::kTypeStopAll:
+			{
+				ReportsAddControlItem("all", Control::kActionStopped, "command");
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
 
-				return CommandParseTokensReturnTypes::kSuccess;
+			case CommandResultItem::kTypeStatus:
+			{
+				CommandPlayStatus();
+				CommandAddResultItem(result, item, control);
+				executed = true;
 			}
-			
-			default:	
+			break;
+
+			case CommandResultItem::kTypeRoutineStart:
 			{
+				RoutineStart();
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
+
+			case CommandResultItem::kTypeRoutineStop:
+			{
+				RoutineStop();
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
+
+			case CommandResultItem::kTypeReboot:
+			{
+				CommandStartReboot();
+				CommandAddResultItem(result, item, control);
+				executed = true;
+			}
+			break;
+
+			case CommandResultItem::kTypeRebootCanceled:
+			{
+				Logger::WriteLine("Ignoring reboot command because it was not followed by "
+										"a positive confirmation.");
+				NotificationPlay("canceled");
+				CommandAddResultItem(result, item, control);
 			}
 			break;
 		}
 	}
 
-	return CommandParseTokensReturnTypes::kInvalid;
+	return executed;
+}
+
+// Parse a list of command tokens into commands, and carry them out together.
+//
+// result:			(Output) The result of parsing, and the commands that were carried out.
+// commandTokens:	All of the potential tokens for the commands.
+// tokenCount:		The number of tokens.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+static CommandParseTokensReturnTypes CommandParseTokenList(CommandResult& result,
+	CommandToken const* commandTokens, unsigned int tokenCount)
+{
+	result = CommandResult();
+
+	CommandBatch batch;
+	auto const finalState = CommandParseBatch(batch, commandTokens, tokenCount);
+
+	// Nothing is done until the reboot is confirmed, since the tokens will be parsed again then.
+	if (finalState == kCommandGrammarStateReboot)
+	{
+		result.m_confirmationText = "Are you sure you want to reboot?";
+		result.m_returnType = CommandParseTokensReturnTypes::kMissingConfirmation;
+		return result.m_returnType;
+	}
+
+	if (CommandExecuteBatch(result, batch) == false)
+	{
+		result.m_returnType = CommandParseTokensReturnTypes::kInvalid;
+		return result.m_returnType;
+	}
+
+	result.m_returnType = CommandParseTokensReturnTypes::kSuccess;
+	return result.m_returnType;
+}
+
+// Parse the command tokens into commands.
+//
+// commandTokens:	All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(std::vector<CommandToken> const& commandTokens)
+{
+	char const* confirmationText = nullptr;
+	return CommandParseTokens(confirmationText, commandTokens);
+}
+
+// Parse the command tokens into commands.
+//
+// confirmationText:	(Output) In cases with missing confirmation, this is the confirmation
+// 	 						prompt.
+// commandTokens:		All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(char const*& confirmationText,
+	std::vector<CommandToken> const& commandTokens)
+{
+	CommandResult result;
+	CommandParseTokenList(result, commandTokens.data(),
+								 static_cast<unsigned int>(commandTokens.size()));
+
+	if (result.m_confirmationText != nullptr)
+	{
+		confirmationText = result.m_confirmationText;
+	}
+
+	return result.m_returnType;
+}
+
+// Parse the command tokens into commands.
+//
+// commandTokens:	All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(CommandTokenBuffer const& commandTokens)
+{
+	CommandResult result;
+	return CommandParseTokens(result, commandTokens);
+}
+
+// Parse the command tokens into commands, and describe what was done.
+//
+// result:			(Output) The result of parsing, and the commands that were carried out.
+// commandTokens:	All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(CommandResult& result,
+	CommandTokenBuffer const& commandTokens)
+{
+	return CommandParseTokenList(result, commandTokens.m_tokens.data(), commandTokens.m_count);
+}
+
+// Get the name of a result of parsing, like "success".
+//
+// returnType:	The result of parsing.
+//
+char const* CommandGetReturnTypeName(CommandParseTokensReturnTypes returnType)
+{
+	return kCommandReturnTypeNames[static_cast<int>(returnType)];
+}
+
+// Get the name of a type of command that was carried out, like "move to position".
+//
+// type:	The type of command.
+//
+char const* CommandGetResultItemTypeName(CommandResultItem::Types type)
+{
+	return kCommandResultItemTypeNames[type];
 }
 
 // Take a token string and convert it into a token type, if possible.
@@ -357,72 +998,94 @@ CommandParseTokensReturnTypes CommandParseTokens(char const*& confirmationText,
 // 
 // Returns:	The corresponding token type or invalid if one couldn't be found.
 // 
-static CommandToken::Types CommandConvertStringToTokenType(std::string const& tokenString)
+static CommandToken::Types CommandConvertStringToTokenType(std::string_view tokenString)
 {
-	// Try to find it in the map.
-	auto const resultIterator = s_commandTokenNameToTypeMap.find(tokenString);
+	// Find the first name that isn't before the string.
+	auto const resultIterator = std::lower_bound(std::begin(kCommandTokenVocabulary),
+		std::end(kCommandTokenVocabulary), tokenString,
+		[](CommandTokenName const& tokenName, std::string_view name)
+		{
+			return tokenName.m_name < name;
+		});
 
-	if (resultIterator == s_commandTokenNameToTypeMap.end()) 
+	if ((resultIterator == std::end(kCommandTokenVocabulary)) ||
+		 (resultIterator->m_name != tokenString))
 	{		
 		// No match.
 		return CommandToken::kTypeInvalid;
 	}
 
 	// Found it!
-	return resultIterator->second;
+	return resultIterator->m_type;
 }
 
-// Take a command string and turn it into a list of tokens.
+// Take a command string and turn it into a list of tokens. This doesn't allocate.
 //
 // commandTokens:	(Output) The resulting command tokens, in order.
 // commandString:	The command string to tokenize.
 //
-void CommandTokenizeString(std::vector<CommandToken>& commandTokens, 
-	std::string const& commandString)
+void CommandTokenizeString(CommandTokenBuffer& commandTokens, std::string_view commandString)
 {
+	commandTokens.m_count = 0u;
+
 	// Get the first token string start.
-	auto nextTokenStringStart = std::string::size_type{0};
+	auto nextTokenStringStart = std::string_view::size_type{0};
 
-	while (nextTokenStringStart != std::string::npos)
+	while (nextTokenStringStart != std::string_view::npos)
 	{
+		if (commandTokens.m_count >= CommandTokenBuffer::kCapacity)
+		{
+			Logger::WriteLine("Ignoring the rest of the command because it has more than ",
+									CommandTokenBuffer::kCapacity, " tokens.");
+			break;
+		}
+
 		// Get the next token string end.
 		auto const nextTokenStringEnd = commandString.find(' ', nextTokenStringStart);
 
-		// Get the token string.
-		auto const tokenStringLength = (nextTokenStringEnd != std::string::npos) ? 
-			(nextTokenStringEnd - nextTokenStringStart) : commandString.size();
-		auto tokenString = commandString.substr(nextTokenStringStart, tokenStringLength);
+		// Get the token string. At the last token, this takes the rest of the command string.
+		auto const tokenString = commandString.substr(nextTokenStringStart,
+			nextTokenStringEnd - nextTokenStringStart);
+
+		auto& token = commandTokens.m_tokens[commandTokens.m_count];
+		token = CommandToken();
 
-		// Make sure the token string is lowercase.
-		for (auto& character : tokenString)
+		// Match the lowercase token string to a token (with no parameter) if possible. Anything
+		// longer than every name can't be one.
+		if (tokenString.size() <= kCommandMaxTokenNameLength)
 		{
-			character = std::tolower(character, std::locale::classic());
-		}
+			char lowercaseCharacters[kCommandMaxTokenNameLength];
 
-		// Match the token string to a token (with no parameter) if possible.
-		CommandToken token;
-		token.m_type = CommandConvertStringToTokenType(tokenString);
+			std::transform(tokenString.begin(), tokenString.end(), lowercaseCharacters,
+				[](char character)
+				{
+					return ((character >= 'A') && (character <= 'Z')) ?
+						static_cast<char>(character - 'A' + 'a') : character;
+				});
+
+			token.m_type = CommandConvertStringToTokenType(std::string_view(lowercaseCharacters,
+				tokenString.size()));
+		}
 
 		// If we couldn't turn it into a plain old token, see if it is a parameter token.
 		if (token.m_type == CommandToken::kTypeInvalid)
 		{
-			std::string_view const tokenStringView(tokenString);
-
 			// Attempt to parse the string into a number; save result into `token.m_parameter`.
-			auto const [endPointer, errorCode] = std::from_chars(tokenStringView.begin(),
-																				  tokenStringView.end(),
+			auto const [endPointer, errorCode] = std::from_chars(tokenString.data(),
+																				  tokenString.data() +
+																				  tokenString.size(),
 																				  token.m_parameter);
 
 			// Check if successfully parsed to number and matched whole string.
-			if (errorCode == std::errc() and endPointer == tokenStringView.end())
+			if (errorCode == std::errc() and endPointer == tokenString.data() + tokenString.size())
 			{
 				token.m_type = CommandToken::kTypeInteger;
 			}
 
 		}
 
-		// Add the token to the list.
-		commandTokens.push_back(token);
+		// Keep the token.
+		commandTokens.m_count++;
 
 		// Get the next token string start (skip delimiter).
 		nextTokenStringStart = nextTokenStringEnd;
@@ -610,9 +1273,11 @@ void CommandTokenizeJSONDocument(std::vector<CommandToken>& commandTokens,
 		std::vector<SlotNameValue> slots;
 		CommandExtractSlotsFromJSONDocument(slots, commandDocument);
 
-		// We are looking to fill out two tokens, the part and the direction.
+		// We are looking to fill out two tokens, the part and the direction. A position can be
+		// given instead of the direction.
 		CommandToken partToken;
 		CommandToken directionToken;
+		CommandToken positionToken;
 
 		for (auto const& slot : slots)
 		{
@@ -629,8 +1294,37 @@ void CommandTokenizeJSONDocument(std::vector<CommandToken>& commandTokens,
 				directionToken.m_type = CommandConvertStringToTokenType(slot.m_value);
 				continue;
 			}			
+
+			// This is the position slot.
+			if (slot.m_name.compare("position") == 0)
+			{
+				auto const& value = slot.m_value;
+				auto const [endPointer, errorCode] = std::from_chars(value.data(),
+					value.data() + value.size(), positionToken.m_parameter);
+
+				if ((errorCode == std::errc()) && (endPointer == value.data() + value.size()))
+				{
+					positionToken.m_type = CommandToken::kTypeInteger;
+				}
+
+				continue;
+			}
 		}	
 
+		if ((partToken.m_type != CommandToken::kTypeInvalid) &&
+			(positionToken.m_type != CommandToken::kTypeInvalid))
+		{
+			Logger::WriteLine("Recognized a ", intentName, " intent.");
+
+			CommandToken toToken;
+			toToken.m_type = CommandToken::kTypeTo;
+
+			commandTokens.push_back(partToken);
+			commandTokens.push_back(toToken);
+			commandTokens.push_back(positionToken);
+			return;
+		}
+
 		if ((partToken.m_type == CommandToken::kTypeInvalid) || 
 			(directionToken.m_type == CommandToken::kTypeInvalid))
 		{
@@ -1,11 +1,16 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstddef>
 
 #include "rapidjson/document.h"
 
+#include "control.h"
+#include "scheduler.h"
+
 // Types
 //
 
@@ -29,6 +34,8 @@ struct CommandToken
 		kTypeReboot, 
 		kTypeYes, 
 		kTypeNo, 
+		kTypeTo,
+		kTypePercent,
 		
 		kTypeNotParameterCount, 
 		
@@ -45,6 +52,19 @@ struct CommandToken
 	unsigned int m_parameter = 0u;
 };
 
+// A fixed capacity list of command tokens, so that tokenizing a command doesn't allocate.
+struct CommandTokenBuffer
+{
+	// The most tokens a command can have. Any after this are ignored.
+	static constexpr unsigned int kCapacity{ 16u };
+
+	// The tokens, in order.
+	std::array<CommandToken, kCapacity> m_tokens;
+
+	// How many of the tokens are valid.
+	unsigned int m_count = 0u;
+};
+
 // Potential return values from parsing tokens.
 enum class CommandParseTokensReturnTypes
 {
@@ -53,14 +73,66 @@ enum class CommandParseTokensReturnTypes
 	kMissingConfirmation, 
 };
 
+// A command that was carried out, as reported back to whoever sent it.
+struct CommandResultItem
+{
+	// Types of commands.
+	enum Types
+	{
+		kTypeMove = 0,
+		kTypeMoveToPosition,
+		kTypeStopAll,
+		kTypeStatus,
+		kTypeRoutineStart,
+		kTypeRoutineStop,
+		kTypeReboot,
+		kTypeRebootCanceled,
+	};
+
+	// The type of the command.
+	Types m_type = kTypeStatus;
+
+	// The name of the control, for moves, or null.
+	char const* m_controlName = nullptr;
+
+	// The direction, for moves in a direction.
+	Control::Actions m_action = Control::kActionStopped;
+
+	// The duration percent, for moves in a direction, or the position, for moves to a position.
+	unsigned int m_parameter = 0u;
+};
+
+// What came of parsing a message and carrying out its commands.
+struct CommandResult
+{
+	// The most commands that are reported. This is as many as a message can have.
+	static constexpr unsigned int kCapacity{ ControlRequestBatch::kCapacity };
+
+	// The result of parsing.
+	CommandParseTokensReturnTypes m_returnType = CommandParseTokensReturnTypes::kInvalid;
+
+	// The confirmation prompt, if the confirmation is missing, or null.
+	char const* m_confirmationText = nullptr;
+
+	// The commands that were carried out, in order.
+	std::array<CommandResultItem, kCapacity> m_items;
+
+	// How many of the commands are valid.
+	unsigned int m_count = 0u;
+
+	// Whether the moves were dropped because the controls are too far behind.
+	bool m_controlRequestsDropped = false;
+};
+
 // Functions
 //
 
 // Initialize the system.
 //
-// input:	The input device.
+// inputManager:	The input devices.
+// scheduler:		Used to give up waiting on the reboot notification.
 //
-void CommandInitialize(class Input const& input);
+void CommandInitialize(class InputManager const& inputManager, Scheduler& scheduler);
 
 // Uninitialize the system.
 //
@@ -68,7 +140,9 @@ void CommandUninitialize();
 
 // Process the system.
 //
-void CommandProcess();
+// currentTime:	The time of the current tick.
+//
+void CommandProcess(Time const& currentTime);
 
 // Parse the command tokens into commands.
 //
@@ -89,13 +163,42 @@ CommandParseTokensReturnTypes CommandParseTokens(std::vector<CommandToken> const
 CommandParseTokensReturnTypes CommandParseTokens(char const*& confirmationText, 
 	std::vector<CommandToken> const& commandTokens);
 
-// Take a command string and turn it into a list of tokens.
+// Parse the command tokens into commands.
+//
+// commandTokens:	All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(CommandTokenBuffer const& commandTokens);
+
+// Parse the command tokens into commands, and describe what was done.
+//
+// result:			(Output) The result of parsing, and the commands that were carried out.
+// commandTokens:	All of the potential tokens for the command.
+//
+// Returns:	A value signifying the result of the parsing.
+//
+CommandParseTokensReturnTypes CommandParseTokens(CommandResult& result,
+	CommandTokenBuffer const& commandTokens);
+
+// Get the name of a result of parsing, like "success".
+//
+// returnType:	The result of parsing.
+//
+char const* CommandGetReturnTypeName(CommandParseTokensReturnTypes returnType);
+
+// Get the name of a type of command that was carried out, like "move to position".
+//
+// type:	The type of command.
+//
+char const* CommandGetResultItemTypeName(CommandResultItem::Types type);
+
+// Take a command string and turn it into a list of tokens. This doesn't allocate.
 //
 // commandTokens:	(Output) The resulting command tokens, in order.
 // commandString:	The command string to tokenize.
 //
-void CommandTokenizeString(std::vector<CommandToken>& commandTokens, 
-	std::string const& commandString);
+void CommandTokenizeString(CommandTokenBuffer& commandTokens, std::string_view commandString);
 
 // Take a command JSON document and turn it into a list of tokens.
 //
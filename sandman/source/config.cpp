@@ -18,11 +18,6 @@
 
 // Config members
 
-Config::Config()
-{
-	m_inputDeviceName[0] = '\0';
-}
-
 // Read the configuration from a file.
 // 
 // configFileName:	The name of the config file.
@@ -89,6 +84,17 @@ bool Config::ReadFromFile(char const* configFileName)
 		}
 	}
 
+	// If there are GPIO settings, try to read them.
+	auto const gpioSettingsIterator = configDocument.FindMember("gpioSettings");
+
+	if (gpioSettingsIterator != configDocument.MemberEnd())
+	{
+		if (ReadGPIOSettingsFromJSON(gpioSettingsIterator->value) == false)
+		{
+			Logger::WriteLine(Shell::Red("Encountered error trying to read GPIO settings."));
+		}
+	}
+
 	fclose(configFile);
 	return true;
 }
@@ -129,6 +135,41 @@ bool Config::ReadControlSettingsFromJSON(rapidjson::Value const& object)
 		}
 	}
 
+	// Try to get the most controls that can move at once.
+	auto const maxMovingControlsIterator = object.FindMember("maxMovingControls");
+
+	if (maxMovingControlsIterator != object.MemberEnd())
+	{
+		if (maxMovingControlsIterator->value.IsUint() == true)
+		{
+			m_controlMaxMovingControls = maxMovingControlsIterator->value.GetUint();
+		}
+	}
+
+	// Try to get the time between controls starting to move.
+	auto const startStaggerIterator = object.FindMember("startStaggerMS");
+
+	if (startStaggerIterator != object.MemberEnd())
+	{
+		if (startStaggerIterator->value.IsUint() == true)
+		{
+			m_controlStartStaggerMS = startStaggerIterator->value.GetUint();
+		}
+	}
+
+	// The control thread is optional, if it's missing the controls run on the main thread.
+	auto const controlThreadIterator = object.FindMember("controlThread");
+
+	if (controlThreadIterator != object.MemberEnd())
+	{
+		if (m_controlThreadConfig.ReadFromJSON(controlThreadIterator->value) == false)
+		{
+			Logger::WriteLine(Shell::Red("Config control settings has a control thread, but it "
+												  "could not be read."));
+			return false;
+		}
+	}
+
 	// A controls array is required, but it may be empty.
 	m_controlConfigs.clear();
 
@@ -191,71 +232,76 @@ bool Config::ReadInputSettingsFromJSON(rapidjson::Value const& object)
 		return false;
 	}
 
-	rapidjson::Value const& inputDevices = inputDevicesIterator->value;
+	m_inputDeviceConfigs.clear();
 
-	// In the future we may support multiple input devices, but for now we will just read the first
-	// one.
-	if (inputDevices.Size() == 0)
+	for (auto const& inputDeviceObject : inputDevicesIterator->value.GetArray())
 	{
-		return true;
-	}
-
-	rapidjson::Value const& inputDevice = inputDevices[0];
+		// Try to read the input device.
+		InputDeviceConfig inputDeviceConfig;
+		if (inputDeviceConfig.ReadFromJSON(inputDeviceObject) == false)
+		{
+			continue;
+		}
 
-	if (inputDevice.IsObject() == false)
-	{
-		Logger::WriteLine(Shell::Red("Config has an input device that is not an object."));
-		return false;
+		// If we successfully read an input device, add it to the list.
+		m_inputDeviceConfigs.push_back(inputDeviceConfig);
 	}
 
-	// We must have a device name.
-	auto const deviceIterator = inputDevice.FindMember("device");
-
-	if (deviceIterator == object.MemberEnd())
-	{
-		Logger::WriteLine(Shell::Red("Config input device is missing the device name."));
-		return false;
-	}
+	return true;
+}
 
-	if (deviceIterator->value.IsString() == false)
+// Read GPIO settings from JSON.
+//
+// object:	The JSON object representing the GPIO settings.
+//
+// Returns:		True if the settings were read successfully, false otherwise.
+//
+bool Config::ReadGPIOSettingsFromJSON(rapidjson::Value const& object)
+{
+	if (object.IsObject() == false)
 	{
-		Logger::WriteLine(Shell::Red("Config input device name is not a string."));
+		Logger::WriteLine(Shell::Red("Config has a GPIO settings member, but it's not an object."));
 		return false;
 	}
-	
-	// Copy no more than the amount of text the buffer can hold.
-	strncpy(m_inputDeviceName, deviceIterator->value.GetString(), sizeof(m_inputDeviceName) - 1);
-	m_inputDeviceName[sizeof(m_inputDeviceName) - 1] = '\0';
-
-	// We must have a bindings array, but it can be empty.
-	m_inputBindings.clear();
 
-	auto const bindingsIterator = inputDevice.FindMember("bindings");
+	auto const simulateIterator = object.FindMember("simulate");
 
-	if (bindingsIterator == inputDevice.MemberEnd())
+	if (simulateIterator != object.MemberEnd())
 	{
-		Logger::WriteLine(Shell::Red("Config input device is missing a bindings array."));
-		return false;
-	}
+		if (simulateIterator->value.IsBool() == false)
+		{
+			Logger::WriteLine(Shell::Red("Config GPIO settings simulate is not a boolean."));
+			return false;
+		}
 
-	if (bindingsIterator->value.IsArray() == false)
-	{
-		Logger::WriteLine(Shell::Red("Config input device bindings exists, but it is not an array."));
-		return false;
+		m_simulateGPIO = simulateIterator->value.GetBool();
 	}
 
-	for (auto const& bindingObject : bindingsIterator->value.GetArray())
+	auto const formatIterator = object.FindMember("timelineFormat");
+
+	if (formatIterator != object.MemberEnd())
 	{
-		// Try to read the binding.
-		InputBinding binding;
-		if (binding.ReadFromJSON(bindingObject) == false)
+		if (formatIterator->value.IsString() == false)
 		{
-			continue;
+			Logger::WriteLine(Shell::Red("Config GPIO settings timeline format is not a string."));
+			return false;
 		}
 
-		// If we successfully read a binding, add it to the list.
-		m_inputBindings.push_back(binding);
+		if (std::strcmp(formatIterator->value.GetString(), "csv") == 0)
+		{
+			m_gpioTimelineFormat = kGPIOTimelineFormatCSV;
+		}
+		else if (std::strcmp(formatIterator->value.GetString(), "json") == 0)
+		{
+			m_gpioTimelineFormat = kGPIOTimelineFormatJSON;
+		}
+		else
+		{
+			Logger::WriteLine(Shell::Red("Config GPIO settings timeline format is not \"csv\" or "
+												  "\"json\"."));
+			return false;
+		}
 	}
 
 	return true;
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "control_thread.h"
+#include "gpio.h"
 #include "input.h"
 
 // Types
@@ -10,8 +12,6 @@
 class Config
 {
 	public:
-	
-		Config();
 		
 		// Read the configuration from a file.
 		// 
@@ -23,14 +23,9 @@ class Config
 		
 		// Accessors.
 		
-		char const* GetInputDeviceName() const
-		{
-			return m_inputDeviceName;
-		}
-		
-		std::vector<InputBinding> const& GetInputBindings() const
+		std::vector<InputDeviceConfig> const& GetInputDeviceConfigs() const
 		{
-			return m_inputBindings;
+			return m_inputDeviceConfigs;
 		}
 		
 		unsigned int GetControlMaxMovingDurationMS() const
@@ -43,10 +38,35 @@ class Config
 			return m_controlCoolDownDurationMS;
 		}
 		
+		unsigned int GetControlMaxMovingControls() const
+		{
+			return m_controlMaxMovingControls;
+		}
+
+		unsigned int GetControlStartStaggerMS() const
+		{
+			return m_controlStartStaggerMS;
+		}
+
 		std::vector<ControlConfig> const& GetControlConfigs() const
 		{
 			return m_controlConfigs;
 		}
+
+		ControlThreadConfig const& GetControlThreadConfig() const
+		{
+			return m_controlThreadConfig;
+		}
+
+		bool GetSimulateGPIO() const
+		{
+			return m_simulateGPIO;
+		}
+
+		GPIOTimelineFormat GetGPIOTimelineFormat() const
+		{
+			return m_gpioTimelineFormat;
+		}
 		
 	private:
 	
@@ -66,22 +86,39 @@ class Config
 		//
 		bool ReadInputSettingsFromJSON(rapidjson::Value const& object);
 
-		// Constants.
-		static constexpr unsigned int kInputDeviceNameCapacity{ 64u };
-		
-		// The name of the input device.
-		char m_inputDeviceName[kInputDeviceNameCapacity];
-							
-		// The list of input bindings.
-		std::vector<InputBinding> m_inputBindings;
+		// Read GPIO settings from JSON.
+		//
+		// object:	The JSON object representing the GPIO settings.
+		//
+		// Returns:		True if the settings were read successfully, false otherwise.
+		//
+		bool ReadGPIOSettingsFromJSON(rapidjson::Value const& object);
+
+		// The input devices and their bindings.
+		std::vector<InputDeviceConfig> m_inputDeviceConfigs;
 		
 		// The maximum duration a control can move for (in milliseconds).
 		unsigned int m_controlMaxMovingDurationMS = 100'000;
 				
 		// The duration a control will be on cooldown (in milliseconds).
 		unsigned int m_controlCoolDownDurationMS = 50'000;
+
+		// How many controls can move at once, or 0 for no limit.
+		unsigned int m_controlMaxMovingControls = 0u;
+
+		// The least time between controls starting to move (in milliseconds).
+		unsigned int m_controlStartStaggerMS = 0u;
 		
 		// The list of control configs.
 		std::vector<ControlConfig> m_controlConfigs;
+
+		// How the controls should be run on their own thread.
+		ControlThreadConfig m_controlThreadConfig;
+
+		// Whether the GPIO pins should be simulated, recording their changes instead.
+		bool m_simulateGPIO = false;
+
+		// The format to write the simulated pin changes in.
+		GPIOTimelineFormat m_gpioTimelineFormat = kGPIOTimelineFormatCSV;
 };
 
@@ -1,640 +1,2495 @@
-#include "control.h"
-
-#include <cstdio>
-#include <cstring>
-#include <map>
-#include <vector>
-
-#include "gpio.h"
-#include "logger.h"
-#include "notification.h"
-#include "timer.h"
-#include "command.h"
-
-
-// Constants
-//
-
-// Maximum duration of the moving state.
-#define MAX_MOVING_STATE_DURATION_MS		(100 * 1000) // 100 sec.
-
-// Maximum duration of the cool down state.
-#define MAX_COOL_DOWN_STATE_DURATION_MS	(50 * 1000) // 50 sec.
-
-// Time between commands.
-//#define COMMAND_INTERVAL_MS				(2 * 1000) // 2 sec.
-
-// The names of the actions.
-static constexpr char const* const kControlActionNames[] =
-{
-	"stopped",		// kActionStopped
-	"moving up",	// kActionMovingUp
-	"moving down",	// kActionMovingDown
-};
-
-// The names of the modes.
-static constexpr char const* const kControlModeNames[] =
-{
-	"manual",	// kModeManual
-	"timed",		// kModeTimed
-};
-
-// The names of the states.
-static constexpr char const* const kControlStateNames[] =
-{
-	"idle",			// kStateIdle
-	"moving up",	// kStateMovingUp
-	"moving down",	// kStateMovingDown
-	"cool down",	// kStateCoolDown
-};
-
-// The notification names of the states.
-static constexpr char const* const kControlStateNotificationNames[] =
-{
-	"",				// kStateIdle
-	"moving_up",	// kStateMovingUp
-	"moving_down",	// kStateMovingDown
-	"stop",			// kStateCoolDown
-};
-
-// Locals
-//
-
-// A list of registered controls.
-static std::vector<Control> s_controls;
-
-// A mapping of control name to control index.
-static std::map<std::string, unsigned int> s_controlNameToIndexMap;
-
-// Control members
-
-unsigned int Control::ms_maxMovingDurationMS = MAX_MOVING_STATE_DURATION_MS;
-unsigned int Control::ms_coolDownDurationMS = MAX_COOL_DOWN_STATE_DURATION_MS;
-
-// Functions
-//
-
-// ControlConfig members
-
-// Read a control config from JSON. 
-//
-// object:	The JSON object representing a control config.
-//
-// Returns:		True if the config was read successfully, false otherwise.
-//
-bool ControlConfig::ReadFromJSON(rapidjson::Value const& object)
-{
-	if (object.IsObject() == false)
-	{
-		Logger::WriteLine("Control config cannot be parsed because it is not an object.");
-		return false;
-	}
-
-	// We must have a control name.
-	auto const nameIterator = object.FindMember("name");
-
-	if (nameIterator == object.MemberEnd())
-	{
-		Logger::WriteLine("Control config is missing a name.");
-		return false;
-	}
-
-	if (nameIterator->value.IsString() == false)
-	{
-		Logger::WriteLine("Control config has a name but it is not a string.");
-		return false;
-	}
-	
-	// Copy no more than the amount of text the buffer can hold.
-	strncpy(m_name, nameIterator->value.GetString(), sizeof(m_name) - 1);
-	m_name[sizeof(m_name) - 1] = '\0';
-
-	// We must have an up pin.
-	auto const upPinIterator = object.FindMember("upPin");
-
-	if (upPinIterator == object.MemberEnd())
-	{
-		Logger::WriteLine("Control config is missing an up pin.");
-		return false;
-	}
-
-	if (upPinIterator->value.IsInt() == false)
-	{
-		Logger::WriteLine("Control config has an up pin, but it is not an integer.");
-		return false;
-	}
-
-	m_upGPIOPin = upPinIterator->value.GetInt();
-
-	// We must also have a down pin.
-	auto const downPinIterator = object.FindMember("downPin");
-
-	if (downPinIterator == object.MemberEnd())
-	{
-		Logger::WriteLine("Control config is missing a down pin.");
-		return false;
-	}
-
-	if (downPinIterator->value.IsInt() == false)
-	{
-		Logger::WriteLine("Control config has a down pin, but it is not an integer.");
-		return false;
-	}
-
-	m_downGPIOPin = downPinIterator->value.GetInt();
-
-	// We might also have a moving duration.
-	auto const movingDurationIterator = object.FindMember("movingDurationMS");
-
-	if (movingDurationIterator != object.MemberEnd())
-	{
-		if (movingDurationIterator->value.IsInt() == true)
-		{
-			m_movingDurationMS = movingDurationIterator->value.GetInt();
-		}
-	}
-
-	return true;
-}
-
-// Control members
-
-// Handle initialization.
-//
-// config:	Configuration parameters for the control.
-//
-void Control::Initialize(ControlConfig const& config)
-{
-	// Copy the name.
-	strncpy(m_name, config.m_name, kNameCapacity - 1);
-	m_name[kNameCapacity - 1] = '\0';
-	
-	m_state = kStateIdle;
-	TimerGetCurrent(m_stateStartTime);
-	m_desiredAction = kActionStopped;
-
-	// Setup the pins and set them to off.
-	m_upGPIOPin = config.m_upGPIOPin;
-	m_downGPIOPin = config.m_downGPIOPin;
-	
-	GPIOAcquireOutputPin(m_upGPIOPin);
-	GPIOAcquireOutputPin(m_downGPIOPin);
-	
-	GPIOSetPinOff(m_upGPIOPin);
-	GPIOSetPinOff(m_downGPIOPin);
-	
-	// Set the individual control moving duration.
-	m_standardMovingDurationMS = config.m_movingDurationMS;
-
-	Logger::WriteLine("Initialized control \'", m_name, "\' with GPIO pins (up ", m_upGPIOPin,
-							", down ", m_downGPIOPin, ") and duration ", m_standardMovingDurationMS,
-							" ms.");
-}
-
-// Handle uninitialization.
-//
-void Control::Uninitialize()
-{
-	// Release pins.
-	GPIOReleasePin(m_upGPIOPin);
-	GPIOReleasePin(m_downGPIOPin);
-}
-
-// Process a tick.
-//
-void Control::Process()
-{
-	// Handle state transitions.
-	switch (m_state) 
-	{
-		case kStateIdle:
-		{
-			// Wait until moving is desired to transition.
-			if (m_desiredAction == kActionStopped) {
-				break;
-			}
-
-			// Transition to moving.
-			if (m_desiredAction == kActionMovingUp)
-			{
-				m_state = kStateMovingUp;
-
-				// Set the pin to on.
-				GPIOSetPinOn(m_upGPIOPin);
-			}
-			else
-			{
-				m_state = kStateMovingDown;
-
-				// Set the pin to on.
-				GPIOSetPinOn(m_downGPIOPin);
-			}
-			
-			// Play the notification.
-			PlayNotification();
-
-			// Record when the state transition timer began.
-			TimerGetCurrent(m_stateStartTime);
-
-			Logger::WriteLine("Control \"", m_name, "\": State transition from \"",
-									kControlStateNames[kStateIdle], "\" to \"", kControlStateNames[m_state],
-									"\" triggered.");
-		}
-		break;
-
-		case kStateMovingUp:	// Fall through...
-		case kStateMovingDown:
-		{
-			// Get elapsed time since state start.
-			Time currentTime;
-			TimerGetCurrent(currentTime);
-
-			auto const elapsedTimeMS = TimerGetElapsedMilliseconds(m_stateStartTime, currentTime);
-
-			// Get the action corresponding to this state, as well as the one for the opposite state.
-			auto const matchingAction = (m_state == kStateMovingUp) ? kActionMovingUp : 
-				kActionMovingDown;
-			auto const oppositeAction = (m_state == kStateMovingUp) ? kActionMovingDown : 
-				kActionMovingUp;
-			
-			// Wait until the desired action no longer matches or the time limit has run out.
-			if ((m_desiredAction == matchingAction) && (elapsedTimeMS < m_movingDurationMS))
-			{
-				break;
-			}
-
-			// We are about to change the state, so keep track of the old one.
-			auto const oldState = m_state;
-			
-			if (m_desiredAction == oppositeAction)
-			{
-				// Transition to the opposite state.
-				auto const oppositeState = (m_state == kStateMovingUp) ? kStateMovingDown :
-					kStateMovingUp;
-				m_state = oppositeState;
-
-				// Flip the pins.
-				auto const oldStatePin = (m_state == kStateMovingDown) ? m_upGPIOPin : 
-					m_downGPIOPin;
-				auto const newStatePin = (m_state == kStateMovingDown) ? m_downGPIOPin : 
-					m_upGPIOPin;
-				GPIOSetPinOff(oldStatePin);
-				GPIOSetPinOn(newStatePin);
-			}
-			else
-			{
-				// Transition to cool down.
-				m_state = kStateCoolDown;
-
-				// Set the pins to off.
-				GPIOSetPinOff(m_upGPIOPin);
-				GPIOSetPinOff(m_downGPIOPin);
-			}
-			
-			// Play the notification.
-			PlayNotification();
-			
-			// Record when the state transition timer began.
-			TimerGetCurrent(m_stateStartTime);
-
-			Logger::WriteLine("Control \"", m_name, "\": State transition from \"",
-									kControlStateNames[oldState], "\" to \"", kControlStateNames[m_state],
-									"\" triggered.");
-		}
-		break;
-
-		case kStateCoolDown:
-		{
-			// Clear the desired action.
-			m_desiredAction = kActionStopped;
-
-			// Get elapsed time since state start.
-			Time currentTime;
-			TimerGetCurrent(currentTime);
-
-			auto const elapsedTimeMS = TimerGetElapsedMilliseconds(m_stateStartTime, currentTime);
-
-			// Wait until the time limit has run out.
-			if (elapsedTimeMS < ms_coolDownDurationMS)
-			{
-				break;
-			}
-
-			// Transition to idle.
-			m_state = kStateIdle;
-
-			// Set the pins to off.
-			GPIOSetPinOff(m_upGPIOPin);
-			GPIOSetPinOff(m_downGPIOPin);
-
-			Logger::WriteLine("Control \"", m_name, "\": State transition from \"",
-									kControlStateNames[kStateCoolDown], "\" to \"",
-									kControlStateNames[m_state], "\" triggered.");
-		}
-		break;
-
-		default:
-		{
-			Logger::WriteLine("Control \"", m_state, "\": Unrecognized state ", m_name,
-									" in Process()");
-		}
-		break;
-	}
-}
-
-// Set the desired action.
-//
-// desiredAction:		The desired action.
-// mode:					The mode of the action.
-// durationPercent:	(Optional) The percent of the normal duration to perform the action for.
-//
-void Control::SetDesiredAction(Actions desiredAction, Modes mode, unsigned int durationPercent)
-{
-	static_assert(std::is_same_v<decltype(durationPercent), decltype(CommandToken::m_parameter)>,
-					  "Assert the type of `durationPercent` "
-					  "is the same as the type of `CommandToken::m_parameter`. "
-					  "Currently, the main purpose of `CommandToken::m_parameter` "
-					  "is to be used as `durationPercent`, "
-					  "so this assertion serves as a notification for if "
-					  "the types become unsynchronized.");
-
-	m_desiredAction = desiredAction;
-	m_mode = mode;
-
-	if (m_mode == kModeTimed)
-	{
-		// Set the current moving duration based on the requested percentage of the standard amount.
-		auto const durationFraction = std::min(durationPercent, 100u) / 100.0f;
-		m_movingDurationMS =
-			static_cast<unsigned int>(m_standardMovingDurationMS * durationFraction);
-	}
-	else
-	{
-		m_movingDurationMS = ms_maxMovingDurationMS;
-	}
-
-	Logger::WriteLine("Control \"", m_name, "\": Setting desired action to \"",
-							kControlActionNames[desiredAction], "\" with mode \"",
-							kControlModeNames[mode], "\" and duration ", m_movingDurationMS, " ms.");
-}
-
-// Enable or disable all controls.
-//
-// enable:	Whether to enable or disable all controls.
-//
-void Control::Enable(bool enable)
-{
-	if (enable == false)
-	{
-		Logger::WriteLine("Controls disabled.");
-	}
-	else
-	{
-		Logger::WriteLine("Controls enabled.");
-	}
-}
-
-// Set the durations.
-//
-// movingDurationMS:		Duration of the moving state (in milliseconds).
-// coolDownDurationMS:	Duration of the cool down state (in milliseconds).
-//
-void Control::SetDurations(unsigned int movingDurationMS, unsigned int coolDownDurationMS)
-{
-	ms_maxMovingDurationMS = movingDurationMS;
-	ms_coolDownDurationMS = coolDownDurationMS;
-
-	Logger::WriteLine("Control durations set to moving - ", movingDurationMS, " ms, cool down - ",
-							coolDownDurationMS, " ms.");
-}
-
-// Look up a control by its name.
-//
-// name:	The name of the control.
-//
-// Returns:		The control, or null if one with the name could not be found.
-//
-Control* Control::GetByName(std::string const& name)
-{
-	auto controlIterator = s_controlNameToIndexMap.find(name);
-	if (controlIterator == s_controlNameToIndexMap.end())
-	{
-		return nullptr;
-	}
-	
-	auto const controlIndex = controlIterator->second;
-	return &s_controls[controlIndex];
-}
-		
-// Play a notification for the state.
-//
-void Control::PlayNotification()
-{
-	// Do not play a notification if the mode is manual.
-	if (m_mode == kModeManual)
-	{
-		return;
-	}
-
-	// Build the notification name.
-	static constexpr std::size_t kNotificationNameCapacity{ 128u };
-	char notificationName[kNotificationNameCapacity];
-	std::snprintf(notificationName, kNotificationNameCapacity, "%s_%s", m_name,
-		kControlStateNotificationNames[m_state]);
-
-	NotificationPlay(notificationName);
-}
-
-// ControlAction members
-
-// A constructor for emplacing.
-// 
-ControlAction::ControlAction(char const* controlName, Control::Actions action)
-	: m_action(action)
-{
-	// Copy the control name.
-	std::strncpy(m_controlName, controlName, kControlNameCapacity - 1);
-	m_controlName[kControlNameCapacity - 1] = '\0';
-}
-
-// Try to find a control action that matches the input text.
-//
-// action:		(Output) The action that was found.
-// inputText:	The name of the action to look for. 
-//
-// Returns:		True if the action was found, false otherwise.
-//
-auto GetControlActionFromString(Control::Actions& action, char const* inputText)
-{
-	// The names of the actions.
-	static constexpr char const* const kActionNames[] =
-	{
-		"stop",	// kActionStopped
-		"up",		// kActionMovingUp
-		"down",	// kActionMovingDown
-	};
-
-	// Try to find a control action that matches this text.
-	auto const actionCount = Control::Actions::kNumActions;
-	for (unsigned int actionIndex = 0; actionIndex < actionCount; actionIndex++)
-	{
-		// Compare the text to the action name.
-		auto const* actionName = kActionNames[actionIndex];
-			
-		if (std::strncmp(inputText, actionName, std::strlen(actionName)) != 0)
-		{
-			continue;
-		}
-			
-		// We found the action, so return it.
-		action = static_cast<Control::Actions>(actionIndex);
-		return true;
-	}
-		
-	return false;
-}
-
-// Read a control action from JSON. 
-//
-// object:	The JSON object representing a control action.
-//
-// Returns:		True if the action was read successfully, false otherwise.
-//
-bool ControlAction::ReadFromJSON(rapidjson::Value const& object)
-{
-	if (object.IsObject() == false)
-	{
-		Logger::WriteLine("Control action cannot be parsed because it is not an object.");
-		return false;
-	}
-
-	// We must have a control name.
-	auto const controlIterator = object.FindMember("control");
-
-	if (controlIterator == object.MemberEnd())
-	{
-		Logger::WriteLine("Control action is missing a control name.");
-		return false;
-	}
-
-	if (controlIterator->value.IsString() == false)
-	{
-		Logger::WriteLine("Control action has a control name, but it is not a string.");
-		return false;
-	}
-	
-	// Copy no more than the amount of text the buffer can hold.
-	strncpy(m_controlName, controlIterator->value.GetString(), sizeof(m_controlName) - 1);
-	m_controlName[sizeof(m_controlName) - 1] = '\0';
-
-	// We must also have an action.
-	auto const actionIterator = object.FindMember("action");
-
-	if (actionIterator == object.MemberEnd())
-	{
-		Logger::WriteLine("Control action does not have an action.");
-		return false;
-	}
-
-	if (actionIterator->value.IsString() == false)
-	{
-		Logger::WriteLine("Control action has an action, but it is not a string.");
-		return false;
-	}
-
-	// Try to get the corresponding action.
-	if (GetControlActionFromString(m_action, actionIterator->value.GetString()) == false)
-	{
-		Logger::WriteLine("Control action has an unrecognized action.");
-		return false;
-	}
-
-	return true;
-}
-
-// Attempt to get the control corresponding to the control action.
-//
-// Returns:	The control if successful, null otherwise.
-//
-Control* ControlAction::GetControl() const
-{
-	return Control::GetByName(m_controlName);
-}
-	
-// Functions
-//
-
-// Initialize all of the controls.
-//
-// configs: Configuration parameters for the controls to add.
-//
-void ControlsInitialize(std::vector<ControlConfig> const& configs)
-{
-	for (auto const& config : configs)
-	{
-		ControlsCreateControl(config);
-	}
-}
-
-// Uninitialize all of the controls.
-//
-void ControlsUninitialize()
-{
-	s_controlNameToIndexMap.clear();
-	
-	for (auto& control : s_controls)
-	{
-		control.Uninitialize();
-	}
-	
-	// Get rid of all of the controls.
-	s_controls.clear();
-}
-
-// Process all of the controls.
-//
-void ControlsProcess()
-{
-	for (auto& control : s_controls)
-	{
-		control.Process();
-	}	
-}
-
-// Create a new control with the provided config. Control names must be unique.
-//
-// config:	Configuration parameters for the control.
-//
-// Returns:		True if the control was successfully created, false otherwise.
-//
-bool ControlsCreateControl(ControlConfig const& config)
-{
-	// Check to see whether a control with this name already exists.
-	if (s_controlNameToIndexMap.find(config.m_name) != s_controlNameToIndexMap.end())
-	{
-		Logger::WriteLine("Control with name \"", config.m_name, "\" already exists.");
-		return false;
-	}
-	
-	// Add a new control.
-	s_controls.emplace_back(Control());
-	
-	// Then, initialize it.
-	unsigned int const controlIndex = s_controls.size() - 1;
-	s_controls[controlIndex].Initialize(config);
-	
-	// And add it to the map.
-	s_controlNameToIndexMap.insert({config.m_name, controlIndex});
-
-	return true;
-}
-
-// Stop all of the controls.
-//
-void ControlsStopAll()
-{
-	for (auto& control : s_controls)
-	{
-		control.SetDesiredAction(Control::kActionStopped, Control::kModeManual);
-	}
-}
+#include "control.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "control_queue.h"
+#include "control_thread.h"
+#include "event_loop.h"
+#include "gpio.h"
+#include "logger.h"
+#include "notification.h"
+#include "timer.h"
+#include "command.h"
+
+
+// Constants
+//
+
+// Maximum duration of the moving state.
+#define MAX_MOVING_STATE_DURATION_MS		(100 * 1000) // 100 sec.
+
+// Maximum duration of the cool down state.
+#define MAX_COOL_DOWN_STATE_DURATION_MS	(50 * 1000) // 50 sec.
+
+// Time between commands.
+//#define COMMAND_INTERVAL_MS				(2 * 1000) // 2 sec.
+
+// Moves to a position that are shorter than this (in percent) aren't worth making.
+static constexpr float kPositionTolerancePercent{ 1.0f };
+
+// Moves to either end run on for this much longer (in percent of the standard duration). The
+// actuators stop themselves at the ends, so this soaks up any error in the estimate.
+static constexpr float kEndOverrunPercent{ 10.0f };
+
+// The most events that can be waiting to be passed on. This must be a power of two.
+static constexpr unsigned int kControlEventQueueCapacity{ 256u };
+
+static_assert((kControlEventQueueCapacity & (kControlEventQueueCapacity - 1u)) == 0u,
+				  "The event queue capacity must be a power of two.");
+
+// Keep positions written by different threads on different cache lines.
+static constexpr std::size_t kCacheLineSize{ 64u };
+
+// The names of the actions.
+static constexpr char const* const kControlActionNames[] =
+{
+	"stopped",		// kActionStopped
+	"moving up",	// kActionMovingUp
+	"moving down",	// kActionMovingDown
+};
+
+// The names of the modes.
+static constexpr char const* const kControlModeNames[] =
+{
+	"manual",	// kModeManual
+	"timed",		// kModeTimed
+};
+
+// The names of the states.
+static constexpr char const* const kControlStateNames[] =
+{
+	"idle",			// kStateIdle
+	"moving up",	// kStateMovingUp
+	"moving down",	// kStateMovingDown
+	"cool down",	// kStateCoolDown
+};
+
+// The notification names of the states.
+static constexpr char const* const kControlStateNotificationNames[] =
+{
+	"",				// kStateIdle
+	"moving_up",	// kStateMovingUp
+	"moving_down",	// kStateMovingDown
+	"stop",			// kStateCoolDown
+};
+
+// Locals
+//
+
+// The runtime state of the controls, kept in parallel arrays indexed by control. Code that looks
+// at one kind of state across many controls then only touches that state.
+struct ControlRuntime
+{
+	// Add the state for a new control, which starts out idle.
+	//
+	void Add();
+
+	// Get rid of the state for every control.
+	//
+	void Clear();
+
+	// Add a control to the active set, if it isn't already.
+	//
+	// controlIndex:	The control to add.
+	//
+	void Activate(unsigned int controlIndex);
+
+	// Remove a control from the active set, if it is in it.
+	//
+	// controlIndex:	The control to remove.
+	//
+	void Deactivate(unsigned int controlIndex);
+
+	// Put a control at the end of the line of controls waiting to move.
+	//
+	// controlIndex:	The control, which must not already be waiting.
+	//
+	void JoinWaitingLine(unsigned int controlIndex);
+
+	// Take a control out of the line of controls waiting to move.
+	//
+	// controlIndex:	The control, which must be waiting.
+	//
+	void LeaveWaitingLine(unsigned int controlIndex);
+
+	// Constants.
+
+	// Signifies that a control isn't in the active set.
+	static constexpr unsigned int kNotActive{ UINT_MAX };
+
+	// Signifies the end of the line of controls waiting to move.
+	static constexpr unsigned int kNoWaitingControl{ UINT_MAX };
+
+	// The state of each control.
+	std::vector<Control::State> m_states;
+
+	// The desired action and movement mode of each control.
+	std::vector<Control::Actions> m_desiredActions;
+	std::vector<Control::Modes> m_modes;
+
+	// How long each control's current move lasts (in milliseconds).
+	std::vector<unsigned int> m_movingDurationsMS;
+
+	// When each control's current state started.
+	std::vector<Time> m_stateStartTimes;
+
+	// The slot that will process each control when its current state has lasted long enough.
+	std::vector<Scheduler::SlotID> m_stateTimerSlotIDs;
+
+	// Whether each control is waiting to be processed on the next tick.
+	std::vector<std::uint8_t> m_processPending;
+
+	// Whether each control has changed since the last snapshot.
+	std::vector<std::uint8_t> m_snapshotPending;
+
+	// The controls that are moving or cooling down, in no particular order.
+	std::vector<unsigned int> m_activeControlIndices;
+
+	// Where each control is in the active set, or kNotActive.
+	std::vector<unsigned int> m_activeSetPositions;
+
+	// The controls waiting for the move limits to let them start, linked through each control so
+	// that any of them can leave the line without moving the rest. The first in line goes first.
+	std::vector<unsigned int> m_nextWaitingIndices;
+	std::vector<unsigned int> m_previousWaitingIndices;
+	unsigned int m_firstWaitingIndex = kNoWaitingControl;
+	unsigned int m_lastWaitingIndex = kNoWaitingControl;
+};
+
+// A list of registered controls.
+static std::vector<Control> s_controls;
+
+// The runtime state of the registered controls.
+static ControlRuntime s_runtime;
+
+// A mapping of control name to control index.
+static std::map<std::string, unsigned int> s_controlNameToIndexMap;
+
+// The indices of controls that need to be processed on the next tick.
+static std::vector<unsigned int> s_pendingControlIndices;
+
+// The controls a request for all of them applies to. The controls that are active or waiting are
+// never the same ones, but either may also be pending.
+static std::vector<unsigned int> s_requestControlIndices;
+
+// Used to process controls when their states have lasted long enough.
+static Scheduler* s_scheduler = nullptr;
+
+// Stops that didn't fit in the queue wait here instead, so that they're never dropped. Each is
+// kept as the queue position the latest stop was requested at, plus one, shifted up to make room
+// for its mode in the lowest bit, or 0 if there is no stop waiting. The requests queued before that
+// position are applied first, so that none of them can start the control moving again.
+static std::unique_ptr<std::atomic<std::size_t>[]> s_stopValues;
+
+// The same, for stopping all of the controls.
+static std::atomic<std::size_t> s_stopAllValue{ 0u };
+
+// Whether any stops are waiting, so that the controls are only looked through when there are.
+static std::atomic<bool> s_stopsRequested{ false };
+
+// A stop that is waiting to be applied.
+struct ControlStop
+{
+	// The stop, as it was kept.
+	std::size_t m_stopValue;
+
+	// The index of the control, or ControlRequest::kAllControls.
+	unsigned int m_controlIndex;
+};
+
+// The stops to apply this tick, oldest first.
+static std::vector<ControlStop> s_pendingStops;
+
+// How many controls are moving.
+static unsigned int s_movingControlCount = 0u;
+
+// Whether any control has started moving yet, and when the most recent one did.
+static bool s_moveStarted = false;
+static Time s_lastMoveStartTime;
+
+// The slot that starts waiting controls once the start stagger has passed.
+static Scheduler::SlotID s_moveStartSlotID = Scheduler::kInvalidSlotID;
+
+// How long recent moves waited before starting. This is only touched on the main thread.
+static ProfilerSampleWindow s_moveStartDelaySampleWindow;
+
+// What the main thread knows about each control, from its events. This is only touched on the main
+// thread.
+static std::vector<ControlStatus> s_statuses;
+
+// A snapshot of every control, for threads other than the one that processes the controls.
+struct ControlSnapshot
+{
+	// The time of the tick that the snapshot was taken in.
+	Time m_time;
+
+	// The status of each control, by index.
+	std::vector<ControlStatus> m_statuses;
+};
+
+// Two copies of the snapshot. While one is being written, readers read the other, so neither side
+// ever waits for the other. They are only resized while there are no readers.
+static std::array<ControlSnapshot, 2> s_snapshots;
+
+// Tells readers which copy to read: the second while it's odd, since the first is being written,
+// and the first while it's even. Goes up by two with every snapshot.
+static std::atomic<unsigned int> s_snapshotSequence{ 0u };
+
+// The controls that have changed since the last snapshot. This is only touched by the thread that
+// processes the controls.
+static std::vector<unsigned int> s_snapshotPendingIndices;
+
+// Events waiting to be passed to the listeners on the main thread. Only the thread that processes
+// the controls records events and only the main thread takes them, so the positions are all that
+// need to be shared, and recording never waits on a lock or allocates.
+static std::array<ControlEvent, kControlEventQueueCapacity> s_events;
+
+// The position the next event will be recorded at. Only the thread that processes the controls
+// changes this.
+alignas(kCacheLineSize) static std::atomic<std::size_t> s_eventRecordPosition{ 0u };
+
+// The position the next event will be taken from. Only the main thread changes this.
+alignas(kCacheLineSize) static std::atomic<std::size_t> s_eventDispatchPosition{ 0u };
+
+// The number of events that were dropped because the main thread was too far behind.
+alignas(kCacheLineSize) static std::atomic<unsigned int> s_droppedEventCount{ 0u };
+
+// The number of events that have been found to be dropped, in total. This is only touched on the
+// main thread.
+static unsigned long long s_dispatchDroppedEventCount = 0ull;
+
+// Whether events have been recorded since the main loop was last woken for them. This is only
+// touched by the thread that processes the controls.
+static bool s_eventsRecorded = false;
+
+// A function to pass events to.
+struct ControlEventListenerEntry
+{
+	// The ID the listener was added with.
+	ControlEventListenerID m_listenerID;
+
+	// The function to call.
+	ControlEventListener m_listener;
+};
+
+// The functions events are passed to, in the order they were added. These are only touched on the
+// main thread.
+static std::vector<ControlEventListenerEntry> s_eventListeners;
+
+// The ID for the next listener.
+static ControlEventListenerID s_nextEventListenerID = kInvalidControlEventListenerID + 1u;
+
+// The listeners that log, notify and keep statistics for the controls.
+static ControlEventListenerID s_logEventListenerID = kInvalidControlEventListenerID;
+static ControlEventListenerID s_notificationEventListenerID = kInvalidControlEventListenerID;
+static ControlEventListenerID s_statisticsEventListenerID = kInvalidControlEventListenerID;
+static ControlEventListenerID s_statusEventListenerID = kInvalidControlEventListenerID;
+
+// Control members
+
+unsigned int Control::ms_maxMovingDurationMS = MAX_MOVING_STATE_DURATION_MS;
+unsigned int Control::ms_coolDownDurationMS = MAX_COOL_DOWN_STATE_DURATION_MS;
+unsigned int Control::ms_maxMovingControls = 0u;
+unsigned int Control::ms_startStaggerMS = 0u;
+
+// ControlRuntime members
+
+// Add the state for a new control, which starts out idle.
+//
+void ControlRuntime::Add()
+{
+	m_states.push_back(Control::kStateIdle);
+	m_desiredActions.push_back(Control::kActionStopped);
+	m_modes.push_back(Control::kModeManual);
+	m_movingDurationsMS.push_back(0u);
+	m_stateStartTimes.push_back(Time());
+	m_stateTimerSlotIDs.push_back(Scheduler::kInvalidSlotID);
+	m_processPending.push_back(false);
+	m_snapshotPending.push_back(false);
+	m_activeSetPositions.push_back(kNotActive);
+	m_nextWaitingIndices.push_back(kNoWaitingControl);
+	m_previousWaitingIndices.push_back(kNoWaitingControl);
+
+	// Make sure that every control can be active without allocating.
+	m_activeControlIndices.reserve(m_states.size());
+}
+
+// Get rid of the state for every control.
+//
+void ControlRuntime::Clear()
+{
+	m_states.clear();
+	m_desiredActions.clear();
+	m_modes.clear();
+	m_movingDurationsMS.clear();
+	m_stateStartTimes.clear();
+	m_stateTimerSlotIDs.clear();
+	m_processPending.clear();
+	m_snapshotPending.clear();
+	m_activeControlIndices.clear();
+	m_activeSetPositions.clear();
+	m_nextWaitingIndices.clear();
+	m_previousWaitingIndices.clear();
+	m_firstWaitingIndex = kNoWaitingControl;
+	m_lastWaitingIndex = kNoWaitingControl;
+}
+
+// Add a control to the active set, if it isn't already.
+//
+// controlIndex:	The control to add.
+//
+void ControlRuntime::Activate(unsigned int controlIndex)
+{
+	if (m_activeSetPositions[controlIndex] != kNotActive)
+	{
+		return;
+	}
+
+	m_activeSetPositions[controlIndex] = static_cast<unsigned int>(m_activeControlIndices.size());
+	m_activeControlIndices.push_back(controlIndex);
+}
+
+// Remove a control from the active set, if it is in it.
+//
+// controlIndex:	The control to remove.
+//
+void ControlRuntime::Deactivate(unsigned int controlIndex)
+{
+	auto const position = m_activeSetPositions[controlIndex];
+
+	if (position == kNotActive)
+	{
+		return;
+	}
+
+	// Fill the gap with the last control, since the order doesn't matter.
+	auto const lastControlIndex = m_activeControlIndices.back();
+	m_activeControlIndices[position] = lastControlIndex;
+	m_activeSetPositions[lastControlIndex] = position;
+
+	m_activeControlIndices.pop_back();
+	m_activeSetPositions[controlIndex] = kNotActive;
+}
+
+// Put a control at the end of the line of controls waiting to move.
+//
+// controlIndex:	The control, which must not already be waiting.
+//
+void ControlRuntime::JoinWaitingLine(unsigned int controlIndex)
+{
+	m_previousWaitingIndices[controlIndex] = m_lastWaitingIndex;
+	m_nextWaitingIndices[controlIndex] = kNoWaitingControl;
+
+	if (m_lastWaitingIndex == kNoWaitingControl)
+	{
+		m_firstWaitingIndex = controlIndex;
+	}
+	else
+	{
+		m_nextWaitingIndices[m_lastWaitingIndex] = controlIndex;
+	}
+
+	m_lastWaitingIndex = controlIndex;
+}
+
+// Take a control out of the line of controls waiting to move.
+//
+// controlIndex:	The control, which must be waiting.
+//
+void ControlRuntime::LeaveWaitingLine(unsigned int controlIndex)
+{
+	auto const previousIndex = m_previousWaitingIndices[controlIndex];
+	auto const nextIndex = m_nextWaitingIndices[controlIndex];
+
+	if (previousIndex == kNoWaitingControl)
+	{
+		m_firstWaitingIndex = nextIndex;
+	}
+	else
+	{
+		m_nextWaitingIndices[previousIndex] = nextIndex;
+	}
+
+	if (nextIndex == kNoWaitingControl)
+	{
+		m_lastWaitingIndex = previousIndex;
+	}
+	else
+	{
+		m_previousWaitingIndices[nextIndex] = previousIndex;
+	}
+
+	m_previousWaitingIndices[controlIndex] = kNoWaitingControl;
+	m_nextWaitingIndices[controlIndex] = kNoWaitingControl;
+}
+
+// Functions
+//
+
+// Wake the main loop to pass on the events that have been recorded, if there are any. This is done
+// after the pins have been set, so that setting them isn't held up.
+//
+static void ControlsWakeForEvents()
+{
+	if (s_eventsRecorded == false)
+	{
+		return;
+	}
+
+	s_eventsRecorded = false;
+
+	// The main loop passes on the events itself when it processes the controls.
+	if (ControlThreadIsRunning() == true)
+	{
+		EventLoopWake();
+	}
+}
+
+// Make sure a control that has changed is in the next snapshot.
+//
+// controlIndex:	The index of the control.
+//
+static void ControlsMarkSnapshotPending(unsigned int controlIndex)
+{
+	auto& snapshotPending = s_runtime.m_snapshotPending[controlIndex];
+
+	if (snapshotPending == false)
+	{
+		snapshotPending = true;
+		s_snapshotPendingIndices.push_back(controlIndex);
+	}
+}
+
+// Get the index of a control.
+//
+// control:	The control, which must be one of the registered controls.
+//
+// Returns:	The index of the control.
+//
+static unsigned int ControlsGetIndex(Control const& control)
+{
+	return static_cast<unsigned int>(&control - s_controls.data());
+}
+
+// Queue requests to be applied together on the next tick of whichever thread processes the
+// controls, and wake that thread up. This may be called from any thread.
+//
+// requests:		The requests to queue.
+// requestCount:	The number of requests.
+//
+// Returns:	True if the requests were queued, false if the queue didn't have room for them.
+//
+static bool ControlsQueueRequests(ControlRequest const* requests, unsigned int requestCount)
+{
+	if (ControlQueuePushBatch(requests, requestCount) == false)
+	{
+		return false;
+	}
+
+	if (ControlThreadIsRunning() == true)
+	{
+		ControlThreadWake();
+	}
+	else
+	{
+		EventLoopWake();
+	}
+
+	return true;
+}
+
+// Get where the stops for a control are kept.
+//
+// controlIndex:	The index of the control, or ControlRequest::kAllControls.
+//
+// Returns:	The kept stop.
+//
+static std::atomic<std::size_t>& ControlsGetStopValue(unsigned int controlIndex)
+{
+	if (controlIndex == ControlRequest::kAllControls)
+	{
+		return s_stopAllValue;
+	}
+
+	return s_stopValues[controlIndex];
+}
+
+// Get the queue position a kept stop was requested at.
+//
+// stopValue:	The kept stop, which must not be 0.
+//
+// Returns:	The queue position.
+//
+static std::size_t ControlsGetStopQueuePosition(std::size_t stopValue)
+{
+	return (stopValue >> 1u) - 1u;
+}
+
+// Request that a control stop, without going through the queue. This may be called from any
+// thread, and never waits on a lock.
+//
+// controlIndex:	The index of the control, or ControlRequest::kAllControls.
+// mode:				The mode of the stop.
+//
+static void ControlsRequestStop(unsigned int controlIndex, Control::Modes mode)
+{
+	auto const stopValue = ((ControlQueueGetPushPosition() + 1u) << 1u) |
+		static_cast<std::size_t>(mode);
+	auto& keptStopValue = ControlsGetStopValue(controlIndex);
+	auto currentStopValue = keptStopValue.load(std::memory_order_relaxed);
+
+	// Another stop may have been requested at the same time, so only ever move the position on.
+	while ((currentStopValue < stopValue) &&
+			 (keptStopValue.compare_exchange_weak(currentStopValue, stopValue,
+				std::memory_order_relaxed) == false))
+	{
+	}
+
+	s_stopsRequested.store(true, std::memory_order_release);
+
+	if (ControlThreadIsRunning() == true)
+	{
+		ControlThreadWake();
+	}
+	else
+	{
+		EventLoopWake();
+	}
+}
+
+// Gather the stops that are waiting, oldest first. This must be called from the thread that
+// processes the controls.
+//
+static void ControlsGatherStops()
+{
+	s_pendingStops.clear();
+
+	if (s_stopsRequested.exchange(false, std::memory_order_acquire) == false)
+	{
+		return;
+	}
+
+	auto const controlCount = static_cast<unsigned int>(s_controls.size());
+
+	for (unsigned int controlIndex = 0u; controlIndex < controlCount; controlIndex++)
+	{
+		auto const stopValue = s_stopValues[controlIndex].load(std::memory_order_relaxed);
+
+		if (stopValue != 0u)
+		{
+			s_pendingStops.push_back(ControlStop{ stopValue, controlIndex });
+		}
+	}
+
+	auto const stopAllValue = s_stopAllValue.load(std::memory_order_relaxed);
+
+	if (stopAllValue != 0u)
+	{
+		s_pendingStops.push_back(ControlStop{ stopAllValue, ControlRequest::kAllControls });
+	}
+
+	std::sort(s_pendingStops.begin(), s_pendingStops.end(),
+		[](ControlStop const& a, ControlStop const& b)
+		{
+			return a.m_stopValue < b.m_stopValue;
+		});
+}
+
+// Apply a stop that was waiting. This must be called from the thread that processes the controls.
+//
+// stop:				The stop.
+// currentTime:	The time of the current tick.
+//
+static void ControlsApplyStop(ControlStop const& stop, Time const& currentTime)
+{
+	auto const mode = static_cast<Control::Modes>(stop.m_stopValue & 1u);
+	ControlsApplyRequest(ControlRequest{ stop.m_controlIndex, Control::kActionStopped, mode, 0u },
+								currentTime);
+
+	// A stop requested since then waits for its own turn.
+	auto stopValue = stop.m_stopValue;
+
+	if (ControlsGetStopValue(stop.m_controlIndex).compare_exchange_strong(stopValue, 0u,
+		std::memory_order_relaxed) == false)
+	{
+		s_stopsRequested.store(true, std::memory_order_relaxed);
+	}
+}
+
+// Log a request once it has been queued.
+//
+// request:	The request.
+//
+static void ControlsLogRequest(ControlRequest const& request)
+{
+	if (request.m_controlIndex == ControlRequest::kAllControls)
+	{
+		Logger::WriteLine("Stopping all controls.");
+		return;
+	}
+
+	auto const* name = ControlsGetName(request.m_controlIndex);
+
+	if (request.m_targetPercent != Control::kNoTargetPercent)
+	{
+		Logger::WriteLine("Control \"", name, "\": Setting desired position to ",
+								request.m_targetPercent, " percent.");
+		return;
+	}
+
+	Logger::WriteLine("Control \"", name, "\": Setting desired action to \"",
+							kControlActionNames[request.m_action], "\" with mode \"",
+							kControlModeNames[request.m_mode], "\" and duration ",
+							request.m_movingDurationMS, " ms.");
+}
+
+// Start as many of the controls waiting in line as the move limits allow.
+//
+// currentTime:	The current time.
+//
+static void ControlsStartWaitingControls(Time const& currentTime)
+{
+	while (s_runtime.m_firstWaitingIndex != ControlRuntime::kNoWaitingControl)
+	{
+		auto const controlIndex = s_runtime.m_firstWaitingIndex;
+		s_controls[controlIndex].Process(currentTime);
+
+		// Stop once the first in line has to keep waiting.
+		if (s_runtime.m_firstWaitingIndex == controlIndex)
+		{
+			break;
+		}
+	}
+}
+
+// ControlConfig members
+
+// Read a control config from JSON. 
+//
+// object:	The JSON object representing a control config.
+//
+// Returns:		True if the config was read successfully, false otherwise.
+//
+bool ControlConfig::ReadFromJSON(rapidjson::Value const& object)
+{
+	if (object.IsObject() == false)
+	{
+		Logger::WriteLine("Control config cannot be parsed because it is not an object.");
+		return false;
+	}
+
+	// We must have a control name.
+	auto const nameIterator = object.FindMember("name");
+
+	if (nameIterator == object.MemberEnd())
+	{
+		Logger::WriteLine("Control config is missing a name.");
+		return false;
+	}
+
+	if (nameIterator->value.IsString() == false)
+	{
+		Logger::WriteLine("Control config has a name but it is not a string.");
+		return false;
+	}
+	
+	// Copy no more than the amount of text the buffer can hold.
+	strncpy(m_name, nameIterator->value.GetString(), sizeof(m_name) - 1);
+	m_name[sizeof(m_name) - 1] = '\0';
+
+	// We must have an up pin.
+	auto const upPinIterator = object.FindMember("upPin");
+
+	if (upPinIterator == object.MemberEnd())
+	{
+		Logger::WriteLine("Control config is missing an up pin.");
+		return false;
+	}
+
+	if (upPinIterator->value.IsInt() == false)
+	{
+		Logger::WriteLine("Control config has an up pin, but it is not an integer.");
+		return false;
+	}
+
+	m_upGPIOPin = upPinIterator->value.GetInt();
+
+	// We must also have a down pin.
+	auto const downPinIterator = object.FindMember("downPin");
+
+	if (downPinIterator == object.MemberEnd())
+	{
+		Logger::WriteLine("Control config is missing a down pin.");
+		return false;
+	}
+
+	if (downPinIterator->value.IsInt() == false)
+	{
+		Logger::WriteLine("Control config has a down pin, but it is not an integer.");
+		return false;
+	}
+
+	m_downGPIOPin = downPinIterator->value.GetInt();
+
+	// We might also have a moving duration.
+	auto const movingDurationIterator = object.FindMember("movingDurationMS");
+
+	if (movingDurationIterator != object.MemberEnd())
+	{
+		if (movingDurationIterator->value.IsInt() == true)
+		{
+			m_movingDurationMS = movingDurationIterator->value.GetInt();
+		}
+	}
+
+	return true;
+}
+
+// Control members
+
+// Handle initialization.
+//
+// config:	Configuration parameters for the control.
+//
+void Control::Initialize(ControlConfig const& config)
+{
+	// The runtime state starts out idle.
+	m_index = ControlsGetIndex(*this);
+
+	auto& state = s_runtime.m_states[m_index];
+	auto& desiredAction = s_runtime.m_desiredActions[m_index];
+	auto& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+
+	// Copy the name.
+	strncpy(m_name, config.m_name, kNameCapacity - 1);
+	m_name[kNameCapacity - 1] = '\0';
+	
+	state = kStateIdle;
+	TimerGetCurrent(stateStartTime);
+	desiredAction = kActionStopped;
+
+	// Setup the pins and set them to off.
+	m_upGPIOPin = config.m_upGPIOPin;
+	m_downGPIOPin = config.m_downGPIOPin;
+	
+	GPIOAcquireOutputPin(m_upGPIOPin);
+	GPIOAcquireOutputPin(m_downGPIOPin);
+	
+	GPIOSetPinOff(m_upGPIOPin);
+	GPIOSetPinOff(m_downGPIOPin);
+	GPIOCommit(stateStartTime);
+
+	// The timer is only ever armed after this, so changing state never allocates. Capture the index
+	// rather than the control, since the list of controls can grow.
+	if (s_scheduler != nullptr)
+	{
+		auto const controlIndex = m_index;
+
+		s_runtime.m_stateTimerSlotIDs[m_index] = s_scheduler->AddSlot(
+			[controlIndex](Time const& currentTime)
+			{
+				s_controls[controlIndex].Process(currentTime);
+				GPIOCommit(currentTime);
+				ControlsWakeForEvents();
+			});
+	}
+	
+	// Set the individual control moving duration.
+	m_standardMovingDurationMS = config.m_movingDurationMS;
+
+	Logger::WriteLine("Initialized control \'", m_name, "\' with GPIO pins (up ", m_upGPIOPin,
+							", down ", m_downGPIOPin, ") and duration ", m_standardMovingDurationMS,
+							" ms.");
+}
+
+// Handle uninitialization.
+//
+void Control::Uninitialize()
+{
+	if (s_scheduler != nullptr)
+	{
+		s_scheduler->RemoveSlot(s_runtime.m_stateTimerSlotIDs[m_index]);
+	}
+
+	// Release pins.
+	GPIOReleasePin(m_upGPIOPin);
+	GPIOReleasePin(m_downGPIOPin);
+}
+
+// Process a tick.
+//
+// currentTime:	The time of the current tick.
+//
+void Control::Process(Time const& currentTime)
+{
+	auto& state = s_runtime.m_states[m_index];
+	auto& desiredAction = s_runtime.m_desiredActions[m_index];
+	auto& mode = s_runtime.m_modes[m_index];
+	auto& movingDurationMS = s_runtime.m_movingDurationsMS[m_index];
+	auto& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+	auto const stateTimerSlotID = s_runtime.m_stateTimerSlotIDs[m_index];
+	auto& processPending = s_runtime.m_processPending[m_index];
+
+	processPending = false;
+
+	// Handle state transitions.
+	switch (state)
+	{
+		case kStateIdle:
+		{
+			// Wait until moving is desired to transition.
+			if (desiredAction == kActionStopped) {
+				StopWaitingToMove(currentTime);
+				break;
+			}
+
+			// Wait until there is enough power to start another motor.
+			if (TryStartMoving(currentTime) == false)
+			{
+				break;
+			}
+
+			// Transition to moving.
+			if (desiredAction == kActionMovingUp)
+			{
+				state = kStateMovingUp;
+
+				// Set the pin to on.
+				GPIOSetPinOn(m_upGPIOPin);
+			}
+			else
+			{
+				state = kStateMovingDown;
+
+				// Set the pin to on.
+				GPIOSetPinOn(m_downGPIOPin);
+			}
+			
+			// Record when the state transition timer began.
+			stateStartTime = currentTime;
+			LimitTimedMove(movingDurationMS);
+			ScheduleStateTimer(movingDurationMS);
+
+			s_runtime.Activate(m_index);
+			RecordTransition(kStateIdle, true, currentTime);
+		}
+		break;
+
+		case kStateMovingUp:	// Fall through...
+		case kStateMovingDown:
+		{
+			// Get elapsed time since state start.
+			auto const elapsedTime = currentTime - stateStartTime;
+
+			// Get the action corresponding to this state, as well as the one for the opposite state.
+			auto const matchingAction = (state == kStateMovingUp) ? kActionMovingUp :
+				kActionMovingDown;
+			auto const oppositeAction = (state == kStateMovingUp) ? kActionMovingDown :
+				kActionMovingUp;
+			
+			// A new duration for the same direction is measured from the start of the state too.
+			if (desiredAction == matchingAction)
+			{
+				LimitTimedMove(movingDurationMS);
+			}
+
+			// Wait until the desired action no longer matches or the time limit has run out.
+			if ((desiredAction == matchingAction) && (elapsedTime < Milliseconds(movingDurationMS)))
+			{
+				// The duration may have changed since the timer was scheduled.
+				ScheduleStateTimer(movingDurationMS);
+				break;
+			}
+
+			// The movement so far counts whether the direction changes or the control stops.
+			UpdatePosition(currentTime);
+
+			// We are about to change the state, so keep track of the old one.
+			auto const oldState = state;
+			
+			if (desiredAction == oppositeAction)
+			{
+				// Transition to the opposite state.
+				auto const oppositeState = (state == kStateMovingUp) ? kStateMovingDown :
+					kStateMovingUp;
+				state = oppositeState;
+
+				// Flip the pins.
+				auto const oldStatePin = (state == kStateMovingDown) ? m_upGPIOPin :
+					m_downGPIOPin;
+				auto const newStatePin = (state == kStateMovingDown) ? m_downGPIOPin :
+					m_upGPIOPin;
+				GPIOSetPinOff(oldStatePin);
+				GPIOSetPinOn(newStatePin);
+			}
+			else
+			{
+				// Transition to cool down.
+				state = kStateCoolDown;
+
+				// Set the pins to off.
+				GPIOSetPinOff(m_upGPIOPin);
+				GPIOSetPinOff(m_downGPIOPin);
+
+				s_movingControlCount--;
+			}
+			
+			// Record when the state transition timer began.
+			stateStartTime = currentTime;
+
+			if (state != kStateCoolDown)
+			{
+				LimitTimedMove(movingDurationMS);
+			}
+
+			ScheduleStateTimer((state == kStateCoolDown) ? ms_coolDownDurationMS :
+				movingDurationMS);
+
+			RecordTransition(oldState, true, currentTime);
+
+			// This control stopping may have made room for another.
+			if (state == kStateCoolDown)
+			{
+				ControlsStartWaitingControls(currentTime);
+			}
+		}
+		break;
+
+		case kStateCoolDown:
+		{
+			// Clear the desired action.
+			desiredAction = kActionStopped;
+
+			// Get elapsed time since state start.
+			auto const elapsedTime = currentTime - stateStartTime;
+
+			// Wait until the time limit has run out.
+			if (elapsedTime < Milliseconds(ms_coolDownDurationMS))
+			{
+				ScheduleStateTimer(ms_coolDownDurationMS);
+				break;
+			}
+
+			// Transition to idle.
+			state = kStateIdle;
+			s_runtime.Deactivate(m_index);
+
+			if (s_scheduler != nullptr)
+			{
+				s_scheduler->DisarmSlot(stateTimerSlotID);
+			}
+
+			// Set the pins to off.
+			GPIOSetPinOff(m_upGPIOPin);
+			GPIOSetPinOff(m_downGPIOPin);
+
+			RecordTransition(kStateCoolDown, false, currentTime);
+
+			// Carry on to a position that had to wait for this move to finish.
+			if (m_pendingTargetPercent != kNoTargetPercent)
+			{
+				auto const targetPercent = m_pendingTargetPercent;
+				PlanMoveToPosition(desiredAction, movingDurationMS, m_pendingTargetPercent,
+										 targetPercent, currentTime);
+				mode = kModeTimed;
+
+				if (desiredAction != kActionStopped)
+				{
+					Process(currentTime);
+				}
+			}
+		}
+		break;
+
+		default:
+		{
+			Logger::WriteLine("Control \"", state, "\": Unrecognized state ", m_name,
+									" in Process()");
+		}
+		break;
+	}
+}
+
+// Set the desired action. A move is dropped if the controls are too far behind, but a stop never
+// is.
+//
+// desiredAction:		The desired action.
+// mode:					The mode of the action.
+// durationPercent:	(Optional) The percent of the normal duration to perform the action for.
+//
+void Control::SetDesiredAction(Actions desiredAction, Modes mode, unsigned int durationPercent)
+{
+	ControlRequest request;
+	MakeActionRequest(request, desiredAction, mode, durationPercent);
+
+	if (ControlsQueueRequests(&request, 1u) == true)
+	{
+		ControlsLogRequest(request);
+		return;
+	}
+
+	// A stop is never dropped, even when the queue is full.
+	if (desiredAction == kActionStopped)
+	{
+		ControlsRequestStop(request.m_controlIndex, mode);
+		ControlsLogRequest(request);
+		return;
+	}
+
+	Logger::WriteLine(Shell::Red("Control \""), m_name,
+							Shell::Red("\": Dropped desired action because the controls are too far "
+										  "behind."));
+}
+
+// Make a request for a desired action, without queueing it.
+//
+// request:				(Output) The request.
+// desiredAction:		The desired action.
+// mode:					The mode of the action.
+// durationPercent:	The percent of the normal duration to perform the action for.
+//
+void Control::MakeActionRequest(ControlRequest& request, Actions desiredAction, Modes mode,
+	unsigned int durationPercent) const
+{
+	static_assert(std::is_same_v<decltype(durationPercent), decltype(CommandToken::m_parameter)>,
+					  "Assert the type of `durationPercent` "
+					  "is the same as the type of `CommandToken::m_parameter`. "
+					  "Currently, the main purpose of `CommandToken::m_parameter` "
+					  "is to be used as `durationPercent`, "
+					  "so this assertion serves as a notification for if "
+					  "the types become unsynchronized.");
+
+	auto movingDurationMS = ms_maxMovingDurationMS;
+
+	if (mode == kModeTimed)
+	{
+		// Set the current moving duration based on the requested percentage of the standard amount.
+		auto const durationFraction = std::min(durationPercent, 100u) / 100.0f;
+		movingDurationMS = static_cast<unsigned int>(m_standardMovingDurationMS * durationFraction);
+	}
+
+	request = ControlRequest{ ControlsGetIndex(*this), desiredAction, mode, movingDurationMS };
+}
+
+// Apply a desired action. This must be called from the thread that processes the controls.
+//
+// desiredAction:		The desired action.
+// mode:					The mode of the action.
+// movingDurationMS:	How long to move for (in milliseconds).
+//
+void Control::ApplyDesiredAction(Actions desiredAction, Modes mode, unsigned int movingDurationMS)
+{
+	// Any other action replaces a move to a position.
+	m_pendingTargetPercent = kNoTargetPercent;
+
+	s_runtime.m_desiredActions[m_index] = desiredAction;
+	s_runtime.m_modes[m_index] = mode;
+	s_runtime.m_movingDurationsMS[m_index] = movingDurationMS;
+	ControlsMarkSnapshotPending(m_index);
+
+	// Act on the new desired action on the next tick.
+	auto& processPending = s_runtime.m_processPending[m_index];
+
+	if (processPending == false)
+	{
+		processPending = true;
+		s_pendingControlIndices.push_back(m_index);
+	}
+}
+
+// Move to a position, as far as it can be estimated.
+//
+// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+//
+void Control::SetDesiredPosition(unsigned int targetPercent)
+{
+	ControlRequest request;
+	MakePositionRequest(request, targetPercent);
+
+	if (ControlsQueueRequests(&request, 1u) == true)
+	{
+		ControlsLogRequest(request);
+	}
+	else
+	{
+		Logger::WriteLine(Shell::Red("Control \""), m_name,
+								Shell::Red("\": Dropped desired position because the controls are too far "
+											  "behind."));
+	}
+}
+
+// Make a request to move to a position, without queueing it.
+//
+// request:			(Output) The request.
+// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+//
+void Control::MakePositionRequest(ControlRequest& request, unsigned int targetPercent) const
+{
+	targetPercent = std::min(targetPercent, 100u);
+
+	request = ControlRequest{ ControlsGetIndex(*this), kActionStopped, kModeTimed, 0u };
+	request.m_targetPercent = targetPercent;
+}
+
+// Apply a desired position. This must be called from the thread that processes the controls.
+//
+// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+// currentTime:	The current time.
+//
+void Control::ApplyDesiredPosition(unsigned int targetPercent, Time const& currentTime)
+{
+	auto& state = s_runtime.m_states[m_index];
+
+	// Moving again has to wait for the cool down, so pick up from wherever this one leaves it.
+	if (state == kStateCoolDown)
+	{
+		m_pendingTargetPercent = targetPercent;
+		return;
+	}
+
+	auto action = kActionStopped;
+	unsigned int movingDurationMS = 0u;
+	unsigned int followUpTargetPercent = kNoTargetPercent;
+	PlanMoveToPosition(action, movingDurationMS, followUpTargetPercent, targetPercent,
+							 currentTime);
+
+	ApplyDesiredAction(action, kModeTimed, movingDurationMS);
+	m_pendingTargetPercent = followUpTargetPercent;
+}
+
+// Estimate the position, including any movement in progress. This must be called from the thread
+// that processes the controls.
+//
+// currentTime:	The current time.
+//
+// Returns:	The position, from 0 (fully lowered) to 100 (fully raised).
+//
+float Control::EstimatePositionPercent(Time const& currentTime) const
+{
+	auto& state = s_runtime.m_states[m_index];
+	auto& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+
+	if (((state != kStateMovingUp) && (state != kStateMovingDown)) ||
+		 (m_standardMovingDurationMS == 0u))
+	{
+		return m_positionPercent;
+	}
+
+	auto const elapsedMS = std::chrono::duration<float, std::milli>(currentTime -
+		stateStartTime).count();
+	auto const travelPercent = std::max(elapsedMS, 0.0f) * 100.0f / m_standardMovingDurationMS;
+	auto const positionPercent = (state == kStateMovingUp) ? (m_positionPercent + travelPercent) :
+		(m_positionPercent - travelPercent);
+
+	return std::clamp(positionPercent, 0.0f, 100.0f);
+}
+
+// Get the state.
+//
+Control::State Control::GetState() const
+{
+	return s_runtime.m_states[m_index];
+}
+
+// Get the status as it is right now. This must be called from the thread that processes the
+// controls.
+//
+// status:	(Output) The status.
+//
+void Control::GetStatus(ControlStatus& status) const
+{
+	status.m_state = s_runtime.m_states[m_index];
+	status.m_stateStartTime = s_runtime.m_stateStartTimes[m_index];
+	status.m_stateDurationMS = GetStateDurationMS();
+	status.m_desiredAction = s_runtime.m_desiredActions[m_index];
+	status.m_mode = s_runtime.m_modes[m_index];
+	status.m_waitingToMove = m_waitingToMove;
+	status.m_positionPercent = m_positionPercent;
+	status.m_positionKnown = m_positionKnown;
+}
+
+// Enable or disable all controls.
+//
+// enable:	Whether to enable or disable all controls.
+//
+void Control::Enable(bool enable)
+{
+	if (enable == false)
+	{
+		Logger::WriteLine("Controls disabled.");
+	}
+	else
+	{
+		Logger::WriteLine("Controls enabled.");
+	}
+}
+
+// Set the durations.
+//
+// movingDurationMS:		Duration of the moving state (in milliseconds).
+// coolDownDurationMS:	Duration of the cool down state (in milliseconds).
+//
+void Control::SetDurations(unsigned int movingDurationMS, unsigned int coolDownDurationMS)
+{
+	ms_maxMovingDurationMS = movingDurationMS;
+	ms_coolDownDurationMS = coolDownDurationMS;
+
+	Logger::WriteLine("Control durations set to moving - ", movingDurationMS, " ms, cool down - ",
+							coolDownDurationMS, " ms.");
+}
+
+// Limit how many controls can move at once, since every motor starting together can draw more than
+// the power supply can give. Controls that can't start yet wait in line.
+//
+// maxMovingControls:	How many controls can move at once, or 0 for no limit.
+// startStaggerMS:		The least time between controls starting to move (in milliseconds).
+//
+void Control::SetMoveLimits(unsigned int maxMovingControls, unsigned int startStaggerMS)
+{
+	ms_maxMovingControls = maxMovingControls;
+	ms_startStaggerMS = startStaggerMS;
+
+	Logger::WriteLine("Control move limits set to at most ", maxMovingControls,
+							" moving at once (0 is no limit), starting ", startStaggerMS, " ms apart.");
+}
+
+// Look up a control by its name.
+//
+// name:	The name of the control.
+//
+// Returns:		The control, or null if one with the name could not be found.
+//
+Control* Control::GetByName(std::string const& name)
+{
+	auto controlIterator = s_controlNameToIndexMap.find(name);
+	if (controlIterator == s_controlNameToIndexMap.end())
+	{
+		return nullptr;
+	}
+	
+	auto const controlIndex = controlIterator->second;
+	return &s_controls[controlIndex];
+}
+		
+// Queue an event for a transition to the current state.
+//
+// oldState:				The state before the transition.
+// playNotification:	Whether a notification should be played for the transition.
+// currentTime:			When the transition happened.
+//
+void Control::RecordTransition(State oldState, bool playNotification, Time const& currentTime)
+{
+	ControlEvent event;
+	event.m_type = ControlEvent::kTypeStateChanged;
+	event.m_oldState = oldState;
+	event.m_playNotification = playNotification;
+	event.m_moveStartDelay = m_moveStartDelay;
+	event.m_stateDurationMS = GetStateDurationMS();
+
+	RecordEvent(event, currentTime);
+}
+
+// Fill in the details of the control and queue an event to be passed to the listeners on the main
+// thread.
+//
+// event:			(Input/Output) The event, with its type and type specific details filled in.
+// currentTime:	When the event happened.
+//
+void Control::RecordEvent(ControlEvent& event, Time const& currentTime)
+{
+	event.m_controlIndex = m_index;
+	event.m_time = currentTime;
+	event.m_newState = s_runtime.m_states[m_index];
+	event.m_desiredAction = s_runtime.m_desiredActions[m_index];
+	event.m_mode = s_runtime.m_modes[m_index];
+	event.m_positionPercent = m_positionPercent;
+	event.m_positionKnown = m_positionKnown;
+
+	// Every change that is worth an event is worth a snapshot.
+	ControlsMarkSnapshotPending(m_index);
+
+	auto const recordPosition = s_eventRecordPosition.load(std::memory_order_relaxed);
+
+	if ((recordPosition - s_eventDispatchPosition.load(std::memory_order_acquire)) >=
+		 kControlEventQueueCapacity)
+	{
+		s_droppedEventCount.fetch_add(1u, std::memory_order_relaxed);
+		return;
+	}
+
+	s_events[recordPosition & (kControlEventQueueCapacity - 1u)] = event;
+	s_eventRecordPosition.store(recordPosition + 1u, std::memory_order_release);
+
+	// The main loop is woken once the pins have been set.
+	s_eventsRecorded = true;
+}
+
+// Get how long the current state is expected to last.
+//
+// Returns:	The duration (in milliseconds), or 0 if the state lasts until something changes it.
+//
+unsigned int Control::GetStateDurationMS() const
+{
+	switch (s_runtime.m_states[m_index])
+	{
+		case kStateMovingUp:	// Fall through...
+		case kStateMovingDown:
+		{
+			return s_runtime.m_movingDurationsMS[m_index];
+		}
+
+		case kStateCoolDown:
+		{
+			return ms_coolDownDurationMS;
+		}
+
+		default:
+		{
+			return 0u;
+		}
+	}
+}
+
+// Make sure the control is processed when the current state has lasted for a duration.
+//
+// durationMS:	How long after the state started to process the control (in milliseconds).
+//
+void Control::ScheduleStateTimer(unsigned int durationMS)
+{
+	auto const& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+
+	if (s_scheduler == nullptr)
+	{
+		return;
+	}
+
+	// Replace any deadline for an earlier duration. The slot is reused, so this doesn't allocate.
+	s_scheduler->ArmSlot(s_runtime.m_stateTimerSlotIDs[m_index],
+								stateStartTime + Milliseconds(durationMS));
+}
+
+// Check whether the move limits allow the control to start moving, and count it as moving if they
+// do. Otherwise, the control waits in line.
+//
+// currentTime:	The current time.
+//
+// Returns:	True if the control can start moving, false if it has to wait.
+//
+bool Control::TryStartMoving(Time const& currentTime)
+{
+	auto const controlIndex = ControlsGetIndex(*this);
+
+	// Controls start in the order they asked to.
+	auto const firstWaitingIndex = s_runtime.m_firstWaitingIndex;
+	auto const firstInLine = (firstWaitingIndex == ControlRuntime::kNoWaitingControl) ||
+		(firstWaitingIndex == controlIndex);
+	auto const underLimit = (ms_maxMovingControls == 0u) ||
+		(s_movingControlCount < ms_maxMovingControls);
+	auto const staggerEndTime = s_lastMoveStartTime + Milliseconds(ms_startStaggerMS);
+	auto const staggered = (s_moveStarted == false) || (currentTime >= staggerEndTime);
+
+	if ((firstInLine == true) && (underLimit == true) && (staggered == true))
+	{
+		m_moveStartDelay = Nanoseconds{ 0 };
+
+		if (m_waitingToMove == true)
+		{
+			m_waitingToMove = false;
+			m_moveStartDelay = currentTime - m_waitStartTime;
+			s_runtime.LeaveWaitingLine(controlIndex);
+		}
+
+		s_movingControlCount++;
+		s_moveStarted = true;
+		s_lastMoveStartTime = currentTime;
+		return true;
+	}
+
+	if (m_waitingToMove == false)
+	{
+		m_waitingToMove = true;
+		m_waitStartTime = currentTime;
+		s_runtime.JoinWaitingLine(controlIndex);
+
+		ControlEvent event;
+		event.m_type = ControlEvent::kTypeMoveWaiting;
+		event.m_oldState = kStateIdle;
+		RecordEvent(event, currentTime);
+	}
+
+	// A control stopping will start the line moving again, but nothing else marks the end of the
+	// stagger.
+	if ((underLimit == true) && (staggered == false) && (s_scheduler != nullptr))
+	{
+		s_scheduler->ArmSlot(s_moveStartSlotID, staggerEndTime);
+	}
+
+	return false;
+}
+
+// Leave the line of controls waiting to move, if the control is in it.
+//
+// currentTime:	The current time.
+//
+void Control::StopWaitingToMove(Time const& currentTime)
+{
+	if (m_waitingToMove == false)
+	{
+		return;
+	}
+
+	m_waitingToMove = false;
+
+	auto const controlIndex = ControlsGetIndex(*this);
+	auto const wasFirstInLine = (s_runtime.m_firstWaitingIndex == controlIndex);
+	s_runtime.LeaveWaitingLine(controlIndex);
+
+	// The next in line may have only been waiting on this control.
+	if (wasFirstInLine == true)
+	{
+		ControlsStartWaitingControls(currentTime);
+	}
+}
+
+// Add the movement of the current moving state to the position. This should be done as the moving
+// state ends.
+//
+// currentTime:	The time the moving state ends.
+//
+void Control::UpdatePosition(Time const& currentTime)
+{
+	auto& state = s_runtime.m_states[m_index];
+	auto& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+
+	m_positionPercent = EstimatePositionPercent(currentTime);
+
+	// Moving for the whole standard duration must have reached the end, wherever it started from.
+	if (currentTime - stateStartTime >= Milliseconds(m_standardMovingDurationMS))
+	{
+		m_positionPercent = (state == kStateMovingUp) ? 100.0f : 0.0f;
+		m_positionKnown = true;
+	}
+}
+
+// Limit a timed move to how long it takes to reach the end it is heading for, plus the overrun at
+// the ends, if the position is known. This must only be called while moving.
+//
+// movingDurationMS:	(Input/Output) How long to move for (in milliseconds), measured from the start
+//							of the current moving state.
+//
+void Control::LimitTimedMove(unsigned int& movingDurationMS) const
+{
+	auto const state = s_runtime.m_states[m_index];
+
+	// Moves that last as long as they are held are already limited by the maximum duration.
+	if ((s_runtime.m_modes[m_index] != kModeTimed) || (m_positionKnown == false))
+	{
+		return;
+	}
+
+	// The position is as of the start of the moving state.
+	auto const remainingPercent = (state == kStateMovingUp) ? (100.0f - m_positionPercent) :
+		m_positionPercent;
+	auto const limitMS = static_cast<unsigned int>(std::lround((remainingPercent +
+		kEndOverrunPercent) / 100.0f * m_standardMovingDurationMS));
+
+	movingDurationMS = std::min(movingDurationMS, limitMS);
+}
+
+// Work out the shortest move to a position.
+//
+// action:						(Output) The action to take.
+// movingDurationMS:			(Output) How long to move for (in milliseconds), measured from the start
+//									of the current moving state if the action continues it.
+// followUpTargetPercent:	(Output) A position to move to once this move has finished, or
+//									kNoTargetPercent if this move reaches the target.
+// targetPercent:				The position to move to.
+// currentTime:				The current time.
+//
+void Control::PlanMoveToPosition(Actions& action, unsigned int& movingDurationMS,
+											unsigned int& followUpTargetPercent, unsigned int targetPercent,
+											Time const& currentTime) const
+{
+	auto& state = s_runtime.m_states[m_index];
+	auto& stateStartTime = s_runtime.m_stateStartTimes[m_index];
+
+	targetPercent = std::min(targetPercent, 100u);
+	followUpTargetPercent = kNoTargetPercent;
+
+	auto const atEnd = (targetPercent == 0u) || (targetPercent == 100u);
+
+	// Without a known position, move all the way to the nearer end first to find it.
+	if (m_positionKnown == false)
+	{
+		action = (targetPercent >= 50u) ? kActionMovingUp : kActionMovingDown;
+		movingDurationMS = m_standardMovingDurationMS;
+
+		if (atEnd == false)
+		{
+			followUpTargetPercent = targetPercent;
+		}
+
+		return;
+	}
+
+	auto const positionPercent = EstimatePositionPercent(currentTime);
+	auto travelPercent = static_cast<float>(targetPercent) - positionPercent;
+
+	if (std::fabs(travelPercent) < kPositionTolerancePercent)
+	{
+		action = kActionStopped;
+		movingDurationMS = 0u;
+		return;
+	}
+
+	action = (travelPercent > 0.0f) ? kActionMovingUp : kActionMovingDown;
+	travelPercent = std::fabs(travelPercent);
+
+	if (atEnd == true)
+	{
+		travelPercent += kEndOverrunPercent;
+	}
+
+	movingDurationMS = static_cast<unsigned int>(std::lround(travelPercent / 100.0f *
+		m_standardMovingDurationMS));
+
+	// The moving state measures its duration from when it started, so continuing it counts the
+	// time it has already been moving.
+	auto const continuing = ((action == kActionMovingUp) && (state == kStateMovingUp)) ||
+		((action == kActionMovingDown) && (state == kStateMovingDown));
+
+	if (continuing == true)
+	{
+		movingDurationMS += static_cast<unsigned int>(
+			std::chrono::duration_cast<Milliseconds>(currentTime - stateStartTime).count());
+	}
+}
+
+// ControlRequestBatch members
+
+static_assert(ControlRequestBatch::kCapacity <= kControlQueueCapacity,
+				  "A whole batch must fit in the queue.");
+
+// Add a desired action for a control.
+//
+// control:				The control.
+// desiredAction:		The desired action.
+// mode:					The mode of the action.
+// durationPercent:	(Optional) The percent of the normal duration to perform the action for.
+//
+// Returns:	True if the request was added, false if the batch is full.
+//
+bool ControlRequestBatch::AddAction(Control const& control, Control::Actions desiredAction,
+	Control::Modes mode, unsigned int durationPercent)
+{
+	if (m_count >= kCapacity)
+	{
+		return false;
+	}
+
+	control.MakeActionRequest(m_requests[m_count], desiredAction, mode, durationPercent);
+	m_count++;
+	return true;
+}
+
+// Add a move to a position for a control.
+//
+// control:			The control.
+// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+//
+// Returns:	True if the request was added, false if the batch is full.
+//
+bool ControlRequestBatch::AddPosition(Control const& control, unsigned int targetPercent)
+{
+	if (m_count >= kCapacity)
+	{
+		return false;
+	}
+
+	control.MakePositionRequest(m_requests[m_count], targetPercent);
+	m_count++;
+	return true;
+}
+
+// Add stopping all of the controls.
+//
+// Returns:	True if the request was added, false if the batch is full.
+//
+bool ControlRequestBatch::AddStopAll()
+{
+	if (m_count >= kCapacity)
+	{
+		return false;
+	}
+
+	m_requests[m_count] = ControlRequest{ ControlRequest::kAllControls, Control::kActionStopped,
+		Control::kModeManual, 0u };
+	m_count++;
+	return true;
+}
+
+// Queue the requests, to be applied in order in the same tick, and empty the batch. This may be
+// called from any thread.
+//
+// Returns:	True if the requests were queued, false if there wasn't room for all of them, in which
+//				case only the stops were kept.
+//
+bool ControlRequestBatch::Submit()
+{
+	if (m_count == 0u)
+	{
+		return true;
+	}
+
+	auto const queued = ControlsQueueRequests(m_requests.data(), m_count);
+
+	for (unsigned int requestIndex = 0u; requestIndex < m_count; requestIndex++)
+	{
+		auto const& request = m_requests[requestIndex];
+
+		if (queued == true)
+		{
+			ControlsLogRequest(request);
+			continue;
+		}
+
+		// The moves are dropped, but a stop never is.
+		if ((request.m_action == Control::kActionStopped) &&
+			 (request.m_targetPercent == Control::kNoTargetPercent))
+		{
+			ControlsRequestStop(request.m_controlIndex, request.m_mode);
+			ControlsLogRequest(request);
+		}
+	}
+
+	m_count = 0u;
+	return queued;
+}
+
+// ControlHandle members
+
+// Look up a control by its name. This should be done when loading, not when acting.
+//
+// name:	The name of the control.
+//
+// Returns:	A handle to the control, which is invalid if there is no control with the name.
+//
+ControlHandle ControlHandle::Resolve(char const* name)
+{
+	ControlHandle handle;
+
+	auto const controlIterator = s_controlNameToIndexMap.find(name);
+
+	if (controlIterator != s_controlNameToIndexMap.end())
+	{
+		handle.m_controlIndex = controlIterator->second;
+	}
+
+	return handle;
+}
+
+// Get the control the handle refers to.
+//
+// Returns:	The control, or null if the handle is invalid.
+//
+Control* ControlHandle::GetControl() const
+{
+	// This also covers the handle being invalid.
+	if (m_controlIndex >= s_controls.size())
+	{
+		return nullptr;
+	}
+
+	return &s_controls[m_controlIndex];
+}
+
+// ControlAction members
+
+// A constructor for emplacing.
+// 
+ControlAction::ControlAction(char const* controlName, Control::Actions action)
+	: m_action(action)
+{
+	// Copy the control name.
+	std::strncpy(m_controlName, controlName, kControlNameCapacity - 1);
+	m_controlName[kControlNameCapacity - 1] = '\0';
+}
+
+// Try to find a control action that matches the input text.
+//
+// action:		(Output) The action that was found.
+// inputText:	The name of the action to look for. 
+//
+// Returns:		True if the action was found, false otherwise.
+//
+auto GetControlActionFromString(Control::Actions& action, char const* inputText)
+{
+	// The names of the actions.
+	static constexpr char const* const kActionNames[] =
+	{
+		"stop",	// kActionStopped
+		"up",		// kActionMovingUp
+		"down",	// kActionMovingDown
+	};
+
+	// Try to find a control action that matches this text.
+	auto const actionCount = Control::Actions::kNumActions;
+	for (unsigned int actionIndex = 0; actionIndex < actionCount; actionIndex++)
+	{
+		// Compare the text to the action name.
+		auto const* actionName = kActionNames[actionIndex];
+			
+		if (std::strncmp(inputText, actionName, std::strlen(actionName)) != 0)
+		{
+			continue;
+		}
+			
+		// We found the action, so return it.
+		action = static_cast<Control::Actions>(actionIndex);
+		return true;
+	}
+		
+	return false;
+}
+
+// Read a control action from JSON. 
+//
+// object:	The JSON object representing a control action.
+//
+// Returns:		True if the action was read successfully, false otherwise.
+//
+bool ControlAction::ReadFromJSON(rapidjson::Value const& object)
+{
+	if (object.IsObject() == false)
+	{
+		Logger::WriteLine("Control action cannot be parsed because it is not an object.");
+		return false;
+	}
+
+	// We must have a control name.
+	auto const controlIterator = object.FindMember("control");
+
+	if (controlIterator == object.MemberEnd())
+	{
+		Logger::WriteLine("Control action is missing a control name.");
+		return false;
+	}
+
+	if (controlIterator->value.IsString() == false)
+	{
+		Logger::WriteLine("Control action has a control name, but it is not a string.");
+		return false;
+	}
+	
+	// Copy no more than the amount of text the buffer can hold.
+	strncpy(m_controlName, controlIterator->value.GetString(), sizeof(m_controlName) - 1);
+	m_controlName[sizeof(m_controlName) - 1] = '\0';
+
+	// We might have a position to move to instead of an action.
+	auto const positionIterator = object.FindMember("position");
+
+	if (positionIterator != object.MemberEnd())
+	{
+		if ((positionIterator->value.IsUint() == false) ||
+			 (positionIterator->value.GetUint() > 100u))
+		{
+			Logger::WriteLine("Control action has a position, but it is not a percent.");
+			return false;
+		}
+
+		m_action = Control::kActionStopped;
+		m_targetPercent = positionIterator->value.GetUint();
+		return true;
+	}
+
+	// Otherwise, we must have an action.
+	m_targetPercent = Control::kNoTargetPercent;
+	auto const actionIterator = object.FindMember("action");
+
+	if (actionIterator == object.MemberEnd())
+	{
+		Logger::WriteLine("Control action does not have an action or a position.");
+		return false;
+	}
+
+	if (actionIterator->value.IsString() == false)
+	{
+		Logger::WriteLine("Control action has an action, but it is not a string.");
+		return false;
+	}
+
+	// Try to get the corresponding action.
+	if (GetControlActionFromString(m_action, actionIterator->value.GetString()) == false)
+	{
+		Logger::WriteLine("Control action has an unrecognized action.");
+		return false;
+	}
+
+	return true;
+}
+
+// Look up the control by name, so that it doesn't need to be looked up when acting. The controls
+// must have been initialized.
+//
+// Returns:	True if the control was found, false otherwise.
+//
+bool ControlAction::ResolveControl()
+{
+	m_controlHandle = ControlHandle::Resolve(m_controlName);
+
+	if (m_controlHandle.IsValid() == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Control action refers to unknown control \""),
+								m_controlName, Shell::Yellow("\"."));
+		return false;
+	}
+
+	return true;
+}
+	
+// Functions
+//
+
+// Write an event to the logger.
+//
+// event:	The event.
+//
+static void ControlsLogEvent(ControlEvent const& event)
+{
+	auto const* controlName = ControlsGetName(event.m_controlIndex);
+
+	if (event.m_type == ControlEvent::kTypeMoveWaiting)
+	{
+		Logger::WriteLine("Control \"", controlName, "\": Waiting for the move limits before "
+								"starting.");
+		return;
+	}
+
+	Logger::WriteLine("Control \"", controlName, "\": State transition from \"",
+							kControlStateNames[event.m_oldState], "\" to \"",
+							kControlStateNames[event.m_newState], "\" triggered.");
+
+	if ((event.m_oldState == Control::kStateIdle) && (event.m_moveStartDelay > Nanoseconds{ 0 }))
+	{
+		Logger::WriteLine("Control \"", controlName, "\": Waited ",
+								std::chrono::duration_cast<Milliseconds>(event.m_moveStartDelay).count(),
+								" ms for the move limits before starting.");
+	}
+
+	// Every move ends in a cool down, which is when the position has been updated.
+	if ((event.m_newState == Control::kStateCoolDown) && (event.m_positionKnown == true))
+	{
+		Logger::WriteLine("Control \"", controlName, "\": Estimated position is ",
+								std::lround(event.m_positionPercent), " percent.");
+	}
+}
+
+// Play the notification for an event, if it has one.
+//
+// event:	The event.
+//
+static void ControlsPlayEventNotification(ControlEvent const& event)
+{
+	if ((event.m_type != ControlEvent::kTypeStateChanged) || (event.m_playNotification == false))
+	{
+		return;
+	}
+
+	// Do not play a notification if the mode is manual.
+	if (event.m_mode == Control::kModeManual)
+	{
+		return;
+	}
+
+	// Build the notification name.
+	static constexpr std::size_t kNotificationNameCapacity{ 128u };
+	char notificationName[kNotificationNameCapacity];
+	std::snprintf(notificationName, kNotificationNameCapacity, "%s_%s",
+		ControlsGetName(event.m_controlIndex), kControlStateNotificationNames[event.m_newState]);
+
+	NotificationPlay(notificationName);
+}
+
+// Keep statistics from an event.
+//
+// event:	The event.
+//
+static void ControlsRecordEventStatistics(ControlEvent const& event)
+{
+	// Every move starts from idle, so that's when to note how long it waited to start.
+	if ((event.m_type == ControlEvent::kTypeStateChanged) &&
+		 (event.m_oldState == Control::kStateIdle))
+	{
+		s_moveStartDelaySampleWindow.Add(event.m_moveStartDelay);
+	}
+}
+
+// Keep track of what is known about a control from an event.
+//
+// event:	The event.
+//
+static void ControlsRecordEventStatus(ControlEvent const& event)
+{
+	if (event.m_controlIndex >= s_statuses.size())
+	{
+		return;
+	}
+
+	auto& status = s_statuses[event.m_controlIndex];
+	status.m_desiredAction = event.m_desiredAction;
+
+	if (event.m_type == ControlEvent::kTypeMoveWaiting)
+	{
+		status.m_waitingToMove = true;
+		return;
+	}
+
+	status.m_state = event.m_newState;
+	status.m_stateStartTime = event.m_time;
+	status.m_stateDurationMS = event.m_stateDurationMS;
+	status.m_mode = event.m_mode;
+	status.m_waitingToMove = false;
+	status.m_positionPercent = event.m_positionPercent;
+	status.m_positionKnown = event.m_positionKnown;
+}
+
+// Take a snapshot of the controls that have changed, for other threads to read.
+//
+// currentTime:	The time of the current tick.
+//
+static void ControlsPublishSnapshot(Time const& currentTime)
+{
+	if (s_snapshotPendingIndices.empty() == true)
+	{
+		return;
+	}
+
+	auto sequence = s_snapshotSequence.load(std::memory_order_relaxed);
+
+	// Move readers off of each copy before writing it. The copies were the same before, so only the
+	// controls that changed need writing.
+	for (auto& snapshot : s_snapshots)
+	{
+		sequence++;
+		s_snapshotSequence.store(sequence, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		snapshot.m_time = currentTime;
+
+		for (auto const controlIndex : s_snapshotPendingIndices)
+		{
+			s_controls[controlIndex].GetStatus(snapshot.m_statuses[controlIndex]);
+		}
+	}
+
+	for (auto const controlIndex : s_snapshotPendingIndices)
+	{
+		s_runtime.m_snapshotPending[controlIndex] = false;
+	}
+
+	s_snapshotPendingIndices.clear();
+}
+
+// Initialize all of the controls.
+//
+// configs: 	Configuration parameters for the controls to add.
+// scheduler:	Used to process the controls when their states have lasted long enough.
+//
+void ControlsInitialize(std::vector<ControlConfig> const& configs, Scheduler& scheduler)
+{
+	s_scheduler = &scheduler;
+	ControlQueueReset();
+
+	s_moveStartSlotID = s_scheduler->AddSlot(
+		[](Time const& timerTime)
+		{
+			ControlsStartWaitingControls(timerTime);
+			GPIOCommit(timerTime);
+			ControlsWakeForEvents();
+		});
+
+	// Anything that takes time happens after the pins have been set, when the events are passed on.
+	s_logEventListenerID = ControlsAddEventListener(ControlsLogEvent);
+	s_notificationEventListenerID = ControlsAddEventListener(ControlsPlayEventNotification);
+	s_statisticsEventListenerID = ControlsAddEventListener(ControlsRecordEventStatistics);
+	s_statusEventListenerID = ControlsAddEventListener(ControlsRecordEventStatus);
+
+	for (auto const& config : configs)
+	{
+		ControlsCreateControl(config);
+	}
+
+	// Request all of the pins at once, rather than disturbing the others as each is acquired.
+	GPIORequestAcquiredPins();
+}
+
+// Uninitialize all of the controls.
+//
+void ControlsUninitialize()
+{
+	s_controlNameToIndexMap.clear();
+	
+	for (auto& control : s_controls)
+	{
+		control.Uninitialize();
+	}
+	
+	// Get rid of all of the controls.
+	s_controls.clear();
+	s_runtime.Clear();
+	s_pendingControlIndices.clear();
+	s_requestControlIndices.clear();
+	ControlQueueReset();
+	s_stopValues.reset();
+	s_stopAllValue.store(0u, std::memory_order_relaxed);
+	s_stopsRequested.store(false, std::memory_order_relaxed);
+	s_pendingStops.clear();
+
+	if (s_scheduler != nullptr)
+	{
+		s_scheduler->RemoveSlot(s_moveStartSlotID);
+	}
+
+	s_movingControlCount = 0u;
+	s_moveStarted = false;
+	s_moveStartDelaySampleWindow.Clear();
+	s_statuses.clear();
+
+	for (auto& snapshot : s_snapshots)
+	{
+		snapshot.m_statuses.clear();
+	}
+
+	s_snapshotPendingIndices.clear();
+	s_snapshotSequence.store(0u, std::memory_order_relaxed);
+
+	// Nothing is recording events any more.
+	s_eventDispatchPosition.store(s_eventRecordPosition.load(std::memory_order_relaxed),
+											std::memory_order_relaxed);
+	s_droppedEventCount.store(0u, std::memory_order_relaxed);
+	s_eventsRecorded = false;
+
+	ControlsRemoveEventListener(s_logEventListenerID);
+	ControlsRemoveEventListener(s_notificationEventListenerID);
+	ControlsRemoveEventListener(s_statisticsEventListenerID);
+	ControlsRemoveEventListener(s_statusEventListenerID);
+
+	s_scheduler = nullptr;
+}
+
+// Process all of the controls that have been given a new desired action. This must be called from
+// the thread that processes the controls.
+//
+// currentTime:	The time of the current tick.
+//
+void ControlsProcess(Time const& currentTime)
+{
+	// Apply the queued requests, oldest first. At most a full queue's worth are applied, so that
+	// busy producers can't hold up the tick.
+	// A batch is never split between ticks, though.
+	ControlQueueEntry entry;
+	unsigned int appliedCount = 0u;
+	bool inBatch = false;
+
+	// A stop that was requested without the queue goes in after the requests queued before it.
+	ControlsGatherStops();
+	std::size_t stopIndex = 0u;
+	auto const stopCount = s_pendingStops.size();
+
+	while (((appliedCount < kControlQueueCapacity) || (inBatch == true)) &&
+			 (ControlQueuePop(entry, currentTime) == true))
+	{
+		while ((stopIndex < stopCount) && (entry.m_sequenceNumber >=
+				 ControlsGetStopQueuePosition(s_pendingStops[stopIndex].m_stopValue)))
+		{
+			ControlsApplyStop(s_pendingStops[stopIndex], currentTime);
+			stopIndex++;
+		}
+
+		ControlsApplyRequest(entry.m_request, currentTime);
+
+		appliedCount++;
+		inBatch = (entry.m_batchRemainingCount > 0u);
+	}
+
+	auto const popPosition = ControlQueueGetPopPosition();
+
+	for (; stopIndex < stopCount; stopIndex++)
+	{
+		auto const& stop = s_pendingStops[stopIndex];
+
+		if (popPosition < ControlsGetStopQueuePosition(stop.m_stopValue))
+		{
+			// Some of the requests before it are still to come, so wait for them.
+			s_stopsRequested.store(true, std::memory_order_relaxed);
+			break;
+		}
+
+		ControlsApplyStop(stop, currentTime);
+	}
+
+	// Every other transition happens when a state timer expires.
+	for (auto const controlIndex : s_pendingControlIndices)
+	{
+		s_controls[controlIndex].Process(currentTime);
+	}	
+
+	s_pendingControlIndices.clear();
+
+	// Every control that changed this tick has its pins set together.
+	GPIOCommit(currentTime);
+
+	ControlsPublishSnapshot(currentTime);
+	ControlsWakeForEvents();
+}
+
+// Pass the events that have happened since the last call to the listeners. This must be called
+// from the main thread.
+//
+void ControlsDispatchEvents()
+{
+	auto const droppedEventCount = s_droppedEventCount.exchange(0u, std::memory_order_relaxed);
+
+	if (droppedEventCount > 0u)
+	{
+		Logger::WriteLine(Shell::Yellow("Dropped "), droppedEventCount,
+								Shell::Yellow(" control events because they weren't passed on in time."));
+	}
+
+	auto dispatchPosition = s_eventDispatchPosition.load(std::memory_order_relaxed);
+	auto const recordPosition = s_eventRecordPosition.load(std::memory_order_acquire);
+
+	while (dispatchPosition != recordPosition)
+	{
+		// Copy the event out, so that its slot can be reused while the listeners run.
+		auto const event = s_events[dispatchPosition & (kControlEventQueueCapacity - 1u)];
+
+		dispatchPosition++;
+		s_eventDispatchPosition.store(dispatchPosition, std::memory_order_release);
+
+		for (auto const& entry : s_eventListeners)
+		{
+			entry.m_listener(event);
+		}
+	}
+
+	// The dropped events came after the ones that were waiting.
+	s_dispatchDroppedEventCount += droppedEventCount;
+}
+
+// Get the number of events that were dropped, before they could be passed to the listeners,
+// because the main thread was too far behind. This only goes up, as each dispatch finds more. This
+// must be called from the main thread.
+//
+unsigned long long ControlsGetDroppedEventCount()
+{
+	return s_dispatchDroppedEventCount;
+}
+
+// Add a function to pass events to. This must be called from the main thread.
+//
+// listener:	The function to pass events to.
+//
+// Returns:	An ID that can be used to remove the listener.
+//
+ControlEventListenerID ControlsAddEventListener(ControlEventListener listener)
+{
+	auto const listenerID = s_nextEventListenerID++;
+	s_eventListeners.push_back({ listenerID, std::move(listener) });
+
+	return listenerID;
+}
+
+// Remove a function that events were passed to. This must be called from the main thread.
+//
+// listenerID:	(Input/Output) The ID of the listener. It will be made invalid.
+//
+void ControlsRemoveEventListener(ControlEventListenerID& listenerID)
+{
+	if (listenerID == kInvalidControlEventListenerID)
+	{
+		return;
+	}
+
+	auto const entryIterator = std::find_if(s_eventListeners.begin(), s_eventListeners.end(),
+		[listenerID](ControlEventListenerEntry const& entry)
+		{
+			return entry.m_listenerID == listenerID;
+		});
+
+	if (entryIterator != s_eventListeners.end())
+	{
+		s_eventListeners.erase(entryIterator);
+	}
+
+	listenerID = kInvalidControlEventListenerID;
+}
+
+// Get the name of a control.
+//
+// controlIndex:	The index of the control.
+//
+// Returns:	The name, or an empty string if there is no control at the index.
+//
+char const* ControlsGetName(unsigned int controlIndex)
+{
+	if (controlIndex >= s_controls.size())
+	{
+		return "";
+	}
+
+	return s_controls[controlIndex].GetName();
+}
+
+// Get the number of controls.
+//
+unsigned int ControlsGetCount()
+{
+	return static_cast<unsigned int>(s_controls.size());
+}
+
+// Get what is known about a control from the events that have been passed on. This must be called
+// from the main thread.
+//
+// status:			(Output) The status of the control.
+// controlIndex:	The index of the control.
+//
+// Returns:	True if there is a control at the index, false otherwise.
+//
+bool ControlsGetStatus(ControlStatus& status, unsigned int controlIndex)
+{
+	if (controlIndex >= s_statuses.size())
+	{
+		return false;
+	}
+
+	status = s_statuses[controlIndex];
+	return true;
+}
+
+// Get a snapshot of every control, as of the end of the last tick in which any of them changed.
+// This may be called from any thread. It never waits on a lock and never holds up the thread that
+// processes the controls. A copy that a new snapshot was taken during is thrown away and read
+// again, at most kControlsSnapshotMaxReadAttempts times.
+//
+// statuses:		(Output) The status of each control, by index. Reusing the same vector avoids
+//						allocating.
+// snapshotTime:	(Output) The time of the tick that the snapshot was taken in.
+// snapshotCount:	(Output) The number of snapshots that have been taken, so that readers can tell
+//						whether anything has changed.
+//
+// Returns:	True on success, false if every copy overlapped a new snapshot, in which case the
+//				outputs may not be consistent.
+//
+bool ControlsGetSnapshot(std::vector<ControlStatus>& statuses, Time& snapshotTime,
+	unsigned int& snapshotCount)
+{
+	for (unsigned int attemptIndex = 0u; attemptIndex < kControlsSnapshotMaxReadAttempts;
+		  attemptIndex++)
+	{
+		auto const sequence = s_snapshotSequence.load(std::memory_order_acquire);
+		auto const& snapshot = s_snapshots[sequence & 1u];
+
+		statuses.assign(snapshot.m_statuses.begin(), snapshot.m_statuses.end());
+		snapshotTime = snapshot.m_time;
+
+		// Make sure the copy is finished before looking at the sequence again.
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		// Only if the writer moved on to this copy while it was being read does it need reading
+		// again.
+		if (s_snapshotSequence.load(std::memory_order_relaxed) == sequence)
+		{
+			snapshotCount = sequence / 2u;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Get the name of a state, like "moving up".
+//
+// state:	The state.
+//
+char const* ControlsGetStateName(Control::State state)
+{
+	return kControlStateNames[state];
+}
+
+// Get the name of an action, like "moving up".
+//
+// action:	The action.
+//
+char const* ControlsGetActionName(Control::Actions action)
+{
+	return kControlActionNames[action];
+}
+
+// Get the name of a movement mode, like "timed".
+//
+// mode:	The movement mode.
+//
+char const* ControlsGetModeName(Control::Modes mode)
+{
+	return kControlModeNames[mode];
+}
+
+// Apply an action to every control that could be doing something other than it. Idle controls
+// that have nothing waiting to be processed are already stopped, so they aren't visited.
+//
+// request:	The request to apply.
+//
+static void ControlsApplyRequestToAll(ControlRequest const& request)
+{
+	// Gather the controls first, since applying the action changes the lists.
+	s_requestControlIndices.assign(s_runtime.m_activeControlIndices.begin(),
+											 s_runtime.m_activeControlIndices.end());
+
+	for (auto controlIndex = s_runtime.m_firstWaitingIndex;
+		  controlIndex != ControlRuntime::kNoWaitingControl;
+		  controlIndex = s_runtime.m_nextWaitingIndices[controlIndex])
+	{
+		s_requestControlIndices.push_back(controlIndex);
+	}
+
+	s_requestControlIndices.insert(s_requestControlIndices.end(), s_pendingControlIndices.begin(),
+											 s_pendingControlIndices.end());
+
+	for (auto const controlIndex : s_requestControlIndices)
+	{
+		s_controls[controlIndex].ApplyDesiredAction(request.m_action, request.m_mode,
+			request.m_movingDurationMS);
+	}
+}
+
+// Get statistics for how long moves waited for the move limits before starting. This must be
+// called from the main thread.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlsGetMoveStartDelayStatistics(ProfilerStatistics& statistics)
+{
+	s_moveStartDelaySampleWindow.GetStatistics(statistics);
+}
+
+// Write the control statistics to the logger. This must be called from the main thread.
+//
+void ControlsLogStatistics()
+{
+	Logger::WriteLine("Control move start delay over the last ", ProfilerSampleWindow::kCapacity,
+							" moves:");
+
+	ProfilerStatistics statistics;
+	ControlsGetMoveStartDelayStatistics(statistics);
+	ProfilerLogStatisticsLine("start", statistics);
+	Logger::WriteLine();
+}
+
+// Apply a request to a control. This must be called from the thread that processes the controls.
+//
+// request:			The request to apply.
+// currentTime:	The time of the current tick.
+//
+void ControlsApplyRequest(ControlRequest const& request, Time const& currentTime)
+{
+	if (request.m_controlIndex == ControlRequest::kAllControls)
+	{
+		ControlsApplyRequestToAll(request);
+		return;
+	}
+
+	if (request.m_controlIndex >= s_controls.size())
+	{
+		return;
+	}
+
+	auto& control = s_controls[request.m_controlIndex];
+
+	if (request.m_targetPercent != Control::kNoTargetPercent)
+	{
+		control.ApplyDesiredPosition(request.m_targetPercent, currentTime);
+		return;
+	}
+
+	control.ApplyDesiredAction(request.m_action, request.m_mode, request.m_movingDurationMS);
+}
+
+// Create a new control with the provided config. Control names must be unique.
+//
+// config:	Configuration parameters for the control.
+//
+// Returns:		True if the control was successfully created, false otherwise.
+//
+bool ControlsCreateControl(ControlConfig const& config)
+{
+	// Check to see whether a control with this name already exists.
+	if (s_controlNameToIndexMap.find(config.m_name) != s_controlNameToIndexMap.end())
+	{
+		Logger::WriteLine("Control with name \"", config.m_name, "\" already exists.");
+		return false;
+	}
+	
+	// Add a new control.
+	s_controls.emplace_back(Control());
+	s_runtime.Add();
+	s_statuses.emplace_back();
+	TimerGetCurrent(s_statuses.back().m_stateStartTime);
+	
+	// Then, initialize it.
+	unsigned int const controlIndex = s_controls.size() - 1;
+	s_controls[controlIndex].Initialize(config);
+
+	// Make sure that the lists of controls never have to grow while acting.
+	auto const controlCount = s_controls.size();
+	s_pendingControlIndices.reserve(controlCount);
+	s_snapshotPendingIndices.reserve(controlCount);
+	s_requestControlIndices.reserve(controlCount * 2u);
+
+	// Nothing can be requesting stops while controls are created either.
+	s_stopValues = std::make_unique<std::atomic<std::size_t>[]>(controlCount);
+	s_pendingStops.reserve(controlCount + 1u);
+
+	// Nothing can be reading the snapshots while controls are created.
+	for (auto& snapshot : s_snapshots)
+	{
+		snapshot.m_statuses.emplace_back();
+		s_controls[controlIndex].GetStatus(snapshot.m_statuses.back());
+	}
+	
+	// And add it to the map.
+	s_controlNameToIndexMap.insert({config.m_name, controlIndex});
+
+	return true;
+}
+
+// Stop all of the controls, after any requests that have already been queued. This may be called
+// from any thread, and is never dropped, even when the queue is full.
+//
+void ControlsStopAll()
+{
+	Logger::WriteLine("Stopping all controls.");
+
+	// This doesn't go through the queue, so that it can never be dropped.
+	ControlsRequestStop(ControlRequest::kAllControls, Control::kModeManual);
+}
+
+// Get the number of controls that are moving or cooling down. This must be called from the thread
+// that processes the controls.
+//
+// Returns:	The number of controls.
+//
+unsigned int ControlsGetActiveCount()
+{
+	return static_cast<unsigned int>(s_runtime.m_activeControlIndices.size());
+}
@@ -1,228 +1,748 @@
-#pragma once
-
-#include <vector>
-
-#include "rapidjson/document.h"
-
-#include "timer.h"
-
-// Types
-//
-
-// Configuration parameters to initialize a control.
-struct ControlConfig
-{
-	// Read a control config from JSON. 
-	//
-	// object:	The JSON object representing a control config.
-	//
-	// Returns:		True if the config was read successfully, false otherwise.
-	//
-	bool ReadFromJSON(rapidjson::Value const& object);
-
-	// Constants.
-	static constexpr unsigned int kControlNameCapacity{32u};
-
-	// The name of the control.
-	char m_name[kControlNameCapacity];
-
-	// The GPIO pins to use.
-	int m_upGPIOPin;
-	int m_downGPIOPin;
-
-	// The duration of the moving state (in milliseconds) for this control.
-	unsigned int m_movingDurationMS;
-};
-
-// An individual control.
-class Control
-{
-	public:
-
-		// States a control may be in.
-		enum State
-		{
-			kStateIdle = 0,
-			kStateMovingUp,
-			kStateMovingDown,
-			kStateCoolDown,    // A delay after moving before moving can occur again.
-		};
-
-		// Actions a control may be desired to perform.
-		enum Actions
-		{
-			kActionStopped = 0,
-			kActionMovingUp,
-			kActionMovingDown,
-			
-			kNumActions,
-		};
-
-		// Movement modes, either manual or timed for now.
-		enum Modes
-		{
-			kModeManual = 0, 
-			kModeTimed,
-		};
-		
-		// Handle initialization.
-		//
-		// config:	Configuration parameters for the control.
-		//
-		void Initialize(ControlConfig const& config);
-
-		// Handle uninitialization.
-		//
-		void Uninitialize();
-		
-		// Process a tick.
-		//
-		void Process();
-
-		// Set the desired action.
-		//
-		// desiredAction:		The desired action.
-		// mode:					The mode of the action.
-		// durationPercent:	(Optional) The percent of the normal duration to perform the action 
-		//								for.
-		//
-		void SetDesiredAction(Actions desiredAction, Modes mode, unsigned int durationPercent = 100);
-
-		// Get the name.
-		//
-		char const* GetName() const
-		{
-			return m_name;
-		}
-
-		// Get the state.
-		//
-		State GetState() const
-		{
-			return m_state;
-		}
-		
-		// Enable or disable all controls.
-		//
-		// enable:	Whether to enable or disable all controls.
-		//
-		static void Enable(bool enable);
-		
-		// Set the durations.
-		//
-		// movingDurationMS:		Duration of the moving state (in milliseconds).
-		// coolDownDurationMS:	Duration of the cool down state (in milliseconds).
-		//
-		static void SetDurations(unsigned int movingDurationMS, unsigned int coolDownDurationMS);
-		
-		// Look up a control by its name.
-		//
-		// name:	The name of the control.
-		//
-		// Returns:		The control, or null if one with the name could not be found.
-		//
-		static Control* GetByName(std::string const& name);
-		
-	private:
-
-		// Constants.
-		static constexpr unsigned int kNameCapacity = 32u;
-
-		// Play a notification for the state.
-		//
-		void PlayNotification();
-		
-		// The name of the control.
-		char m_name[kNameCapacity];
-		
-		// The control state.
-		State m_state;
-
-		// A record of when the state transition timer began.
-		Time m_stateStartTime;
-
-		// The desired action.
-		Actions m_desiredAction;
-
-		// The control movement mode.
-		Modes m_mode;
-		
-		// The GPIO pins to use.
-		int m_upGPIOPin;
-		int m_downGPIOPin;
-		
-		// The current duration of the moving state (in milliseconds) for this control.
-		unsigned int m_movingDurationMS;
-		
-		// The standard duration of the moving state (in milliseconds) for this control.
-		unsigned int m_standardMovingDurationMS;
-
-		// Maximum duration of the moving state (in milliseconds).
-		static unsigned int ms_maxMovingDurationMS;
-		
-		// Maximum duration of the cool down state (in milliseconds).
-		static unsigned int ms_coolDownDurationMS;	
-};
-
-// Enough information to trigger a specific control action.
-struct ControlAction
-{	
-	ControlAction() = default;
-	
-	// A constructor for emplacing.
-	// 
-	ControlAction(char const* controlName, Control::Actions action);
-
-	// Read a control action from JSON. 
-	//
-	// object:	The JSON object representing a control action.
-	//
-	// Returns:		True if the action was read successfully, false otherwise.
-	//
-	bool ReadFromJSON(rapidjson::Value const& object);
-
-	// Attempt to get the control corresponding to the control action.
-	//
-	// Returns:	The control if successful, null otherwise.
-	//
-	Control* GetControl() const;
-	
-	// Constants.
-	static constexpr unsigned int kControlNameCapacity = 32u;
-	
-	// The name of the control to manipulate.
-	char m_controlName[kControlNameCapacity];
-	
-	// The action for the control.
-	Control::Actions m_action;
-};
-
-
-// Functions
-//
-
-// Initialize all of the controls.
-//
-// configs: Configuration parameters for the controls to add.
-//
-void ControlsInitialize(std::vector<ControlConfig> const& configs);
-
-// Uninitialize all of the controls.
-//
-void ControlsUninitialize();
-
-// Process all of the controls.
-//
-void ControlsProcess();
-
-// Create a new control with the provided config. Control names must be unique.
-//
-// config:	Configuration parameters for the control.
-//
-// Returns:		True if the control was successfully created, false otherwise.
-//
-bool ControlsCreateControl(ControlConfig const& config);
-
-// Stop all of the controls.
-//
-void ControlsStopAll();
+#pragma once
+
+#include <array>
+#include <climits>
+#include <functional>
+#include <vector>
+
+#include "rapidjson/document.h"
+
+#include "profiler.h"
+#include "scheduler.h"
+#include "timer.h"
+
+// Types
+//
+
+struct ControlEvent;
+struct ControlStatus;
+struct ControlRequest;
+
+// Configuration parameters to initialize a control.
+struct ControlConfig
+{
+	// Read a control config from JSON. 
+	//
+	// object:	The JSON object representing a control config.
+	//
+	// Returns:		True if the config was read successfully, false otherwise.
+	//
+	bool ReadFromJSON(rapidjson::Value const& object);
+
+	// Constants.
+	static constexpr unsigned int kControlNameCapacity{32u};
+
+	// The name of the control.
+	char m_name[kControlNameCapacity];
+
+	// The GPIO pins to use.
+	int m_upGPIOPin;
+	int m_downGPIOPin;
+
+	// The duration of the moving state (in milliseconds) for this control.
+	unsigned int m_movingDurationMS;
+};
+
+// An individual control.
+class Control
+{
+	public:
+
+		// States a control may be in.
+		enum State
+		{
+			kStateIdle = 0,
+			kStateMovingUp,
+			kStateMovingDown,
+			kStateCoolDown,    // A delay after moving before moving can occur again.
+		};
+
+		// Actions a control may be desired to perform.
+		enum Actions
+		{
+			kActionStopped = 0,
+			kActionMovingUp,
+			kActionMovingDown,
+			
+			kNumActions,
+		};
+
+		// Movement modes, either manual or timed for now.
+		enum Modes
+		{
+			kModeManual = 0, 
+			kModeTimed,
+		};
+
+		// Constants.
+
+		// Signifies that there is no target position.
+		static constexpr unsigned int kNoTargetPercent{ UINT_MAX };
+		
+		// Handle initialization.
+		//
+		// config:	Configuration parameters for the control.
+		//
+		void Initialize(ControlConfig const& config);
+
+		// Handle uninitialization.
+		//
+		void Uninitialize();
+		
+		// Process a tick.
+		//
+		// currentTime:	The time of the current tick.
+		//
+		void Process(Time const& currentTime);
+
+		// Set the desired action. A move is dropped if the controls are too far behind, but a stop
+		// never is.
+		//
+		// desiredAction:		The desired action.
+		// mode:					The mode of the action.
+		// durationPercent:	(Optional) The percent of the normal duration to perform the action 
+		//								for.
+		//
+		void SetDesiredAction(Actions desiredAction, Modes mode, unsigned int durationPercent = 100);
+
+		// Make a request for a desired action, without queueing it.
+		//
+		// request:				(Output) The request.
+		// desiredAction:		The desired action.
+		// mode:					The mode of the action.
+		// durationPercent:	The percent of the normal duration to perform the action for.
+		//
+		void MakeActionRequest(ControlRequest& request, Actions desiredAction, Modes mode,
+			unsigned int durationPercent) const;
+
+		// Apply a desired action. This must be called from the thread that processes the controls.
+		//
+		// desiredAction:		The desired action.
+		// mode:					The mode of the action.
+		// movingDurationMS:	How long to move for (in milliseconds).
+		//
+		void ApplyDesiredAction(Actions desiredAction, Modes mode, unsigned int movingDurationMS);
+
+		// Move to a position, as far as it can be estimated.
+		//
+		// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+		//
+		void SetDesiredPosition(unsigned int targetPercent);
+
+		// Make a request to move to a position, without queueing it.
+		//
+		// request:			(Output) The request.
+		// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+		//
+		void MakePositionRequest(ControlRequest& request, unsigned int targetPercent) const;
+
+		// Apply a desired position. This must be called from the thread that processes the controls.
+		//
+		// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+		// currentTime:	The current time.
+		//
+		void ApplyDesiredPosition(unsigned int targetPercent, Time const& currentTime);
+
+		// Estimate the position, including any movement in progress. This must be called from the
+		// thread that processes the controls.
+		//
+		// currentTime:	The current time.
+		//
+		// Returns:	The position, from 0 (fully lowered) to 100 (fully raised).
+		//
+		float EstimatePositionPercent(Time const& currentTime) const;
+
+		// Determine whether the position is known. It becomes known once the control has moved for
+		// its whole standard duration in one direction, since it must then be at one end.
+		//
+		bool IsPositionKnown() const
+		{
+			return m_positionKnown;
+		}
+
+		// Get the name.
+		//
+		char const* GetName() const
+		{
+			return m_name;
+		}
+
+		// Get the state.
+		//
+		State GetState() const;
+
+		// Get the status as it is right now. This must be called from the thread that processes the
+		// controls.
+		//
+		// status:	(Output) The status.
+		//
+		void GetStatus(ControlStatus& status) const;
+		
+		// Enable or disable all controls.
+		//
+		// enable:	Whether to enable or disable all controls.
+		//
+		static void Enable(bool enable);
+		
+		// Set the durations.
+		//
+		// movingDurationMS:		Duration of the moving state (in milliseconds).
+		// coolDownDurationMS:	Duration of the cool down state (in milliseconds).
+		//
+		static void SetDurations(unsigned int movingDurationMS, unsigned int coolDownDurationMS);
+
+		// Limit how many controls can move at once, since every motor starting together can draw
+		// more than the power supply can give. Controls that can't start yet wait in line.
+		//
+		// maxMovingControls:	How many controls can move at once, or 0 for no limit.
+		// startStaggerMS:		The least time between controls starting to move (in milliseconds).
+		//
+		static void SetMoveLimits(unsigned int maxMovingControls, unsigned int startStaggerMS);
+		
+		// Look up a control by its name.
+		//
+		// name:	The name of the control.
+		//
+		// Returns:		The control, or null if one with the name could not be found.
+		//
+		static Control* GetByName(std::string const& name);
+		
+	private:
+
+		// Constants.
+		static constexpr unsigned int kNameCapacity = 32u;
+
+		// Queue an event for a transition to the current state.
+		//
+		// oldState:				The state before the transition.
+		// playNotification:	Whether a notification should be played for the transition.
+		// currentTime:			When the transition happened.
+		//
+		void RecordTransition(State oldState, bool playNotification, Time const& currentTime);
+
+		// Fill in the details of the control and queue an event to be passed to the listeners on the
+		// main thread.
+		//
+		// event:			(Input/Output) The event, with its type and type specific details filled
+		//						in.
+		// currentTime:	When the event happened.
+		//
+		void RecordEvent(ControlEvent& event, Time const& currentTime);
+
+		// Get how long the current state is expected to last.
+		//
+		// Returns:	The duration (in milliseconds), or 0 if the state lasts until something changes
+		//				it.
+		//
+		unsigned int GetStateDurationMS() const;
+
+		// Make sure the control is processed when the current state has lasted for a duration.
+		//
+		// durationMS:	How long after the state started to process the control (in milliseconds).
+		//
+		void ScheduleStateTimer(unsigned int durationMS);
+
+		// Check whether the move limits allow the control to start moving, and count it as moving if
+		// they do. Otherwise, the control waits in line.
+		//
+		// currentTime:	The current time.
+		//
+		// Returns:	True if the control can start moving, false if it has to wait.
+		//
+		bool TryStartMoving(Time const& currentTime);
+
+		// Leave the line of controls waiting to move, if the control is in it.
+		//
+		// currentTime:	The current time.
+		//
+		void StopWaitingToMove(Time const& currentTime);
+
+		// Add the movement of the current moving state to the position. This should be done as the
+		// moving state ends.
+		//
+		// currentTime:	The time the moving state ends.
+		//
+		void UpdatePosition(Time const& currentTime);
+
+		// Limit a timed move to how long it takes to reach the end it is heading for, plus the
+		// overrun at the ends, if the position is known. This must only be called while moving.
+		//
+		// movingDurationMS:	(Input/Output) How long to move for (in milliseconds), measured from the
+		//							start of the current moving state.
+		//
+		void LimitTimedMove(unsigned int& movingDurationMS) const;
+
+		// Work out the shortest move to a position.
+		//
+		// action:						(Output) The action to take.
+		// movingDurationMS:			(Output) How long to move for (in milliseconds), measured from the
+		//									start of the current moving state if the action continues it.
+		// followUpTargetPercent:	(Output) A position to move to once this move has finished, or
+		//									kNoTargetPercent if this move reaches the target.
+		// targetPercent:				The position to move to.
+		// currentTime:				The current time.
+		//
+		void PlanMoveToPosition(Actions& action, unsigned int& movingDurationMS,
+										unsigned int& followUpTargetPercent, unsigned int targetPercent,
+										Time const& currentTime) const;
+		
+		// The index of the control. The state, desired action, mode, moving duration, state start
+		// time and state timer are kept with those of the other controls, at this index.
+		unsigned int m_index = 0u;
+
+		// The name of the control.
+		char m_name[kNameCapacity];
+		
+		// The GPIO pins to use.
+		int m_upGPIOPin;
+		int m_downGPIOPin;
+		
+		// The standard duration of the moving state (in milliseconds) for this control. This is how
+		// long it takes to move from one end to the other.
+		unsigned int m_standardMovingDurationMS;
+
+		// The estimated position as of the start of the current state, from 0 (fully lowered) to 100
+		// (fully raised).
+		float m_positionPercent = 0.0f;
+
+		// Whether the position has been found by moving all the way to one end.
+		bool m_positionKnown = false;
+
+		// A position to move to once the current move and cool down have finished.
+		unsigned int m_pendingTargetPercent = kNoTargetPercent;
+
+		// Whether the control is in line, waiting for the move limits to let it start moving.
+		bool m_waitingToMove = false;
+
+		// When the control started waiting to move.
+		Time m_waitStartTime;
+
+		// How long the control waited before its current move started.
+		Nanoseconds m_moveStartDelay{ 0 };
+
+		// Maximum duration of the moving state (in milliseconds).
+		static unsigned int ms_maxMovingDurationMS;
+		
+		// Maximum duration of the cool down state (in milliseconds).
+		static unsigned int ms_coolDownDurationMS;	
+
+		// How many controls can move at once, or 0 for no limit.
+		static unsigned int ms_maxMovingControls;
+
+		// The least time between controls starting to move (in milliseconds).
+		static unsigned int ms_startStaggerMS;
+};
+
+// Something that happened to a control. Events are recorded as the controls are processed, and
+// only passed to listeners afterwards on the main thread, so that logging, notifications and the
+// like stay out of the way of setting the pins.
+struct ControlEvent
+{
+	// Types of events.
+	enum Types
+	{
+		kTypeStateChanged = 0,	// The control transitioned to a new state.
+		kTypeMoveWaiting,			// The control has to wait for the move limits before moving.
+	};
+
+	// The type of the event.
+	Types m_type = kTypeStateChanged;
+
+	// The index of the control.
+	unsigned int m_controlIndex = 0u;
+
+	// When the event happened.
+	Time m_time;
+
+	// The states before and after the event.
+	Control::State m_oldState = Control::kStateIdle;
+	Control::State m_newState = Control::kStateIdle;
+
+	// The desired action and movement mode at the time of the event.
+	Control::Actions m_desiredAction = Control::kActionStopped;
+	Control::Modes m_mode = Control::kModeManual;
+
+	// Whether a notification should be played for a state change.
+	bool m_playNotification = false;
+
+	// How long the new state is expected to last (in milliseconds), for state changes. This is 0
+	// for states that last until something changes them.
+	unsigned int m_stateDurationMS = 0u;
+
+	// How long the control waited to start moving, for state changes from idle.
+	Nanoseconds m_moveStartDelay{ 0 };
+
+	// The estimated position at the time of the event, if it is known.
+	float m_positionPercent = 0.0f;
+	bool m_positionKnown = false;
+};
+
+// What is known about a control, either by the main thread as of the last of its events that was
+// passed on, or by any thread as of the last snapshot.
+struct ControlStatus
+{
+	// The state, and when it started.
+	Control::State m_state = Control::kStateIdle;
+	Time m_stateStartTime;
+
+	// How long the state is expected to last (in milliseconds), or 0 if it lasts until something
+	// changes it.
+	unsigned int m_stateDurationMS = 0u;
+
+	// The desired action, and the movement mode of the current or last move.
+	Control::Actions m_desiredAction = Control::kActionStopped;
+	Control::Modes m_mode = Control::kModeManual;
+
+	// Whether the control is waiting for the move limits before moving.
+	bool m_waitingToMove = false;
+
+	// The estimated position at the start of the state, if it is known.
+	float m_positionPercent = 0.0f;
+	bool m_positionKnown = false;
+};
+
+// A function that events are passed to.
+using ControlEventListener = std::function<void(ControlEvent const&)>;
+
+// Identifies a listener, so that it can be removed.
+using ControlEventListenerID = unsigned int;
+
+// Signifies that there is no listener.
+static constexpr ControlEventListenerID kInvalidControlEventListenerID{ 0u };
+
+// How many times ControlsGetSnapshot() tries to copy the snapshot before giving up. A copy only has
+// to be read again when a new snapshot is taken during it, which is at most once a tick.
+static constexpr unsigned int kControlsSnapshotMaxReadAttempts{ 100u };
+
+// A request for a control to change its desired action.
+struct ControlRequest
+{
+	// Constants.
+
+	// Signifies that the request applies to every control.
+	static constexpr unsigned int kAllControls{ UINT_MAX };
+
+	// The index of the control, or kAllControls.
+	unsigned int m_controlIndex;
+
+	// The desired action.
+	Control::Actions m_action;
+
+	// The mode of the action.
+	Control::Modes m_mode;
+
+	// How long to move for (in milliseconds).
+	unsigned int m_movingDurationMS;
+
+	// The position to move to instead, or kNoTargetPercent to perform the action.
+	unsigned int m_targetPercent = Control::kNoTargetPercent;
+};
+
+// Requests that are queued together, so that they're applied in the same tick and the moves start
+// together.
+//
+class ControlRequestBatch
+{
+	public:
+
+		// Constants.
+
+		// The most requests a batch can hold.
+		static constexpr unsigned int kCapacity{ 16u };
+
+		// Add a desired action for a control.
+		//
+		// control:				The control.
+		// desiredAction:		The desired action.
+		// mode:					The mode of the action.
+		// durationPercent:	(Optional) The percent of the normal duration to perform the action
+		//								for.
+		//
+		// Returns:	True if the request was added, false if the batch is full.
+		//
+		bool AddAction(Control const& control, Control::Actions desiredAction, Control::Modes mode,
+			unsigned int durationPercent = 100);
+
+		// Add a move to a position for a control.
+		//
+		// control:			The control.
+		// targetPercent:	The position to move to, from 0 (fully lowered) to 100 (fully raised).
+		//
+		// Returns:	True if the request was added, false if the batch is full.
+		//
+		bool AddPosition(Control const& control, unsigned int targetPercent);
+
+		// Add stopping all of the controls.
+		//
+		// Returns:	True if the request was added, false if the batch is full.
+		//
+		bool AddStopAll();
+
+		// Queue the requests, to be applied in order in the same tick, and empty the batch. This may
+		// be called from any thread.
+		//
+		// Returns:	True if the requests were queued, false if there wasn't room for all of them, in
+		//				which case only the stops were kept.
+		//
+		bool Submit();
+
+		// Get the number of requests in the batch.
+		//
+		unsigned int GetCount() const
+		{
+			return m_count;
+		}
+
+	private:
+
+		// The requests, in order.
+		std::array<ControlRequest, kCapacity> m_requests;
+
+		// How many of the requests are valid.
+		unsigned int m_count = 0u;
+};
+
+// A control that has been looked up once, so that getting to it afterwards is only an array index.
+//
+class ControlHandle
+{
+	public:
+
+		ControlHandle() = default;
+
+		// Look up a control by its name. This should be done when loading, not when acting.
+		//
+		// name:	The name of the control.
+		//
+		// Returns:	A handle to the control, which is invalid if there is no control with the name.
+		//
+		static ControlHandle Resolve(char const* name);
+
+		// Determine whether the handle refers to a control.
+		//
+		bool IsValid() const
+		{
+			return m_controlIndex != kInvalidIndex;
+		}
+
+		// Get the control the handle refers to.
+		//
+		// Returns:	The control, or null if the handle is invalid.
+		//
+		Control* GetControl() const;
+
+		// Get the index of the control the handle refers to.
+		//
+		unsigned int GetIndex() const
+		{
+			return m_controlIndex;
+		}
+
+	private:
+
+		// Constants.
+		static constexpr unsigned int kInvalidIndex{ UINT_MAX };
+
+		// The index of the control.
+		unsigned int m_controlIndex = kInvalidIndex;
+};
+
+// Enough information to trigger a specific control action.
+struct ControlAction
+{	
+	ControlAction() = default;
+	
+	// A constructor for emplacing.
+	// 
+	ControlAction(char const* controlName, Control::Actions action);
+
+	// Read a control action from JSON. 
+	//
+	// object:	The JSON object representing a control action.
+	//
+	// Returns:		True if the action was read successfully, false otherwise.
+	//
+	bool ReadFromJSON(rapidjson::Value const& object);
+
+	// Look up the control by name, so that it doesn't need to be looked up when acting. The
+	// controls must have been initialized.
+	//
+	// Returns:	True if the control was found, false otherwise.
+	//
+	bool ResolveControl();
+
+	// Determine whether the action is a move to a position, rather than a direction.
+	//
+	bool HasTargetPosition() const
+	{
+		return m_targetPercent != Control::kNoTargetPercent;
+	}
+
+	// Get the control corresponding to the control action.
+	//
+	// Returns:	The control if it has been resolved, null otherwise.
+	//
+	Control* GetControl() const
+	{
+		return m_controlHandle.GetControl();
+	}
+	
+	// Constants.
+	static constexpr unsigned int kControlNameCapacity = 32u;
+	
+	// The name of the control to manipulate.
+	char m_controlName[kControlNameCapacity];
+	
+	// The action for the control.
+	Control::Actions m_action;
+
+	// The position to move the control to instead, or kNoTargetPercent to perform the action.
+	unsigned int m_targetPercent = Control::kNoTargetPercent;
+
+	// The control to manipulate, once it has been resolved.
+	ControlHandle m_controlHandle;
+};
+
+
+// Functions
+//
+
+// Initialize all of the controls.
+//
+// configs: 	Configuration parameters for the controls to add.
+// scheduler:	Used to process the controls when their states have lasted long enough.
+//
+void ControlsInitialize(std::vector<ControlConfig> const& configs, Scheduler& scheduler);
+
+// Uninitialize all of the controls.
+//
+void ControlsUninitialize();
+
+// Process all of the controls that have been given a new desired action. This must be called from
+// the thread that processes the controls.
+//
+// currentTime:	The time of the current tick.
+//
+void ControlsProcess(Time const& currentTime);
+
+// Pass the events that have happened since the last call to the listeners. This must be called
+// from the main thread.
+//
+void ControlsDispatchEvents();
+
+// Get the number of events that were dropped, before they could be passed to the listeners,
+// because the main thread was too far behind. This only goes up, as each dispatch finds more. This
+// must be called from the main thread.
+//
+unsigned long long ControlsGetDroppedEventCount();
+
+// Add a function to pass events to. The controls add listeners for logging, notifications and
+// statistics when they are initialized. This must be called from the main thread.
+//
+// listener:	The function to pass events to.
+//
+// Returns:	An ID that can be used to remove the listener.
+//
+ControlEventListenerID ControlsAddEventListener(ControlEventListener listener);
+
+// Remove a function that events were passed to. This must be called from the main thread, but not
+// from a listener.
+//
+// listenerID:	(Input/Output) The ID of the listener. It will be made invalid.
+//
+void ControlsRemoveEventListener(ControlEventListenerID& listenerID);
+
+// Get the name of a control.
+//
+// controlIndex:	The index of the control.
+//
+// Returns:	The name, or an empty string if there is no control at the index.
+//
+char const* ControlsGetName(unsigned int controlIndex);
+
+// Get the number of controls.
+//
+unsigned int ControlsGetCount();
+
+// Get what is known about a control from the events that have been passed on. This must be called
+// from the main thread.
+//
+// status:			(Output) The status of the control.
+// controlIndex:	The index of the control.
+//
+// Returns:	True if there is a control at the index, false otherwise.
+//
+bool ControlsGetStatus(ControlStatus& status, unsigned int controlIndex);
+
+// Get a snapshot of every control, as of the end of the last tick in which any of them changed.
+// This may be called from any thread. It never waits on a lock and never holds up the thread that
+// processes the controls. A copy that a new snapshot was taken during is thrown away and read
+// again, at most kControlsSnapshotMaxReadAttempts times.
+//
+// statuses:		(Output) The status of each control, by index. Reusing the same vector avoids
+//						allocating.
+// snapshotTime:	(Output) The time of the tick that the snapshot was taken in.
+// snapshotCount:	(Output) The number of snapshots that have been taken, so that readers can tell
+//						whether anything has changed.
+//
+// Returns:	True on success, false if every copy overlapped a new snapshot, in which case the
+//				outputs may not be consistent.
+//
+bool ControlsGetSnapshot(std::vector<ControlStatus>& statuses, Time& snapshotTime,
+	unsigned int& snapshotCount);
+
+// Get the name of a state, like "moving up".
+//
+// state:	The state.
+//
+char const* ControlsGetStateName(Control::State state);
+
+// Get the name of an action, like "moving up".
+//
+// action:	The action.
+//
+char const* ControlsGetActionName(Control::Actions action);
+
+// Get the name of a movement mode, like "timed".
+//
+// mode:	The movement mode.
+//
+char const* ControlsGetModeName(Control::Modes mode);
+
+// Get statistics for how long moves waited for the move limits before starting. This must be
+// called from the main thread.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlsGetMoveStartDelayStatistics(ProfilerStatistics& statistics);
+
+// Write the control statistics to the logger. This must be called from the main thread.
+//
+void ControlsLogStatistics();
+
+// Apply a request to a control. This must be called from the thread that processes the controls.
+//
+// request:			The request to apply.
+// currentTime:	The time of the current tick.
+//
+void ControlsApplyRequest(ControlRequest const& request, Time const& currentTime);
+
+// Create a new control with the provided config. Control names must be unique.
+//
+// config:	Configuration parameters for the control.
+//
+// Returns:		True if the control was successfully created, false otherwise.
+//
+bool ControlsCreateControl(ControlConfig const& config);
+
+// Stop all of the controls, after any requests that have already been queued. This may be called
+// from any thread, and is never dropped, even when the queue is full.
+//
+void ControlsStopAll();
+
+// Get the number of controls that are moving or cooling down. This must be called from the thread
+// that processes the controls.
+//
+// Returns:	The number of controls.
+//
+unsigned int ControlsGetActiveCount();
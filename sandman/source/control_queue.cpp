@@ -0,0 +1,271 @@
+#include "control_queue.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "logger.h"
+
+// Constants
+//
+
+// Keep data written by different threads on different cache lines.
+static constexpr std::size_t kCacheLineSize{ 64u };
+
+static_assert((kControlQueueCapacity & (kControlQueueCapacity - 1u)) == 0u,
+				  "The queue capacity must be a power of two.");
+
+// Types
+//
+
+// A slot in the queue. The sequence number says whose turn it is to use the slot: it is equal to
+// the position being queued when the slot is free, and one past it once the request is ready. It
+// is stored less the index of the slot, so that every slot starts out free for the first lap.
+struct alignas(kCacheLineSize) ControlQueueSlot
+{
+	std::atomic<std::size_t> m_sequenceNumber{ 0u };
+	ControlQueueEntry m_entry;
+};
+
+// Locals
+//
+
+// The slots, which are reused as the positions wrap around.
+static std::array<ControlQueueSlot, kControlQueueCapacity> s_slots;
+
+// The position the next request will be queued at. Producers claim positions from this.
+alignas(kCacheLineSize) static std::atomic<std::size_t> s_pushPosition{ 0u };
+
+// The position the next request will be taken from. Only the consumer changes this.
+alignas(kCacheLineSize) static std::atomic<std::size_t> s_popPosition{ 0u };
+
+// Statistics.
+alignas(kCacheLineSize) static std::atomic<unsigned int> s_queuedCount{ 0u };
+static std::atomic<unsigned int> s_droppedCount{ 0u };
+static std::atomic<unsigned int> s_takenCount{ 0u };
+static std::atomic<unsigned int> s_maxDepth{ 0u };
+static std::atomic<Nanoseconds::rep> s_totalWaitTime{ 0 };
+static std::atomic<Nanoseconds::rep> s_maxWaitTime{ 0 };
+
+// Functions
+//
+
+// Raise an atomic value to at least another value.
+//
+// maximum:	(Input/Output) The value to raise.
+// value:	The value to raise it to.
+//
+template <typename T>
+static void ControlQueueRaiseMaximum(std::atomic<T>& maximum, T value)
+{
+	auto currentMaximum = maximum.load(std::memory_order_relaxed);
+
+	while ((currentMaximum < value) && (maximum.compare_exchange_weak(currentMaximum, value,
+		std::memory_order_relaxed) == false))
+	{
+	}
+}
+
+// Queue a request to be applied by the thread that processes the controls. This may be called from
+// any thread, and never waits on a lock.
+//
+// request:	The request to queue.
+//
+// Returns:	True if the request was queued, false if the queue was full.
+//
+bool ControlQueuePush(ControlRequest const& request)
+{
+	return ControlQueuePushBatch(&request, 1u);
+}
+
+// Queue several requests to be applied together, in order, in the same tick. Either all of them are
+// queued or none are. This may be called from any thread, and never waits on a lock.
+//
+// requests:		The requests to queue.
+// requestCount:	The number of requests, which must be no more than the capacity of the queue.
+//
+// Returns:	True if the requests were queued, false if the queue didn't have room for them.
+//
+bool ControlQueuePushBatch(ControlRequest const* requests, unsigned int requestCount)
+{
+	if ((requestCount == 0u) || (requestCount > kControlQueueCapacity))
+	{
+		return false;
+	}
+
+	auto position = s_pushPosition.load(std::memory_order_relaxed);
+
+	// Claim a run of positions. Whoever claims first is applied first.
+	while (true)
+	{
+		// The consumer frees slots in order, so if the last slot is free for this lap, the ones
+		// before it are too.
+		auto const lastPosition = position + requestCount - 1u;
+		auto const lastSlotIndex = lastPosition & (kControlQueueCapacity - 1u);
+
+		auto const sequenceNumber = lastSlotIndex +
+			s_slots[lastSlotIndex].m_sequenceNumber.load(std::memory_order_acquire);
+		auto const difference = static_cast<std::intptr_t>(sequenceNumber - lastPosition);
+
+		if (difference == 0)
+		{
+			if (s_pushPosition.compare_exchange_weak(position, position + requestCount,
+				std::memory_order_relaxed) == true)
+			{
+				break;
+			}
+		}
+		else if (difference < 0)
+		{
+			// The slot still holds a request from a lap ago that hasn't been taken.
+			s_droppedCount.fetch_add(requestCount, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			// Another producer got here first.
+			position = s_pushPosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	Time queueTime;
+	TimerGetCurrent(queueTime);
+
+	// Hand the slots to the consumer, first one last. Once the consumer can see the first, it can
+	// see the rest, so the whole batch is always applied in the same tick.
+	for (auto requestIndex = requestCount; requestIndex-- > 0u; )
+	{
+		auto const requestPosition = position + requestIndex;
+		auto const slotIndex = requestPosition & (kControlQueueCapacity - 1u);
+		auto& slot = s_slots[slotIndex];
+
+		auto& entry = slot.m_entry;
+		entry.m_request = requests[requestIndex];
+		entry.m_queueTime = queueTime;
+		entry.m_sequenceNumber = requestPosition;
+		entry.m_batchRemainingCount = requestCount - requestIndex - 1u;
+
+		slot.m_sequenceNumber.store(requestPosition + 1u - slotIndex, std::memory_order_release);
+	}
+
+	s_queuedCount.fetch_add(requestCount, std::memory_order_relaxed);
+
+	auto const depth = position + requestCount - s_popPosition.load(std::memory_order_relaxed);
+	ControlQueueRaiseMaximum(s_maxDepth, static_cast<unsigned int>(depth));
+
+	return true;
+}
+
+// Take the oldest request off of the queue. This must only be called from the thread that
+// processes the controls.
+//
+// entry:			(Output) The request, if there was one.
+// currentTime:	The time of the current tick, which the request's wait is measured up to.
+//
+// Returns:	True if a request was taken, false if there are none ready.
+//
+bool ControlQueuePop(ControlQueueEntry& entry, Time const& currentTime)
+{
+	auto const position = s_popPosition.load(std::memory_order_relaxed);
+	auto const slotIndex = position & (kControlQueueCapacity - 1u);
+	auto& slot = s_slots[slotIndex];
+
+	// A producer that has claimed this position but not finished writing holds up the ones after
+	// it, so that requests are always applied in order.
+	if (slot.m_sequenceNumber.load(std::memory_order_acquire) + slotIndex != position + 1u)
+	{
+		return false;
+	}
+
+	entry = slot.m_entry;
+
+	// Free the slot for the producer that will claim it on the next lap.
+	slot.m_sequenceNumber.store(position + kControlQueueCapacity - slotIndex,
+		std::memory_order_release);
+	s_popPosition.store(position + 1u, std::memory_order_relaxed);
+
+	// Requests queued after the tick started count as not having waited at all.
+	auto const waitTime = std::max(currentTime - entry.m_queueTime, Nanoseconds{ 0 }).count();
+	s_takenCount.fetch_add(1u, std::memory_order_relaxed);
+	s_totalWaitTime.fetch_add(waitTime, std::memory_order_relaxed);
+	ControlQueueRaiseMaximum(s_maxWaitTime, waitTime);
+
+	return true;
+}
+
+// Get the position the next request will be queued at. Every request that has been queued has a
+// lower sequence number. This may be called from any thread.
+//
+std::size_t ControlQueueGetPushPosition()
+{
+	return s_pushPosition.load(std::memory_order_relaxed);
+}
+
+// Get the position the next request will be taken from. Every request with a lower sequence number
+// has been taken. This must only be called from the thread that processes the controls.
+//
+std::size_t ControlQueueGetPopPosition()
+{
+	return s_popPosition.load(std::memory_order_relaxed);
+}
+
+// Get statistics for the queue. This may be called from any thread.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlQueueGetStatistics(ControlQueueStatistics& statistics)
+{
+	statistics.m_queuedCount = s_queuedCount.load(std::memory_order_relaxed);
+	statistics.m_droppedCount = s_droppedCount.load(std::memory_order_relaxed);
+	statistics.m_takenCount = s_takenCount.load(std::memory_order_relaxed);
+	statistics.m_maxDepth = s_maxDepth.load(std::memory_order_relaxed);
+	statistics.m_totalWaitTime = Nanoseconds{ s_totalWaitTime.load(std::memory_order_relaxed) };
+	statistics.m_maxWaitTime = Nanoseconds{ s_maxWaitTime.load(std::memory_order_relaxed) };
+}
+
+// Throw away any waiting requests and forget the statistics. Nothing else may be using the queue
+// while this is called.
+//
+void ControlQueueReset()
+{
+	for (auto& slot : s_slots)
+	{
+		slot.m_sequenceNumber.store(0u, std::memory_order_relaxed);
+	}
+
+	s_pushPosition.store(0u, std::memory_order_relaxed);
+	s_popPosition.store(0u, std::memory_order_relaxed);
+
+	s_queuedCount.store(0u, std::memory_order_relaxed);
+	s_droppedCount.store(0u, std::memory_order_relaxed);
+	s_takenCount.store(0u, std::memory_order_relaxed);
+	s_maxDepth.store(0u, std::memory_order_relaxed);
+	s_totalWaitTime.store(0, std::memory_order_relaxed);
+	s_maxWaitTime.store(0, std::memory_order_relaxed);
+}
+
+// Write the queue statistics to the logger.
+//
+void ControlQueueLogStatistics()
+{
+	ControlQueueStatistics statistics;
+	ControlQueueGetStatistics(statistics);
+
+	auto const averageWaitTime = (statistics.m_takenCount > 0u) ?
+		statistics.m_totalWaitTime / statistics.m_takenCount : Nanoseconds{ 0 };
+
+	using DoubleMilliseconds = std::chrono::duration<double, std::milli>;
+
+	Logger::WriteLine("Control request queue:");
+	Logger::WriteLine(std::fixed, std::setprecision(3),
+							"\t", statistics.m_queuedCount, " queued, ", statistics.m_takenCount,
+							" applied, ", statistics.m_droppedCount, " dropped, at most ",
+							statistics.m_maxDepth, " of ", kControlQueueCapacity, " waiting",
+							" (wait avg ", DoubleMilliseconds(averageWaitTime).count(), " max ",
+							DoubleMilliseconds(statistics.m_maxWaitTime).count(), " ms)",
+
+							/* Restore the default formatting. */
+							std::defaultfloat, std::setprecision(6));
+	Logger::WriteLine();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+
+#include "control.h"
+#include "timer.h"
+
+// Constants
+//
+
+// The maximum number of requests that can be waiting to be applied. This must be a power of two.
+static constexpr unsigned int kControlQueueCapacity{ 256u };
+
+// Types
+//
+
+// A request waiting to be applied, along with when and in what order it was queued.
+struct ControlQueueEntry
+{
+	// The request.
+	ControlRequest m_request;
+
+	// When the request was queued.
+	Time m_queueTime;
+
+	// Requests are applied in the order of their sequence numbers, which is the order they were
+	// queued in.
+	std::size_t m_sequenceNumber = 0u;
+
+	// The number of requests after this one that were queued along with it, to be applied in the
+	// same tick.
+	unsigned int m_batchRemainingCount = 0u;
+};
+
+// Statistics for how the queue has kept up with the requests given to it.
+struct ControlQueueStatistics
+{
+	// The number of requests that were queued.
+	unsigned int m_queuedCount = 0u;
+
+	// The number of requests that were dropped because the queue was full.
+	unsigned int m_droppedCount = 0u;
+
+	// The number of requests that were taken off of the queue.
+	unsigned int m_takenCount = 0u;
+
+	// The most requests that have been waiting at once.
+	unsigned int m_maxDepth = 0u;
+
+	// How long the requests that were taken off of the queue waited, in total and at most.
+	Nanoseconds m_totalWaitTime{ 0 };
+	Nanoseconds m_maxWaitTime{ 0 };
+};
+
+// Functions
+//
+
+// Queue a request to be applied by the thread that processes the controls. This may be called from
+// any thread, and never waits on a lock.
+//
+// request:	The request to queue.
+//
+// Returns:	True if the request was queued, false if the queue was full.
+//
+bool ControlQueuePush(ControlRequest const& request);
+
+// Queue several requests to be applied together, in order, in the same tick. Either all of them are
+// queued or none are. This may be called from any thread, and never waits on a lock.
+//
+// requests:		The requests to queue.
+// requestCount:	The number of requests, which must be no more than the capacity of the queue.
+//
+// Returns:	True if the requests were queued, false if the queue didn't have room for them.
+//
+bool ControlQueuePushBatch(ControlRequest const* requests, unsigned int requestCount);
+
+// Take the oldest request off of the queue. This must only be called from the thread that
+// processes the controls.
+//
+// entry:			(Output) The request, if there was one.
+// currentTime:	The time of the current tick, which the request's wait is measured up to.
+//
+// Returns:	True if a request was taken, false if there are none ready.
+//
+bool ControlQueuePop(ControlQueueEntry& entry, Time const& currentTime);
+
+// Get the position the next request will be queued at. Every request that has been queued has a
+// lower sequence number. This may be called from any thread.
+//
+std::size_t ControlQueueGetPushPosition();
+
+// Get the position the next request will be taken from. Every request with a lower sequence number
+// has been taken. This must only be called from the thread that processes the controls.
+//
+std::size_t ControlQueueGetPopPosition();
+
+// Get statistics for the queue. This may be called from any thread.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlQueueGetStatistics(ControlQueueStatistics& statistics);
+
+// Throw away any waiting requests and forget the statistics. Nothing else may be using the queue
+// while this is called.
+//
+void ControlQueueReset();
+
+// Write the queue statistics to the logger.
+//
+void ControlQueueLogStatistics();
@@ -0,0 +1,358 @@
+#include "control_thread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+// Constants
+//
+
+// Used to detect when a file handle is invalid.
+static constexpr int kInvalidFileHandle{ -1 };
+
+// Locals
+//
+
+// The thread the controls are processed on.
+static std::thread s_thread;
+
+// Whether the thread is running.
+static std::atomic<bool> s_threadRunning{ false };
+
+// Set to ask the thread to finish.
+static std::atomic<bool> s_stopRequested{ false };
+
+// Written to in order to wake up the thread.
+static int s_wakeFileHandle = kInvalidFileHandle;
+
+// Processes timers for the controls when they run on the thread.
+static Scheduler s_scheduler;
+
+// We need to protect access to the wake up latency samples.
+static std::mutex s_wakeUpLatencyMutex;
+
+// How late the thread woke up for its most recent timers.
+static ProfilerSampleWindow s_wakeUpLatencySampleWindow;
+
+// The number of wake up latency samples that were dropped to avoid waiting on the lock.
+static std::atomic<unsigned int> s_droppedWakeUpLatencySampleCount{ 0u };
+
+// Functions
+//
+
+// ControlThreadConfig members
+
+// Read a control thread config from JSON.
+//
+// object:	The JSON object representing a control thread config.
+//
+// Returns:		True if the config was read successfully, false otherwise.
+//
+bool ControlThreadConfig::ReadFromJSON(rapidjson::Value const& object)
+{
+	if (object.IsObject() == false)
+	{
+		Logger::WriteLine("Control thread config could not be parsed because it is not an object.");
+		return false;
+	}
+
+	auto const enabledIterator = object.FindMember("enabled");
+
+	if ((enabledIterator != object.MemberEnd()) && (enabledIterator->value.IsBool() == true))
+	{
+		m_enabled = enabledIterator->value.GetBool();
+	}
+
+	auto const priorityIterator = object.FindMember("priority");
+
+	if ((priorityIterator != object.MemberEnd()) && (priorityIterator->value.IsInt() == true))
+	{
+		m_priority = priorityIterator->value.GetInt();
+	}
+
+	auto const cpuIterator = object.FindMember("cpu");
+
+	if ((cpuIterator != object.MemberEnd()) && (cpuIterator->value.IsInt() == true))
+	{
+		m_cpu = cpuIterator->value.GetInt();
+	}
+
+	auto const lockMemoryIterator = object.FindMember("lockMemory");
+
+	if ((lockMemoryIterator != object.MemberEnd()) && (lockMemoryIterator->value.IsBool() == true))
+	{
+		m_lockMemory = lockMemoryIterator->value.GetBool();
+	}
+
+	return true;
+}
+
+// Record how late the thread woke up for a timer.
+//
+// latency:	How long after the deadline the thread woke up.
+//
+static void ControlThreadAddWakeUpLatency(Nanoseconds latency)
+{
+	// Never wait on the statistics being read, it's better to lose the sample.
+	std::unique_lock<std::mutex> wakeUpLatencyLock(s_wakeUpLatencyMutex, std::try_to_lock);
+
+	if (wakeUpLatencyLock.owns_lock() == false)
+	{
+		s_droppedWakeUpLatencySampleCount++;
+		return;
+	}
+
+	s_wakeUpLatencySampleWindow.Add(latency);
+}
+
+// Sleep until the next timer expires or the thread is woken up.
+//
+// deadline:	(Output) The deadline of the next timer, if there is one.
+//
+// Returns:	True if the thread woke up for a timer, false otherwise.
+//
+static bool ControlThreadWait(Time& deadline)
+{
+	pollfd pollFileDescriptor = {};
+	pollFileDescriptor.fd = s_wakeFileHandle;
+	pollFileDescriptor.events = POLLIN;
+
+	timespec timeout = {};
+	timespec* timeoutPointer = nullptr;
+
+	auto const hasDeadline = s_scheduler.GetNextDeadline(deadline);
+
+	if (hasDeadline == true)
+	{
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		auto const remainingTime = std::max(deadline - currentTime, Nanoseconds{ 0 });
+		auto const remainingSeconds = std::chrono::duration_cast<Seconds>(remainingTime);
+
+		timeout.tv_sec = remainingSeconds.count();
+		timeout.tv_nsec = (remainingTime - remainingSeconds).count();
+		timeoutPointer = &timeout;
+	}
+
+	auto const readyCount = ppoll(&pollFileDescriptor, 1, timeoutPointer, nullptr);
+
+	if (readyCount > 0)
+	{
+		uint64_t count = 0;
+		[[maybe_unused]] auto const readCount = read(s_wakeFileHandle, &count, sizeof(count));
+	}
+
+	return (hasDeadline == true) && (readyCount == 0);
+}
+
+// Process the controls until asked to stop.
+//
+static void ControlThreadMain()
+{
+	while (s_stopRequested == false)
+	{
+		Time deadline;
+		auto const wokeUpForTimer = ControlThreadWait(deadline);
+
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		if (wokeUpForTimer == true)
+		{
+			ControlThreadAddWakeUpLatency(currentTime - deadline);
+		}
+
+		// Processing the controls applies the queued requests, so a stop is acted on in this tick.
+		s_scheduler.Process(currentTime);
+		ControlsProcess(currentTime);
+	}
+}
+
+// Give the thread real-time priority and pin it to a CPU, as configured.
+//
+// config:	Configuration parameters for the thread.
+//
+static void ControlThreadConfigureRealTime(ControlThreadConfig const& config)
+{
+	auto const threadHandle = s_thread.native_handle();
+
+	sched_param schedulingParameters = {};
+	schedulingParameters.sched_priority = config.m_priority;
+
+	auto const scheduleResult = pthread_setschedparam(threadHandle, SCHED_FIFO,
+		&schedulingParameters);
+
+	if (scheduleResult != 0)
+	{
+		Logger::WriteLine(Shell::Yellow("Failed to give the control thread real-time priority "),
+								config.m_priority, Shell::Yellow(": "), std::strerror(scheduleResult));
+	}
+	else
+	{
+		Logger::WriteLine("Control thread has real-time priority ", config.m_priority, ".");
+	}
+
+	if (config.m_cpu < 0)
+	{
+		return;
+	}
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(config.m_cpu, &cpuSet);
+
+	auto const affinityResult = pthread_setaffinity_np(threadHandle, sizeof(cpuSet), &cpuSet);
+
+	if (affinityResult != 0)
+	{
+		Logger::WriteLine(Shell::Yellow("Failed to pin the control thread to CPU "), config.m_cpu,
+								Shell::Yellow(": "), std::strerror(affinityResult));
+	}
+	else
+	{
+		Logger::WriteLine("Control thread is pinned to CPU ", config.m_cpu, ".");
+	}
+}
+
+// Get the scheduler that processes timers on the control thread. Controls should be initialized
+// with this when the thread will be started.
+//
+// Returns:	The scheduler.
+//
+Scheduler& ControlThreadGetScheduler()
+{
+	return s_scheduler;
+}
+
+// Start processing the controls on their own thread. The controls must already be initialized with
+// the control thread's scheduler.
+//
+// config:	Configuration parameters for the thread.
+//
+// Returns:	True if the thread started, false otherwise.
+//
+bool ControlThreadStart(ControlThreadConfig const& config)
+{
+	Logger::WriteLine("Starting the control thread...");
+
+	s_wakeFileHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (s_wakeFileHandle < 0)
+	{
+		s_wakeFileHandle = kInvalidFileHandle;
+		Logger::WriteLine('\t', Shell::Red("failed"));
+		return false;
+	}
+
+	// Keep the thread from ever waiting on memory being paged in. This locks the whole process,
+	// since the thread shares its memory with the rest of it.
+	if (config.m_lockMemory == true)
+	{
+		if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+		{
+			Logger::WriteLine(Shell::Yellow("Failed to lock memory: "), std::strerror(errno));
+		}
+		else
+		{
+			Logger::WriteLine("Locked all process memory for the control thread.");
+		}
+	}
+
+	// The thread starts processing right away, and may wake the main loop, which only wakes up
+	// through the event loop while the thread is marked as running.
+	s_stopRequested = false;
+	s_threadRunning = true;
+	s_thread = std::thread(ControlThreadMain);
+
+	ControlThreadConfigureRealTime(config);
+
+	Logger::WriteLine('\t', Shell::Green("succeeded"));
+	Logger::WriteLine();
+	return true;
+}
+
+// Stop the control thread, if it is running, and wait for it to finish.
+//
+void ControlThreadStop()
+{
+	if (s_threadRunning == false)
+	{
+		return;
+	}
+
+	s_stopRequested = true;
+	ControlThreadWake();
+
+	s_thread.join();
+	s_threadRunning = false;
+
+	close(s_wakeFileHandle);
+	s_wakeFileHandle = kInvalidFileHandle;
+
+	munlockall();
+}
+
+// Determine whether the control thread is running. While it is, only the control thread may touch
+// the controls.
+//
+bool ControlThreadIsRunning()
+{
+	return s_threadRunning;
+}
+
+// Wake the control thread up so that it applies any queued control requests. This may be called
+// from any thread.
+//
+void ControlThreadWake()
+{
+	if (s_wakeFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	uint64_t const count = 1;
+	[[maybe_unused]] auto const writeCount = write(s_wakeFileHandle, &count, sizeof(count));
+}
+
+// Get statistics for how late the control thread woke up for its timers.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlThreadGetWakeUpLatencyStatistics(ProfilerStatistics& statistics)
+{
+	std::lock_guard<std::mutex> wakeUpLatencyGuard(s_wakeUpLatencyMutex);
+	s_wakeUpLatencySampleWindow.GetStatistics(statistics);
+}
+
+// Write the control thread statistics to the logger.
+//
+void ControlThreadLogStatistics()
+{
+	if (s_threadRunning == false)
+	{
+		return;
+	}
+
+	Logger::WriteLine("Control thread timer wake up latency:");
+
+	ProfilerStatistics statistics;
+	ControlThreadGetWakeUpLatencyStatistics(statistics);
+	ProfilerLogStatisticsLine("wake up", statistics);
+
+	Logger::WriteLine("\t", s_droppedWakeUpLatencySampleCount, " latency samples dropped.");
+	Logger::WriteLine();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "rapidjson/document.h"
+
+#include "control.h"
+#include "profiler.h"
+#include "scheduler.h"
+
+// Types
+//
+
+// Configuration parameters for running the controls on their own real-time thread.
+struct ControlThreadConfig
+{
+	// Read a control thread config from JSON.
+	//
+	// object:	The JSON object representing a control thread config.
+	//
+	// Returns:		True if the config was read successfully, false otherwise.
+	//
+	bool ReadFromJSON(rapidjson::Value const& object);
+
+	// Whether the controls should run on their own thread.
+	bool m_enabled = false;
+
+	// The SCHED_FIFO priority of the thread, from 1 (lowest) to 99 (highest).
+	int m_priority = 80;
+
+	// The CPU to pin the thread to, or -1 to let it run on any CPU.
+	int m_cpu = -1;
+
+	// Whether to lock the memory of the process so that the thread never waits on a page fault. This
+	// locks all of the process's memory, including anything allocated later, not just the thread's.
+	bool m_lockMemory = true;
+};
+
+// Functions
+//
+
+// Get the scheduler that processes timers on the control thread. Controls should be initialized
+// with this when the thread will be started.
+//
+// Returns:	The scheduler.
+//
+Scheduler& ControlThreadGetScheduler();
+
+// Start processing the controls on their own thread. The controls must already be initialized with
+// the control thread's scheduler.
+//
+// config:	Configuration parameters for the thread.
+//
+// Returns:	True if the thread started, false otherwise.
+//
+bool ControlThreadStart(ControlThreadConfig const& config);
+
+// Stop the control thread, if it is running, and wait for it to finish.
+//
+void ControlThreadStop();
+
+// Determine whether the control thread is running. While it is, only the control thread may touch
+// the controls.
+//
+bool ControlThreadIsRunning();
+
+// Wake the control thread up so that it applies any queued control requests. This may be called
+// from any thread.
+//
+void ControlThreadWake();
+
+// Get statistics for how late the control thread woke up for its timers.
+//
+// statistics:	(Output) The statistics.
+//
+void ControlThreadGetWakeUpLatencyStatistics(ProfilerStatistics& statistics);
+
+// Write the control thread statistics to the logger.
+//
+void ControlThreadLogStatistics();
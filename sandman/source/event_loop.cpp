@@ -0,0 +1,384 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <map>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+// Constants
+//
+
+// Used to detect when a file handle is invalid.
+static constexpr int kInvalidFileHandle{ -1 };
+
+// The maximum number of ready file descriptors to handle per wait.
+static constexpr int kMaxEventsPerWait{ 16 };
+
+// Locals
+//
+
+// The epoll instance that all file descriptors are registered with.
+static int s_epollFileHandle = kInvalidFileHandle;
+
+// Written to in order to wake up a waiting loop, possibly from another thread.
+static int s_wakeFileHandle = kInvalidFileHandle;
+
+// Expires when the current timeout has elapsed.
+static int s_timerFileHandle = kInvalidFileHandle;
+
+// A mapping from watched file descriptor to the function to call when it is ready to be read.
+static std::map<int, EventLoopCallback> s_fileDescriptorToCallbackMap;
+
+// A mapping from watched file descriptor to the function to call when it is ready to be written.
+static std::map<int, EventLoopCallback> s_fileDescriptorToWritableCallbackMap;
+
+// Functions
+//
+
+// Register a file descriptor with the epoll instance.
+//
+// fileDescriptor:	The file descriptor to register.
+//
+// Returns:	True on success, false on failure.
+//
+static bool EventLoopRegister(int fileDescriptor)
+{
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = fileDescriptor;
+
+	return (epoll_ctl(s_epollFileHandle, EPOLL_CTL_ADD, fileDescriptor, &event) == 0);
+}
+
+// Update what a file descriptor is watched for with the epoll instance, to match the callbacks it
+// has.
+//
+// fileDescriptor:	The file descriptor to update.
+// wasRegistered:		Whether the file descriptor was registered before the callbacks changed.
+//
+// Returns:	True on success, false on failure.
+//
+static bool EventLoopUpdateRegistration(int fileDescriptor, bool wasRegistered)
+{
+	epoll_event event = {};
+	event.data.fd = fileDescriptor;
+
+	if (s_fileDescriptorToCallbackMap.count(fileDescriptor) > 0u)
+	{
+		event.events |= EPOLLIN;
+	}
+
+	if (s_fileDescriptorToWritableCallbackMap.count(fileDescriptor) > 0u)
+	{
+		event.events |= EPOLLOUT;
+	}
+
+	if (event.events == 0u)
+	{
+		if (wasRegistered == true)
+		{
+			epoll_ctl(s_epollFileHandle, EPOLL_CTL_DEL, fileDescriptor, nullptr);
+		}
+
+		return true;
+	}
+
+	auto const operation = (wasRegistered == true) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+	return (epoll_ctl(s_epollFileHandle, operation, fileDescriptor, &event) == 0);
+}
+
+// Determine whether a file descriptor is registered with the epoll instance.
+//
+// fileDescriptor:	The file descriptor.
+//
+static bool EventLoopIsRegistered(int fileDescriptor)
+{
+	return (s_fileDescriptorToCallbackMap.count(fileDescriptor) > 0u) ||
+		(s_fileDescriptorToWritableCallbackMap.count(fileDescriptor) > 0u);
+}
+
+// Call the callback for a file descriptor that is ready, if it still has one.
+//
+// callbackMap:		The callbacks for the kind of readiness.
+// fileDescriptor:	The file descriptor that is ready.
+//
+static void EventLoopCall(std::map<int, EventLoopCallback> const& callbackMap, int fileDescriptor)
+{
+	// The file descriptor may have been removed by an earlier callback.
+	auto const callbackIterator = callbackMap.find(fileDescriptor);
+
+	if (callbackIterator == callbackMap.end())
+	{
+		return;
+	}
+
+	// Copy the callback, since it is allowed to remove its own file descriptor.
+	auto const callback = callbackIterator->second;
+	callback();
+}
+
+// Consume the counter of an eventfd or timerfd so that it stops reporting as ready.
+//
+// fileDescriptor:	The file descriptor to drain.
+//
+static void EventLoopDrain(int fileDescriptor)
+{
+	uint64_t count = 0;
+	[[maybe_unused]] auto const readCount = read(fileDescriptor, &count, sizeof(count));
+}
+
+// Initialize the event loop.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopInitialize()
+{
+	Logger::WriteLine("Initializing the event loop...");
+
+	s_epollFileHandle = epoll_create1(EPOLL_CLOEXEC);
+	s_wakeFileHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	s_timerFileHandle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if ((s_epollFileHandle < 0) || (s_wakeFileHandle < 0) || (s_timerFileHandle < 0))
+	{
+		Logger::WriteLine('\t', Shell::Red("failed"));
+		EventLoopUninitialize();
+		return false;
+	}
+
+	if ((EventLoopRegister(s_wakeFileHandle) == false) ||
+		 (EventLoopRegister(s_timerFileHandle) == false))
+	{
+		Logger::WriteLine('\t', Shell::Red("failed"));
+		EventLoopUninitialize();
+		return false;
+	}
+
+	Logger::WriteLine('\t', Shell::Green("succeeded"));
+	Logger::WriteLine();
+	return true;
+}
+
+// Uninitialize the event loop.
+//
+void EventLoopUninitialize()
+{
+	s_fileDescriptorToCallbackMap.clear();
+	s_fileDescriptorToWritableCallbackMap.clear();
+
+	for (auto* fileHandle : { &s_timerFileHandle, &s_wakeFileHandle, &s_epollFileHandle })
+	{
+		if (*fileHandle != kInvalidFileHandle)
+		{
+			close(*fileHandle);
+			*fileHandle = kInvalidFileHandle;
+		}
+	}
+}
+
+// Start watching a file descriptor for readability.
+//
+// fileDescriptor:	The file descriptor to watch.
+// callback:			The function to call from EventLoopWait() when the file descriptor is ready.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopAddFileDescriptor(int fileDescriptor, EventLoopCallback const& callback)
+{
+	if (s_epollFileHandle == kInvalidFileHandle)
+	{
+		return false;
+	}
+
+	if (s_fileDescriptorToCallbackMap.find(fileDescriptor) != s_fileDescriptorToCallbackMap.end())
+	{
+		Logger::WriteLine(Shell::Yellow("Attempted to watch file descriptor "), fileDescriptor,
+								Shell::Yellow(", but it is already being watched."));
+		return false;
+	}
+
+	auto const wasRegistered = EventLoopIsRegistered(fileDescriptor);
+	s_fileDescriptorToCallbackMap.insert({fileDescriptor, callback});
+
+	if (EventLoopUpdateRegistration(fileDescriptor, wasRegistered) == false)
+	{
+		Logger::WriteLine(Shell::Red("Failed to watch file descriptor "), fileDescriptor,
+								Shell::Red("."));
+		s_fileDescriptorToCallbackMap.erase(fileDescriptor);
+		return false;
+	}
+
+	return true;
+}
+
+// Stop watching a file descriptor for readability. This should be done before the file
+// descriptor is closed.
+//
+// fileDescriptor:	The file descriptor to stop watching.
+//
+void EventLoopRemoveFileDescriptor(int fileDescriptor)
+{
+	if (s_fileDescriptorToCallbackMap.erase(fileDescriptor) == 0u)
+	{
+		return;
+	}
+
+	EventLoopUpdateRegistration(fileDescriptor, true);
+}
+
+// Start watching a file descriptor for writability, such as a socket with output waiting to be
+// sent. It may be watched for readability at the same time.
+//
+// fileDescriptor:	The file descriptor to watch.
+// callback:			The function to call from EventLoopWait() when the file descriptor is ready.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopAddWritableFileDescriptor(int fileDescriptor, EventLoopCallback const& callback)
+{
+	if (s_epollFileHandle == kInvalidFileHandle)
+	{
+		return false;
+	}
+
+	if (s_fileDescriptorToWritableCallbackMap.find(fileDescriptor) !=
+		 s_fileDescriptorToWritableCallbackMap.end())
+	{
+		Logger::WriteLine(Shell::Yellow("Attempted to watch file descriptor "), fileDescriptor,
+								Shell::Yellow(" for writing, but it is already being watched."));
+		return false;
+	}
+
+	auto const wasRegistered = EventLoopIsRegistered(fileDescriptor);
+	s_fileDescriptorToWritableCallbackMap.insert({fileDescriptor, callback});
+
+	if (EventLoopUpdateRegistration(fileDescriptor, wasRegistered) == false)
+	{
+		Logger::WriteLine(Shell::Red("Failed to watch file descriptor "), fileDescriptor,
+								Shell::Red(" for writing."));
+		s_fileDescriptorToWritableCallbackMap.erase(fileDescriptor);
+		return false;
+	}
+
+	return true;
+}
+
+// Stop watching a file descriptor for writability. This should be done before the file descriptor
+// is closed.
+//
+// fileDescriptor:	The file descriptor to stop watching.
+//
+void EventLoopRemoveWritableFileDescriptor(int fileDescriptor)
+{
+	if (s_fileDescriptorToWritableCallbackMap.erase(fileDescriptor) == 0u)
+	{
+		return;
+	}
+
+	EventLoopUpdateRegistration(fileDescriptor, true);
+}
+
+// Limit how long the next wait may sleep for.
+//
+// timeoutMS:	The maximum amount of time to sleep for (in milliseconds).
+//
+void EventLoopSetTimeout(unsigned int timeoutMS)
+{
+	if (s_timerFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	itimerspec timerValue = {};
+	timerValue.it_value.tv_sec = timeoutMS / 1'000u;
+	timerValue.it_value.tv_nsec = (timeoutMS % 1'000u) * 1'000'000l;
+
+	// A zero value would disarm the timer, so expire as soon as possible instead.
+	if (timeoutMS == 0u)
+	{
+		timerValue.it_value.tv_nsec = 1;
+	}
+
+	timerfd_settime(s_timerFileHandle, 0, &timerValue, nullptr);
+}
+
+// Allow the next wait to sleep until a file descriptor is ready or the loop is woken.
+//
+void EventLoopClearTimeout()
+{
+	if (s_timerFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	itimerspec const timerValue = {};
+	timerfd_settime(s_timerFileHandle, 0, &timerValue, nullptr);
+}
+
+// Wake up the event loop if it is waiting. This may be called from any thread.
+//
+void EventLoopWake()
+{
+	if (s_wakeFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	uint64_t const count = 1;
+	[[maybe_unused]] auto const writeCount = write(s_wakeFileHandle, &count, sizeof(count));
+}
+
+// Sleep until a watched file descriptor is ready, the timeout expires, or the loop is woken. Any
+// callbacks for ready file descriptors are called before returning.
+//
+void EventLoopWait()
+{
+	if (s_epollFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	epoll_event events[kMaxEventsPerWait];
+	auto const eventCount = epoll_wait(s_epollFileHandle, events, kMaxEventsPerWait, -1);
+
+	// Being interrupted by a signal is not an error, the caller will just process a tick.
+	if (eventCount < 0)
+	{
+		if (errno != EINTR)
+		{
+			Logger::WriteLine(Shell::Red("Failed to wait for events."));
+		}
+
+		return;
+	}
+
+	for (int eventIndex = 0; eventIndex < eventCount; eventIndex++)
+	{
+		auto const fileDescriptor = events[eventIndex].data.fd;
+
+		if ((fileDescriptor == s_wakeFileHandle) || (fileDescriptor == s_timerFileHandle))
+		{
+			EventLoopDrain(fileDescriptor);
+			continue;
+		}
+
+		// Hang ups and errors go to both callbacks, so that either can notice and clean up.
+		auto const readyEvents = events[eventIndex].events;
+
+		if ((readyEvents & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0u)
+		{
+			EventLoopCall(s_fileDescriptorToCallbackMap, fileDescriptor);
+		}
+
+		if ((readyEvents & (EPOLLOUT | EPOLLHUP | EPOLLERR)) != 0u)
+		{
+			EventLoopCall(s_fileDescriptorToWritableCallbackMap, fileDescriptor);
+		}
+	}
+}
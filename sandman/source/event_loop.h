@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+
+// Types
+//
+
+// A function that is called when a watched file descriptor is ready to be read or written.
+using EventLoopCallback = std::function<void()>;
+
+// Functions
+//
+
+// Initialize the event loop.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopInitialize();
+
+// Uninitialize the event loop.
+//
+void EventLoopUninitialize();
+
+// Start watching a file descriptor for readability.
+//
+// fileDescriptor:	The file descriptor to watch.
+// callback:			The function to call from EventLoopWait() when the file descriptor is ready.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopAddFileDescriptor(int fileDescriptor, EventLoopCallback const& callback);
+
+// Stop watching a file descriptor for readability. This should be done before the file
+// descriptor is closed.
+//
+// fileDescriptor:	The file descriptor to stop watching.
+//
+void EventLoopRemoveFileDescriptor(int fileDescriptor);
+
+// Start watching a file descriptor for writability, such as a socket with output waiting to be
+// sent. It may be watched for readability at the same time.
+//
+// fileDescriptor:	The file descriptor to watch.
+// callback:			The function to call from EventLoopWait() when the file descriptor is ready.
+//
+// Returns:	True on success, false on failure.
+//
+bool EventLoopAddWritableFileDescriptor(int fileDescriptor, EventLoopCallback const& callback);
+
+// Stop watching a file descriptor for writability. This should be done before the file descriptor
+// is closed.
+//
+// fileDescriptor:	The file descriptor to stop watching.
+//
+void EventLoopRemoveWritableFileDescriptor(int fileDescriptor);
+
+// Limit how long the next wait may sleep for.
+//
+// timeoutMS:	The maximum amount of time to sleep for (in milliseconds).
+//
+void EventLoopSetTimeout(unsigned int timeoutMS);
+
+// Allow the next wait to sleep until a file descriptor is ready or the loop is woken.
+//
+void EventLoopClearTimeout();
+
+// Wake up the event loop if it is waiting. This may be called from any thread.
+//
+void EventLoopWake();
+
+// Sleep until a watched file descriptor is ready, the timeout expires, or the loop is woken. Any
+// callbacks for ready file descriptors are called before returning.
+//
+void EventLoopWait();
@@ -1,6 +1,11 @@
 #include "gpio.h"
 
-#include <map>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <vector>
 
 #if defined ENABLE_GPIO
 	#include <gpiod.h>
@@ -15,9 +20,68 @@
 static constexpr int kPinOnValue = 0;
 static constexpr int kPinOffValue = 1;
 
+// Pin numbers must be below this. A Raspberry Pi has 54 lines on its main chip.
+static constexpr int kPinCapacity{ 64 };
+
+// The number of most recent transitions kept when GPIO is simulated.
+static constexpr unsigned int kTimelineCapacity{ 4'096u };
+
+// Types
+//
+
+// The state of a pin.
+struct GPIOPin
+{
+	// Whether the pin has been acquired for output.
+	bool m_acquired = false;
+
+	// Whether the pin has been set since the last commit.
+	bool m_set = false;
+
+	// The value the pin will be set to on the next commit.
+	int m_pendingValue = kPinOffValue;
+
+	// The value the pin was last set to.
+	int m_value = kPinOffValue;
+
+	#if defined ENABLE_GPIO
+
+		// The line for the pin.
+		gpiod_line* m_line = nullptr;
+
+	#endif // defined ENABLE_GPIO
+};
+
 // Locals
 //
 
+// The state of every pin, indexed by pin number.
+static std::array<GPIOPin, kPinCapacity> s_pinTable;
+
+// The pins that we have acquired, in the order they were requested.
+static std::vector<int> s_acquiredPins;
+
+// Counts of writes that were made and writes that were skipped because nothing changed.
+static std::atomic<unsigned long long> s_commitCount{ 0ull };
+static std::atomic<unsigned long long> s_skippedCommitCount{ 0ull };
+static std::atomic<unsigned long long> s_pinChangeCount{ 0ull };
+static std::atomic<unsigned long long> s_skippedPinChangeCount{ 0ull };
+
+// Whether pins are simulated instead of being set on hardware.
+static bool s_simulateGPIO = false;
+
+// We need to protect access to the timeline, since pins may be committed on the control thread.
+static std::mutex s_timelineMutex;
+
+// The most recent transitions when GPIO is simulated, oldest first once the ring has wrapped.
+static std::array<GPIOTransition, kTimelineCapacity> s_timeline;
+
+// Where the next transition will be written.
+static unsigned int s_timelineNextIndex = 0u;
+
+// How many of the transitions are valid.
+static unsigned int s_timelineCount = 0u;
+
 #if defined ENABLE_GPIO
 
 	// Whether controls can use GPIO or not.
@@ -26,28 +90,144 @@ static constexpr int kPinOffValue = 1;
 	// The interface with the pins through the chip they are controlled by.
 	static gpiod_chip* s_chip = nullptr;
 
-	// A mapping of all of the pins that we have acquired.
-	static std::map<int, gpiod_line*> s_pinToLineMap;
+	// All of the acquired lines, requested together so that they can be set with a single call.
+	static gpiod_line_bulk s_lineBulk;
+
+	// Whether the lines are currently requested.
+	static bool s_lineBulkRequested = false;
+
+	// The pins of the requested lines, in the order they were requested. Pins that are released
+	// stay requested, and off, until all of them are, so that the others don't have to be
+	// requested again.
+	static std::vector<int> s_requestedPins;
 
 #endif // defined ENABLE_GPIO
 
 // Functions
 //
 
+// Find a pin that has been acquired.
+//
+// pin:	The GPIO pin to find.
+//
+// Returns:	The pin, or null if it hasn't been acquired.
+//
+static GPIOPin* GPIOFindPin(int pin)
+{
+	if ((pin < 0) || (pin >= kPinCapacity) || (s_pinTable[pin].m_acquired == false))
+	{
+		return nullptr;
+	}
+
+	return &s_pinTable[pin];
+}
+
+#if defined ENABLE_GPIO
+
+	// Determine whether the pins are being set on hardware.
+	//
+	static bool GPIOUsingHardware()
+	{
+		return (s_enableGPIO == true) && (s_simulateGPIO == false);
+	}
+
+	// Release the requested lines, if there are any.
+	//
+	static void GPIOReleaseLines()
+	{
+		if (s_lineBulkRequested == true)
+		{
+			gpiod_line_release_bulk(&s_lineBulk);
+			s_lineBulkRequested = false;
+		}
+
+		s_requestedPins.clear();
+	}
+
+	// Determine whether every acquired pin has a requested line.
+	//
+	static bool GPIOAcquiredPinsRequested()
+	{
+		if (s_lineBulkRequested == false)
+		{
+			return s_acquiredPins.empty();
+		}
+
+		return std::all_of(s_acquiredPins.begin(), s_acquiredPins.end(), [](int pin)
+			{
+				return std::find(s_requestedPins.begin(), s_requestedPins.end(), pin) !=
+					s_requestedPins.end();
+			});
+	}
+
+	// Write a value to every requested line at once. Lines of released pins are written off.
+	//
+	// pending:	Whether to write the pending values rather than the ones already written.
+	//
+	// Returns:	True on success, false otherwise.
+	//
+	static bool GPIOWriteLines(bool pending)
+	{
+		int values[GPIOD_LINE_BULK_MAX_LINES];
+
+		for (unsigned int pinIndex = 0u; pinIndex < s_requestedPins.size(); pinIndex++)
+		{
+			auto const& requestedPin = s_pinTable[s_requestedPins[pinIndex]];
+
+			if (requestedPin.m_acquired == false)
+			{
+				values[pinIndex] = kPinOffValue;
+			}
+			else
+			{
+				values[pinIndex] = (pending == true) ? requestedPin.m_pendingValue :
+					requestedPin.m_value;
+			}
+		}
+
+		return gpiod_line_set_value_bulk(&s_lineBulk, values) >= 0;
+	}
+
+#endif // defined ENABLE_GPIO
+
+// Add a transition to the simulated timeline.
+//
+// transition:	The transition to add.
+//
+static void GPIORecordTransition(GPIOTransition const& transition)
+{
+	std::lock_guard<std::mutex> timelineGuard(s_timelineMutex);
+
+	s_timeline[s_timelineNextIndex] = transition;
+	s_timelineNextIndex = (s_timelineNextIndex + 1u) % kTimelineCapacity;
+	s_timelineCount = std::min(s_timelineCount + 1u, kTimelineCapacity);
+}
+
 // Initialize GPIO support.
 //
-// enableGPIO: Whether to turn on GPIO or not.
+// enableGPIO:		Whether to turn on GPIO or not.
+// simulateGPIO:	Whether to simulate the pins instead, recording every change to a timeline.
 //
-void GPIOInitialize([[maybe_unused]] bool const enableGPIO)
+void GPIOInitialize([[maybe_unused]] bool const enableGPIO, bool const simulateGPIO)
 {
+	s_simulateGPIO = simulateGPIO;
+	GPIOClearTimeline();
+	GPIOResetStatistics();
+
+	if (s_simulateGPIO == true)
+	{
+		Logger::WriteLine("GPIO is simulated, pin changes will be recorded instead.");
+		Logger::WriteLine();
+	}
+
 	#if defined ENABLE_GPIO
-	
+
 		s_enableGPIO = enableGPIO;
 
-		if (s_enableGPIO == true)
+		if (GPIOUsingHardware() == true)
 		{
 			Logger::WriteLine("Initializing GPIO support...");
-	
+
 			// RPI5 attempt.
 			s_chip = gpiod_chip_open_by_name("gpiochip4");
 
@@ -63,101 +243,107 @@ void GPIOInitialize([[maybe_unused]] bool const enableGPIO)
 			}
 
 			Logger::WriteLine('\t', Shell::Green("succeeded"));
+			Logger::WriteLine();
 		}
-		else
+		else if (s_enableGPIO == false)
 		{
 			Logger::WriteLine("GPIO support not enabled, initialization skipped.");
+			Logger::WriteLine();
 		}
-		
-		Logger::WriteLine();
 
 	#endif // defined ENABLE_GPIO
 }
 
 // Uninitialize GPIO support.
-// 
+//
 void GPIOUninitialize()
 {
 	#if defined ENABLE_GPIO
-	
-		if (s_enableGPIO == false)
-		{
-			return;
-		}
 
-		if (s_chip == nullptr)
+		if ((GPIOUsingHardware() == true) && (s_chip != nullptr))
 		{
-			return;
+			// Release all of the pins.
+			GPIOReleaseLines();
+			gpiod_chip_close(s_chip);
+			s_chip = nullptr;
 		}
 
-		// Release all of the pins.
-		for (auto& pair : s_pinToLineMap)
-		{
-			gpiod_line_release(pair.second);
-		}
-		s_pinToLineMap.clear();
-
-		gpiod_chip_close(s_chip);
-		s_chip = nullptr;
-	
 	#endif // defined ENABLE_GPIO
+
+	s_pinTable.fill(GPIOPin());
+	s_acquiredPins.clear();
 }
 
-// Acquire a GPIO pin as output.
+// Acquire a GPIO pin as output. It starts off.
 //
 // pin:	The GPIO pin to acquire as output.
-// 
+//
 void GPIOAcquireOutputPin(int pin)
 {
 	#if defined ENABLE_GPIO
-	
-		if (s_enableGPIO == false)
+
+		if ((s_enableGPIO == false) && (s_simulateGPIO == false))
 		{
-			Logger::WriteLine("Would have acquired GPIO ", pin, 
+			Logger::WriteLine("Would have acquired GPIO ", pin,
 									" pin for output, but it's not enabled.");
 			return;
 		}
 
-		if (s_chip == nullptr)
+		if ((GPIOUsingHardware() == true) && (s_chip == nullptr))
 		{
-			Logger::WriteLine(Shell::Red("No chip when attempting to acquire GPIO "), pin, 
+			Logger::WriteLine(Shell::Red("No chip when attempting to acquire GPIO "), pin,
 									Shell::Red(" pin for output."));
 			return;
 		}
 
-		if (s_pinToLineMap.find(pin) != s_pinToLineMap.end())
-		{
-			Logger::WriteLine(Shell::Yellow("Attempted to acquire GPIO "), pin, 
-									Shell::Yellow(" pin for output, but it's already been acquired."));
-			return;
-		}
+	#endif // defined ENABLE_GPIO
 
-		auto* line = gpiod_chip_get_line(s_chip, pin);
+	if ((pin < 0) || (pin >= kPinCapacity))
+	{
+		Logger::WriteLine(Shell::Red("Attempted to acquire GPIO "), pin,
+								Shell::Red(" pin for output, but there is no such pin."));
+		return;
+	}
 
-		if (line == nullptr)
-		{
-			Logger::WriteLine(Shell::Red("Failed to get line when attempting to acquire GPIO "), pin,
-									Shell::Red(" pin for output."));
-			return;
-		}
+	if (GPIOFindPin(pin) != nullptr)
+	{
+		Logger::WriteLine(Shell::Yellow("Attempted to acquire GPIO "), pin,
+								Shell::Yellow(" pin for output, but it's already been acquired."));
+		return;
+	}
+
+	GPIOPin acquiredPin;
+	acquiredPin.m_acquired = true;
 
-		if (gpiod_line_request_output(line, "sandman", 0) < 0)
+	#if defined ENABLE_GPIO
+
+		if (GPIOUsingHardware() == true)
 		{
-			Logger::WriteLine(Shell::Red("Failed to set pin to output when trying to acquire GPIO "),
-									pin, Shell::Red(" pin for output."));
-			gpiod_line_release(line);
-			return;
-		}
+			acquiredPin.m_line = gpiod_chip_get_line(s_chip, pin);
 
-		// Add a record.
-		s_pinToLineMap.insert({pin, line});
+			if (acquiredPin.m_line == nullptr)
+			{
+				Logger::WriteLine(Shell::Red("Failed to get line when attempting to acquire GPIO "),
+										pin, Shell::Red(" pin for output."));
+				return;
+			}
+
+			// The line is requested along with the others once they have all been acquired.
+		}
 
 	#else
 
-		Logger::WriteLine("A Raspberry Pi would have tried to acquire GPIO ", pin, 
-								" pin for output.");
+		if (s_simulateGPIO == false)
+		{
+			Logger::WriteLine("A Raspberry Pi would have tried to acquire GPIO ", pin,
+									" pin for output.");
+		}
 
 	#endif // defined ENABLE_GPIO
+
+	// Add a record.
+	s_pinTable[pin] = acquiredPin;
+	s_acquiredPins.push_back(pin);
 }
 
 // Release a GPIO pin.
@@ -168,92 +354,151 @@ void GPIOReleasePin(int pin)
 {
 	#if defined ENABLE_GPIO
 
-		if (s_enableGPIO == false)
+		if ((s_enableGPIO == false) && (s_simulateGPIO == false))
 		{
 			Logger::WriteLine("Would have released GPIO ", pin, " pin, but it's not enabled.");
 			return;
 		}
 
-		if (s_chip == nullptr)
+		if ((GPIOUsingHardware() == true) && (s_chip == nullptr))
 		{
-			Logger::WriteLine(Shell::Red("No chip when attempting to release GPIO "), pin, 
+			Logger::WriteLine(Shell::Red("No chip when attempting to release GPIO "), pin,
 									Shell::Red(" pin."));
 			return;
 		}
 
-		// See if we have acquired the pin.
-		auto pinIterator = s_pinToLineMap.find(pin);
-		if (pinIterator == s_pinToLineMap.end())
-		{
-			Logger::WriteLine(Shell::Yellow("Attempted to release GPIO "), pin, 
-									Shell::Yellow(" pin, but hasn't been acquired."));
-			return;
-		}
+	#endif // defined ENABLE_GPIO
+
+	// See if we have acquired the pin.
+	auto* const acquiredPin = GPIOFindPin(pin);
 
-		auto* line = pinIterator->second;
-		gpiod_line_release(line);
+	if (acquiredPin == nullptr)
+	{
+		Logger::WriteLine(Shell::Yellow("Attempted to release GPIO "), pin,
+								Shell::Yellow(" pin, but hasn't been acquired."));
+		return;
+	}
 
-		// Erase our record.
-		s_pinToLineMap.erase(pinIterator);
+	#if defined ENABLE_GPIO
+
+		auto const wasOn = (acquiredPin->m_value == kPinOnValue);
+
+	#endif // defined ENABLE_GPIO
+
+	// Erase our record.
+	*acquiredPin = GPIOPin();
+	s_acquiredPins.erase(std::find(s_acquiredPins.begin(), s_acquiredPins.end(), pin));
+
+	#if defined ENABLE_GPIO
+
+		// The line stays requested, so that the other pins aren't disturbed, but it is turned off.
+		if ((GPIOUsingHardware() == true) && (s_lineBulkRequested == true))
+		{
+			if (s_acquiredPins.empty() == true)
+			{
+				GPIOReleaseLines();
+			}
+			else if ((wasOn == true) && (GPIOWriteLines(false) == false))
+			{
+				Logger::WriteLine(Shell::Red("Attempted to turn off released GPIO "), pin,
+										Shell::Red(" pin, but there was an error."));
+			}
+		}
 
 	#else
 
-		Logger::WriteLine("A Raspberry Pi would have tried to release GPIO ", pin, " pin.");
+		if (s_simulateGPIO == false)
+		{
+			Logger::WriteLine("A Raspberry Pi would have tried to release GPIO ", pin, " pin.");
+		}
 
 	#endif // defined ENABLE_GPIO
 }
 
-// Set the given GPIO pin to a specific value.
+// Request the lines of all of the acquired pins as one set, keeping their current values, so that
+// they can be set together. Requesting lines again briefly lets go of them, so this should be done
+// once every pin has been acquired. Otherwise, it is done on the next commit that changes a pin.
 //
-// pin:		The GPIO pin to set the value of.
-// value:	The value to set the pin to.
+// Returns:	True if the lines are requested, or there is no hardware to request them from, false
+//				otherwise.
 //
-static void GPIOSetPinValue(int pin, int value)
+bool GPIORequestAcquiredPins()
 {
-	const char* valueString = (value == kPinOffValue) ? "off" : "on";
-
 	#if defined ENABLE_GPIO
 
-		if (s_enableGPIO == false)
+		if ((GPIOUsingHardware() == false) || (GPIOAcquiredPinsRequested() == true))
 		{
-			Logger::WriteLine("Would have set GPIO ", pin, " to ", valueString, 
-									", but it's not enabled.");
-			return;
+			return true;
 		}
 
-		if (s_chip == nullptr)
+		GPIOReleaseLines();
+
+		if (s_acquiredPins.size() > GPIOD_LINE_BULK_MAX_LINES)
 		{
-			Logger::WriteLine(Shell::Red("No chip when attempting to set GPIO "), pin, 
-									Shell::Red(" pin to "), valueString, Shell::Red("."));
-			return;
+			Logger::WriteLine(Shell::Red("Too many GPIO pins to request at once."));
+			return false;
 		}
 
-		// See if we have acquired the pin.
-		auto pinIterator = s_pinToLineMap.find(pin);
-		if (pinIterator == s_pinToLineMap.end())
+		int values[GPIOD_LINE_BULK_MAX_LINES];
+		gpiod_line_bulk_init(&s_lineBulk);
+
+		for (unsigned int pinIndex = 0u; pinIndex < s_acquiredPins.size(); pinIndex++)
 		{
-			Logger::WriteLine(Shell::Yellow("Attempted to set GPIO "), pin, 
-									Shell::Yellow(" pin to "), valueString, 
-									Shell::Yellow(", but hasn't been acquired."));
-			return;
+			auto const& acquiredPin = s_pinTable[s_acquiredPins[pinIndex]];
+			gpiod_line_bulk_add(&s_lineBulk, acquiredPin.m_line);
+			values[pinIndex] = acquiredPin.m_value;
 		}
 
-		auto* line = pinIterator->second;
-		if (gpiod_line_set_value(line, value) < 0)
+		if (gpiod_line_request_bulk_output(&s_lineBulk, "sandman", values) < 0)
 		{
-			Logger::WriteLine(Shell::Red("Attempted to set GPIO "), pin, 
-									Shell::Red(" pin to "), valueString, 
-									Shell::Red(", but there was an error."));
+			Logger::WriteLine(Shell::Red("Failed to request GPIO pins for output."));
+			return false;
 		}
 
-	#else
+		s_lineBulkRequested = true;
+		s_requestedPins = s_acquiredPins;
+
+	#endif // defined ENABLE_GPIO
 
-		Logger::WriteLine("A Raspberry Pi would have set GPIO ", pin, " to ", valueString, ".");
+	return true;
+}
+
+// Set the given GPIO pin to a specific value on the next commit.
+//
+// pin:		The GPIO pin to set the value of.
+// value:	The value to set the pin to.
+//
+static void GPIOSetPinValue(int pin, int value)
+{
+	#if defined ENABLE_GPIO
+
+		if ((s_enableGPIO == false) && (s_simulateGPIO == false))
+		{
+			const char* valueString = (value == kPinOffValue) ? "off" : "on";
+			Logger::WriteLine("Would have set GPIO ", pin, " to ", valueString,
+									", but it's not enabled.");
+			return;
+		}
 
 	#endif // defined ENABLE_GPIO
+
+	// See if we have acquired the pin.
+	auto* const acquiredPin = GPIOFindPin(pin);
+
+	if (acquiredPin == nullptr)
+	{
+		const char* valueString = (value == kPinOffValue) ? "off" : "on";
+		Logger::WriteLine(Shell::Yellow("Attempted to set GPIO "), pin,
+								Shell::Yellow(" pin to "), valueString,
+								Shell::Yellow(", but hasn't been acquired."));
+		return;
+	}
+
+	acquiredPin->m_pendingValue = value;
+	acquiredPin->m_set = true;
 }
 
-// Set the given GPIO pin to the "on" value.
+// Set the given GPIO pin to the "on" value on the next commit.
 //
 // pin:	The GPIO pin to set the value of.
 //
@@ -262,7 +507,7 @@ void GPIOSetPinOn(int pin)
 	GPIOSetPinValue(pin, kPinOnValue);
 }
 
-// Set the given GPIO pin to the "off" value.
+// Set the given GPIO pin to the "off" value on the next commit.
 //
 // pin:	The GPIO pin to set the value of.
 //
@@ -271,3 +516,237 @@ void GPIOSetPinOff(int pin)
 	GPIOSetPinValue(pin, kPinOffValue);
 }
 
+// Apply every pin value set since the last commit at once, so the relays are never seen half way
+// between two states.
+//
+// decisionTime:	The time of the tick that decided on the values.
+//
+void GPIOCommit([[maybe_unused]] Time const& decisionTime)
+{
+	// Only pins that were set to something new need writing.
+	auto const changed = std::any_of(s_acquiredPins.begin(), s_acquiredPins.end(), [](int pin)
+		{
+			auto const& acquiredPin = s_pinTable[pin];
+			return (acquiredPin.m_set == true) &&
+				(acquiredPin.m_pendingValue != acquiredPin.m_value);
+		});
+
+	if (changed == true)
+	{
+		#if defined ENABLE_GPIO
+
+			// The pins stay set if they can't be written, so that the next commit tries again and
+			// the values that were written are still known.
+			if (GPIOUsingHardware() == true)
+			{
+				// Pins acquired since the lines were requested, if they ever were, need requesting.
+				if (GPIORequestAcquiredPins() == false)
+				{
+					Logger::WriteLine(Shell::Red("Attempted to set GPIO pins, but they aren't "
+														  "requested."));
+					return;
+				}
+
+				if (GPIOWriteLines(true) == false)
+				{
+					Logger::WriteLine(Shell::Red("Attempted to set GPIO pins, but there was an "
+														  "error."));
+					return;
+				}
+			}
+
+		#endif // defined ENABLE_GPIO
+
+		s_commitCount.fetch_add(1ull, std::memory_order_relaxed);
+	}
+	else
+	{
+		s_skippedCommitCount.fetch_add(1ull, std::memory_order_relaxed);
+	}
+
+	// Every pin in a commit changes at the same moment.
+	Time writeTime;
+	if ((changed == true) && (s_simulateGPIO == true))
+	{
+		TimerGetCurrent(writeTime);
+	}
+
+	for (auto const pin : s_acquiredPins)
+	{
+		auto& acquiredPin = s_pinTable[pin];
+
+		if (acquiredPin.m_set == false)
+		{
+			continue;
+		}
+
+		acquiredPin.m_set = false;
+
+		if (acquiredPin.m_pendingValue == acquiredPin.m_value)
+		{
+			s_skippedPinChangeCount.fetch_add(1ull, std::memory_order_relaxed);
+			continue;
+		}
+
+		s_pinChangeCount.fetch_add(1ull, std::memory_order_relaxed);
+
+		if (s_simulateGPIO == true)
+		{
+			GPIORecordTransition({ decisionTime, writeTime, pin,
+				acquiredPin.m_pendingValue == kPinOnValue });
+		}
+
+		#if !defined ENABLE_GPIO
+
+			else
+			{
+				const char* valueString = (acquiredPin.m_pendingValue == kPinOffValue) ? "off" : "on";
+				Logger::WriteLine("A Raspberry Pi would have set GPIO ", pin, " to ", valueString,
+										".");
+			}
+
+		#endif // !defined ENABLE_GPIO
+
+		acquiredPin.m_value = acquiredPin.m_pendingValue;
+	}
+}
+
+// Get counts of the writes that were made and the ones that were skipped.
+//
+// statistics:	(Output) The counts.
+//
+void GPIOGetStatistics(GPIOStatistics& statistics)
+{
+	statistics.m_commitCount = s_commitCount.load(std::memory_order_relaxed);
+	statistics.m_skippedCommitCount = s_skippedCommitCount.load(std::memory_order_relaxed);
+	statistics.m_pinChangeCount = s_pinChangeCount.load(std::memory_order_relaxed);
+	statistics.m_skippedPinChangeCount = s_skippedPinChangeCount.load(std::memory_order_relaxed);
+}
+
+// Forget the counts of writes.
+//
+void GPIOResetStatistics()
+{
+	s_commitCount = 0ull;
+	s_skippedCommitCount = 0ull;
+	s_pinChangeCount = 0ull;
+	s_skippedPinChangeCount = 0ull;
+}
+
+// Write the counts of writes to the logger.
+//
+void GPIOLogStatistics()
+{
+	GPIOStatistics statistics;
+	GPIOGetStatistics(statistics);
+
+	Logger::WriteLine("GPIO writes: ", statistics.m_commitCount, " made, ",
+							statistics.m_skippedCommitCount, " skipped. Pin changes: ",
+							statistics.m_pinChangeCount, " made, ", statistics.m_skippedPinChangeCount,
+							" skipped.");
+	Logger::WriteLine();
+}
+
+// Determine whether the pins are simulated.
+//
+bool GPIOIsSimulated()
+{
+	return s_simulateGPIO;
+}
+
+// Determine whether a pin was last set to the "on" value.
+//
+// pin:	The GPIO pin.
+//
+// Returns:	True if the pin is acquired and on, false otherwise.
+//
+bool GPIOIsPinOn(int pin)
+{
+	auto const* const acquiredPin = GPIOFindPin(pin);
+	return (acquiredPin != nullptr) && (acquiredPin->m_value == kPinOnValue);
+}
+
+// Get the recorded transitions, when GPIO is simulated.
+//
+// transitions:	(Output) The transitions, oldest first.
+//
+void GPIOGetTimeline(std::vector<GPIOTransition>& transitions)
+{
+	std::lock_guard<std::mutex> timelineGuard(s_timelineMutex);
+
+	transitions.clear();
+	transitions.reserve(s_timelineCount);
+
+	auto const oldestIndex = (s_timelineNextIndex + kTimelineCapacity - s_timelineCount) %
+		kTimelineCapacity;
+
+	for (unsigned int transitionIndex = 0u; transitionIndex < s_timelineCount; transitionIndex++)
+	{
+		transitions.push_back(s_timeline[(oldestIndex + transitionIndex) % kTimelineCapacity]);
+	}
+}
+
+// Forget the recorded transitions.
+//
+void GPIOClearTimeline()
+{
+	std::lock_guard<std::mutex> timelineGuard(s_timelineMutex);
+
+	s_timelineNextIndex = 0u;
+	s_timelineCount = 0u;
+}
+
+// Write the recorded transitions to a file. Times are in nanoseconds on the monotonic clock.
+//
+// fileName:	The name of the file to write.
+// format:		The format to write the transitions in.
+//
+// Returns:	True if the file was written, false otherwise.
+//
+bool GPIOWriteTimeline(char const* fileName, GPIOTimelineFormat format)
+{
+	std::vector<GPIOTransition> transitions;
+	GPIOGetTimeline(transitions);
+
+	std::ofstream timelineFile(fileName);
+
+	if (timelineFile.is_open() == false)
+	{
+		Logger::WriteLine(Shell::Red("Failed to open the GPIO timeline file "), fileName,
+								Shell::Red("."));
+		return false;
+	}
+
+	if (format == kGPIOTimelineFormatCSV)
+	{
+		timelineFile << "decisionTimeNS,writeTimeNS,pin,value\n";
+
+		for (auto const& transition : transitions)
+		{
+			timelineFile << transition.m_decisionTime.time_since_epoch().count() << ',' <<
+				transition.m_writeTime.time_since_epoch().count() << ',' << transition.m_pin << ',' <<
+				((transition.m_on == true) ? "on" : "off") << '\n';
+		}
+	}
+	else
+	{
+		timelineFile << "{\n\t\"transitions\" : [";
+
+		char const* separator = "\n";
+
+		for (auto const& transition : transitions)
+		{
+			timelineFile << separator << "\t\t{ \"decisionTimeNS\" : " <<
+				transition.m_decisionTime.time_since_epoch().count() << ", \"writeTimeNS\" : " <<
+				transition.m_writeTime.time_since_epoch().count() << ", \"pin\" : " <<
+				transition.m_pin << ", \"value\" : \"" << ((transition.m_on == true) ? "on" : "off") <<
+				"\" }";
+
+			separator = ",\n";
+		}
+
+		timelineFile << "\n\t]\n}\n";
+	}
+
+	return timelineFile.good();
+}
@@ -1,20 +1,67 @@
 #pragma once
 
+#include <vector>
+
+#include "timer.h"
+
+// Types
+//
+
+// A change to the value of a pin, recorded when GPIO is simulated.
+struct GPIOTransition
+{
+	// The time of the tick that decided on the change.
+	Time m_decisionTime;
+
+	// When the change was written.
+	Time m_writeTime;
+
+	// The GPIO pin.
+	int m_pin;
+
+	// Whether the pin was turned on or off.
+	bool m_on;
+};
+
+// Counts of the writes that were made and the ones that were skipped because nothing changed.
+struct GPIOStatistics
+{
+	// The number of commits that wrote to the pins. With hardware, each is one system call.
+	unsigned long long m_commitCount = 0ull;
+
+	// The number of commits that were skipped because no pin changed.
+	unsigned long long m_skippedCommitCount = 0ull;
+
+	// The number of pins set to a new value.
+	unsigned long long m_pinChangeCount = 0ull;
+
+	// The number of pins set to the value they already had.
+	unsigned long long m_skippedPinChangeCount = 0ull;
+};
+
+// The formats the simulated timeline can be written in.
+enum GPIOTimelineFormat
+{
+	kGPIOTimelineFormatCSV = 0,
+	kGPIOTimelineFormatJSON,
+};
 
 // Functions
 //
 
 // Initialize GPIO support.
 //
-// enableGPIO: Whether to turn on GPIO or not.
+// enableGPIO:		Whether to turn on GPIO or not.
+// simulateGPIO:	(Optional) Whether to simulate the pins instead, recording every change to a
+//						timeline.
 //
-void GPIOInitialize(bool const enableGPIO);
+void GPIOInitialize(bool const enableGPIO, bool const simulateGPIO = false);
 
 // Uninitialize GPIO support.
 // 
 void GPIOUninitialize();
 
-// Acquire a GPIO pin as output.
+// Acquire a GPIO pin as output. It starts off.
 //
 // pin:	The GPIO pin to acquire as output.
 //
@@ -26,15 +73,76 @@ void GPIOAcquireOutputPin(int pin);
 //
 void GPIOReleasePin(int pin);
 
-// Set the given GPIO pin to the "on" value.
+// Request the lines of all of the acquired pins as one set, keeping their current values, so that
+// they can be set together. Requesting lines again briefly lets go of them, so this should be done
+// once every pin has been acquired. Otherwise, it is done on the next commit that changes a pin.
+//
+// Returns:	True if the lines are requested, or there is no hardware to request them from, false
+//				otherwise.
+//
+bool GPIORequestAcquiredPins();
+
+// Set the given GPIO pin to the "on" value on the next commit.
 //
 // pin:	The GPIO pin to set the value of.
 //
 void GPIOSetPinOn(int pin);
 
-// Set the given GPIO pin to the "off" value.
+// Set the given GPIO pin to the "off" value on the next commit.
 //
 // pin:	The GPIO pin to set the value of.
 //
 void GPIOSetPinOff(int pin);
 
+// Apply every pin value set since the last commit at once, so the relays are never seen half way
+// between two states.
+//
+// decisionTime:	The time of the tick that decided on the values.
+//
+void GPIOCommit(Time const& decisionTime);
+
+// Get counts of the writes that were made and the ones that were skipped.
+//
+// statistics:	(Output) The counts.
+//
+void GPIOGetStatistics(GPIOStatistics& statistics);
+
+// Forget the counts of writes.
+//
+void GPIOResetStatistics();
+
+// Write the counts of writes to the logger.
+//
+void GPIOLogStatistics();
+
+// Determine whether the pins are simulated.
+//
+bool GPIOIsSimulated();
+
+// Determine whether a pin was last set to the "on" value.
+//
+// pin:	The GPIO pin.
+//
+// Returns:	True if the pin is acquired and on, false otherwise.
+//
+bool GPIOIsPinOn(int pin);
+
+// Get the recorded transitions, when GPIO is simulated.
+//
+// transitions:	(Output) The transitions, oldest first.
+//
+void GPIOGetTimeline(std::vector<GPIOTransition>& transitions);
+
+// Forget the recorded transitions.
+//
+void GPIOClearTimeline();
+
+// Write the recorded transitions to a file. Times are in nanoseconds on the monotonic clock.
+//
+// fileName:	The name of the file to write.
+// format:		The format to write the transitions in.
+//
+// Returns:	True if the file was written, false otherwise.
+//
+bool GPIOWriteTimeline(char const* fileName, GPIOTimelineFormat format);
+
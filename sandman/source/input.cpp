@@ -1,27 +1,37 @@
 #include "input.h"
 
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <iomanip>
 #include <sstream>
 
 #include <cerrno>
 #include <fcntl.h>
 #include <linux/input.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "event_loop.h"
 #include "logger.h"
 #include "notification.h"
-#include "timer.h"
+#include "profiler.h"
+#include "status.h"
 
 #define DATADIR		AM_DATADIR
 
 // Constants
 //
 
+// The changes to watch the device directories for. Nodes are often created before their permissions
+// are set, and udev moves links into place rather than creating them there.
+static constexpr std::uint32_t kWatchMask{ IN_CREATE | IN_ATTRIB | IN_MOVED_TO };
 
 // Types
 //
@@ -30,6 +40,19 @@
 // Locals
 //
 
+// What the input devices are doing with a control.
+struct InputControlHoldState
+{
+	// The number of keys held down for each action, over all input devices.
+	std::array<unsigned int, Control::kNumActions> m_heldKeyCounts{};
+
+	// The action that the input devices last gave the control.
+	Control::Actions m_action = Control::kActionStopped;
+};
+
+// The hold state of each control, by control index. Input is only handled on the main thread.
+static std::vector<InputControlHoldState> s_controlHoldStates;
+
 
 // Functions
 //
@@ -82,245 +105,1188 @@ bool InputBinding::ReadFromJSON(rapidjson::Value const& object)
 		return false;
 	}
 
+	// Keys move controls for as long as they are held, which doesn't go with moving to a position.
+	if (m_controlAction.HasTargetPosition() == true)
+	{
+		Logger::WriteLine("Input binding has a control action with a position, but only actions are "
+								"supported.");
+		return false;
+	}
+
 	return true;
 }
 
-// Input members
+// InputDeviceConfig members
 
-// Handle initialization.
+InputDeviceConfig::InputDeviceConfig()
+{
+	m_deviceName[0] = '\0';
+	m_matchName[0] = '\0';
+}
+
+// Read a vendor or product ID from JSON. IDs are usually written in hexadecimal, so a string such
+// as "0x045e" is accepted as well as a number.
+//
+// id:		(Output) The ID.
+// object:	The JSON object that may hold the ID.
+// key:		The name of the member holding the ID.
 //
-// deviceName:	The name of the input device that this will manage.
-// bindings:		A list of input bindings.
+// Returns:	True if the ID is missing or was read successfully, false otherwise.
 //
-void Input::Initialize(char const* deviceName, std::vector<InputBinding> const& bindings)
+static bool InputReadIDFromJSON(int& id, rapidjson::Value const& object, char const* key)
 {
-	// Copy the device name.
-	strncpy(m_deviceName, deviceName, kDeviceNameCapacity - 1);
-	m_deviceName[kDeviceNameCapacity - 1] = '\0';
-	
-	// Populate the input bindings.
-	m_bindings = bindings;
-	
-	// Use the bindings to populate the input to action mapping.
-	for (const auto& binding : m_bindings) 
+	auto const idIterator = object.FindMember(key);
+
+	if (idIterator == object.MemberEnd())
 	{
-		// Blindly insert. If the same key is bound more than once, the mapping will get overwritten 
-		// with the last occurrence.
-		m_inputToActionMap[binding.m_keyCode] = binding.m_controlAction;
+		return true;
 	}
-	
-	// Display what we initialized.
-	Logger::WriteLine("Initialized input device \'", m_deviceName, "\' with input bindings:");
 
-	for (auto const& binding : m_bindings) 
+	long value = -1;
+
+	if (idIterator->value.IsInt() == true)
 	{
-		auto* const actionText = 
-			(binding.m_controlAction.m_action == Control::Actions::kActionMovingUp) ? "up" : "down";
+		value = idIterator->value.GetInt();
+	}
+	else if (idIterator->value.IsString() == true)
+	{
+		char* end = nullptr;
+		value = std::strtol(idIterator->value.GetString(), &end, 0);
 
-		Logger::WriteLine("\tCode ", binding.m_keyCode, " -> ", binding.m_controlAction.m_controlName,
-								", ", actionText);
+		if ((end == idIterator->value.GetString()) || (*end != '\0'))
+		{
+			value = -1;
+		}
 	}
-	
-	Logger::WriteLine();
-}
 
-// Handle uninitialization.
-//
-void Input::Uninitialize()
-{
-	// Make sure the device file is closed.
-	CloseDevice(false, "");
+	if ((value < 0) || (value > 0xFFFF))
+	{
+		Logger::WriteLine(Shell::Red("Config input device "), key,
+								Shell::Red(" is not a 16-bit number."));
+		return false;
+	}
+
+	id = static_cast<int>(value);
+	return true;
 }
 
-// Process a tick.
+// Read an input device config from JSON.
 //
-void Input::Process()
+// object:	The JSON object representing an input device.
+//
+// Returns:		True if the input device was read successfully, false otherwise.
+//
+bool InputDeviceConfig::ReadFromJSON(rapidjson::Value const& object)
 {
-	// See if we need to open the device.
-	if (m_deviceFileHandle == kInvalidFileHandle) {
-		
-		// If we have failed before, see whether we have waited long enough before trying to open 
-		// again.
-		if (m_deviceOpenHasFailed == true)
-		{		
-			// Get elapsed time since the last failure.
-			Time currentTime;
-			TimerGetCurrent(currentTime);
-
-			auto const elapsedTimeMS = TimerGetElapsedMilliseconds(m_lastDeviceOpenFailTime, 
-				currentTime);
-			
-			if (elapsedTimeMS < kDeviceOpenRetryDelayMS)
-			{
-				return;
-			}
+	if (object.IsObject() == false)
+	{
+		Logger::WriteLine(Shell::Red("Config has an input device that is not an object."));
+		return false;
+	}
+
+	// The device path is optional, since the device can also be found by name or ID.
+	auto const deviceIterator = object.FindMember("device");
+
+	if (deviceIterator != object.MemberEnd())
+	{
+		if (deviceIterator->value.IsString() == false)
+		{
+			Logger::WriteLine(Shell::Red("Config input device path is not a string."));
+			return false;
 		}
 
-		// We open in nonblocking mode so that we don't hang waiting for input.
-		m_deviceFileHandle = open(m_deviceName, O_RDONLY | O_NONBLOCK);
+		// Copy no more than the amount of text the buffer can hold.
+		strncpy(m_deviceName, deviceIterator->value.GetString(), kDeviceNameCapacity - 1);
+		m_deviceName[kDeviceNameCapacity - 1] = '\0';
+	}
+
+	auto const nameIterator = object.FindMember("name");
 
-		if (m_deviceFileHandle < 0)
+	if (nameIterator != object.MemberEnd())
+	{
+		if (nameIterator->value.IsString() == false)
 		{
-			// Record the time of the last open failure.
-			TimerGetCurrent(m_lastDeviceOpenFailTime);
+			Logger::WriteLine(Shell::Red("Config input device name is not a string."));
+			return false;
+		}
 
-			std::string const errorMessage(
-				(std::ostringstream() << "Failed to open input device \'" << m_deviceName << "\'")
-					.str());
+		strncpy(m_matchName, nameIterator->value.GetString(), kDeviceNameCapacity - 1);
+		m_matchName[kDeviceNameCapacity - 1] = '\0';
+	}
 
-			CloseDevice(true, errorMessage);
+	auto const grabIterator = object.FindMember("grab");
 
-			return;
+	if (grabIterator != object.MemberEnd())
+	{
+		if (grabIterator->value.IsBool() == false)
+		{
+			Logger::WriteLine(Shell::Red("Config input device grab is not a boolean."));
+			return false;
 		}
 
-		// Try to get the name.
-		char name[256];
-		if (ioctl(m_deviceFileHandle, EVIOCGNAME(sizeof(name)), name) < 0)
-		{	
-			// Record the time of the last open failure.
-			TimerGetCurrent(m_lastDeviceOpenFailTime);
+		m_grab = grabIterator->value.GetBool();
+	}
+
+	if ((InputReadIDFromJSON(m_vendorID, object, "vendorID") == false) ||
+		 (InputReadIDFromJSON(m_productID, object, "productID") == false))
+	{
+		return false;
+	}
+
+	// We must have a bindings array, but it can be empty.
+	m_bindings.clear();
 
-			std::string const errorMessage((std::ostringstream()
-													  << "Failed to get name for input device \'" << m_deviceName
-													  << "\'")
-														 .str());
+	auto const bindingsIterator = object.FindMember("bindings");
+
+	if (bindingsIterator == object.MemberEnd())
+	{
+		Logger::WriteLine(Shell::Red("Config input device is missing a bindings array."));
+		return false;
+	}
+
+	if (bindingsIterator->value.IsArray() == false)
+	{
+		Logger::WriteLine(Shell::Red("Config input device bindings exists, but it is not an array."));
+		return false;
+	}
 
-			CloseDevice(true, errorMessage);
+	for (auto const& bindingObject : bindingsIterator->value.GetArray())
+	{
+		// Try to read the binding.
+		InputBinding binding;
+		if (binding.ReadFromJSON(bindingObject) == false)
+		{
+			continue;
 		}
 
-		Logger::WriteLine("Input device \'", m_deviceName, "\' is a \'", name, "\'");
+		// If we successfully read a binding, add it to the list.
+		m_bindings.push_back(binding);
+	}
 
-		// More device information.
-		unsigned short deviceID[4];
-		ioctl(m_deviceFileHandle, EVIOCGID, deviceID);
+	return true;
+}
 
-		Logger::WriteLine(/* Use hexadecimal and show base of number (`0x`). */
-								std::hex, std::showbase,
-								
-								"Input device bus ", deviceID[ID_BUS    ],
-								", vendor "        , deviceID[ID_VENDOR ],
-								", product "       , deviceID[ID_PRODUCT],
-								", version "       , deviceID[ID_VERSION], ".",
+// Determine whether there is anything to pick out a device with.
+//
+bool InputDeviceConfig::CanMatch() const
+{
+	return (m_deviceName[0] != '\0') || (m_matchName[0] != '\0') || (m_vendorID != kMatchAnyID) ||
+		(m_productID != kMatchAnyID);
+}
 
-								/* Restore to using decimal and not showing base of number. */
-								std::dec, std::noshowbase);
+// Determine whether a device matches.
+//
+// devicePath:	The path of the device node.
+// name:			The name reported by the device.
+// vendorID:	The vendor ID reported by the device.
+// productID:	The product ID reported by the device.
+//
+// Returns:	True if the device matches, false otherwise.
+//
+bool InputDeviceConfig::Matches(char const* devicePath, char const* name, unsigned short vendorID,
+	unsigned short productID) const
+{
+	if (CanMatch() == false)
+	{
+		return false;
+	}
 
-		// Play controller connected notification.
-		NotificationPlay("control_connected");
-			
-		m_deviceOpenHasFailed = false;
+	if ((m_deviceName[0] != '\0') && (std::strcmp(m_deviceName, devicePath) != 0))
+	{
+		return false;
 	}
 
-	// Read up to 64 input events at a time.
-	static constexpr std::size_t kEventsToReadCount{64};
-	input_event events[kEventsToReadCount];
-	static constexpr std::size_t kEventSize{sizeof(input_event)};
-	static constexpr std::size_t kEventBufferSize{kEventsToReadCount * kEventSize};
+	if ((m_matchName[0] != '\0') && (std::strcmp(m_matchName, name) != 0))
+	{
+		return false;
+	}
 
-	static_assert(kEventBufferSize <= SSIZE_MAX,
-					  "In `man 'read(2)'`, DESCRIPTION: "
-					  "\"According to POSIX.1, if count is greater than SSIZE_MAX, "
-					  "the result is implementation-defined; see NOTES for the upper limit on Linux.\"");
-	auto const readCount = read(m_deviceFileHandle, events, kEventBufferSize);
+	if ((m_vendorID != kMatchAnyID) && (m_vendorID != vendorID))
+	{
+		return false;
+	}
 
-	// I think maybe this would happen if the device got disconnected?
-	if (readCount < 0)
+	if ((m_productID != kMatchAnyID) && (m_productID != productID))
 	{
-		// When we are in nonblocking mode, this "error" means that there was no data and 
-		// we need to check the device again.
-		if (errno == EAGAIN)
+		return false;
+	}
+
+	return true;
+}
+
+// Get a description of the device to use in log messages.
+//
+std::string InputDeviceConfig::GetDescription() const
+{
+	std::ostringstream description;
+	char const* separator = "";
+
+	if (m_deviceName[0] != '\0')
+	{
+		description << m_deviceName;
+		separator = ", ";
+	}
+
+	if (m_matchName[0] != '\0')
+	{
+		description << separator << "named " << m_matchName;
+		separator = ", ";
+	}
+
+	if ((m_vendorID != kMatchAnyID) || (m_productID != kMatchAnyID))
+	{
+		description << separator << std::hex << std::setfill('0');
+
+		if (m_vendorID != kMatchAnyID)
 		{
-			return;
+			description << std::setw(4) << m_vendorID;
+		}
+		else
+		{
+			description << "****";
 		}
 
-		std::string const errorMessage(
-			(std::ostringstream() << "Failed to read from input device \'" << m_deviceName << "\'")
-				.str());
+		description << ':';
 
-		CloseDevice(true, errorMessage);
+		if (m_productID != kMatchAnyID)
+		{
+			description << std::setw(4) << m_productID;
+		}
+		else
+		{
+			description << "****";
+		}
+	}
 
-		return;
+	return description.str();
+}
+
+// Input members
+
+// Handle initialization. This doesn't open the device, it waits to be offered one.
+//
+// config:						The input device that this will manage, and its bindings.
+// deviceIndex:				The index of the device, in the order it was configured.
+// disconnectedCallback:	Called when the device has been lost.
+//
+void Input::Initialize(InputDeviceConfig const& config, unsigned int deviceIndex,
+	std::function<void()> const& disconnectedCallback)
+{
+	m_config = config;
+	m_deviceIndex = deviceIndex;
+	m_disconnectedCallback = disconnectedCallback;
+
+	// Look up the controls now, so handling an event doesn't have to.
+	for (auto& binding : m_config.m_bindings)
+	{
+		binding.m_controlAction.ResolveControl();
 	}
-	
-	// Process each of the input events.
-	auto const eventCount = readCount / kEventSize;
-	for (unsigned int eventIndex = 0; eventIndex < eventCount; eventIndex++)
+
+	// Use the bindings to populate the key table.
+	m_keyBindings.fill(KeyBinding());
+	m_pressedKeys.reset();
+
+	for (const auto& binding : m_config.m_bindings)
 	{
-		auto const& event = events[eventIndex];
-		
-		// We are only handling keys/buttons for now.
-		if (event.type != EV_KEY)
+		if (binding.m_keyCode >= KEY_CNT)
 		{
+			Logger::WriteLine(Shell::Yellow("Input binding key code "), binding.m_keyCode,
+									Shell::Yellow(" is not a valid key."));
 			continue;
 		}
 
-		// Try to find a control action corresponding to this input.
-		auto result = m_inputToActionMap.find(event.code);
-		
-		if (result == m_inputToActionMap.end())
+		auto const& controlHandle = binding.m_controlAction.m_controlHandle;
+
+		if (controlHandle.IsValid() == false)
 		{
 			continue;
 		}
-		
-		// The action is the second member of the pair.
-		auto& controlAction = result->second;
-	
-		// Try to find the corresponding control.
-		auto* control = controlAction.GetControl();
 
-		if (control == nullptr)
+		// Blindly insert. If the same key is bound more than once, the mapping will get overwritten 
+		// with the last occurrence.
+		m_keyBindings[binding.m_keyCode] = { controlHandle, binding.m_controlAction.m_action };
+
+		if (controlHandle.GetIndex() >= s_controlHoldStates.size())
 		{
-			Logger::WriteLine("Couldn't find control \'", controlAction.m_controlName,
-									"\' mapped to key code ", event.code, ".");
-			continue;
+			s_controlHoldStates.resize(controlHandle.GetIndex() + 1u);
 		}
+	}
+	
+	// Display what we initialized.
+	Logger::WriteLine("Initialized input device \'", m_config.GetDescription(),
+							"\' with input bindings:");
+
+	for (auto const& binding : m_config.m_bindings)
+	{
+		auto* const actionText = 
+			(binding.m_controlAction.m_action == Control::Actions::kActionMovingUp) ? "up" : "down";
 
-		// Translate whether the key was pressed or not into the appropriate action.
-		auto const action = (event.value == 1) ? controlAction.m_action : 
-			Control::Actions::kActionStopped;
+		Logger::WriteLine("\tCode ", binding.m_keyCode, " -> ", binding.m_controlAction.m_controlName,
+								", ", actionText);
+	}
+	
+	Logger::WriteLine();
 
-		// Manipulate the control.
-		control->SetDesiredAction(action, Control::Modes::kModeManual);
-	}	
+	if (m_config.CanMatch() == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Input device has no path, name, or ID to find it by, so it "
+												  "will never be opened."));
+	}
 }
 
-// Determine whether the input device is connected.
+// Handle uninitialization.
 //
-bool Input::IsConnected() const
+void Input::Uninitialize()
 {
-	return (m_deviceFileHandle != kInvalidFileHandle);
+	// Make sure the device file is closed.
+	CloseDevice(false, "");
+
+	m_disconnectedCallback = nullptr;
 }
 
-// Close the input device.
+// Get how the device is recognized, and its bindings.
 //
-// wasFailure:	Whether the device is being closed due to a failure or not.
-// message: message that may be logged
+InputDeviceConfig const& Input::GetConfig() const
+{
+	return m_config;
+}
+
+// Get the path of the device node that is open, or an empty string if there isn't one.
 //
-void Input::CloseDevice(bool const wasFailure, std::string_view const message)
+char const* Input::GetOpenPath() const
 {
-	// Close the device.
-	if (m_deviceFileHandle != kInvalidFileHandle)
+	return m_openPath;
+}
+
+// Determine whether a device node is the one that is open, however it was reached.
+//
+// deviceStatus:	The status of the device node, from stat().
+//
+// Returns:	True if the node is the open device, false otherwise.
+//
+bool Input::IsDeviceOpen(struct stat const& deviceStatus) const
+{
+	if (m_deviceFileHandle == kInvalidFileHandle)
 	{
-		close(m_deviceFileHandle);
-		m_deviceFileHandle = kInvalidFileHandle;
+		return false;
 	}
-			
-	// Only log a message/play sound on failure.
-	if (wasFailure == false) {
-		return;
+
+	struct stat openStatus;
+
+	if (fstat(m_deviceFileHandle, &openStatus) < 0)
+	{
+		return false;
 	}
-	
-	// And only if it was the first failure.
-	if (m_deviceOpenHasFailed == true)
+
+	// Separate nodes for the same device count as the same device too.
+	if ((S_ISCHR(openStatus.st_mode) != 0) && (S_ISCHR(deviceStatus.st_mode) != 0))
 	{
-		return;
+		return openStatus.st_rdev == deviceStatus.st_rdev;
 	}
-	
-	m_deviceOpenHasFailed = true;	
-	
-	// Log the message.
-	Logger::WriteLine(Shell::Red(message));
 
-	// Play controller disconnected notification.
-	NotificationPlay("control_disconnected");
+	return (openStatus.st_dev == deviceStatus.st_dev) && (openStatus.st_ino == deviceStatus.st_ino);
+}
+
+// Try to open a device node, keeping it only if it matches the config.
+//
+// devicePath:	The path of the device node.
+//
+// Returns:	True if the device was opened, false otherwise.
+//
+bool Input::TryOpenDevice(char const* devicePath)
+{
+	if ((IsConnected() == true) || (m_config.CanMatch() == false))
+	{
+		return false;
+	}
+
+	// Don't bother opening a node that can't be the configured one.
+	if ((m_config.m_deviceName[0] != '\0') && (std::strcmp(m_config.m_deviceName, devicePath) != 0))
+	{
+		return false;
+	}
+
+	// We open in nonblocking mode so that we don't hang waiting for input. Not being able to open
+	// the node isn't a failure, it's just not ready yet.
+	auto const fileHandle = open(devicePath, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+
+	if (fileHandle < 0)
+	{
+		return false;
+	}
+
+	// Try to get the name. If there isn't one, this isn't an input device.
+	char name[256];
+	if (ioctl(fileHandle, EVIOCGNAME(sizeof(name)), name) < 0)
+	{
+		close(fileHandle);
+		return false;
+	}
+
+	// More device information.
+	unsigned short deviceID[4];
+	if (ioctl(fileHandle, EVIOCGID, deviceID) < 0)
+	{
+		close(fileHandle);
+		return false;
+	}
+
+	if (m_config.Matches(devicePath, name, deviceID[ID_VENDOR], deviceID[ID_PRODUCT]) == false)
+	{
+		close(fileHandle);
+		return false;
+	}
+
+	Logger::WriteLine("Input device \'", devicePath, "\' is a \'", name, "\'");
+
+	Logger::WriteLine(/* Use hexadecimal and show base of number (`0x`). */
+							std::hex, std::showbase,
+
+							"Input device bus ", deviceID[ID_BUS    ],
+							", vendor "        , deviceID[ID_VENDOR ],
+							", product "       , deviceID[ID_PRODUCT],
+							", version "       , deviceID[ID_VERSION], ".",
+
+							/* Restore to using decimal and not showing base of number. */
+							std::dec, std::noshowbase);
+
+	return AttachDevice(fileHandle, devicePath);
+}
+
+// Take over a file handle for a device node that has already been opened and matched. The kernel
+// is asked to filter and grab it, as configured, though it is kept even if it can't.
+//
+// fileHandle:	The open file handle, which the input now owns.
+// devicePath:	The path of the device node.
+//
+// Returns:	True if the device is connected, false otherwise.
+//
+bool Input::AttachDevice(int fileHandle, char const* devicePath)
+{
+	if (IsConnected() == true)
+	{
+		close(fileHandle);
+		return false;
+	}
+
+	m_deviceFileHandle = fileHandle;
+	strncpy(m_openPath, devicePath, kDevicePathCapacity - 1);
+	m_openPath[kDevicePathCapacity - 1] = '\0';
+
+	StatusPublishInputConnection(m_deviceIndex, true);
+
+	// Without the mask, events we don't want are still thrown away, just after reading them.
+	m_eventMaskInstalled = InstallEventMask();
+
+	if (m_eventMaskInstalled == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Input device \'"), m_openPath,
+								Shell::Yellow("\' can't filter events, all of them will be read."));
+	}
+
+	if (m_config.m_grab == true)
+	{
+		m_grabbed = (ioctl(m_deviceFileHandle, EVIOCGRAB, 1) == 0);
+
+		if (m_grabbed == false)
+		{
+			Logger::WriteLine(Shell::Yellow("Input device \'"), m_openPath,
+									Shell::Yellow("\' couldn't be grabbed, it may be in use elsewhere."));
+		}
+	}
+
+	// Have the event loop tell us whenever there are events to read.
+	if (EventLoopAddFileDescriptor(m_deviceFileHandle, [this]() { ReadEvents(); }) == false)
+	{
+		std::string const errorMessage((std::ostringstream() << "Failed to watch input device \'"
+												  << m_openPath << "\'").str());
+
+		CloseDevice(true, errorMessage);
+		return false;
+	}
+
+	// Play controller connected notification.
+	NotificationPlay("control_connected");
+
+	m_deviceOpenHasFailed = false;
+
+	// There may already be events waiting.
+	ReadEvents();
+
+	return IsConnected();
+}
+
+// Report that the device could not be found. This is only logged the first time.
+//
+void Input::ReportMissing()
+{
+	std::string const errorMessage((std::ostringstream() << "Could not find input device \'"
+											  << m_config.GetDescription() << "\'").str());
+
+	CloseDevice(true, errorMessage);
+}
+
+// Read and handle all of the input events that are waiting on the device.
+//
+void Input::ReadEvents()
+{
+	ProfilerScope const profilerScope(kProfilerStageInput);
+
+	// Read up to 64 input events at a time.
+	static constexpr std::size_t kEventsToReadCount{64};
+	input_event events[kEventsToReadCount];
+	static constexpr std::size_t kEventSize{sizeof(input_event)};
+	static constexpr std::size_t kEventBufferSize{kEventsToReadCount * kEventSize};
+
+	static_assert(kEventBufferSize <= SSIZE_MAX,
+					  "In `man 'read(2)'`, DESCRIPTION: "
+					  "\"According to POSIX.1, if count is greater than SSIZE_MAX, "
+					  "the result is implementation-defined; see NOTES for the upper limit on Linux.\"");
+	auto const readCount = read(m_deviceFileHandle, events, kEventBufferSize);
+	m_statistics.m_wakeUpCount++;
+
+	// I think maybe this would happen if the device got disconnected?
+	if (readCount < 0)
+	{
+		// When we are in nonblocking mode, this "error" means that there was no data and 
+		// we need to check the device again.
+		if (errno == EAGAIN)
+		{
+			return;
+		}
+
+		std::string const errorMessage((std::ostringstream() << "Failed to read from input device \'"
+												  << m_openPath << "\'").str());
+
+		CloseDevice(true, errorMessage);
+
+		return;
+	}
+	
+	// Process each of the input events.
+	auto const eventCount = readCount / kEventSize;
+	m_statistics.m_eventCount += eventCount;
+
+	for (unsigned int eventIndex = 0; eventIndex < eventCount; eventIndex++)
+	{
+		auto const& event = events[eventIndex];
+
+		// The kernel ran out of room and dropped events, so a release may have been missed.
+		if ((event.type == EV_SYN) && (event.code == SYN_DROPPED))
+		{
+			ResynchronizeKeys();
+			continue;
+		}
+		
+		// We are only handling keys/buttons for now. Reports that end a bundle of events don't
+		// count as ignored, since they come along with the keys.
+		if ((event.type != EV_KEY) || (event.code >= KEY_CNT) ||
+			 (m_keyBindings[event.code].m_controlHandle.IsValid() == false))
+		{
+			if (event.type != EV_SYN)
+			{
+				m_statistics.m_ignoredEventCount++;
+			}
+
+			continue;
+		}
+
+		HandleKeyEvent(event.code, event.value);
+	}
+}
+
+// Have the kernel only pass along the key events that are bound, so nothing else wakes us.
+//
+// Returns:	True if the mask was installed, false otherwise.
+//
+bool Input::InstallEventMask()
+{
+	InputEventMaskBits maskBits;
+	GetEventMaskBits(maskBits);
+
+	// The mask for EV_SYN selects which event types are passed along.
+	input_mask mask{};
+	mask.type = EV_SYN;
+	mask.codes_size = maskBits.m_typeBits.size();
+	mask.codes_ptr = reinterpret_cast<std::uintptr_t>(maskBits.m_typeBits.data());
+
+	if (ioctl(m_deviceFileHandle, EVIOCSMASK, &mask) < 0)
+	{
+		return false;
+	}
+
+	// Then only the bound keys.
+	mask.type = EV_KEY;
+	mask.codes_size = maskBits.m_keyBits.size();
+	mask.codes_ptr = reinterpret_cast<std::uintptr_t>(maskBits.m_keyBits.data());
+
+	return ioctl(m_deviceFileHandle, EVIOCSMASK, &mask) == 0;
+}
+
+// Get the bitmaps the kernel is given to filter events, from the bindings.
+//
+// maskBits:	(Output) The bitmaps.
+//
+void Input::GetEventMaskBits(InputEventMaskBits& maskBits) const
+{
+	// Reports are always needed to notice dropped events.
+	maskBits.m_typeBits.fill(0u);
+	maskBits.m_typeBits[EV_SYN / 8u] |= 1u << (EV_SYN % 8u);
+	maskBits.m_typeBits[EV_KEY / 8u] |= 1u << (EV_KEY % 8u);
+
+	maskBits.m_keyBits.fill(0u);
+
+	for (unsigned int keyCode = 0u; keyCode < KEY_CNT; keyCode++)
+	{
+		if (m_keyBindings[keyCode].m_controlHandle.IsValid() == true)
+		{
+			maskBits.m_keyBits[keyCode / 8u] |= 1u << (keyCode % 8u);
+		}
+	}
+}
+
+// Determine whether the kernel is filtering events for the open device.
+//
+bool Input::IsEventMaskInstalled() const
+{
+	return m_eventMaskInstalled;
+}
+
+// Determine whether the open device has been grabbed.
+//
+bool Input::IsGrabbed() const
+{
+	return m_grabbed;
+}
+
+// Get counts of what the device has sent.
+//
+InputStatistics const& Input::GetStatistics() const
+{
+	return m_statistics;
+}
+
+// Write the statistics and filtering state of the device to the logger.
+//
+void Input::LogStatistics() const
+{
+	Logger::WriteLine("\t", m_config.GetDescription(), ": ",
+							(IsConnected() == true) ? "connected" : "not connected",
+							(m_eventMaskInstalled == true) ? ", kernel filtered" : "",
+							(m_grabbed == true) ? ", grabbed" : "", ", ", m_statistics.m_wakeUpCount,
+							" wake ups, ", m_statistics.m_eventCount, " events read, ",
+							m_statistics.m_ignoredEventCount, " ignored.");
+}
+
+// Handle a key event, as if it came from the device.
+//
+// keyCode:	The code of the key.
+// value:	0 if the key was released, 1 if it was pressed, or 2 if it is repeating.
+//
+void Input::HandleKeyEvent(unsigned int keyCode, int value)
+{
+	if (keyCode >= KEY_CNT)
+	{
+		return;
+	}
+
+	auto const& keyBinding = m_keyBindings[keyCode];
+	auto* const control = keyBinding.m_controlHandle.GetControl();
+
+	// The control was looked up when the bindings were loaded. A missing one was reported then.
+	if (control == nullptr)
+	{
+		return;
+	}
+
+	// Holding a key down keeps the control going, so a repeat doesn't change anything. Neither does
+	// a press of a key that is already down or a release of one that isn't.
+	bool const pressed = (value != 0);
+
+	if ((value == 2) || (m_pressedKeys.test(keyCode) == pressed))
+	{
+		return;
+	}
+
+	m_pressedKeys.set(keyCode, pressed);
+
+	auto& holdState = s_controlHoldStates[keyBinding.m_controlHandle.GetIndex()];
+	auto& heldKeyCounts = holdState.m_heldKeyCounts;
+	auto newAction = holdState.m_action;
+
+	if (pressed == true)
+	{
+		// The most recent press wins.
+		heldKeyCounts[keyBinding.m_action]++;
+		newAction = keyBinding.m_action;
+	}
+	else
+	{
+		heldKeyCounts[keyBinding.m_action]--;
+
+		// Keep going while any key for the current action is still held, otherwise fall back to
+		// another held action, or stop.
+		if (heldKeyCounts[holdState.m_action] == 0u)
+		{
+			newAction = Control::kActionStopped;
+
+			for (auto const action : { Control::kActionMovingUp, Control::kActionMovingDown })
+			{
+				if (heldKeyCounts[action] > 0u)
+				{
+					newAction = action;
+					break;
+				}
+			}
+		}
+	}
+
+	if ((newAction == holdState.m_action) && (pressed == false))
+	{
+		return;
+	}
+
+	holdState.m_action = newAction;
+
+	// Manipulate the control.
+	control->SetDesiredAction(newAction, Control::Modes::kModeManual);
+}
+
+// Release any keys that the device no longer reports as held, after events were dropped.
+//
+void Input::ResynchronizeKeys()
+{
+	// The kernel reports held keys as a bitmap, one bit per key code.
+	std::array<unsigned char, (KEY_CNT + 7u) / 8u> keyStates{};
+
+	if (ioctl(m_deviceFileHandle, EVIOCGKEY(keyStates.size()), keyStates.data()) < 0)
+	{
+		ReleaseAllKeys();
+		return;
+	}
+
+	for (unsigned int keyCode = 0u; keyCode < KEY_CNT; keyCode++)
+	{
+		bool const held = ((keyStates[keyCode / 8u] >> (keyCode % 8u)) & 1u) != 0u;
+
+		if (m_pressedKeys.test(keyCode) != held)
+		{
+			HandleKeyEvent(keyCode, held ? 1 : 0);
+		}
+	}
+}
+
+// Release every key that is held.
+//
+void Input::ReleaseAllKeys()
+{
+	for (unsigned int keyCode = 0u; (keyCode < KEY_CNT) && (m_pressedKeys.any() == true);
+		keyCode++)
+	{
+		if (m_pressedKeys.test(keyCode) == true)
+		{
+			HandleKeyEvent(keyCode, 0);
+		}
+	}
+}
+
+// Determine whether the input device is connected.
+//
+bool Input::IsConnected() const
+{
+	return (m_deviceFileHandle != kInvalidFileHandle);
+}
+
+// Close the input device.
+//
+// wasFailure:	Whether the device is being closed due to a failure or not.
+// message: message that may be logged
+//
+void Input::CloseDevice(bool const wasFailure, std::string_view const message)
+{
+	// Don't leave a control moving because its key was held when the device went away.
+	ReleaseAllKeys();
+
+	// Close the device.
+	if (m_deviceFileHandle != kInvalidFileHandle)
+	{
+		EventLoopRemoveFileDescriptor(m_deviceFileHandle);
+		close(m_deviceFileHandle);
+		m_deviceFileHandle = kInvalidFileHandle;
+
+		StatusPublishInputConnection(m_deviceIndex, false);
+	}
+
+	m_openPath[0] = '\0';
+	m_eventMaskInstalled = false;
+	m_grabbed = false;
+			
+	// Only log a message/play sound on failure.
+	if (wasFailure == false) {
+		return;
+	}
+
+	// Let the manager know to look for the device again.
+	if (m_disconnectedCallback != nullptr)
+	{
+		m_disconnectedCallback();
+	}
+	
+	// And only if it was the first failure.
+	if (m_deviceOpenHasFailed == true)
+	{
+		return;
+	}
+	
+	m_deviceOpenHasFailed = true;	
+	
+	// Log the message.
+	Logger::WriteLine(Shell::Red(message));
+
+	// Play controller disconnected notification.
+	NotificationPlay("control_disconnected");
+}
+
+// InputManager members
+
+// Handle initialization.
+//
+// configs:		The input devices to manage, and their bindings.
+// scheduler:	Used to look for devices again if device nodes can't be watched.
+//
+void InputManager::Initialize(std::vector<InputDeviceConfig> const& configs, Scheduler& scheduler)
+{
+	m_scheduler = &scheduler;
+
+	m_inputs.clear();
+	m_inputs.reserve(configs.size());
+
+	for (auto const& config : configs)
+	{
+		auto const deviceIndex = static_cast<unsigned int>(m_inputs.size());
+		auto& input = m_inputs.emplace_back(std::make_unique<Input>());
+		input->Initialize(config, deviceIndex, [this]() { OnDeviceDisconnected(); });
+	}
+
+	// Watch before looking, so a device that appears in between isn't missed.
+	if (StartWatching() == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Can't watch for input devices being added, they will be "
+												  "looked for every "), kDeviceRescanDelayMS,
+								Shell::Yellow(" ms."));
+	}
+
+	ScanDevices();
+
+	for (auto& input : m_inputs)
+	{
+		if (input->IsConnected() == false)
+		{
+			input->ReportMissing();
+		}
+	}
+}
+
+// Handle uninitialization.
+//
+void InputManager::Uninitialize()
+{
+	if (m_scheduler != nullptr)
+	{
+		m_scheduler->CancelTimer(m_rescanTimerID);
+	}
+
+	StopWatching();
+
+	for (auto& input : m_inputs)
+	{
+		input->Uninitialize();
+	}
+
+	m_inputs.clear();
+	m_scheduler = nullptr;
+}
+
+// Determine whether any input device is connected.
+//
+bool InputManager::IsConnected() const
+{
+	for (auto const& input : m_inputs)
+	{
+		if (input->IsConnected() == true)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Get the number of input devices being managed.
+//
+unsigned int InputManager::GetDeviceCount() const
+{
+	return static_cast<unsigned int>(m_inputs.size());
+}
+
+// Determine whether a particular input device is connected.
+//
+// deviceIndex:	The index of the device, in the order it was configured.
+//
+bool InputManager::IsDeviceConnected(unsigned int deviceIndex) const
+{
+	if (deviceIndex >= m_inputs.size())
+	{
+		return false;
+	}
+
+	return m_inputs[deviceIndex]->IsConnected();
+}
+
+// Determine whether new device nodes are being watched for.
+//
+bool InputManager::IsWatchingForDevices() const
+{
+	return (m_watchFileHandle != kInvalidFileHandle);
+}
+
+// Start watching for device nodes being added.
+//
+// Returns:	True if device nodes are being watched, false otherwise.
+//
+bool InputManager::StartWatching()
+{
+	m_watchFileHandle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (m_watchFileHandle < 0)
+	{
+		m_watchFileHandle = kInvalidFileHandle;
+		return false;
+	}
+
+	if (inotify_add_watch(m_watchFileHandle, kDeviceDirectory, kWatchMask) < 0)
+	{
+		StopWatching();
+		return false;
+	}
+
+	WatchLinkDirectories();
+
+	if (EventLoopAddFileDescriptor(m_watchFileHandle, [this]() { ReadWatchEvents(); }) == false)
+	{
+		close(m_watchFileHandle);
+		m_watchFileHandle = kInvalidFileHandle;
+		return false;
+	}
+
+	return true;
+}
+
+// Stop watching for device nodes being added.
+//
+void InputManager::StopWatching()
+{
+	if (m_watchFileHandle == kInvalidFileHandle)
+	{
+		return;
+	}
+
+	EventLoopRemoveFileDescriptor(m_watchFileHandle);
+	close(m_watchFileHandle);
+	m_watchFileHandle = kInvalidFileHandle;
+}
+
+// Watch the directories that links to device nodes are added to, including those of the configured
+// device paths. Directories that don't exist yet are watched once they do.
+//
+void InputManager::WatchLinkDirectories()
+{
+	// Watching a directory again does nothing, and one that doesn't exist can't be watched yet, so
+	// neither is an error.
+	for (auto const* const linkDirectory : kDeviceLinkDirectories)
+	{
+		inotify_add_watch(m_watchFileHandle, linkDirectory, kWatchMask);
+	}
+
+	for (auto const& input : m_inputs)
+	{
+		auto const& config = input->GetConfig();
+
+		if (config.m_deviceName[0] == '\0')
+		{
+			continue;
+		}
+
+		auto const directory = std::filesystem::path(config.m_deviceName).parent_path();
+
+		if (directory.empty() == false)
+		{
+			inotify_add_watch(m_watchFileHandle, directory.c_str(), kWatchMask);
+		}
+	}
+}
+
+// Read the changes to the device nodes and look for devices if there were any.
+//
+void InputManager::ReadWatchEvents()
+{
+	ProfilerScope const profilerScope(kProfilerStageInput);
+
+	// The details of the changes don't matter, they're only a sign to look again.
+	alignas(inotify_event) char buffer[4'096];
+	bool changed = false;
+
+	while (true)
+	{
+		auto const readCount = read(m_watchFileHandle, buffer, sizeof(buffer));
+
+		if (readCount <= 0)
+		{
+			break;
+		}
+
+		changed = true;
+	}
+
+	if (changed == true)
+	{
+		// The link directories are created along with the first links in them.
+		WatchLinkDirectories();
+		ScanDevices();
+	}
+}
+
+// Offer the device nodes to any input that isn't connected.
+//
+void InputManager::ScanDevices()
+{
+	m_rescanTimerID = Scheduler::kInvalidTimerID;
+
+	bool anyDisconnected = false;
+
+	// Inputs with a configured path only ever want that node, which may be a symlink outside of the
+	// device directory.
+	for (auto& input : m_inputs)
+	{
+		auto const& config = input->GetConfig();
+
+		if ((input->IsConnected() == true) || (config.CanMatch() == false))
+		{
+			continue;
+		}
+
+		anyDisconnected = true;
+
+		if ((config.m_deviceName[0] != '\0') && (IsDeviceOpen(config.m_deviceName) == false))
+		{
+			input->TryOpenDevice(config.m_deviceName);
+		}
+	}
+
+	if (anyDisconnected == false)
+	{
+		return;
+	}
+
+	// Offer each event node to the inputs that find their device by name or ID, in order.
+	std::error_code errorCode;
+	for (auto const& entry : std::filesystem::directory_iterator(kDeviceDirectory, errorCode))
+	{
+		auto const fileName = entry.path().filename().string();
+
+		if (fileName.compare(0, 5, "event") != 0)
+		{
+			continue;
+		}
+
+		auto const devicePath = entry.path().string();
+
+		if (IsDeviceOpen(devicePath.c_str()) == true)
+		{
+			continue;
+		}
+
+		for (auto& input : m_inputs)
+		{
+			if ((input->IsConnected() == false) && (input->GetConfig().m_deviceName[0] == '\0') &&
+				 (input->TryOpenDevice(devicePath.c_str()) == true))
+			{
+				break;
+			}
+		}
+	}
+
+	// Without a watch, the only way to notice a device is to look again.
+	for (auto const& input : m_inputs)
+	{
+		if ((input->IsConnected() == false) && (input->GetConfig().CanMatch() == true))
+		{
+			ScheduleRescan();
+			break;
+		}
+	}
+}
+
+// Determine whether a device node is already open by one of the inputs. Links to the node, like
+// the ones in /dev/input/by-id, count as the node itself.
+//
+// devicePath:	The path of the device node.
+//
+bool InputManager::IsDeviceOpen(char const* devicePath) const
+{
+	struct stat deviceStatus;
+
+	// A node that can't be looked at can't be opened either.
+	if (stat(devicePath, &deviceStatus) < 0)
+	{
+		return false;
+	}
+
+	for (auto const& input : m_inputs)
+	{
+		if (input->IsDeviceOpen(deviceStatus) == true)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Handle an input losing its device.
+//
+void InputManager::OnDeviceDisconnected()
+{
+	ScheduleRescan();
+}
+
+// Look for devices again after a delay, if device nodes can't be watched.
+//
+void InputManager::ScheduleRescan()
+{
+	if ((IsWatchingForDevices() == true) || (m_scheduler == nullptr) ||
+		 (m_rescanTimerID != Scheduler::kInvalidTimerID))
+	{
+		return;
+	}
+
+	m_rescanTimerID = m_scheduler->AddTimer(kDeviceRescanDelayMS,
+		[this](Time const& /* currentTime */)
+		{
+			ScanDevices();
+		});
+}
+
+// Write the statistics of each input device to the logger.
+//
+void InputManager::LogStatistics() const
+{
+	Logger::WriteLine("Input devices:");
+
+	for (auto const& input : m_inputs)
+	{
+		input->LogStatistics();
+	}
+
+	Logger::WriteLine();
 }
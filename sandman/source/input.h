@@ -1,10 +1,18 @@
 #pragma once
 
-#include <map>
+#include <array>
+#include <bitset>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <linux/input-event-codes.h>
+#include <sys/stat.h>
+
 #include "control.h"
-#include "timer.h"
+#include "scheduler.h"
 
 // Types
 //
@@ -37,43 +45,201 @@ struct InputBinding
 	ControlAction		m_controlAction;
 };
 
+// The description of an input device and its bindings. A device can be picked out by its path, its
+// name, its vendor and product IDs, or any combination of these. Every one given must match.
+struct InputDeviceConfig
+{
+	InputDeviceConfig();
+
+	// Read an input device config from JSON.
+	//
+	// object:	The JSON object representing an input device.
+	//
+	// Returns:		True if the input device was read successfully, false otherwise.
+	//
+	bool ReadFromJSON(rapidjson::Value const& object);
+
+	// Determine whether there is anything to pick out a device with.
+	//
+	bool CanMatch() const;
+
+	// Determine whether a device matches.
+	//
+	// devicePath:	The path of the device node.
+	// name:			The name reported by the device.
+	// vendorID:	The vendor ID reported by the device.
+	// productID:	The product ID reported by the device.
+	//
+	// Returns:	True if the device matches, false otherwise.
+	//
+	bool Matches(char const* devicePath, char const* name, unsigned short vendorID,
+		unsigned short productID) const;
+
+	// Get a description of the device to use in log messages.
+	//
+	std::string GetDescription() const;
+
+	// Constants.
+
+	// The maximum length of the device name.
+	static constexpr unsigned int kDeviceNameCapacity{ 64u };
+
+	// Used when any vendor or product ID will do.
+	static constexpr int kMatchAnyID{ -1 };
+
+	// The path of the device node to get input from, or empty to find the device some other way.
+	char m_deviceName[kDeviceNameCapacity];
+
+	// The name the device must report, or empty for any name.
+	char m_matchName[kDeviceNameCapacity];
+
+	// The vendor ID the device must report, or kMatchAnyID.
+	int m_vendorID = kMatchAnyID;
+
+	// The product ID the device must report, or kMatchAnyID.
+	int m_productID = kMatchAnyID;
+
+	// Whether to take the device for ourselves, so nothing else (like the console) sees its events.
+	bool m_grab = false;
+
+	// The list of input bindings for this device.
+	std::vector<InputBinding> m_bindings;
+};
+
+// Counts of what an input device has sent.
+struct InputStatistics
+{
+	// The number of times the device was read because it had events.
+	unsigned long long m_wakeUpCount = 0ull;
+
+	// The number of events read from the device.
+	unsigned long long m_eventCount = 0ull;
+
+	// The number of events read that weren't acted on. The kernel filters most of these out when
+	// the event mask is installed.
+	unsigned long long m_ignoredEventCount = 0ull;
+};
+
+// The bitmaps the kernel is given to filter the events of an input device, one bit per event type
+// or key code.
+struct InputEventMaskBits
+{
+	// The event types that are passed along.
+	std::array<unsigned char, (EV_CNT + 7u) / 8u> m_typeBits{};
+
+	// The key codes that are passed along.
+	std::array<unsigned char, (KEY_CNT + 7u) / 8u> m_keyBits{};
+};
+
 // Handles dealing with an input device.
 //
 class Input
 {
 	public:
 		
-		// Handle initialization.
+		Input() = default;
+
+		// The event loop refers to the input, so it must stay where it is.
+		Input(Input const&) = delete;
+		Input& operator=(Input const&) = delete;
+
+		// Handle initialization. This doesn't open the device, it waits to be offered one.
 		//
-		// deviceName:	The name of the input device that this will manage.
-		// bindings:		A list of input bindings.
+		// config:						The input device that this will manage, and its bindings.
+		// deviceIndex:				The index of the device, in the order it was configured.
+		// disconnectedCallback:	Called when the device has been lost.
 		//
-		void Initialize(char const* deviceName, std::vector<InputBinding> const& bindings);
+		void Initialize(InputDeviceConfig const& config, unsigned int deviceIndex,
+			std::function<void()> const& disconnectedCallback);
 
 		// Handle uninitialization.
 		//
 		void Uninitialize();
 		
-		// Process a tick.
-		//
-		void Process();
-		
 		// Determine whether the input device is connected.
 		//
 		bool IsConnected() const;
-		
+
+		// Get how the device is recognized, and its bindings.
+		//
+		InputDeviceConfig const& GetConfig() const;
+
+		// Get the path of the device node that is open, or an empty string if there isn't one.
+		//
+		char const* GetOpenPath() const;
+
+		// Determine whether a device node is the one that is open, however it was reached.
+		//
+		// deviceStatus:	The status of the device node, from stat().
+		//
+		// Returns:	True if the node is the open device, false otherwise.
+		//
+		bool IsDeviceOpen(struct stat const& deviceStatus) const;
+
+		// Try to open a device node, keeping it only if it matches the config.
+		//
+		// devicePath:	The path of the device node.
+		//
+		// Returns:	True if the device was opened, false otherwise.
+		//
+		bool TryOpenDevice(char const* devicePath);
+
+		// Take over a file handle for a device node that has already been opened and matched. The
+		// kernel is asked to filter and grab it, as configured, though it is kept even if it can't.
+		//
+		// fileHandle:	The open file handle, which the input now owns.
+		// devicePath:	The path of the device node.
+		//
+		// Returns:	True if the device is connected, false otherwise.
+		//
+		bool AttachDevice(int fileHandle, char const* devicePath);
+
+		// Report that the device could not be found. This is only logged the first time.
+		//
+		void ReportMissing();
+
+		// Get counts of what the device has sent.
+		//
+		InputStatistics const& GetStatistics() const;
+
+		// Write the statistics and filtering state of the device to the logger.
+		//
+		void LogStatistics() const;
+
+		// Get the bitmaps the kernel is given to filter events, from the bindings.
+		//
+		// maskBits:	(Output) The bitmaps.
+		//
+		void GetEventMaskBits(InputEventMaskBits& maskBits) const;
+
+		// Determine whether the kernel is filtering events for the open device.
+		//
+		bool IsEventMaskInstalled() const;
+
+		// Determine whether the open device has been grabbed.
+		//
+		bool IsGrabbed() const;
+
+		// Handle a key event, as if it came from the device.
+		//
+		// keyCode:	The code of the key.
+		// value:	0 if the key was released, 1 if it was pressed, or 2 if it is repeating.
+		//
+		void HandleKeyEvent(unsigned int keyCode, int value);
+
 	private:
 
 		// Constants.
-		
-		// The maximum length of the device name.
-		static constexpr unsigned int kDeviceNameCapacity{ 64u };
 
 		// Used to detect when a file handle is invalid.
 		static constexpr int	kInvalidFileHandle{ -1 };
 
-		// The amount of time to wait between failing to open the device.
-		static constexpr unsigned int kDeviceOpenRetryDelayMS{ 1'000u };
+		// The maximum length of a device node path.
+		static constexpr unsigned int kDevicePathCapacity{ 256u };
+
+		// Read and handle all of the input events that are waiting on the device.
+		//
+		void ReadEvents();
 
 		// Close the input device.
 		//
@@ -82,21 +248,174 @@ class Input
 		//
 		void CloseDevice(bool const wasFailure, std::string_view const message);
 
-		// The name of the device to get input from.
-		char m_deviceName[kDeviceNameCapacity];
+		// Have the kernel only pass along the key events that are bound, so nothing else wakes us.
+		//
+		// Returns:	True if the mask was installed, false otherwise.
+		//
+		bool InstallEventMask();
+
+		// Release any keys that the device no longer reports as held, after events were dropped.
+		//
+		void ResynchronizeKeys();
+
+		// Release every key that is held.
+		//
+		void ReleaseAllKeys();
+
+		// The action bound to a key.
+		struct KeyBinding
+		{
+			// The control to manipulate. This is invalid if the key isn't bound.
+			ControlHandle m_controlHandle;
+
+			// The action for the control.
+			Control::Actions m_action = Control::kActionStopped;
+		};
+
+		// How to recognize the device, and its bindings.
+		InputDeviceConfig m_config;
+
+		// The index of the device, in the order it was configured.
+		unsigned int m_deviceIndex = 0u;
+
+		// The path of the device node that is open.
+		char m_openPath[kDevicePathCapacity] = "";
 		
 		// The device file handle (file descriptor).
 		int m_deviceFileHandle = kInvalidFileHandle;	
 		
 		// Indicates that the device open has failed before.
 		bool m_deviceOpenHasFailed = false;
+
+		// Called when the device has been lost.
+		std::function<void()> m_disconnectedCallback;
 		
-		// A time, so we can tell how long to wait before trying to open the device again.
-		Time m_lastDeviceOpenFailTime;
-				
-		// The list of input bindings.
-		std::vector<InputBinding> m_bindings;
-		
-		// A mapping from input to action.
-		std::map<unsigned short, ControlAction> m_inputToActionMap;
+		// The action for each key code.
+		std::array<KeyBinding, KEY_CNT> m_keyBindings;
+
+		// The keys on this device that are held down.
+		std::bitset<KEY_CNT> m_pressedKeys;
+
+		// Whether the kernel is filtering events for the open device.
+		bool m_eventMaskInstalled = false;
+
+		// Whether the open device has been grabbed.
+		bool m_grabbed = false;
+
+		// Counts of what the device has sent, over every time it was connected.
+		InputStatistics m_statistics;
+};
+
+// Handles all of the configured input devices. Each device is watched by the event loop and is
+// reconnected on its own. New device nodes are noticed as soon as they appear.
+//
+class InputManager
+{
+	public:
+
+		InputManager() = default;
+
+		// The event loop refers to the manager, so it must stay where it is.
+		InputManager(InputManager const&) = delete;
+		InputManager& operator=(InputManager const&) = delete;
+
+		// Handle initialization.
+		//
+		// configs:		The input devices to manage, and their bindings.
+		// scheduler:	Used to look for devices again if device nodes can't be watched.
+		//
+		void Initialize(std::vector<InputDeviceConfig> const& configs, Scheduler& scheduler);
+
+		// Handle uninitialization.
+		//
+		void Uninitialize();
+
+		// Determine whether any input device is connected.
+		//
+		bool IsConnected() const;
+
+		// Get the number of input devices being managed.
+		//
+		unsigned int GetDeviceCount() const;
+
+		// Determine whether a particular input device is connected.
+		//
+		// deviceIndex:	The index of the device, in the order it was configured.
+		//
+		bool IsDeviceConnected(unsigned int deviceIndex) const;
+
+		// Determine whether new device nodes are being watched for.
+		//
+		bool IsWatchingForDevices() const;
+
+		// Write the statistics of each input device to the logger.
+		//
+		void LogStatistics() const;
+
+	private:
+
+		// Constants.
+
+		// Where the input device nodes live.
+		static constexpr char const* kDeviceDirectory{ "/dev/input" };
+
+		// Where udev adds persistent links to the device nodes, some time after the nodes themselves.
+		static constexpr char const* kDeviceLinkDirectories[]{ "/dev/input/by-id",
+			"/dev/input/by-path" };
+
+		// The amount of time to wait between looking for devices, when device nodes can't be watched.
+		static constexpr unsigned int kDeviceRescanDelayMS{ 1'000u };
+
+		// Used to detect when a file handle is invalid.
+		static constexpr int	kInvalidFileHandle{ -1 };
+
+		// Start watching for device nodes being added.
+		//
+		// Returns:	True if device nodes are being watched, false otherwise.
+		//
+		bool StartWatching();
+
+		// Stop watching for device nodes being added.
+		//
+		void StopWatching();
+
+		// Watch the directories that links to device nodes are added to, including those of the
+		// configured device paths. Directories that don't exist yet are watched once they do.
+		//
+		void WatchLinkDirectories();
+
+		// Read the changes to the device nodes and look for devices if there were any.
+		//
+		void ReadWatchEvents();
+
+		// Offer the device nodes to any input that isn't connected.
+		//
+		void ScanDevices();
+
+		// Determine whether a device node is already open by one of the inputs. Links to the node,
+		// like the ones in /dev/input/by-id, count as the node itself.
+		//
+		// devicePath:	The path of the device node.
+		//
+		bool IsDeviceOpen(char const* devicePath) const;
+
+		// Handle an input losing its device.
+		//
+		void OnDeviceDisconnected();
+
+		// Look for devices again after a delay, if device nodes can't be watched.
+		//
+		void ScheduleRescan();
+
+		// The input devices. These are held by pointer, since they must not move.
+		std::vector<std::unique_ptr<Input>> m_inputs;
+
+		// The inotify file handle watching the device directory.
+		int m_watchFileHandle = kInvalidFileHandle;
+
+		// Used to look for devices again if device nodes can't be watched.
+		Scheduler* m_scheduler = nullptr;
+
+		// The timer that will look for devices again.
+		Scheduler::TimerID m_rescanTimerID = Scheduler::kInvalidTimerID;
 };
@@ -1,642 +1,945 @@
-#include <cstddef>
-#include <cctype>
-#include <cstdio>
-#include <ctime>
-#include <filesystem>
-
-#include <fcntl.h>
-#include <pwd.h>
-#include <sys/socket.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <sys/un.h>
-#include <unistd.h>
-
-#include "command.h"
-#include "config.h"
-#include "control.h"
-#include "gpio.h"
-#include "input.h"
-#include "logger.h"
-#include "mqtt.h"
-#include "shell.h"
-#include "notification.h"
-#include "reports.h"
-#include "routines.h"
-#include "timer.h"
-
-// Types
-//
-
-enum ProgramMode
-{
-	kProgramModeInteractive = 0,
-	kProgramModeDaemon,
-	kProgramModeDocker,
-
-	kNumProgramModes
-};
-
-// Locals
-//
-
-// Whether controls have been initialized.
-static bool s_controlsInitialized = false;
-
-// The input device.
-static Input s_input;
-
-// What mode the program is running in.
-static ProgramMode s_programMode = kProgramModeInteractive;
-
-// Used to listen for connections.
-static int s_listeningSocket = -1;
-
-static int s_exitCode = 0;
-
-// The base directory for files we will be using.
-static std::string s_baseDirectory;
-
-// Functions
-//
-
-// Do daemon specific initialization.
-// 
-// Returns: True on success, false on failure.
-// 
-static bool InitializeDaemon()
-{
-	std::printf("Initializing as a daemon.\n");
-
-	// Fork a child off of the parent process.
-	auto const processID = fork();
-
-	// Legitimate failure.
-	if (processID < 0)
-	{
-		s_exitCode = 1;
-		return false;
-	}
-
-	// The parent gets the ID of the child and exits.
-	if (processID > 0)
-	{
-		s_exitCode = 1;
-		return false;
-	}
-
-	// The child gets 0 and continues.
-
-	// Allow file access.
-	umask(0);
-
-	// Initialize logging.
-	if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
-	{
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Need a new session ID.
-	auto const sessionID = setsid();
-
-	if (sessionID < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to get new session ID for daemon."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Change the current working directory.
-	if (chdir(s_baseDirectory.c_str()) < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to change working directory to \"", 
-											  s_baseDirectory.c_str(), "\" ID for daemon."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Close stdin, stdout, stderr.
-	close(STDIN_FILENO);
-	close(STDOUT_FILENO);
-	close(STDERR_FILENO);
-
-	// Redirect stdin, stdout, stderr to /dev/null (this relies on them mapping to
-	// the lowest numbered file descriptors).
-	open("dev/null", O_RDWR);
-	open("dev/null", O_RDWR);
-	open("dev/null", O_RDWR);
-
-	// Now that we are a daemon, set up Unix domain sockets for communication.
-
-	// Create a listening socket.
-	s_listeningSocket = socket(AF_UNIX, SOCK_STREAM, 0);
-
-	if (s_listeningSocket < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to create listening socket."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Set to non-blocking.
-	if (fcntl(s_listeningSocket, F_SETFL, O_NONBLOCK) < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to make listening socket non-blocking."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	sockaddr_un listeningAddress;
-	{
-		std::string const socketFilename = s_baseDirectory + "sandman.sock";
-
-		listeningAddress.sun_family = AF_UNIX;
-		std::strncpy(listeningAddress.sun_path, socketFilename.c_str(),
-							sizeof(listeningAddress.sun_path) - 1);
-	}
-
-	// Unlink the file if needed.
-	unlink(listeningAddress.sun_path);
-
-	// Bind the socket to the file.
-	if (bind(s_listeningSocket, reinterpret_cast<sockaddr*>(&listeningAddress),
-				sizeof(sockaddr_un)) < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to bind listening socket."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Mark the socket for listening.
-	if (listen(s_listeningSocket, 5) < 0)
-	{
-		Logger::WriteLine(Shell::Red("Failed to mark listening socket to listen."));
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Sockets setup!
-	return true;
-}
-
-// Create directories and potentially files needed.
-//
-static bool SetupEnvironment()
-{
-	// Get the home directory.
-	auto* homeDirectory = getenv("SANDMAN_ROOT");
-
-	if (homeDirectory == nullptr)
-	{
-		homeDirectory = getenv("HOME");
-	}
-
-	if (homeDirectory == nullptr)
-	{
-		homeDirectory = getpwuid(getuid())->pw_dir;
-
-		if (homeDirectory == nullptr)
-		{
-			return false;
-		}
-	}
-
-	// Create the base directory if needed.
-	std::string baseDirectory = std::string(homeDirectory) + "/.sandman/";
-	
-	if (std::filesystem::exists(baseDirectory) == false)
-	{
-		if (std::filesystem::create_directory(baseDirectory) == false)
-		{
-			printf("Directory \"%s\" doesn't exist and failed to create it!", baseDirectory.c_str());
-			return false;
-		}
-	}
-
-	s_baseDirectory = baseDirectory;
-
-	return true;
-}
-
-// Initialize program components.
-//
-// returns:		True for success, false otherwise.
-//
-static bool Initialize()
-{
-	if (SetupEnvironment() == false)
-	{
-		return false;
-	}
-
-	switch (s_programMode)
-	{
-		case kProgramModeDaemon:
-		{
-			if (InitializeDaemon() == false)
-			{
-				return false;
-			}
-		}
-		break;
-
-		case kProgramModeDocker:
-		{
-			// Initialize logging.
-			if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
-			{
-				s_exitCode = 1;
-				return false;
-			}
-		}
-		break;
-
-		case kProgramModeInteractive:
-		{
-			// Initialize logging.
-			if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
-			{
-				s_exitCode = 1;
-				return false;
-			}
-
-			Shell::Initialize();
-			Logger::SetEchoToScreen(true);
-		}
-		break;
-
-		default:
-		{
-			std::printf("Undefined program mode!");
-		}
-		return false;
-	};
-
-	Config config;
-
-	// Read the config.
-	std::string configFilename = s_baseDirectory + "sandman.conf";
-	if (config.ReadFromFile(configFilename.c_str()) == false)
-	{
-		Logger::WriteLine(Shell::Yellow("Using default configuration."));
-	}
-
-	// Initialize MQTT.
-	if (MQTTInitialize() == false)
-	{
-		s_exitCode = 1;
-		return false;
-	}
-
-	// Initialize GPIO.
-	static constexpr bool kEnableGPIO = true;
-	GPIOInitialize(kEnableGPIO);
-
-	// Initialize controls.
-	ControlsInitialize(config.GetControlConfigs());
-
-	// Set control durations.
-	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
-								 config.GetControlCoolDownDurationMS());
-
-	// Enable all controls.
-	Control::Enable(true);
-
-	// Controls have been initialized.
-	s_controlsInitialized = true;
-
-	// Initialize the input device.
-	s_input.Initialize(config.GetInputDeviceName(), config.GetInputBindings());
-
-	// Initialize the routines.
-	RoutinesInitialize(s_baseDirectory);
-
-	// Initialize reports.
-	ReportsInitialize(s_baseDirectory);
-
-	// Initialize the commands.
-	CommandInitialize(s_input);
-
-	NotificationPlay("initialized");
-
-	return true;
-}
-
-// Uninitialize program components.
-//
-static void Uninitialize()
-{
-	// Close the listening socket, if there was one.
-	if (s_listeningSocket >= 0)
-	{
-		close(s_listeningSocket);
-	}
-
-	// Uninitialize the commands.
-	CommandUninitialize();
-
-	// Uninitialize reports.
-	ReportsUninitialize();
-
-	// Uninitialize the routines.
-	RoutinesUninitialize();
-
-	// Uninitialize MQTT.
-	MQTTUninitialize();
-
-	if (s_controlsInitialized == true)
-	{
-		// Disable all controls.
-		Control::Enable(false);
-
-		// Uninitialize controls.
-		ControlsUninitialize();
-	}
-
-	// Uninitialize GPIO.
-	GPIOUninitialize();
-
-	// Uninitialize the input.
-	s_input.Uninitialize();
-
-	// Uninitialize logging.
-	Logger::Uninitialize();
-
-	if (s_programMode == kProgramModeInteractive)
-	{
-		Shell::Uninitialize();
-	}
-}
-
-// Process socket communication.
-//
-// returns:		True if the quit command was received, false otherwise.
-//
-static bool ProcessSocketCommunication()
-{
-	// Attempt to accept an incoming connection.
-	auto const connectionSocket = accept(s_listeningSocket, nullptr, nullptr);
-
-	if (connectionSocket < 0)
-	{
-		return false;
-	}
-
-	// Got a connection.
-	Logger::WriteLine("Got a new connection.");
-
-	// Try to read data.
-	static constexpr std::size_t kMessageBufferCapacity{ 100u };
-	char messageBuffer[kMessageBufferCapacity];
-
-	// Assert can subtract one from this without underflow.
-	static_assert(kMessageBufferCapacity >= 1u);
-
-	auto const numReceivedBytes = recv(connectionSocket, messageBuffer,
-												  kMessageBufferCapacity - 1u, 0);
-
-	if (numReceivedBytes <= 0)
-	{
-		Logger::WriteLine("Connection closed, error receiving.");
-
-		// Close the connection.
-		close(connectionSocket);
-		return false;
-	}
-
-	// Terminate.
-	messageBuffer[numReceivedBytes] = '\0';
-
-	Logger::WriteLine("Received \"", messageBuffer, "\".");
-
-	// Handle the message, if necessary.
-	auto done = false;
-
-	if (std::strcmp(messageBuffer, "shutdown") == 0)
-	{
-		done = true;
-	}
-	else
-	{
-		// Parse a command.
-
-		// Tokenize the message.
-		std::vector<CommandToken> commandTokens;
-		CommandTokenizeString(commandTokens, messageBuffer);
-
-		// Parse command tokens.
-		CommandParseTokens(commandTokens);
-	}
-
-	Logger::WriteLine("Connection closed.");
-
-	// Close the connection.
-	close(connectionSocket);
-
-	return done;
-}
-
-// Send a message to the daemon process.
-//
-// message:	The message to send.
-//
-static void SendMessageToDaemon(char const* message)
-{
-	// Create a sending socket.
-	auto const sendingSocket = socket(AF_UNIX, SOCK_STREAM, 0);
-
-	if (sendingSocket < 0)
-	{
-		std::printf("Failed to create sending socket.\n");
-		return;
-	}
-
-	sockaddr_un sendingAddress;
-	{
-		std::string const socketFilename = s_baseDirectory + "sandman.sock";
-
-		sendingAddress.sun_family = AF_UNIX;
-		std::strncpy(sendingAddress.sun_path, socketFilename.c_str(),
-						 sizeof(sendingAddress.sun_path) - 1);
-	}
-
-	// Attempt to connect to the daemon.
-	if (connect(sendingSocket, reinterpret_cast<sockaddr*>(&sendingAddress),
-					sizeof(sockaddr_un)) < 0)
-	{
-		std::printf("Failed to connect to the daemon.\n");
-		close(sendingSocket);
-		return;
-	}
-
-	// Send the message.
-	if (send(sendingSocket, message, std::strlen(message), 0) < 0)
-	{
-		std::printf("Failed to send \"%s\" message to the daemon.\n", message);
-		close(sendingSocket);
-		return;
-	}
-
-	std::printf("Sent \"%s\" message to the daemon.\n", message);
-
-	// Close the connection.
-	close(sendingSocket);
-}
-
-// Handle the commandline arguments.
-//
-//	arguments:		The argument list.
-// argumentCount:	The number of arguments in the list.
-//
-// Returns:	True if the program should exit, false if it should continue.
-//
-static bool HandleCommandLine(char const* const* const arguments, unsigned int const argumentCount)
-{
-	for (unsigned int argumentIndex = 0; argumentIndex < argumentCount; argumentIndex++)
-	{
-		auto const* argument = arguments[argumentIndex];
-
-		// Start as a daemon?
-		if (std::strcmp(argument, "--daemon") == 0)
-		{
-			s_programMode = kProgramModeDaemon;
-			break;
-		}
-		// Start as docker?
-		else if (std::strcmp(argument, "--docker") == 0)
-		{
-			s_programMode = kProgramModeDocker;
-			break;
-		}
-		else if (std::strcmp(argument, "--shutdown") == 0)
-		{
-			SendMessageToDaemon("shutdown");
-			return true;
-		}
-		else
-		{
-			// We are going to see if there is a command to send to the daemon.
-			static constexpr char const* kCommandPrefix = "--command=";
-
-			auto const* commandStringStart = std::strstr(argument, kCommandPrefix);
-
-			if (commandStringStart != nullptr)
-			{
-				// Skip the command prefix.
-				commandStringStart += std::strlen(kCommandPrefix);
-
-				static constexpr std::size_t kCommandBufferCapacity{ 100u };
-				char commandBuffer[kCommandBufferCapacity];
-
-				static_assert(kCommandBufferCapacity >= 1u);
-
-				// Copy only the actual command.
-				std::strncpy(commandBuffer, commandStringStart, kCommandBufferCapacity - 1u);
-				commandBuffer[kCommandBufferCapacity - 1] = '\0';
-
-				// Replace '_' with ' '.
-				auto* currentCharacter = commandBuffer;
-
-				while (*currentCharacter != '\0')
-				{
-					if (*currentCharacter == '_')
-					{
-						*currentCharacter = ' ';
-					}
-
-					currentCharacter++;
-				}
-
-				// Send the command to the daemon.
-				SendMessageToDaemon(commandBuffer);
-				return true;
-			}
-		}
-	}
-
-	return false;
-}
-
-int main(int const argc, char const* const* const argv)
-{
-	// Deal with command line arguments.
-	if (HandleCommandLine(argv, argc) == true)
-	{
-		return s_exitCode;
-	}
-
-	// Initialization.
-	if (Initialize() == false)
-	{
-		Uninitialize();
-		return s_exitCode;
-	}
-
-	auto done = false;
-	while (done == false)
-	{
-		// We're gonna track the framerate.
-		Time frameStartTime;
-		TimerGetCurrent(frameStartTime);
-
-		if (s_programMode == kProgramModeInteractive)
-		{
-			Shell::Lock const lock;
-			Shell::InputWindow::Result const result{ Shell::InputWindow::ProcessSingleUserKey() };
-			done = (result == Shell::InputWindow::Result::kRequestToQuit);
-			Shell::CheckResize();
-		}
-
-		// Process command.
-		CommandProcess();
-
-		// Process controls.
-		ControlsProcess();
-
-		// Process the input.
-		s_input.Process();
-
-		// Process MQTT.
-		MQTTProcess();
-
-		// Process the routines.
-		RoutinesProcess();
-
-		// Process the reports.
-		ReportsProcess();
-
-		if (s_programMode == kProgramModeDaemon)
-		{
-			// Process socket communication.
-			done = ProcessSocketCommunication();
-		}
-
-		// Get the duration of the frame in nanoseconds.
-		Time frameEndTime;
-		TimerGetCurrent(frameEndTime);
-
-		float const frameDurationMS = TimerGetElapsedMilliseconds(frameStartTime, frameEndTime);
-		auto const frameDurationNS = static_cast<unsigned long>(frameDurationMS * 1.0e6f);
-
-		// If the frame is shorter than the duration corresponding to the desired framerate, sleep the
-		// difference off.
-		unsigned long const targetFrameDurationNS = 1'000'000'000ul / 60ul;
-
-		if (frameDurationNS < targetFrameDurationNS)
-		{
-			timespec sleepTime;
-			sleepTime.tv_sec = 0;
-			sleepTime.tv_nsec = targetFrameDurationNS - frameDurationNS;
-
-			timespec remainingTime;
-			nanosleep(&sleepTime, &remainingTime);
-		}
-	}
-
-	Logger::WriteLine("Uninitializing.");
-
-	// Cleanup.
-	Uninitialize();
-	return s_exitCode;
-}
+#include <algorithm>
+#include <cstddef>
+#include <cctype>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <string_view>
+
+#include <fcntl.h>
+#include <pwd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "command.h"
+#include "config.h"
+#include "control.h"
+#include "control_thread.h"
+#include "event_loop.h"
+#include "gpio.h"
+#include "input.h"
+#include "logger.h"
+#include "mqtt.h"
+#include "shell.h"
+#include "socket_server.h"
+#include "notification.h"
+#include "profiler.h"
+#include "reports.h"
+#include "routines.h"
+#include "scheduler.h"
+#include "status.h"
+#include "status_page.h"
+#include "timer.h"
+
+// Constants
+//
+
+// How long to wait for the daemon to reply to a message (in milliseconds).
+static constexpr unsigned int kDaemonReplyTimeoutMS{ 5'000u };
+
+// Types
+//
+
+enum ProgramMode
+{
+	kProgramModeInteractive = 0,
+	kProgramModeDaemon,
+	kProgramModeDocker,
+
+	kNumProgramModes
+};
+
+// Locals
+//
+
+// Whether controls have been initialized.
+static bool s_controlsInitialized = false;
+
+// The input devices.
+static InputManager s_inputManager;
+
+// Calls the functions for anything that needs to happen at a particular time.
+static Scheduler s_scheduler;
+
+// The format to write the simulated GPIO timeline in when shutting down.
+static GPIOTimelineFormat s_gpioTimelineFormat = kGPIOTimelineFormatCSV;
+
+// What mode the program is running in.
+static ProgramMode s_programMode = kProgramModeInteractive;
+
+// Set when the program has been asked to quit.
+static bool s_quitRequested = false;
+
+static int s_exitCode = 0;
+
+// The base directory for files we will be using.
+static std::string s_baseDirectory;
+
+// Functions
+//
+
+// Do daemon specific initialization.
+// 
+// Returns: True on success, false on failure.
+// 
+static bool InitializeDaemon()
+{
+	std::printf("Initializing as a daemon.\n");
+
+	// Fork a child off of the parent process.
+	auto const processID = fork();
+
+	// Legitimate failure.
+	if (processID < 0)
+	{
+		s_exitCode = 1;
+		return false;
+	}
+
+	// The parent gets the ID of the child and exits.
+	if (processID > 0)
+	{
+		s_exitCode = 1;
+		return false;
+	}
+
+	// The child gets 0 and continues.
+
+	// Allow file access.
+	umask(0);
+
+	// Initialize logging.
+	if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
+	{
+		s_exitCode = 1;
+		return false;
+	}
+
+	// Need a new session ID.
+	auto const sessionID = setsid();
+
+	if (sessionID < 0)
+	{
+		Logger::WriteLine(Shell::Red("Failed to get new session ID for daemon."));
+		s_exitCode = 1;
+		return false;
+	}
+
+	// Change the current working directory.
+	if (chdir(s_baseDirectory.c_str()) < 0)
+	{
+		Logger::WriteLine(Shell::Red("Failed to change working directory to \"", 
+											  s_baseDirectory.c_str(), "\" ID for daemon."));
+		s_exitCode = 1;
+		return false;
+	}
+
+	// Close stdin, stdout, stderr.
+	close(STDIN_FILENO);
+	close(STDOUT_FILENO);
+	close(STDERR_FILENO);
+
+	// Redirect stdin, stdout, stderr to /dev/null (this relies on them mapping to
+	// the lowest numbered file descriptors).
+	open("dev/null", O_RDWR);
+	open("dev/null", O_RDWR);
+	open("dev/null", O_RDWR);
+
+	return true;
+}
+
+// Create directories and potentially files needed.
+//
+static bool SetupEnvironment()
+{
+	// Get the home directory.
+	auto* homeDirectory = getenv("SANDMAN_ROOT");
+
+	if (homeDirectory == nullptr)
+	{
+		homeDirectory = getenv("HOME");
+	}
+
+	if (homeDirectory == nullptr)
+	{
+		homeDirectory = getpwuid(getuid())->pw_dir;
+
+		if (homeDirectory == nullptr)
+		{
+			return false;
+		}
+	}
+
+	// Create the base directory if needed.
+	std::string baseDirectory = std::string(homeDirectory) + "/.sandman/";
+	
+	if (std::filesystem::exists(baseDirectory) == false)
+	{
+		if (std::filesystem::create_directory(baseDirectory) == false)
+		{
+			printf("Directory \"%s\" doesn't exist and failed to create it!", baseDirectory.c_str());
+			return false;
+		}
+	}
+
+	s_baseDirectory = baseDirectory;
+
+	return true;
+}
+
+// Initialize program components.
+//
+// returns:		True for success, false otherwise.
+//
+static bool Initialize()
+{
+	if (SetupEnvironment() == false)
+	{
+		return false;
+	}
+
+	switch (s_programMode)
+	{
+		case kProgramModeDaemon:
+		{
+			if (InitializeDaemon() == false)
+			{
+				return false;
+			}
+		}
+		break;
+
+		case kProgramModeDocker:
+		{
+			// Initialize logging.
+			if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
+			{
+				s_exitCode = 1;
+				return false;
+			}
+		}
+		break;
+
+		case kProgramModeInteractive:
+		{
+			// Initialize logging.
+			if (Logger::Initialize(s_baseDirectory + "sandman.log") == false)
+			{
+				s_exitCode = 1;
+				return false;
+			}
+
+			Shell::Initialize();
+			Logger::SetEchoToScreen(true);
+		}
+		break;
+
+		default:
+		{
+			std::printf("Undefined program mode!");
+		}
+		return false;
+	};
+
+	// Initialize the event loop.
+	if (EventLoopInitialize() == false)
+	{
+		s_exitCode = 1;
+		return false;
+	}
+
+	Config config;
+
+	// Read the config.
+	std::string configFilename = s_baseDirectory + "sandman.conf";
+	if (config.ReadFromFile(configFilename.c_str()) == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Using default configuration."));
+	}
+
+	// Initialize MQTT.
+	if (MQTTInitialize(s_scheduler) == false)
+	{
+		s_exitCode = 1;
+		return false;
+	}
+
+	// Initialize GPIO.
+	static constexpr bool kEnableGPIO = true;
+	GPIOInitialize(kEnableGPIO, config.GetSimulateGPIO());
+	s_gpioTimelineFormat = config.GetGPIOTimelineFormat();
+
+	// Initialize controls. If they will run on their own thread, their timers must be too.
+	auto const& controlThreadConfig = config.GetControlThreadConfig();
+	auto& controlsScheduler = (controlThreadConfig.m_enabled == true) ?
+		ControlThreadGetScheduler() : s_scheduler;
+	ControlsInitialize(config.GetControlConfigs(), controlsScheduler);
+
+	// Set control durations.
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+
+	// Keep the power supply from being overloaded.
+	Control::SetMoveLimits(config.GetControlMaxMovingControls(),
+								  config.GetControlStartStaggerMS());
+
+	// Enable all controls.
+	Control::Enable(true);
+
+	// Controls have been initialized.
+	s_controlsInitialized = true;
+
+	// Start running the controls on their own thread.
+	if (controlThreadConfig.m_enabled == true)
+	{
+		if (ControlThreadStart(controlThreadConfig) == false)
+		{
+			s_exitCode = 1;
+			return false;
+		}
+	}
+
+	// Initialize the input device.
+	s_inputManager.Initialize(config.GetInputDeviceConfigs(), s_scheduler);
+
+	// Initialize the routines.
+	RoutinesInitialize(s_baseDirectory, s_scheduler);
+
+	// Initialize reports.
+	ReportsInitialize(s_baseDirectory);
+
+	// Initialize the commands.
+	CommandInitialize(s_inputManager, s_scheduler);
+
+	// Initialize the status, for replies.
+	StatusInitialize(s_inputManager);
+
+	// Let local programs read the status of the daemon straight from memory.
+	if (s_programMode == kProgramModeDaemon)
+	{
+		auto const statusPageFileName = s_baseDirectory + "sandman.status";
+		StatusPageInitialize(statusPageFileName.c_str(), s_inputManager, s_scheduler);
+	}
+
+	NotificationPlay("initialized");
+
+	return true;
+}
+
+// Uninitialize program components.
+//
+static void Uninitialize()
+{
+	// Close any connections that are still open, and stop listening for more.
+	SocketServerUninitialize();
+
+	// Uninitialize the status.
+	StatusPageUninitialize();
+	StatusUninitialize();
+
+	// Uninitialize the commands.
+	CommandUninitialize();
+
+	// Uninitialize reports.
+	ReportsUninitialize();
+
+	// Uninitialize the routines.
+	RoutinesUninitialize();
+
+	// Uninitialize MQTT.
+	MQTTUninitialize();
+
+	if (s_controlsInitialized == true)
+	{
+		// Stop the control thread, so that nothing else touches the controls.
+		ControlThreadStop();
+
+		// Disable all controls.
+		Control::Enable(false);
+
+		// Uninitialize controls.
+		ControlsUninitialize();
+	}
+
+	// Keep what the relays would have done.
+	if (GPIOIsSimulated() == true)
+	{
+		auto const timelineFileName = s_baseDirectory + ((s_gpioTimelineFormat ==
+			kGPIOTimelineFormatCSV) ? "gpio_timeline.csv" : "gpio_timeline.json");
+		GPIOWriteTimeline(timelineFileName.c_str(), s_gpioTimelineFormat);
+	}
+
+	// Uninitialize GPIO.
+	GPIOUninitialize();
+
+	// Uninitialize the input.
+	s_inputManager.Uninitialize();
+
+	// Uninitialize the event loop.
+	EventLoopUninitialize();
+
+	// Uninitialize logging.
+	Logger::Uninitialize();
+
+	if (s_programMode == kProgramModeInteractive)
+	{
+		Shell::Uninitialize();
+	}
+}
+
+// Handle a command that was received from a connection, and reply with what came of it and the
+// current status, as one line of JSON. The state of each control is only included for status
+// commands, and only as many as fit in a reply.
+//
+// connectionID:	The connection that sent the command.
+// command:			The command.
+//
+static void HandleSocketCommand(SocketServerConnectionID const connectionID,
+	std::string_view const command)
+{
+	Logger::WriteLine("Received \"", command, "\" from connection ", connectionID, ".");
+
+	Time startTime;
+	TimerGetCurrent(startTime);
+
+	rapidjson::StringBuffer replyBuffer;
+	StatusJSONWriter replyWriter(replyBuffer);
+	replyWriter.StartObject();
+
+	// Whether the command asked for the state of each control.
+	auto statusRequested = false;
+
+	// Handle the message, if necessary.
+	if (command == "shutdown")
+	{
+		s_quitRequested = true;
+
+		replyWriter.Key("result");
+		replyWriter.String("shutdown");
+	}
+	// Start or stop streaming events to the connection. Events follow this reply.
+	else if (command == "subscribe")
+	{
+		StatusSubscribe(connectionID);
+
+		replyWriter.Key("result");
+		replyWriter.String("subscribed");
+	}
+	else if (command == "unsubscribe")
+	{
+		StatusUnsubscribe(connectionID);
+
+		replyWriter.Key("result");
+		replyWriter.String("unsubscribed");
+	}
+	else
+	{
+		// Parse a command.
+
+		// Tokenize the message.
+		CommandTokenBuffer commandTokens;
+		CommandTokenizeString(commandTokens, command);
+
+		// Parse command tokens.
+		CommandResult result;
+		CommandParseTokens(result, commandTokens);
+
+		StatusWriteCommandResultJSON(replyWriter, result);
+
+		statusRequested = std::any_of(result.m_items.begin(),
+			result.m_items.begin() + result.m_count, [](CommandResultItem const& item)
+			{
+				return item.m_type == CommandResultItem::kTypeStatus;
+			});
+	}
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	// How long the command took to handle.
+	replyWriter.Key("durationUS");
+	replyWriter.Int64(std::chrono::duration_cast<Microseconds>(currentTime - startTime).count());
+
+	StatusWriteJSON(replyWriter);
+
+	// Leave room for the newline.
+	if (statusRequested == true)
+	{
+		StatusWriteControlsJSON(replyWriter, replyBuffer, kSocketServerMaxReplySize - 1u,
+			currentTime);
+	}
+
+	replyWriter.EndObject();
+
+	// There is always room for a reply this size, so the client is never left waiting for one.
+	if (replyBuffer.GetSize() >= kSocketServerMaxReplySize)
+	{
+		Logger::WriteLine(Shell::Yellow("The reply to connection "), connectionID,
+								Shell::Yellow(" was too long to send."));
+
+		replyBuffer.Clear();
+		replyWriter.Reset(replyBuffer);
+		replyWriter.StartObject();
+		replyWriter.Key("result");
+		replyWriter.String("reply too long");
+		replyWriter.EndObject();
+	}
+
+	replyBuffer.Put('\n');
+
+	if (SocketServerSend(connectionID, std::string_view(replyBuffer.GetString(),
+		replyBuffer.GetSize())) == false)
+	{
+		Logger::WriteLine(Shell::Yellow("Unable to reply to connection "), connectionID,
+								Shell::Yellow("."));
+	}
+}
+
+// Handle keys that the user has typed into the shell.
+//
+static void ProcessShellInput()
+{
+	ProfilerScope const profilerScope(kProfilerStageShell);
+
+	Shell::Lock const lock;
+	Shell::InputWindow::Result const result{ Shell::InputWindow::ProcessPendingUserKeys() };
+
+	if (result == Shell::InputWindow::Result::kRequestToQuit)
+	{
+		s_quitRequested = true;
+	}
+}
+
+// Start watching the file descriptors that the program mode needs to respond to.
+//
+// Returns:	True on success, false on failure.
+//
+static bool WatchProgramModeFileDescriptors()
+{
+	switch (s_programMode)
+	{
+		case kProgramModeDaemon:
+		{
+			// Listen for commands on a Unix domain socket.
+			auto const socketFileName = s_baseDirectory + "sandman.sock";
+			return SocketServerInitialize(socketFileName.c_str(), HandleSocketCommand);
+		}
+
+		case kProgramModeInteractive:
+		{
+			return EventLoopAddFileDescriptor(STDIN_FILENO, ProcessShellInput);
+		}
+
+		default:
+		{
+		}
+		break;
+	}
+
+	return true;
+}
+
+// Let the main loop sleep until the next timer expires.
+//
+static void UpdateEventLoopTimeout()
+{
+	Time deadline;
+
+	// If there are no timers, there is nothing to do until something happens.
+	if (s_scheduler.GetNextDeadline(deadline) == false)
+	{
+		EventLoopClearTimeout();
+		return;
+	}
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	// Round up, so that we never wake up just before the deadline.
+	auto timeoutMS = 0u;
+
+	if (currentTime < deadline)
+	{
+		timeoutMS = static_cast<unsigned int>(std::chrono::ceil<Milliseconds>(deadline -
+			currentTime).count());
+	}
+
+	EventLoopSetTimeout(timeoutMS);
+}
+
+// Wait for the daemon to reply to a message.
+//
+// reply:				(Output) The reply, without the newline.
+// sendingSocket:		The socket the message was sent on.
+//
+// Returns:	True if a whole reply was received, false if there was an error or it took too long.
+//
+static bool ReceiveReplyFromDaemon(std::string& reply, int const sendingSocket)
+{
+	// Give up on any single receive that takes too long.
+	timeval timeout = {};
+	timeout.tv_sec = kDaemonReplyTimeoutMS / 1'000u;
+	timeout.tv_usec = (kDaemonReplyTimeoutMS % 1'000u) * 1'000u;
+
+	if (setsockopt(sendingSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0)
+	{
+		return false;
+	}
+
+	reply.clear();
+
+	while (true)
+	{
+		static constexpr std::size_t kReceiveBufferCapacity{ 1'024u };
+		char receiveBuffer[kReceiveBufferCapacity];
+
+		auto const receivedByteCount = recv(sendingSocket, receiveBuffer, kReceiveBufferCapacity, 0);
+
+		if (receivedByteCount <= 0)
+		{
+			return false;
+		}
+
+		reply.append(receiveBuffer, static_cast<std::size_t>(receivedByteCount));
+
+		// The reply is a single line.
+		auto const lineEnd = reply.find('\n');
+
+		if (lineEnd != std::string::npos)
+		{
+			reply.resize(lineEnd);
+			return true;
+		}
+	}
+}
+
+// Connect to the daemon process.
+//
+// sendingSocket:	(Output) The connected socket, which must be closed when done.
+//
+// Returns:	True if connected, false otherwise.
+//
+static bool ConnectToDaemon(int& sendingSocket)
+{
+	// Create a sending socket.
+	sendingSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (sendingSocket < 0)
+	{
+		std::printf("Failed to create sending socket.\n");
+		return false;
+	}
+
+	sockaddr_un sendingAddress;
+	{
+		std::string const socketFilename = s_baseDirectory + "sandman.sock";
+
+		sendingAddress.sun_family = AF_UNIX;
+		std::strncpy(sendingAddress.sun_path, socketFilename.c_str(),
+						 sizeof(sendingAddress.sun_path) - 1);
+	}
+
+	// Attempt to connect to the daemon.
+	if (connect(sendingSocket, reinterpret_cast<sockaddr*>(&sendingAddress),
+					sizeof(sockaddr_un)) < 0)
+	{
+		std::printf("Failed to connect to the daemon.\n");
+		close(sendingSocket);
+		return false;
+	}
+
+	return true;
+}
+
+// Send a message to the daemon process, and print its reply.
+//
+// message:	The message to send.
+//
+static void SendMessageToDaemon(char const* message)
+{
+	int sendingSocket = -1;
+
+	if (ConnectToDaemon(sendingSocket) == false)
+	{
+		s_exitCode = 1;
+		return;
+	}
+
+	// Send the message. The daemon handles a command once it has received the newline.
+	std::string const line = std::string(message) + "\n";
+
+	if (send(sendingSocket, line.c_str(), line.size(), 0) < 0)
+	{
+		std::printf("Failed to send \"%s\" message to the daemon.\n", message);
+		s_exitCode = 1;
+		close(sendingSocket);
+		return;
+	}
+
+	// Nothing else will be sent, which lets the daemon close the connection after replying.
+	shutdown(sendingSocket, SHUT_WR);
+
+	std::string reply;
+
+	if (ReceiveReplyFromDaemon(reply, sendingSocket) == false)
+	{
+		std::printf("No reply from the daemon to \"%s\" message.\n", message);
+		s_exitCode = 1;
+		close(sendingSocket);
+		return;
+	}
+
+	std::printf("%s\n", reply.c_str());
+
+	// Let scripts tell whether the message did anything.
+	rapidjson::Document replyDocument;
+	replyDocument.Parse(reply.c_str());
+
+	auto const succeeded = (replyDocument.IsObject() == true) &&
+		(replyDocument.HasMember("result") == true) &&
+		(replyDocument["result"].IsString() == true) &&
+		((std::strcmp(replyDocument["result"].GetString(), "success") == 0) ||
+		 (std::strcmp(replyDocument["result"].GetString(), "shutdown") == 0));
+
+	if (succeeded == false)
+	{
+		s_exitCode = 1;
+	}
+
+	// Close the connection.
+	close(sendingSocket);
+}
+
+// Subscribe to the daemon's events, and print each one as it arrives, until the daemon goes away.
+//
+static void SubscribeToDaemon()
+{
+	int sendingSocket = -1;
+
+	if (ConnectToDaemon(sendingSocket) == false)
+	{
+		s_exitCode = 1;
+		return;
+	}
+
+	static constexpr char const kSubscribeLine[] = "subscribe\n";
+
+	if (send(sendingSocket, kSubscribeLine, sizeof(kSubscribeLine) - 1u, 0) < 0)
+	{
+		std::printf("Failed to subscribe to the daemon.\n");
+		s_exitCode = 1;
+		close(sendingSocket);
+		return;
+	}
+
+	// The reply and the events are already one line each, so pass them straight through.
+	while (true)
+	{
+		static constexpr std::size_t kReceiveBufferCapacity{ 4'096u };
+		char receiveBuffer[kReceiveBufferCapacity];
+
+		auto const receivedByteCount = recv(sendingSocket, receiveBuffer, kReceiveBufferCapacity, 0);
+
+		if (receivedByteCount <= 0)
+		{
+			break;
+		}
+
+		std::fwrite(receiveBuffer, 1u, static_cast<std::size_t>(receivedByteCount), stdout);
+		std::fflush(stdout);
+	}
+
+	close(sendingSocket);
+}
+
+// Handle the commandline arguments.
+//
+//	arguments:		The argument list.
+// argumentCount:	The number of arguments in the list.
+//
+// Returns:	True if the program should exit, false if it should continue.
+//
+static bool HandleCommandLine(char const* const* const arguments, unsigned int const argumentCount)
+{
+	for (unsigned int argumentIndex = 0; argumentIndex < argumentCount; argumentIndex++)
+	{
+		auto const* argument = arguments[argumentIndex];
+
+		// Start as a daemon?
+		if (std::strcmp(argument, "--daemon") == 0)
+		{
+			s_programMode = kProgramModeDaemon;
+			break;
+		}
+		// Start as docker?
+		else if (std::strcmp(argument, "--docker") == 0)
+		{
+			s_programMode = kProgramModeDocker;
+			break;
+		}
+		else if (std::strcmp(argument, "--shutdown") == 0)
+		{
+			SendMessageToDaemon("shutdown");
+			return true;
+		}
+		else if (std::strcmp(argument, "--subscribe") == 0)
+		{
+			SubscribeToDaemon();
+			return true;
+		}
+		else
+		{
+			// We are going to see if there is a command to send to the daemon.
+			static constexpr char const* kCommandPrefix = "--command=";
+
+			auto const* commandStringStart = std::strstr(argument, kCommandPrefix);
+
+			if (commandStringStart != nullptr)
+			{
+				// Skip the command prefix.
+				commandStringStart += std::strlen(kCommandPrefix);
+
+				static constexpr std::size_t kCommandBufferCapacity{ 100u };
+				char commandBuffer[kCommandBufferCapacity];
+
+				static_assert(kCommandBufferCapacity >= 1u);
+
+				// Copy only the actual command.
+				std::strncpy(commandBuffer, commandStringStart, kCommandBufferCapacity - 1u);
+				commandBuffer[kCommandBufferCapacity - 1] = '\0';
+
+				// Replace '_' with ' '.
+				auto* currentCharacter = commandBuffer;
+
+				while (*currentCharacter != '\0')
+				{
+					if (*currentCharacter == '_')
+					{
+						*currentCharacter = ' ';
+					}
+
+					currentCharacter++;
+				}
+
+				// Send the command to the daemon.
+				SendMessageToDaemon(commandBuffer);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+int main(int const argc, char const* const* const argv)
+{
+	// Deal with command line arguments.
+	if (HandleCommandLine(argv, argc) == true)
+	{
+		return s_exitCode;
+	}
+
+	// Initialization.
+	if (Initialize() == false)
+	{
+		Uninitialize();
+		return s_exitCode;
+	}
+
+	// Start watching for things to respond to.
+	if (WatchProgramModeFileDescriptors() == false)
+	{
+		Logger::WriteLine(Shell::Red("Failed to watch for program events."));
+		s_exitCode = 1;
+		Uninitialize();
+		return s_exitCode;
+	}
+
+	while (s_quitRequested == false)
+	{
+		if (s_programMode == kProgramModeInteractive)
+		{
+			Shell::Lock const lock;
+			Shell::CheckResize();
+		}
+
+		// Take one snapshot of the time for everything processed during this tick.
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		// Call the functions for any timers that have expired.
+		{
+			ProfilerScope const profilerScope(kProfilerStageTimers);
+			s_scheduler.Process(currentTime);
+		}
+
+		// Process MQTT.
+		{
+			ProfilerScope const profilerScope(kProfilerStageMQTT);
+			MQTTProcess();
+		}
+
+		// Process commands from socket connections.
+		{
+			ProfilerScope const profilerScope(kProfilerStageSocket);
+			SocketServerProcess();
+		}
+
+		// Process command.
+		{
+			ProfilerScope const profilerScope(kProfilerStageCommand);
+			CommandProcess(currentTime);
+		}
+
+		// Process controls.
+		{
+			ProfilerScope const profilerScope(kProfilerStageControls);
+
+			// The control thread processes the controls itself, when it is running.
+			if (ControlThreadIsRunning() == false)
+			{
+				ControlsProcess(currentTime);
+			}
+
+			ControlsDispatchEvents();
+		}
+
+		// Send status changes to subscribers.
+		{
+			ProfilerScope const profilerScope(kProfilerStageSocket);
+			StatusProcess();
+		}
+
+		// Process the reports.
+		{
+			ProfilerScope const profilerScope(kProfilerStageReports);
+			ReportsProcess();
+		}
+
+		// Record how long this tick took, including anything handled while waking up.
+		ProfilerEndTick();
+
+		// Publish the status for local programs, including how long this tick took.
+		StatusPageUpdate(currentTime);
+
+		// Sleep until there is something to do. Anything that is ready will be handled in here.
+		UpdateEventLoopTimeout();
+
+		// Don't sleep if there are socket commands left over from this tick.
+		if (SocketServerHasPendingCommands() == true)
+		{
+			EventLoopSetTimeout(0u);
+		}
+
+		EventLoopWait();
+	}
+
+	Logger::WriteLine("Uninitializing.");
+
+	// Cleanup.
+	Uninitialize();
+	return s_exitCode;
+}
@@ -1,5 +1,6 @@
 #include "mqtt.h"
 
+#include <atomic>
 #include <mutex>
 #include <unistd.h>
 
@@ -7,13 +8,18 @@
 #include "rapidjson/document.h"
 
 #include "command.h"
+#include "event_loop.h"
 #include "logger.h"
+#include "status.h"
 
 #define DATADIR		AM_DATADIR
 
 // Constants
 //
 
+// How long to wait before reattempting the first notification (in milliseconds).
+static constexpr unsigned int kFirstNotificationReattemptDelayMS{ 5'000u };
+
 // Types
 //
 
@@ -33,8 +39,8 @@ struct MessageInfo
 // The client instance.
 static mosquitto* s_mosquittoClient = nullptr;
 
-// Track whether we are connected to the host.
-static bool s_connectedToHost = false;
+// Track whether we are connected to the host. This is set from the MQTT thread.
+static std::atomic<bool> s_connectedToHost{ false };
 
 // Keep track of whether we have ever seen text-to-speech finish.
 static bool s_firstTextToSpeechFinished = false;
@@ -60,6 +66,16 @@ static std::string s_dialogueManagerSessionID;
 // If we have command tokens awaiting confirmation, store them here.
 static std::vector<CommandToken> s_commandTokensPendingConfirmation;
 
+// Used to reattempt the first notification.
+static Scheduler* s_scheduler = nullptr;
+
+// We use this to tell not only when we are attempting the first notification for the very first
+// time, but to prevent us from double posting the first notification after we succeed.
+static std::string s_firstNotification = "";
+
+// The timer that will reattempt the first notification.
+static Scheduler::TimerID s_firstNotificationReattemptTimerID = Scheduler::kInvalidTimerID;
+
 // Functions
 //
 
@@ -101,12 +117,32 @@ void OnConnectCallback(mosquitto* mosquittoClient, void* /* userData */, int ret
 	}
 
 	s_connectedToHost = true;
+	StatusRecordMQTTConnection(true);
 	Logger::WriteLine("Connected to MQTT host.");
 
 	// Subscribe to the relevant topics.
 	MQTTSubscribeTopic(mosquittoClient, "hermes/intent/#");
 	MQTTSubscribeTopic(mosquittoClient, "hermes/tts/#");
 	MQTTSubscribeTopic(mosquittoClient, "hermes/dialogueManager/#");
+
+	// Let the main loop know that it can publish anything that is pending.
+	EventLoopWake();
+}
+
+// Handles losing the connection.
+//
+// mosquittoClient:	The client instance that disconnected.
+// userData:				The user data associated with the client instance.
+// returnCode:			Zero if the disconnection was asked for, otherwise it was unexpected.
+//
+void OnDisconnectCallback(mosquitto* /* mosquittoClient */, void* /* userData */, int returnCode)
+{
+	s_connectedToHost = false;
+	StatusRecordMQTTConnection(false);
+	Logger::WriteLine("Disconnected from MQTT host with return code ", returnCode, ".");
+
+	// Let the main loop know that the connection has changed.
+	EventLoopWake();
 }
 
 // Handles message for a subscribed topic.
@@ -129,6 +165,9 @@ void OnMessageCallback(mosquitto* /* mosquittoClient */, void* /* userData */,
 
 		// Record this time.
 		TimerGetCurrent(s_lastTextToSpeechFinishedTime);
+
+		// Held back notifications and a pending reboot may now be able to proceed.
+		EventLoopWake();
 	}
 
 	// Helper lambda to save a message to process later.
@@ -142,6 +181,9 @@ void OnMessageCallback(mosquitto* /* mosquittoClient */, void* /* userData */,
 		messageObject.m_payload = payloadString;
 
 		s_receivedMessageList.push_back(messageObject);
+
+		// Let the main loop know that there is a message to process.
+		EventLoopWake();
 	};
 
 	// Only save certain messages to process later.
@@ -160,10 +202,13 @@ void OnMessageCallback(mosquitto* /* mosquittoClient */, void* /* userData */,
 
 // Initialize MQTT.
 //
-bool MQTTInitialize()
+// scheduler:	Used to reattempt the first notification.
+//
+bool MQTTInitialize(Scheduler& scheduler)
 {
 	Logger::WriteLine("Initializing MQTT support...");
 
+	s_scheduler = &scheduler;
 	s_connectedToHost = false;
 	s_firstTextToSpeechFinished = false;
 	s_dialogueManagerSessionID = "";
@@ -200,6 +245,7 @@ bool MQTTInitialize()
 
 	// Set some necessary callbacks.
 	mosquitto_connect_callback_set(s_mosquittoClient, OnConnectCallback);
+	mosquitto_disconnect_callback_set(s_mosquittoClient, OnDisconnectCallback);
 	mosquitto_message_callback_set(s_mosquittoClient, OnMessageCallback);
 
 	Logger::WriteLine("Connecting to MQTT host...");
@@ -210,6 +256,9 @@ bool MQTTInitialize()
 	
 	Time connectStartTime;
 	TimerGetCurrent(connectStartTime);
+
+	// Attempt for five minutes at most.
+	static constexpr Seconds kTimeoutDuration{ 5 * 60 };
 		
 	while (connected == false)
 	{
@@ -229,13 +278,7 @@ bool MQTTInitialize()
 		Time connectCurrentTime;
 		TimerGetCurrent(connectCurrentTime);
 		
-		float const durationMS = TimerGetElapsedMilliseconds(connectStartTime, connectCurrentTime);
-		auto const durationSeconds = static_cast<unsigned long>(durationMS) / 1'000;
-		
-		// Attempt for five minutes at most.
-		static constexpr unsigned long kTimeoutDurationSeconds = 5 * 60;
-		
-		if (durationSeconds >= kTimeoutDurationSeconds)
+		if ((connectCurrentTime - connectStartTime) >= kTimeoutDuration)
 		{
 			break;
 		}
@@ -263,6 +306,12 @@ bool MQTTInitialize()
 //
 void MQTTUninitialize()
 {
+	if (s_scheduler != nullptr)
+	{
+		s_scheduler->CancelTimer(s_firstNotificationReattemptTimerID);
+		s_scheduler = nullptr;
+	}
+
 	if (s_mosquittoClient != nullptr)
 	{
 		// Stop any processing that may have been occurring in another thread.
@@ -503,6 +552,28 @@ static void MQTTPublishNotification(std::string const& text)
 	MQTTPublishMessage(topic, messageBuffer);
 }
 
+// Publish the first notification again and schedule another attempt, in case this one doesn't
+// play either.
+//
+// currentTime:	The time of the current tick.
+//
+static void MQTTReattemptFirstNotification(Time const& /* currentTime */)
+{
+	s_firstNotificationReattemptTimerID = Scheduler::kInvalidTimerID;
+
+	// The main loop may not have caught up with the first notification finishing yet.
+	if (s_firstTextToSpeechFinished == true)
+	{
+		return;
+	}
+
+	MQTTPublishNotification(s_firstNotification);
+	s_firstNotificationReattemptTimerID = s_scheduler->AddTimer(kFirstNotificationReattemptDelayMS,
+		MQTTReattemptFirstNotification);
+
+	Logger::WriteLine("Reattempted first notification.");
+}
+
 // Process MQTT.
 //
 void MQTTProcess()
@@ -534,6 +605,8 @@ void MQTTProcess()
 
 		if (s_firstTextToSpeechFinished == true)
 		{
+			s_scheduler->CancelTimer(s_firstNotificationReattemptTimerID);
+
 			// If we have successfully started playing notifications, go ahead and post the rest.
 			for (auto const& pendingNotification : s_pendingNotificationList)
 			{
@@ -543,50 +616,29 @@ void MQTTProcess()
 			// Get rid of the pending notifications. 
 			s_pendingNotificationList.clear();
 		}
-		else
+		else if ((s_firstNotification.compare("") == 0) && (s_pendingNotificationList.size() > 0))
 		{
-			// We use this to tell not only when we are attempting the first notification for the very 
-			// first time, but to prevent us from double posting the first notification after we 
-			//succeed.
-			static std::string s_firstNotification = "";
-
-			static Time s_lastAttemptTime;
+			// Pull the first notification off and store it separately.
+			s_firstNotification = s_pendingNotificationList[0];
+			s_pendingNotificationList.erase(s_pendingNotificationList.begin());
 
-			if ((s_firstNotification.compare("") == 0) && (s_pendingNotificationList.size() > 0))
-			{
-				// Pull the first notification off and store it separately.
-				s_firstNotification = s_pendingNotificationList[0];
-				s_pendingNotificationList.erase(s_pendingNotificationList.begin());
-
-				// Make our first attempt.
-				MQTTPublishNotification(s_firstNotification);
-				TimerGetCurrent(s_lastAttemptTime);
+			// Make our first attempt.
+			MQTTPublishNotification(s_firstNotification);
+			s_firstNotificationReattemptTimerID = s_scheduler->AddTimer(
+				kFirstNotificationReattemptDelayMS, MQTTReattemptFirstNotification);
 
-				Logger::WriteLine("Attempted first notification.");
-			}
-
-			// See if enough time has passed since our last attempt.
-			Time currentTime;
-			TimerGetCurrent(currentTime);
-
-			auto const durationMS = TimerGetElapsedMilliseconds(s_lastAttemptTime, currentTime);
-			auto const durationSeconds = static_cast<unsigned long>(durationMS) / 1'000;
-
-			static constexpr unsigned long kReattemptTimeSeconds = 5;
-
-			if ((s_firstNotification.compare("") != 0) && 
-				(durationSeconds >= kReattemptTimeSeconds))
-			{
-				// If so, reattempt the notification.
-				MQTTPublishNotification(s_firstNotification);
-				TimerGetCurrent(s_lastAttemptTime);
-
-				Logger::WriteLine("Reattempted first notification.");
-			}
+			Logger::WriteLine("Attempted first notification.");
 		}
 	}
 }
 
+// Determine whether there is a connection to the MQTT host.
+//
+bool MQTTIsConnected()
+{
+	return s_connectedToHost;
+}
+
 // Generates and publishes a message to cause the provided text to be spoken.
 //
 // text:	The text that should be spoken.
@@ -613,6 +665,9 @@ void MQTTTextToSpeech(std::string const& text)
 void MQTTNotification(std::string const& text)
 {
 	s_pendingNotificationList.push_back(text);
+
+	// Make sure the main loop gets around to posting it.
+	EventLoopWake();
 }
 
 // Get the time that the last text-to-speech finished.
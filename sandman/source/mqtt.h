@@ -2,6 +2,7 @@
 
 #include <string>
 
+#include "scheduler.h"
 #include "timer.h"
 
 // Functions
@@ -9,7 +10,9 @@
 
 // Initialize MQTT.
 //
-bool MQTTInitialize();
+// scheduler:	Used to reattempt the first notification.
+//
+bool MQTTInitialize(Scheduler& scheduler);
 
 // Uninitialize MQTT.
 //
@@ -19,6 +22,10 @@ void MQTTUninitialize();
 //
 void MQTTProcess();
 
+// Determine whether there is a connection to the MQTT host.
+//
+bool MQTTIsConnected();
+
 // Generates and publishes a message to cause the provided text to be spoken.
 //
 // text:	The text that should be spoken.
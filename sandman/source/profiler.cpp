@@ -0,0 +1,310 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <vector>
+
+#include "logger.h"
+
+// Constants
+//
+
+// A tick taking longer than this is logged. This is the tick length of the old 60 Hz loop.
+static constexpr Nanoseconds kTickBudget{ Milliseconds(1'000) / 60 };
+
+// Names for the stages.
+static constexpr char const* kProfilerStageNames[] =
+{
+	"timers",	// kProfilerStageTimers
+	"mqtt",		// kProfilerStageMQTT
+	"command",	// kProfilerStageCommand
+	"controls",	// kProfilerStageControls
+	"input",		// kProfilerStageInput
+	"reports",	// kProfilerStageReports
+	"socket",	// kProfilerStageSocket
+	"shell",		// kProfilerStageShell
+};
+
+static_assert(std::size(kProfilerStageNames) == kNumProfilerStages);
+
+// Locals
+//
+
+// Whether any time has been added to the current tick.
+static bool s_tickStarted = false;
+
+// When the current tick started.
+static Time s_tickStartTime;
+
+// The time spent in each stage during the current tick.
+static std::array<Nanoseconds, kNumProfilerStages> s_tickStageTimes;
+
+// Whether each stage has run during the current tick.
+static std::array<bool, kNumProfilerStages> s_tickStagesRan;
+
+// Recent samples for each stage.
+static std::array<ProfilerSampleWindow, kNumProfilerStages> s_stageSampleWindows;
+
+// Recent samples for whole ticks.
+static ProfilerSampleWindow s_tickSampleWindow;
+
+// Running counts for whole ticks.
+static ProfilerTickCounters s_tickCounters;
+
+// Functions
+//
+
+// Convert a duration to milliseconds for display.
+//
+// duration:	The duration to convert.
+//
+// Returns:	The duration in milliseconds.
+//
+static double ProfilerToMilliseconds(Nanoseconds duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Write statistics to the logger.
+//
+// name:			What the statistics are for.
+// statistics:	The statistics.
+//
+void ProfilerLogStatisticsLine(char const* name, ProfilerStatistics const& statistics)
+{
+	Logger::WriteLine(std::fixed, std::setprecision(3),
+							"\t", std::left, std::setw(10), name, std::right,
+							" min ", ProfilerToMilliseconds(statistics.m_minimum),
+							" avg ", ProfilerToMilliseconds(statistics.m_average),
+							" p99 ", ProfilerToMilliseconds(statistics.m_99thPercentile),
+							" max ", ProfilerToMilliseconds(statistics.m_maximum),
+							" ms (", statistics.m_sampleCount, " samples)",
+
+							/* Restore the default formatting. */
+							std::defaultfloat, std::setprecision(6));
+}
+
+// ProfilerSampleWindow members
+
+// Add a sample.
+//
+// sample:	The sample to add.
+//
+void ProfilerSampleWindow::Add(Nanoseconds sample)
+{
+	m_samples[m_nextSampleIndex] = sample;
+	m_nextSampleIndex = (m_nextSampleIndex + 1u) % kCapacity;
+	m_sampleCount = std::min(m_sampleCount + 1u, kCapacity);
+}
+
+// Calculate statistics over the samples.
+//
+// statistics:	(Output) The statistics.
+//
+void ProfilerSampleWindow::GetStatistics(ProfilerStatistics& statistics) const
+{
+	statistics = ProfilerStatistics();
+	statistics.m_sampleCount = m_sampleCount;
+
+	if (m_sampleCount == 0u)
+	{
+		return;
+	}
+
+	std::vector<Nanoseconds> sortedSamples(m_samples.begin(), m_samples.begin() + m_sampleCount);
+	std::sort(sortedSamples.begin(), sortedSamples.end());
+
+	Nanoseconds total{ 0 };
+
+	for (auto const sample : sortedSamples)
+	{
+		total += sample;
+	}
+
+	// The smallest sample that at least 99% of the samples are no larger than.
+	auto const percentileIndex = ((m_sampleCount * 99u) + 99u) / 100u - 1u;
+
+	statistics.m_minimum = sortedSamples.front();
+	statistics.m_average = total / m_sampleCount;
+	statistics.m_99thPercentile = sortedSamples[percentileIndex];
+	statistics.m_maximum = sortedSamples.back();
+}
+
+// Forget all samples.
+//
+void ProfilerSampleWindow::Clear()
+{
+	m_nextSampleIndex = 0u;
+	m_sampleCount = 0u;
+}
+
+// ProfilerScope members
+
+// Start measuring a stage.
+//
+// stage:	The stage being measured.
+//
+ProfilerScope::ProfilerScope(ProfilerStage stage)
+	: m_stage(stage)
+{
+	TimerGetCurrent(m_startTime);
+
+	// The tick starts when its first stage does, so time spent waiting for events isn't counted.
+	if (s_tickStarted == false)
+	{
+		s_tickStarted = true;
+		s_tickStartTime = m_startTime;
+	}
+}
+
+// Stop measuring the stage and add the time to the current tick.
+//
+ProfilerScope::~ProfilerScope()
+{
+	Time endTime;
+	TimerGetCurrent(endTime);
+
+	ProfilerAddStageTime(m_stage, endTime - m_startTime);
+}
+
+// Add time spent in a stage to the current tick. The tick starts with the first time added to it.
+//
+// stage:		The stage the time was spent in.
+// duration:	How long was spent.
+//
+void ProfilerAddStageTime(ProfilerStage stage, Nanoseconds duration)
+{
+	if (s_tickStarted == false)
+	{
+		s_tickStarted = true;
+		TimerGetCurrent(s_tickStartTime);
+		s_tickStartTime -= duration;
+	}
+
+	s_tickStageTimes[stage] += duration;
+	s_tickStagesRan[stage] = true;
+}
+
+// Finish the current tick, recording the time spent in each stage. If the tick went over budget, a
+// breakdown of where the time went is logged.
+//
+void ProfilerEndTick()
+{
+	if (s_tickStarted == false)
+	{
+		return;
+	}
+
+	Time endTime;
+	TimerGetCurrent(endTime);
+
+	auto const tickDuration = endTime - s_tickStartTime;
+	s_tickSampleWindow.Add(tickDuration);
+
+	s_tickCounters.m_tickCount++;
+	s_tickCounters.m_lastTickDuration = tickDuration;
+	s_tickCounters.m_maximumTickDuration = std::max(s_tickCounters.m_maximumTickDuration,
+		tickDuration);
+
+	for (unsigned int stageIndex = 0u; stageIndex < kNumProfilerStages; stageIndex++)
+	{
+		if (s_tickStagesRan[stageIndex] == true)
+		{
+			s_stageSampleWindows[stageIndex].Add(s_tickStageTimes[stageIndex]);
+		}
+	}
+
+	if (tickDuration > kTickBudget)
+	{
+		s_tickCounters.m_slowTickCount++;
+
+		// List the stages that ran, so it's clear which one was responsible.
+		std::ostringstream breakdown;
+		breakdown << std::fixed << std::setprecision(3);
+
+		for (unsigned int stageIndex = 0u; stageIndex < kNumProfilerStages; stageIndex++)
+		{
+			if (s_tickStagesRan[stageIndex] == true)
+			{
+				breakdown << ' ' << kProfilerStageNames[stageIndex] << ' ' <<
+					ProfilerToMilliseconds(s_tickStageTimes[stageIndex]) << " ms,";
+			}
+		}
+
+		Logger::WriteLine(Shell::Yellow("Slow tick: "), std::fixed, std::setprecision(3),
+								ProfilerToMilliseconds(tickDuration), " ms (budget ",
+								ProfilerToMilliseconds(kTickBudget), " ms):", breakdown.str(),
+								std::defaultfloat, std::setprecision(6));
+	}
+
+	// Get ready for the next tick.
+	s_tickStarted = false;
+	s_tickStageTimes.fill(Nanoseconds{ 0 });
+	s_tickStagesRan.fill(false);
+}
+
+// Get statistics for the time spent in a stage, over the ticks in which it ran.
+//
+// statistics:	(Output) The statistics.
+// stage:		The stage to get statistics for.
+//
+void ProfilerGetStageStatistics(ProfilerStatistics& statistics, ProfilerStage stage)
+{
+	s_stageSampleWindows[stage].GetStatistics(statistics);
+}
+
+// Get statistics for the time spent in whole ticks.
+//
+// statistics:	(Output) The statistics.
+//
+void ProfilerGetTickStatistics(ProfilerStatistics& statistics)
+{
+	s_tickSampleWindow.GetStatistics(statistics);
+}
+
+// Get the running counts for whole ticks.
+//
+// counters:	(Output) The counters.
+//
+void ProfilerGetTickCounters(ProfilerTickCounters& counters)
+{
+	counters = s_tickCounters;
+}
+
+// Write the statistics for whole ticks and each stage to the logger.
+//
+void ProfilerLogStatistics()
+{
+	Logger::WriteLine("Tick timing over the last ", ProfilerSampleWindow::kCapacity, " samples:");
+
+	ProfilerStatistics statistics;
+	ProfilerGetTickStatistics(statistics);
+	ProfilerLogStatisticsLine("tick", statistics);
+
+	for (unsigned int stageIndex = 0u; stageIndex < kNumProfilerStages; stageIndex++)
+	{
+		auto const stage = static_cast<ProfilerStage>(stageIndex);
+		ProfilerGetStageStatistics(statistics, stage);
+		ProfilerLogStatisticsLine(kProfilerStageNames[stageIndex], statistics);
+	}
+
+	Logger::WriteLine();
+}
+
+// Forget all samples.
+//
+void ProfilerReset()
+{
+	s_tickStarted = false;
+	s_tickStageTimes.fill(Nanoseconds{ 0 });
+	s_tickStagesRan.fill(false);
+
+	for (auto& sampleWindow : s_stageSampleWindows)
+	{
+		sampleWindow.Clear();
+	}
+
+	s_tickSampleWindow.Clear();
+	s_tickCounters = ProfilerTickCounters{};
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+
+#include "timer.h"
+
+// Types
+//
+
+// The stages of a tick that are measured.
+enum ProfilerStage
+{
+	kProfilerStageTimers = 0,
+	kProfilerStageMQTT,
+	kProfilerStageCommand,
+	kProfilerStageControls,
+	kProfilerStageInput,
+	kProfilerStageReports,
+	kProfilerStageSocket,
+	kProfilerStageShell,
+
+	kNumProfilerStages
+};
+
+// Statistics over the most recent samples of a stage or of whole ticks.
+struct ProfilerStatistics
+{
+	// The number of samples the statistics cover.
+	unsigned int m_sampleCount = 0u;
+
+	Nanoseconds m_minimum{ 0 };
+	Nanoseconds m_average{ 0 };
+	Nanoseconds m_99thPercentile{ 0 };
+	Nanoseconds m_maximum{ 0 };
+};
+
+// Running counts for whole ticks, which are cheap enough to read every tick.
+struct ProfilerTickCounters
+{
+	// The number of ticks that have finished.
+	unsigned long long m_tickCount = 0ull;
+
+	// The number of ticks that went over budget.
+	unsigned long long m_slowTickCount = 0ull;
+
+	// How long the last tick took.
+	Nanoseconds m_lastTickDuration{ 0 };
+
+	// How long the longest tick took.
+	Nanoseconds m_maximumTickDuration{ 0 };
+};
+
+// Holds the most recent samples, overwriting the oldest once full.
+//
+class ProfilerSampleWindow
+{
+	public:
+
+		// Constants.
+
+		// The number of recent samples that statistics are calculated over.
+		static constexpr unsigned int kCapacity{ 1'024u };
+
+		// Add a sample.
+		//
+		// sample:	The sample to add.
+		//
+		void Add(Nanoseconds sample);
+
+		// Calculate statistics over the samples.
+		//
+		// statistics:	(Output) The statistics.
+		//
+		void GetStatistics(ProfilerStatistics& statistics) const;
+
+		// Forget all samples.
+		//
+		void Clear();
+
+	private:
+
+		// The samples, oldest first once the window has wrapped.
+		std::array<Nanoseconds, kCapacity> m_samples;
+
+		// Where the next sample will be written.
+		unsigned int m_nextSampleIndex = 0u;
+
+		// How many of the samples are valid.
+		unsigned int m_sampleCount = 0u;
+};
+
+// Measures the time spent in a stage for as long as it exists.
+//
+class ProfilerScope
+{
+	public:
+
+		// Start measuring a stage.
+		//
+		// stage:	The stage being measured.
+		//
+		explicit ProfilerScope(ProfilerStage stage);
+
+		// Stop measuring the stage and add the time to the current tick.
+		//
+		~ProfilerScope();
+
+		ProfilerScope(ProfilerScope const&) = delete;
+		ProfilerScope& operator=(ProfilerScope const&) = delete;
+
+	private:
+
+		// The stage being measured.
+		ProfilerStage m_stage;
+
+		// When measuring started.
+		Time m_startTime;
+};
+
+// Functions
+//
+
+// Add time spent in a stage to the current tick. The tick starts with the first time added to it.
+//
+// stage:		The stage the time was spent in.
+// duration:	How long was spent.
+//
+void ProfilerAddStageTime(ProfilerStage stage, Nanoseconds duration);
+
+// Finish the current tick, recording the time spent in each stage. If the tick went over budget, a
+// breakdown of where the time went is logged.
+//
+void ProfilerEndTick();
+
+// Get statistics for the time spent in a stage, over the ticks in which it ran.
+//
+// statistics:	(Output) The statistics.
+// stage:		The stage to get statistics for.
+//
+void ProfilerGetStageStatistics(ProfilerStatistics& statistics, ProfilerStage stage);
+
+// Get statistics for the time spent in whole ticks.
+//
+// statistics:	(Output) The statistics.
+//
+void ProfilerGetTickStatistics(ProfilerStatistics& statistics);
+
+// Get the running counts for whole ticks.
+//
+// counters:	(Output) The counters.
+//
+void ProfilerGetTickCounters(ProfilerTickCounters& counters);
+
+// Write the statistics for whole ticks and each stage to the logger.
+//
+void ProfilerLogStatistics();
+
+// Write statistics to the logger.
+//
+// name:			What the statistics are for.
+// statistics:	The statistics.
+//
+void ProfilerLogStatisticsLine(char const* name, ProfilerStatistics const& statistics);
+
+// Forget all samples.
+//
+void ProfilerReset();
@@ -330,22 +330,29 @@ void ReportsProcess()
 	// Acquire a lock for the rest of the function.
 	const std::lock_guard<std::mutex> reportGuard(s_reportMutex);
 
-	if (s_reportFile != nullptr)
+	// Make sure we have the correct file open. The main loop may have been asleep for a long time,
+	// so this must happen before writing out items that were only just added.
+	ReportsOpenFile();
+
+	if (s_reportFile == nullptr)
 	{
-		// We are going to write out any pending items first, before we check whether we need to 
-		// switch the file.
-		for (auto const& item : s_pendingItemList)
-		{
-			ReportsWriteItem(item);
-		}
+		return;
+	}
 
-		s_pendingItemList.clear();
+	// Nothing to do if there aren't any pending items.
+	if (s_pendingItemList.empty() == true)
+	{
+		return;
+	}
 
-		fflush(s_reportFile);
+	for (auto const& item : s_pendingItemList)
+	{
+		ReportsWriteItem(item);
 	}
 
-	// Make sure we have the correct file open.
-	ReportsOpenFile();
+	s_pendingItemList.clear();
+
+	fflush(s_reportFile);
 }
 
 // Add an item to the report.
@@ -410,6 +417,43 @@ void ReportsAddControlItem(std::string const& controlName, Control::Actions cons
 	ReportsAddItem(itemBuffer.GetString());
 }
 
+// Add an item to the report corresponding to a control moving to a position.
+//
+// controlName:		The name of the control.
+// targetPercent:	The position the control is moving to.
+// sourceName:		An identifier for where this item comes from.
+//
+void ReportsAddControlPositionItem(std::string const& controlName, unsigned int targetPercent,
+											  std::string const& sourceName)
+{
+	// Make a JSON representation of this item.
+	rapidjson::Document itemDocument;
+	itemDocument.SetObject();
+
+	auto itemAllocator = itemDocument.GetAllocator();
+
+	itemDocument.AddMember("type",
+		rapidjson::Value(rapidjson::StringRef("control")), itemAllocator);
+
+	// It is safe to use a string reference here because this document will not live outside of this
+	// scope.
+	itemDocument.AddMember("control",
+		rapidjson::Value(rapidjson::StringRef(controlName.c_str())), itemAllocator);
+
+	itemDocument.AddMember("position", rapidjson::Value(targetPercent), itemAllocator);
+
+	itemDocument.AddMember("source",
+		rapidjson::Value(rapidjson::StringRef(sourceName.c_str())), itemAllocator);
+
+	// Write this into a string.
+	rapidjson::StringBuffer itemBuffer;
+	rapidjson::Writer<rapidjson::StringBuffer> itemWriter(itemBuffer);
+	itemDocument.Accept(itemWriter);
+
+	// Handle the rest.
+	ReportsAddItem(itemBuffer.GetString());
+}
+
 // Add an item to the report corresponding to a routine event.
 // 
 // actionName:	The name of the routine action.
@@ -33,6 +33,15 @@ void ReportsProcess();
 void ReportsAddControlItem(std::string const& controlName, Control::Actions const action, 
 									std::string const& sourceName);
 
+// Add an item to the report corresponding to a control moving to a position.
+//
+// controlName:		The name of the control.
+// targetPercent:	The position the control is moving to.
+// sourceName:		An identifier for where this item comes from.
+//
+void ReportsAddControlPositionItem(std::string const& controlName, unsigned int targetPercent,
+											  std::string const& sourceName);
+
 // Add an item to the report corresponding to a routine event.
 // 
 // actionName:	The name of the routine action.
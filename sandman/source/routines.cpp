@@ -6,11 +6,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <string>
 
 #include "rapidjson/filereadstream.h"
 #include "logger.h"
 #include "notification.h"
 #include "reports.h"
+#include "status.h"
 #include "timer.h"
 
 
@@ -32,8 +34,11 @@ static std::string s_routinesDirectory;
 // The current spot in the routine.
 static unsigned int s_routineIndex = UINT_MAX;
 
-// The time the delay for the next step began.
-static Time s_routineDelayStartTime;
+// Used to perform each step once its delay has passed.
+static Scheduler* s_scheduler = nullptr;
+
+// The timer that will perform the current step.
+static Scheduler::TimerID s_routineStepTimerID = Scheduler::kInvalidTimerID;
 
 static Routine s_routine;
 
@@ -181,6 +186,26 @@ std::vector<RoutineStep> const& Routine::GetSteps() const
 	return m_steps;
 }
 
+// Look up the controls for each step, so that performing a step doesn't have to. The controls must
+// have been initialized.
+//
+// Returns:		True if every control was found, false otherwise.
+//
+bool Routine::ResolveControls()
+{
+	bool allResolved = true;
+
+	for (auto& step : m_steps)
+	{
+		if (step.m_controlAction.ResolveControl() == false)
+		{
+			allResolved = false;
+		}
+	}
+
+	return allResolved;
+}
+
 // Functions
 //
 
@@ -189,7 +214,15 @@ std::vector<RoutineStep> const& Routine::GetSteps() const
 static bool RoutineLoad()
 {
 	auto const routineFile = s_routinesDirectory + "sandman.rtn";
-	return s_routine.ReadFromFile(routineFile.c_str());
+
+	if (s_routine.ReadFromFile(routineFile.c_str()) == false)
+	{
+		return false;
+	}
+
+	// A step with an unknown control is kept, since its delay still matters to the steps after it.
+	s_routine.ResolveControls();
+	return true;
 }
 
 // Write the loaded routine to the logger.
@@ -219,6 +252,15 @@ static void RoutineLogLoaded()
 		
 		auto const* actionText = (step.m_controlAction.m_action == Control::kActionMovingUp) ? 
 			"up" : "down";
+
+		// Moves to a position show the position instead.
+		std::string positionText;
+
+		if (step.m_controlAction.HasTargetPosition() == true)
+		{
+			actionText = "to ";
+			positionText = std::to_string(step.m_controlAction.m_targetPercent) + " percent";
+		}
 			
 		// Print the event.
 		Logger::WriteLine(std::setfill('0'),
@@ -229,7 +271,7 @@ static void RoutineLogLoaded()
 								std::setw(2), delayMin  , "m ",
 								std::setw(2), delaySec  , "s "
 
-								"-> ", step.m_controlAction.m_controlName, ", ", actionText,
+								"-> ", step.m_controlAction.m_controlName, ", ", actionText, positionText,
 
 								// Restore fill to space.
 								std::setfill(' ')
@@ -240,13 +282,84 @@ static void RoutineLogLoaded()
 	Logger::WriteLine();
 }
 
+static void RoutinePerformStep(Time const& currentTime);
+
+// Schedule the current step to be performed once its delay has passed.
+//
+// delayStartTime:	The time the delay for the step began.
+//
+static void RoutineScheduleStep(Time const& delayStartTime)
+{
+	// No need to do anything for routines with zero steps.
+	if (s_routine.IsEmpty() == true)
+	{
+		return;
+	}
+
+	auto const& step = s_routine.GetSteps()[s_routineIndex];
+	s_routineStepTimerID = s_scheduler->AddTimer(delayStartTime + Seconds(step.m_delaySec),
+		RoutinePerformStep);
+}
+
+// Perform the current step and schedule the next one.
+//
+// currentTime:	The time of the current tick.
+//
+static void RoutinePerformStep(Time const& currentTime)
+{
+	s_routineStepTimerID = Scheduler::kInvalidTimerID;
+
+	auto const& step = s_routine.GetSteps()[s_routineIndex];
+
+	// Move to the next step.
+	s_routineIndex = (s_routineIndex + 1u) % s_routine.GetNumSteps();
+	RoutineScheduleStep(currentTime);
+	StatusPublishRoutineStep(s_routineIndex);
+
+	// Sanity check the step.
+	if (step.m_controlAction.m_action >= Control::kNumActions)
+	{
+		Logger::WriteLine("Routine moving to step ", s_routineIndex, ".");
+		return;
+	}
+
+	// The control was looked up when the routine was loaded.
+	auto* control = step.m_controlAction.GetControl();
+
+	if (control == nullptr)
+	{
+		Logger::WriteLine("Routine couldn't find control \"", step.m_controlAction.m_controlName,
+								"\". Moving to step ", s_routineIndex, ".");
+		return;
+	}
+
+	// Perform the action.
+	if (step.m_controlAction.HasTargetPosition() == true)
+	{
+		control->SetDesiredPosition(step.m_controlAction.m_targetPercent);
+
+		ReportsAddControlPositionItem(control->GetName(), step.m_controlAction.m_targetPercent,
+												"routine");
+	}
+	else
+	{
+		control->SetDesiredAction(step.m_controlAction.m_action, Control::kModeTimed);
+
+		ReportsAddControlItem(control->GetName(), step.m_controlAction.m_action, "routine");
+	}
+
+	Logger::WriteLine("Routine moving to step ", s_routineIndex, ".");
+}
+
 // Initialize the routines.
 //
 // baseDirectory: The base directory for data files.
+// scheduler:		Used to perform each step once its delay has passed.
 //
-void RoutinesInitialize(std::string const& baseDirectory)
+void RoutinesInitialize(std::string const& baseDirectory, Scheduler& scheduler)
 {	
 	s_routineIndex = UINT_MAX;
+	s_scheduler = &scheduler;
 	
 	Logger::WriteLine("Initializing the routines...");
 
@@ -288,6 +401,9 @@ void RoutinesUninitialize()
 		return;
 	}
 	
+	s_scheduler->CancelTimer(s_routineStepTimerID);
+	s_routineIndex = UINT_MAX;
+
 	s_routinesInitialized = false;
 }
 
@@ -311,7 +427,11 @@ void RoutineStart()
 	}
 	
 	s_routineIndex = 0u;
-	TimerGetCurrent(s_routineDelayStartTime);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	RoutineScheduleStep(currentTime);
+	StatusPublishRoutineStep(s_routineIndex);
 	
 	// Notify.
 	NotificationPlay("routine_start");
@@ -339,6 +459,8 @@ void RoutineStop()
 	}
 	
 	s_routineIndex = UINT_MAX;
+	s_scheduler->CancelTimer(s_routineStepTimerID);
+	StatusPublishRoutineStep(s_routineIndex);
 	
 	// Notify.
 	NotificationPlay("routine_stop");
@@ -353,71 +475,11 @@ bool RoutineIsRunning()
 	return (s_routineIndex != UINT_MAX);
 }
 
-// Process the routines.
+// Get the index of the step the routine will perform next.
 //
-void RoutinesProcess()
+// Returns:	The index of the step, or UINT_MAX if the routine isn't running.
+//
+unsigned int RoutineGetStepIndex()
 {
-	// Make sure it's initialized.
-	if (s_routinesInitialized == false)
-	{
-		return;
-	}
-	
-	// Running?
-	if (RoutineIsRunning() == false)
-	{
-		return;
-	}
-
-	// No need to do anything for routines with zero steps.
-	auto const numSteps = s_routine.GetNumSteps();
-	if (numSteps == 0u)
-	{
-		return;
-	}
-
-	// Get elapsed time since delay start.
-	Time currentTime;
-	TimerGetCurrent(currentTime);
-
-	auto const elapsedTimeSec = 
-		TimerGetElapsedMilliseconds(s_routineDelayStartTime, currentTime) / 1000.0f;
-
-	// Time up?
-	auto& step = s_routine.GetSteps()[s_routineIndex];
-	
-	if (elapsedTimeSec < step.m_delaySec)
-	{
-		return;
-	}
-	
-	// Move to the next step.
-	s_routineIndex = (s_routineIndex + 1u) % numSteps;
-	
-	// Set the new delay start time.
-	TimerGetCurrent(s_routineDelayStartTime);
-	
-	// Sanity check the step.
-	if (step.m_controlAction.m_action >= Control::kNumActions)
-	{
-		Logger::WriteLine("Routine moving to step ", s_routineIndex, ".");
-		return;
-	}
-
-	// Try to find the control to perform the action.
-	auto* control = step.m_controlAction.GetControl();
-	
-	if (control == nullptr)
-	{
-		Logger::WriteLine("Routine couldn't find control \"", step.m_controlAction.m_controlName,
-								"\". Moving to step ", s_routineIndex, ".");
-		return;
-	}
-		
-	// Perform the action.
-	control->SetDesiredAction(step.m_controlAction.m_action, Control::kModeTimed);
-	
-	ReportsAddControlItem(control->GetName(), step.m_controlAction.m_action, "routine");
-
-	Logger::WriteLine("Routine moving to step ", s_routineIndex, ".");
+	return s_routineIndex;
 }
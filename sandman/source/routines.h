@@ -4,6 +4,7 @@
 #include "rapidjson/document.h"
 
 #include "control.h"
+#include "scheduler.h"
 
 // Types
 //
@@ -52,6 +53,13 @@ class Routine
       //
       std::vector<RoutineStep> const& GetSteps() const;
 
+      // Look up the controls for each step, so that performing a step doesn't have to. The
+      // controls must have been initialized.
+      //
+      // Returns:		True if every control was found, false otherwise.
+      //
+      bool ResolveControls();
+
    private:
       // The list of steps making up the routine.
       std::vector<RoutineStep> m_steps;
@@ -64,8 +72,9 @@ class Routine
 // Initialize the routines.
 //
 // baseDirectory: The base directory for data files.
+// scheduler:		Used to perform each step once its delay has passed.
 //
-void RoutinesInitialize(std::string const& baseDirectory);
+void RoutinesInitialize(std::string const& baseDirectory, Scheduler& scheduler);
 
 // Uninitialize the routines.
 // 
@@ -83,7 +92,9 @@ void RoutineStop();
 //
 bool RoutineIsRunning();
 
-// Process the routines.
+// Get the index of the step the routine will perform next.
+//
+// Returns:	The index of the step, or UINT_MAX if the routine isn't running.
 //
-void RoutinesProcess();
+unsigned int RoutineGetStepIndex();
 
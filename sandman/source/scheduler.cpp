@@ -0,0 +1,436 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+// Functions
+//
+
+// Scheduler members
+
+// Schedule a function to be called once after a delay.
+//
+// delayMS:		How long to wait before calling the function (in milliseconds).
+// callback:	The function to call.
+//
+// Returns:	The ID of the new timer.
+//
+Scheduler::TimerID Scheduler::AddTimer(unsigned int delayMS, Callback const& callback)
+{
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	return AddTimer(currentTime + Milliseconds(delayMS), callback);
+}
+
+// Schedule a function to be called once after a deadline.
+//
+// deadline:	When to call the function.
+// callback:	The function to call.
+//
+// Returns:	The ID of the new timer.
+//
+Scheduler::TimerID Scheduler::AddTimer(Time const& deadline, Callback const& callback)
+{
+	auto const timerID = m_nextTimerID;
+	m_nextTimerID++;
+
+	m_timerHeap.push_back({deadline, timerID});
+	std::push_heap(m_timerHeap.begin(), m_timerHeap.end(), ExpiresAfter);
+
+	m_timerIDToCallbackMap.insert({timerID, callback});
+	return timerID;
+}
+
+// Cancel a timer, if it hasn't expired yet.
+//
+// timerID:	(Input/Output) The timer to cancel. This will be set to the invalid ID.
+//
+void Scheduler::CancelTimer(TimerID& timerID)
+{
+	if (timerID == kInvalidTimerID)
+	{
+		return;
+	}
+
+	m_timerIDToCallbackMap.erase(timerID);
+	timerID = kInvalidTimerID;
+
+	DiscardCancelledTimers();
+}
+
+// Add a slot, which won't call its function until it is armed. This may allocate, so do it up
+// front.
+//
+// callback:	The function to call each time the slot expires.
+//
+// Returns:	The ID of the new slot.
+//
+Scheduler::SlotID Scheduler::AddSlot(Callback const& callback)
+{
+	auto slotIterator = std::find_if(m_slots.begin(), m_slots.end(),
+		[](Slot const& slot) { return slot.m_inUse == false; });
+
+	if (slotIterator == m_slots.end())
+	{
+		slotIterator = m_slots.emplace(m_slots.end());
+	}
+
+	slotIterator->m_callback = callback;
+	slotIterator->m_id = kInvalidTimerID;
+	slotIterator->m_inUse = true;
+
+	// Make room for every slot to be armed or set aside at once, so that neither allocates.
+	m_slotHeap.reserve(m_slots.size());
+	m_setAsideSlots.reserve(m_slots.size());
+
+	return static_cast<SlotID>(slotIterator - m_slots.begin());
+}
+
+// Remove a slot, so that it can be reused.
+//
+// slotID:	(Input/Output) The slot to remove. This will be set to the invalid ID.
+//
+void Scheduler::RemoveSlot(SlotID& slotID)
+{
+	if (slotID == kInvalidSlotID)
+	{
+		return;
+	}
+
+	DisarmSlot(slotID);
+
+	auto& slot = m_slots[slotID];
+	slot.m_callback = nullptr;
+	slot.m_inUse = false;
+
+	slotID = kInvalidSlotID;
+}
+
+// Arm a slot to call its function once after a deadline, replacing any deadline it already had.
+// This never allocates.
+//
+// slotID:		The slot to arm.
+// deadline:	When to call the function.
+//
+void Scheduler::ArmSlot(SlotID slotID, Time const& deadline)
+{
+	auto& slot = m_slots[slotID];
+
+	if (slot.m_id == kInvalidTimerID)
+	{
+		m_armedSlotCount++;
+	}
+
+	slot.m_deadline = deadline;
+	slot.m_id = m_nextTimerID;
+	m_nextTimerID++;
+
+	// A slot that was set aside goes back in the heap at the end of Process.
+	if (slot.m_setAside == true)
+	{
+		return;
+	}
+
+	if (slot.m_heapIndex == kNotInSlotHeap)
+	{
+		InsertSlotIntoHeap(slotID);
+		return;
+	}
+
+	RestoreSlotHeap(slot.m_heapIndex);
+}
+
+// Disarm a slot, if it hasn't expired yet.
+//
+// slotID:	The slot to disarm.
+//
+void Scheduler::DisarmSlot(SlotID slotID)
+{
+	auto& slot = m_slots[slotID];
+
+	if (slot.m_id == kInvalidTimerID)
+	{
+		return;
+	}
+
+	slot.m_id = kInvalidTimerID;
+	m_armedSlotCount--;
+
+	if (slot.m_heapIndex != kNotInSlotHeap)
+	{
+		RemoveSlotFromHeap(slotID);
+	}
+}
+
+// Call the functions for all of the timers that have expired.
+//
+// currentTime:	The time of the current tick.
+//
+void Scheduler::Process(Time const& currentTime)
+{
+	// Timers added by the callbacks are never due until a later call, even if their deadline has
+	// already passed. Otherwise a callback that keeps adding timers could stall the tick.
+	auto const firstAddedTimerID = m_nextTimerID;
+
+	while (true)
+	{
+		// Set aside timers that were added during this call, so that the ones behind them still
+		// expire.
+		while ((m_timerHeap.empty() == false) && (currentTime >= m_timerHeap.front().m_deadline) &&
+				 (m_timerHeap.front().m_id >= firstAddedTimerID))
+		{
+			std::pop_heap(m_timerHeap.begin(), m_timerHeap.end(), ExpiresAfter);
+			m_setAsideTimers.push_back(m_timerHeap.back());
+			m_timerHeap.pop_back();
+		}
+
+		// The same goes for slots that were armed during this call.
+		while ((m_slotHeap.empty() == false) &&
+				 (currentTime >= m_slots[m_slotHeap.front()].m_deadline) &&
+				 (m_slots[m_slotHeap.front()].m_id >= firstAddedTimerID))
+		{
+			auto const setAsideSlotID = m_slotHeap.front();
+			RemoveSlotFromHeap(setAsideSlotID);
+
+			// A slot is only listed once, however many times it is armed again.
+			auto& setAsideSlot = m_slots[setAsideSlotID];
+
+			if (setAsideSlot.m_setAside == false)
+			{
+				setAsideSlot.m_setAside = true;
+				m_setAsideSlots.push_back(setAsideSlotID);
+			}
+		}
+
+		auto const heapDue = (m_timerHeap.empty() == false) &&
+			(currentTime >= m_timerHeap.front().m_deadline);
+
+		auto const slotID = (m_slotHeap.empty() == false) ? m_slotHeap.front() : kInvalidSlotID;
+		auto const slotDue = (slotID != kInvalidSlotID) &&
+			(currentTime >= m_slots[slotID].m_deadline);
+
+		if ((heapDue == false) && (slotDue == false))
+		{
+			break;
+		}
+
+		// Timers and slots expire in the same order as if they were all in the heap.
+		auto const slotFirst = (slotDue == true) && ((heapDue == false) ||
+			(ExpiresAfter(m_timerHeap.front(), GetSlotTimer(slotID)) == true));
+
+		if (slotFirst == true)
+		{
+			// The slot is disarmed before the callback runs, so it is free to arm it again. The
+			// callback is copied in case it adds slots; the functions given to slots are expected to
+			// be small enough to copy without allocating.
+			DisarmSlot(slotID);
+
+			auto const callback = m_slots[slotID].m_callback;
+			callback(currentTime);
+			continue;
+		}
+
+		auto const timerID = m_timerHeap.front().m_id;
+
+		std::pop_heap(m_timerHeap.begin(), m_timerHeap.end(), ExpiresAfter);
+		m_timerHeap.pop_back();
+
+		// Skip timers that have been cancelled.
+		auto const callbackIterator = m_timerIDToCallbackMap.find(timerID);
+
+		if (callbackIterator == m_timerIDToCallbackMap.end())
+		{
+			continue;
+		}
+
+		// The timer is done before the callback runs, so it is free to add more timers.
+		auto const callback = callbackIterator->second;
+		m_timerIDToCallbackMap.erase(callbackIterator);
+
+		callback(currentTime);
+	}
+
+	for (auto const& timer : m_setAsideTimers)
+	{
+		m_timerHeap.push_back(timer);
+		std::push_heap(m_timerHeap.begin(), m_timerHeap.end(), ExpiresAfter);
+	}
+
+	// Keep the storage, so that setting timers aside doesn't usually allocate.
+	m_setAsideTimers.clear();
+
+	for (auto const setAsideSlotID : m_setAsideSlots)
+	{
+		auto& slot = m_slots[setAsideSlotID];
+		slot.m_setAside = false;
+
+		if ((slot.m_id != kInvalidTimerID) && (slot.m_heapIndex == kNotInSlotHeap))
+		{
+			InsertSlotIntoHeap(setAsideSlotID);
+		}
+	}
+
+	m_setAsideSlots.clear();
+
+	DiscardCancelledTimers();
+}
+
+// Get the deadline of the timer that will expire next.
+//
+// deadline:	(Output) The next deadline, if there is one.
+//
+// Returns:	True if there is a timer, false otherwise.
+//
+bool Scheduler::GetNextDeadline(Time& deadline) const
+{
+	auto const slotID = (m_slotHeap.empty() == false) ? m_slotHeap.front() : kInvalidSlotID;
+
+	if (m_timerHeap.empty() == true)
+	{
+		if (slotID == kInvalidSlotID)
+		{
+			return false;
+		}
+
+		deadline = m_slots[slotID].m_deadline;
+		return true;
+	}
+
+	deadline = m_timerHeap.front().m_deadline;
+
+	if ((slotID != kInvalidSlotID) && (m_slots[slotID].m_deadline < deadline))
+	{
+		deadline = m_slots[slotID].m_deadline;
+	}
+
+	return true;
+}
+
+// Add an armed slot to the slot heap. This never allocates, since the heap has room for every slot.
+//
+// slotID:	The slot.
+//
+void Scheduler::InsertSlotIntoHeap(SlotID slotID)
+{
+	auto const heapIndex = static_cast<unsigned int>(m_slotHeap.size());
+
+	m_slotHeap.push_back(slotID);
+	m_slots[slotID].m_heapIndex = heapIndex;
+
+	RestoreSlotHeap(heapIndex);
+}
+
+// Take a slot out of the slot heap.
+//
+// slotID:	The slot, which must be in the heap.
+//
+void Scheduler::RemoveSlotFromHeap(SlotID slotID)
+{
+	auto const heapIndex = m_slots[slotID].m_heapIndex;
+	auto const lastIndex = static_cast<unsigned int>(m_slotHeap.size() - 1u);
+
+	// Fill the gap with the last slot, and then move that one to where it belongs.
+	SwapSlotHeapEntries(heapIndex, lastIndex);
+	m_slotHeap.pop_back();
+	m_slots[slotID].m_heapIndex = kNotInSlotHeap;
+
+	if (heapIndex < lastIndex)
+	{
+		RestoreSlotHeap(heapIndex);
+	}
+}
+
+// Move a slot in the slot heap to where its deadline belongs, after it has changed.
+//
+// heapIndex:	Where the slot is in the heap.
+//
+void Scheduler::RestoreSlotHeap(unsigned int heapIndex)
+{
+	// Move up past any parents that expire after it.
+	while (heapIndex > 0u)
+	{
+		auto const parentIndex = (heapIndex - 1u) / 2u;
+
+		if (SlotExpiresAfter(m_slotHeap[parentIndex], m_slotHeap[heapIndex]) == false)
+		{
+			break;
+		}
+
+		SwapSlotHeapEntries(parentIndex, heapIndex);
+		heapIndex = parentIndex;
+	}
+
+	// Then down past any children that expire before it.
+	auto const heapSize = static_cast<unsigned int>(m_slotHeap.size());
+
+	while (true)
+	{
+		auto firstIndex = heapIndex;
+
+		for (auto const childIndex : { (2u * heapIndex) + 1u, (2u * heapIndex) + 2u })
+		{
+			if ((childIndex < heapSize) &&
+				 (SlotExpiresAfter(m_slotHeap[firstIndex], m_slotHeap[childIndex]) == true))
+			{
+				firstIndex = childIndex;
+			}
+		}
+
+		if (firstIndex == heapIndex)
+		{
+			break;
+		}
+
+		SwapSlotHeapEntries(heapIndex, firstIndex);
+		heapIndex = firstIndex;
+	}
+}
+
+// Swap two entries in the slot heap, keeping track of where each slot is.
+//
+// leftIndex:	Where one of the slots is in the heap.
+// rightIndex:	Where the other slot is in the heap.
+//
+void Scheduler::SwapSlotHeapEntries(unsigned int leftIndex, unsigned int rightIndex)
+{
+	std::swap(m_slotHeap[leftIndex], m_slotHeap[rightIndex]);
+
+	m_slots[m_slotHeap[leftIndex]].m_heapIndex = leftIndex;
+	m_slots[m_slotHeap[rightIndex]].m_heapIndex = rightIndex;
+}
+
+// Remove cancelled timers from the top of the heap so that it always holds the next deadline.
+//
+void Scheduler::DiscardCancelledTimers()
+{
+	while (m_timerHeap.empty() == false)
+	{
+		auto const timerID = m_timerHeap.front().m_id;
+
+		if (m_timerIDToCallbackMap.find(timerID) != m_timerIDToCallbackMap.end())
+		{
+			return;
+		}
+
+		std::pop_heap(m_timerHeap.begin(), m_timerHeap.end(), ExpiresAfter);
+		m_timerHeap.pop_back();
+	}
+}
+
+// Orders timers so that the standard heap functions produce a min-heap by deadline. Timers with the
+// same deadline expire in the order they were added.
+//
+// left:		A timer.
+// right:	Another timer.
+//
+// Returns:	True if the left timer expires after the right one.
+//
+bool Scheduler::ExpiresAfter(Timer const& left, Timer const& right)
+{
+	if (left.m_deadline != right.m_deadline)
+	{
+		return left.m_deadline > right.m_deadline;
+	}
+
+	return left.m_id > right.m_id;
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "timer.h"
+
+// Types
+//
+
+// Calls functions once their deadlines have passed.
+//
+class Scheduler
+{
+	public:
+
+		// Identifies a timer so that it can be cancelled.
+		using TimerID = uint64_t;
+
+		// Identifies a slot: a timer that is set up once, and can then be armed again and again
+		// without allocating.
+		using SlotID = unsigned int;
+
+		// A function to call when a timer expires. It is given the time of the current tick.
+		using Callback = std::function<void(Time const& currentTime)>;
+
+		// Constants.
+
+		// Used to detect when a timer ID does not refer to a timer.
+		static constexpr TimerID kInvalidTimerID{ 0u };
+
+		// Used to detect when a slot ID does not refer to a slot.
+		static constexpr SlotID kInvalidSlotID{ UINT_MAX };
+
+		// Schedule a function to be called once after a delay.
+		//
+		// delayMS:		How long to wait before calling the function (in milliseconds).
+		// callback:	The function to call.
+		//
+		// Returns:	The ID of the new timer.
+		//
+		TimerID AddTimer(unsigned int delayMS, Callback const& callback);
+
+		// Schedule a function to be called once after a deadline.
+		//
+		// deadline:	When to call the function.
+		// callback:	The function to call.
+		//
+		// Returns:	The ID of the new timer.
+		//
+		TimerID AddTimer(Time const& deadline, Callback const& callback);
+
+		// Cancel a timer, if it hasn't expired yet.
+		//
+		// timerID:	(Input/Output) The timer to cancel. This will be set to the invalid ID.
+		//
+		void CancelTimer(TimerID& timerID);
+
+		// Add a slot, which won't call its function until it is armed. This may allocate, so do it
+		// up front.
+		//
+		// callback:	The function to call each time the slot expires.
+		//
+		// Returns:	The ID of the new slot.
+		//
+		SlotID AddSlot(Callback const& callback);
+
+		// Remove a slot, so that it can be reused.
+		//
+		// slotID:	(Input/Output) The slot to remove. This will be set to the invalid ID.
+		//
+		void RemoveSlot(SlotID& slotID);
+
+		// Arm a slot to call its function once after a deadline, replacing any deadline it already
+		// had. This never allocates.
+		//
+		// slotID:		The slot to arm.
+		// deadline:	When to call the function.
+		//
+		void ArmSlot(SlotID slotID, Time const& deadline);
+
+		// Disarm a slot, if it hasn't expired yet.
+		//
+		// slotID:	The slot to disarm.
+		//
+		void DisarmSlot(SlotID slotID);
+
+		// Call the functions for all of the timers that have expired.
+		//
+		// currentTime:	The time of the current tick.
+		//
+		void Process(Time const& currentTime);
+
+		// Get the deadline of the timer that will expire next.
+		//
+		// deadline:	(Output) The next deadline, if there is one.
+		//
+		// Returns:	True if there is a timer, false otherwise.
+		//
+		bool GetNextDeadline(Time& deadline) const;
+
+		// Get the number of timers that have not expired or been cancelled, including armed slots.
+		//
+		unsigned int GetTimerCount() const
+		{
+			return static_cast<unsigned int>(m_timerIDToCallbackMap.size()) + m_armedSlotCount;
+		}
+
+	private:
+
+		// A timer waiting to expire.
+		struct Timer
+		{
+			// When the timer expires.
+			Time m_deadline;
+
+			// Which timer this is.
+			TimerID m_id;
+		};
+
+		// Used to detect when a slot isn't in the slot heap.
+		static constexpr unsigned int kNotInSlotHeap{ UINT_MAX };
+
+		// A timer that stays in place, so that arming it again only changes its deadline.
+		struct Slot
+		{
+			// The function to call when the slot expires.
+			Callback m_callback;
+
+			// When the slot expires, if it is armed.
+			Time m_deadline;
+
+			// Orders the slot among the timers, or the invalid ID if it isn't armed.
+			TimerID m_id = kInvalidTimerID;
+
+			// Where the slot is in the slot heap, or kNotInSlotHeap if it isn't there.
+			unsigned int m_heapIndex = kNotInSlotHeap;
+
+			// Whether the slot has been added and not removed.
+			bool m_inUse = false;
+
+			// Whether the slot was set aside during Process, which puts it back in the heap if it is
+			// still armed.
+			bool m_setAside = false;
+		};
+
+		// Get an armed slot as a timer, so that it can be ordered among the timers.
+		//
+		// slotID:	The slot.
+		//
+		// Returns:	The deadline and ID of the slot.
+		//
+		Timer GetSlotTimer(SlotID slotID) const
+		{
+			return {m_slots[slotID].m_deadline, m_slots[slotID].m_id};
+		}
+
+		// Add an armed slot to the slot heap. This never allocates, since the heap has room for every
+		// slot.
+		//
+		// slotID:	The slot.
+		//
+		void InsertSlotIntoHeap(SlotID slotID);
+
+		// Take a slot out of the slot heap.
+		//
+		// slotID:	The slot, which must be in the heap.
+		//
+		void RemoveSlotFromHeap(SlotID slotID);
+
+		// Move a slot in the slot heap to where its deadline belongs, after it has changed.
+		//
+		// heapIndex:	Where the slot is in the heap.
+		//
+		void RestoreSlotHeap(unsigned int heapIndex);
+
+		// Swap two entries in the slot heap, keeping track of where each slot is.
+		//
+		// leftIndex:	Where one of the slots is in the heap.
+		// rightIndex:	Where the other slot is in the heap.
+		//
+		void SwapSlotHeapEntries(unsigned int leftIndex, unsigned int rightIndex);
+
+		// Determine whether a slot expires after another one, in the same order as timers.
+		//
+		// leftSlotID:		A slot.
+		// rightSlotID:	Another slot.
+		//
+		// Returns:	True if the left slot expires after the right one.
+		//
+		bool SlotExpiresAfter(SlotID leftSlotID, SlotID rightSlotID) const
+		{
+			return ExpiresAfter(GetSlotTimer(leftSlotID), GetSlotTimer(rightSlotID));
+		}
+
+		// Orders timers so that the standard heap functions produce a min-heap by deadline. Timers
+		// with the same deadline expire in the order they were added.
+		//
+		// left:		A timer.
+		// right:	Another timer.
+		//
+		// Returns:	True if the left timer expires after the right one.
+		//
+		static bool ExpiresAfter(Timer const& left, Timer const& right);
+
+		// Remove cancelled timers from the top of the heap so that it always holds the next deadline.
+		//
+		void DiscardCancelledTimers();
+
+		// Timers ordered as a min-heap by deadline. Cancelled timers are left in place until they
+		// reach the top.
+		std::vector<Timer> m_timerHeap;
+
+		// Timers that were added while they were being processed, which wait for the next call.
+		std::vector<Timer> m_setAsideTimers;
+
+		// A mapping from the ID of each timer that is still active to its function.
+		std::map<TimerID, Callback> m_timerIDToCallbackMap;
+
+		// The slots. Removed slots are kept so that they can be reused.
+		std::vector<Slot> m_slots;
+
+		// The armed slots, ordered as a min-heap by deadline. Each slot knows where it is, so that
+		// arming or disarming it only moves it as far as it needs to go.
+		std::vector<SlotID> m_slotHeap;
+
+		// Slots that were armed while they were being processed, which wait for the next call.
+		std::vector<SlotID> m_setAsideSlots;
+
+		// How many slots are armed.
+		unsigned int m_armedSlotCount = 0u;
+
+		// The ID to give the next timer. Slots take one each time they are armed.
+		TimerID m_nextTimerID = kInvalidTimerID + 1u;
+};
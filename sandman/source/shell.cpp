@@ -464,7 +464,7 @@ namespace Shell
 			// Parse a command.
 			{
 				// Tokenize the string.
-				std::vector<CommandToken> commandTokens;
+				CommandTokenBuffer commandTokens;
 				CommandTokenizeString(commandTokens, s_buffer.GetData().data());
 
 				// Parse command tokens.
@@ -609,4 +609,28 @@ namespace Shell
 		}
 	}
 
+	auto InputWindow::ProcessPendingUserKeys() -> Result
+	{
+		// Keep processing keys until there are none left.
+		while (true)
+		{
+			// Peek at the next key by putting it back for the single key processing to get.
+			int const inputKey{ wgetch(s_window) };
+
+			if (inputKey == ERR)
+			{
+				return Result::kNone;
+			}
+
+			ungetch(inputKey);
+
+			Result const result{ ProcessSingleUserKey() };
+
+			if (result == Result::kRequestToQuit)
+			{
+				return result;
+			}
+		}
+	}
+
 }
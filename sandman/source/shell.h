@@ -206,6 +206,13 @@ namespace Shell
 		///
 		[[nodiscard]]
 		Result ProcessSingleUserKey();
+
+		/// @brief Process all of the key inputs from the user that are waiting, if any.
+		/// @warning Not thread safe.
+		/// @returns `kRequestToQuit` if the "quit" command was processed.
+		///
+		[[nodiscard]]
+		Result ProcessPendingUserKeys();
 	}
 
 	// Adjusts the windows to the new dimensions of
@@ -0,0 +1,701 @@
+#include "socket_server.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "logger.h"
+#include "profiler.h"
+
+// Constants
+//
+
+// Used to detect when a socket is invalid.
+static constexpr int kInvalidSocket{ -1 };
+
+// Types
+//
+
+// A connection, along with whatever it has sent that hasn't been handled yet.
+struct SocketServerConnection
+{
+	// The socket of the connection, or invalid if the slot is free.
+	int m_socket = kInvalidSocket;
+
+	// Identifies the connection to the command handler.
+	SocketServerConnectionID m_id = 0u;
+
+	// Bytes received but not yet handled. Only the first m_receivedByteCount are valid.
+	std::array<char, kSocketServerReceiveBufferCapacity> m_receiveBuffer;
+	unsigned int m_receivedByteCount = 0u;
+
+	// Whether the event loop is watching the socket. It stops while the receive buffer is full, so
+	// that a client sending faster than its commands are handled waits on its own socket.
+	bool m_watched = false;
+
+	// Whether the client has finished sending. The connection is closed once everything it sent has
+	// been handled and everything for it has been sent.
+	bool m_finished = false;
+
+	// Bytes waiting to be sent. Only the first m_sendByteCount are valid.
+	std::array<char, kSocketServerSendBufferCapacity> m_sendBuffer;
+	unsigned int m_sendByteCount = 0u;
+
+	// Whether the event loop is watching the socket for room to send.
+	bool m_watchedForSend = false;
+
+	// Whether sending failed. The connection is closed as soon as nothing is using it.
+	bool m_failed = false;
+};
+
+// Locals
+//
+
+// The socket that connections are accepted on.
+static int s_listeningSocket = kInvalidSocket;
+
+// The function to call with each command that is received.
+static SocketServerCommandHandler s_commandHandler;
+
+// The connections, in a fixed number of slots.
+static std::array<SocketServerConnection, kSocketServerMaxConnectionCount> s_connections;
+
+// The ID the next connection will get.
+static SocketServerConnectionID s_nextConnectionID = 1u;
+
+// Statistics.
+static SocketServerStatistics s_statistics;
+
+// Functions
+//
+
+// Find the end of the first complete line in a connection's receive buffer.
+//
+// connection:	The connection.
+// offset:		Where to start looking.
+//
+// Returns:	The newline at the end of the line, or null if there isn't a complete line.
+//
+static char const* SocketServerFindLineEnd(SocketServerConnection const& connection,
+	unsigned int offset)
+{
+	auto const* lineStart = connection.m_receiveBuffer.data() + offset;
+	return static_cast<char const*>(std::memchr(lineStart, '\n',
+		connection.m_receivedByteCount - offset));
+}
+
+// Close a connection and free its slot.
+//
+// connection:	The connection to close.
+//
+static void SocketServerCloseConnection(SocketServerConnection& connection)
+{
+	if (connection.m_watched == true)
+	{
+		EventLoopRemoveFileDescriptor(connection.m_socket);
+	}
+
+	if (connection.m_watchedForSend == true)
+	{
+		EventLoopRemoveWritableFileDescriptor(connection.m_socket);
+	}
+
+	close(connection.m_socket);
+
+	connection.m_socket = kInvalidSocket;
+	connection.m_receivedByteCount = 0u;
+	connection.m_watched = false;
+	connection.m_finished = false;
+	connection.m_sendByteCount = 0u;
+	connection.m_watchedForSend = false;
+	connection.m_failed = false;
+
+	s_statistics.m_openConnectionCount--;
+}
+
+// Stop watching a connection's socket, so that nothing more is received from it for now.
+//
+// connection:	The connection.
+//
+static void SocketServerUnwatchConnection(SocketServerConnection& connection)
+{
+	if (connection.m_watched == false)
+	{
+		return;
+	}
+
+	EventLoopRemoveFileDescriptor(connection.m_socket);
+	connection.m_watched = false;
+}
+
+// Determine whether there is enough room waiting to be sent to a connection to handle another of
+// its commands.
+//
+// connection:	The connection.
+//
+static bool SocketServerHasRoomToReply(SocketServerConnection const& connection)
+{
+	return (kSocketServerSendBufferCapacity - connection.m_sendByteCount) >=
+		kSocketServerMaxReplySize;
+}
+
+static void SocketServerSendPending(unsigned int connectionIndex);
+
+// Send as much of what is waiting to be sent to a connection as it has room for, and watch for room
+// to send the rest.
+//
+// connection:	The connection.
+//
+// Returns:	True on success, false if sending failed, in which case the connection should be closed.
+//
+static bool SocketServerFlush(SocketServerConnection& connection)
+{
+	auto sentByteCount = 0u;
+
+	while (sentByteCount < connection.m_sendByteCount)
+	{
+		auto const result = send(connection.m_socket, connection.m_sendBuffer.data() + sentByteCount,
+			connection.m_sendByteCount - sentByteCount, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+		if (result >= 0)
+		{
+			sentByteCount += static_cast<unsigned int>(result);
+			continue;
+		}
+
+		if (errno == EINTR)
+		{
+			continue;
+		}
+
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+		{
+			break;
+		}
+
+		Logger::WriteLine(Shell::Yellow("Connection "), connection.m_id,
+								Shell::Yellow(" closed, error sending: "), std::strerror(errno));
+		connection.m_sendByteCount = 0u;
+		connection.m_failed = true;
+		break;
+	}
+
+	// Move what is left to the front, so that it goes out first.
+	if (connection.m_failed == false)
+	{
+		connection.m_sendByteCount -= sentByteCount;
+		std::memmove(connection.m_sendBuffer.data(), connection.m_sendBuffer.data() + sentByteCount,
+						 connection.m_sendByteCount);
+	}
+
+	auto const sendPending = (connection.m_sendByteCount > 0u);
+
+	if ((sendPending == true) && (connection.m_watchedForSend == false))
+	{
+		auto const connectionIndex = static_cast<unsigned int>(&connection - s_connections.data());
+
+		if (EventLoopAddWritableFileDescriptor(connection.m_socket,
+			[connectionIndex]() { SocketServerSendPending(connectionIndex); }) == false)
+		{
+			Logger::WriteLine(Shell::Yellow("Connection "), connection.m_id,
+									Shell::Yellow(" closed, unable to wait for room to send."));
+			connection.m_sendByteCount = 0u;
+			connection.m_failed = true;
+		}
+		else
+		{
+			connection.m_watchedForSend = true;
+		}
+	}
+	else if ((sendPending == false) && (connection.m_watchedForSend == true))
+	{
+		EventLoopRemoveWritableFileDescriptor(connection.m_socket);
+		connection.m_watchedForSend = false;
+	}
+
+	return (connection.m_failed == false);
+}
+
+// Send what is waiting to be sent to a connection, now that it has room.
+//
+// connectionIndex:	The slot of the connection.
+//
+static void SocketServerSendPending(unsigned int connectionIndex)
+{
+	ProfilerScope const profilerScope(kProfilerStageSocket);
+
+	auto& connection = s_connections[connectionIndex];
+
+	if (SocketServerFlush(connection) == false)
+	{
+		SocketServerCloseConnection(connection);
+	}
+}
+
+// Receive whatever a connection has sent, as far as there is room for it.
+//
+// connectionIndex:	The slot of the connection.
+//
+static void SocketServerReceive(unsigned int connectionIndex)
+{
+	ProfilerScope const profilerScope(kProfilerStageSocket);
+
+	auto& connection = s_connections[connectionIndex];
+	auto* const receiveStart = connection.m_receiveBuffer.data() + connection.m_receivedByteCount;
+	auto const freeByteCount = kSocketServerReceiveBufferCapacity -
+		connection.m_receivedByteCount;
+
+	auto const receivedByteCount = recv(connection.m_socket, receiveStart, freeByteCount, 0);
+
+	if (receivedByteCount < 0)
+	{
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+		{
+			return;
+		}
+
+		Logger::WriteLine(Shell::Yellow("Connection "), connection.m_id,
+								Shell::Yellow(" closed, error receiving: "), std::strerror(errno));
+		SocketServerCloseConnection(connection);
+		return;
+	}
+
+	// The client has finished sending. What it sent is handled before the connection is closed.
+	if (receivedByteCount == 0)
+	{
+		SocketServerUnwatchConnection(connection);
+		connection.m_finished = true;
+		return;
+	}
+
+	connection.m_receivedByteCount += static_cast<unsigned int>(receivedByteCount);
+
+	if (connection.m_receivedByteCount < kSocketServerReceiveBufferCapacity)
+	{
+		return;
+	}
+
+	// A full buffer without a newline holds part of a command that can never fit.
+	if (SocketServerFindLineEnd(connection, 0u) == nullptr)
+	{
+		Logger::WriteLine(Shell::Yellow("Connection "), connection.m_id,
+								Shell::Yellow(" closed, it sent a command longer than "),
+								kSocketServerReceiveBufferCapacity, Shell::Yellow(" bytes."));
+		s_statistics.m_overflowedConnectionCount++;
+		SocketServerCloseConnection(connection);
+		return;
+	}
+
+	// Wait for the commands to be handled before receiving any more.
+	SocketServerUnwatchConnection(connection);
+}
+
+// Accept any incoming connections.
+//
+static void SocketServerAccept()
+{
+	ProfilerScope const profilerScope(kProfilerStageSocket);
+
+	while (true)
+	{
+		auto const connectionSocket = accept4(s_listeningSocket, nullptr, nullptr,
+			SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+		if (connectionSocket < 0)
+		{
+			return;
+		}
+
+		// Find a free slot for the connection.
+		auto connectionIndex = 0u;
+
+		while ((connectionIndex < kSocketServerMaxConnectionCount) &&
+			(s_connections[connectionIndex].m_socket != kInvalidSocket))
+		{
+			connectionIndex++;
+		}
+
+		if (connectionIndex == kSocketServerMaxConnectionCount)
+		{
+			Logger::WriteLine(Shell::Yellow("Connection closed, there are already "),
+									kSocketServerMaxConnectionCount, Shell::Yellow(" open."));
+			s_statistics.m_rejectedConnectionCount++;
+			close(connectionSocket);
+			continue;
+		}
+
+		if (EventLoopAddFileDescriptor(connectionSocket,
+			[connectionIndex]() { SocketServerReceive(connectionIndex); }) == false)
+		{
+			Logger::WriteLine(Shell::Yellow("Connection closed, unable to wait for it."));
+			close(connectionSocket);
+			continue;
+		}
+
+		auto& connection = s_connections[connectionIndex];
+		connection.m_socket = connectionSocket;
+		connection.m_id = s_nextConnectionID++;
+		connection.m_receivedByteCount = 0u;
+		connection.m_watched = true;
+		connection.m_finished = false;
+		connection.m_sendByteCount = 0u;
+		connection.m_watchedForSend = false;
+		connection.m_failed = false;
+
+		s_statistics.m_openConnectionCount++;
+		s_statistics.m_acceptedConnectionCount++;
+
+		Logger::WriteLine("Got a new connection ", connection.m_id, ".");
+	}
+}
+
+// Pass a command to the handler.
+//
+// connection:	The connection that sent the command.
+// command:		The command, which may still end with a carriage return.
+//
+// Returns:	True if the command was handled, false if it was empty.
+//
+static bool SocketServerHandleCommand(SocketServerConnection const& connection,
+	std::string_view command)
+{
+	if ((command.empty() == false) && (command.back() == '\r'))
+	{
+		command.remove_suffix(1u);
+	}
+
+	if (command.empty() == true)
+	{
+		return false;
+	}
+
+	s_statistics.m_commandCount++;
+	s_commandHandler(connection.m_id, command);
+	return true;
+}
+
+// Handle the commands a connection has sent, up to the limit per tick.
+//
+// connection:	The connection.
+//
+static void SocketServerProcessConnection(SocketServerConnection& connection)
+{
+	auto handledByteCount = 0u;
+	auto handledCommandCount = 0u;
+
+	// Commands wait while the replies to earlier ones haven't been read.
+	while ((handledCommandCount < kSocketServerMaxCommandsPerTick) &&
+		(connection.m_failed == false) && (SocketServerHasRoomToReply(connection) == true))
+	{
+		auto const* const lineEnd = SocketServerFindLineEnd(connection, handledByteCount);
+
+		if (lineEnd == nullptr)
+		{
+			break;
+		}
+
+		auto const* const lineStart = connection.m_receiveBuffer.data() + handledByteCount;
+		auto const lineLength = static_cast<std::size_t>(lineEnd - lineStart);
+		handledByteCount += static_cast<unsigned int>(lineLength) + 1u;
+
+		if (SocketServerHandleCommand(connection, std::string_view(lineStart, lineLength)) ==
+			true)
+		{
+			handledCommandCount++;
+		}
+	}
+
+	// Move what is left to the front, to make room to receive more.
+	connection.m_receivedByteCount -= handledByteCount;
+	std::memmove(connection.m_receiveBuffer.data(),
+					 connection.m_receiveBuffer.data() + handledByteCount,
+					 connection.m_receivedByteCount);
+
+	if (connection.m_failed == true)
+	{
+		SocketServerCloseConnection(connection);
+		return;
+	}
+
+	if (connection.m_finished == true)
+	{
+		if ((SocketServerFindLineEnd(connection, 0u) != nullptr) ||
+			(SocketServerHasRoomToReply(connection) == false))
+		{
+			return;
+		}
+
+		// Older clients send a single command without a newline and then close the connection.
+		if (connection.m_receivedByteCount > 0u)
+		{
+			SocketServerHandleCommand(connection, std::string_view(connection.m_receiveBuffer.data(),
+				connection.m_receivedByteCount));
+			connection.m_receivedByteCount = 0u;
+
+			if (connection.m_failed == true)
+			{
+				SocketServerCloseConnection(connection);
+				return;
+			}
+		}
+
+		// Wait for the replies to go out first.
+		if (connection.m_sendByteCount > 0u)
+		{
+			return;
+		}
+
+		Logger::WriteLine("Connection ", connection.m_id, " closed.");
+		SocketServerCloseConnection(connection);
+		return;
+	}
+
+	// Start receiving again now that there is room.
+	if ((connection.m_watched == false) &&
+		(connection.m_receivedByteCount < kSocketServerReceiveBufferCapacity))
+	{
+		auto const connectionIndex = static_cast<unsigned int>(&connection - s_connections.data());
+
+		if (EventLoopAddFileDescriptor(connection.m_socket,
+			[connectionIndex]() { SocketServerReceive(connectionIndex); }) == false)
+		{
+			Logger::WriteLine(Shell::Yellow("Connection "), connection.m_id,
+									Shell::Yellow(" closed, unable to wait for it."));
+			SocketServerCloseConnection(connection);
+			return;
+		}
+
+		connection.m_watched = true;
+	}
+}
+
+// Start listening for connections on a Unix domain socket. The event loop must be initialized.
+//
+// socketFileName:	The file name of the socket. Any existing file is replaced.
+// commandHandler:	The function to call with each command that is received.
+//
+// Returns:	True on success, false on failure.
+//
+bool SocketServerInitialize(char const* socketFileName,
+	SocketServerCommandHandler const& commandHandler)
+{
+	s_listeningSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+	if (s_listeningSocket < 0)
+	{
+		s_listeningSocket = kInvalidSocket;
+		Logger::WriteLine(Shell::Red("Failed to create listening socket."));
+		return false;
+	}
+
+	sockaddr_un listeningAddress = {};
+	listeningAddress.sun_family = AF_UNIX;
+	std::strncpy(listeningAddress.sun_path, socketFileName, sizeof(listeningAddress.sun_path) - 1);
+
+	// Unlink the file if needed.
+	unlink(listeningAddress.sun_path);
+
+	// Bind the socket to the file.
+	if (bind(s_listeningSocket, reinterpret_cast<sockaddr*>(&listeningAddress),
+				sizeof(sockaddr_un)) < 0)
+	{
+		Logger::WriteLine(Shell::Red("Failed to bind listening socket."));
+		SocketServerUninitialize();
+		return false;
+	}
+
+	// Mark the socket for listening.
+	if (listen(s_listeningSocket, kSocketServerMaxConnectionCount) < 0)
+	{
+		Logger::WriteLine(Shell::Red("Failed to mark listening socket to listen."));
+		SocketServerUninitialize();
+		return false;
+	}
+
+	if (EventLoopAddFileDescriptor(s_listeningSocket, SocketServerAccept) == false)
+	{
+		Logger::WriteLine(Shell::Red("Failed to wait for connections on the listening socket."));
+		SocketServerUninitialize();
+		return false;
+	}
+
+	s_commandHandler = commandHandler;
+	s_nextConnectionID = 1u;
+	s_statistics = SocketServerStatistics{};
+
+	return true;
+}
+
+// Close all of the connections and stop listening.
+//
+void SocketServerUninitialize()
+{
+	for (auto& connection : s_connections)
+	{
+		if (connection.m_socket != kInvalidSocket)
+		{
+			SocketServerCloseConnection(connection);
+		}
+	}
+
+	if (s_listeningSocket != kInvalidSocket)
+	{
+		EventLoopRemoveFileDescriptor(s_listeningSocket);
+		close(s_listeningSocket);
+		s_listeningSocket = kInvalidSocket;
+	}
+
+	s_commandHandler = nullptr;
+}
+
+// Handle the commands that have been received, up to a limit per connection, and close any
+// connections that have finished.
+//
+void SocketServerProcess()
+{
+	for (auto& connection : s_connections)
+	{
+		if (connection.m_socket != kInvalidSocket)
+		{
+			SocketServerProcessConnection(connection);
+		}
+	}
+}
+
+// Find an open connection.
+//
+// connectionID:	The connection.
+//
+// Returns:	The connection, or null if it isn't open.
+//
+static SocketServerConnection* SocketServerFindConnection(SocketServerConnectionID connectionID)
+{
+	auto const connectionIterator = std::find_if(s_connections.begin(), s_connections.end(),
+		[connectionID](SocketServerConnection const& connection)
+		{
+			return (connection.m_socket != kInvalidSocket) && (connection.m_id == connectionID);
+		});
+
+	if (connectionIterator == s_connections.end())
+	{
+		return nullptr;
+	}
+
+	return &(*connectionIterator);
+}
+
+// Send data to a connection. Whatever can't be sent right away is held and sent once the connection
+// is ready for it. Either all of the data is sent or none of it is.
+//
+// connectionID:	The connection to send to.
+// data:				The data to send.
+//
+// Returns:	True if the data was sent or is waiting to be sent, false if the connection is closed or
+//				there isn't room to hold the data.
+//
+bool SocketServerSend(SocketServerConnectionID connectionID, std::string_view data)
+{
+	auto* const connectionPointer = SocketServerFindConnection(connectionID);
+
+	if ((connectionPointer == nullptr) || (connectionPointer->m_failed == true))
+	{
+		return false;
+	}
+
+	auto& connection = *connectionPointer;
+
+	if (data.size() > (kSocketServerSendBufferCapacity - connection.m_sendByteCount))
+	{
+		s_statistics.m_droppedSendCount++;
+		return false;
+	}
+
+	std::memcpy(connection.m_sendBuffer.data() + connection.m_sendByteCount, data.data(),
+					data.size());
+	connection.m_sendByteCount += static_cast<unsigned int>(data.size());
+
+	// Connections are closed on the next tick, so that the caller isn't surprised by it.
+	return SocketServerFlush(connection);
+}
+
+// Determine whether a connection is still open.
+//
+// connectionID:	The connection.
+//
+bool SocketServerIsConnectionOpen(SocketServerConnectionID connectionID)
+{
+	return (SocketServerFindConnection(connectionID) != nullptr);
+}
+
+// Determine whether there are commands that have been received but not yet handled, because of the
+// limit per tick, or connections that are ready to be closed.
+//
+bool SocketServerHasPendingCommands()
+{
+	for (auto const& connection : s_connections)
+	{
+		if (connection.m_socket == kInvalidSocket)
+		{
+			continue;
+		}
+
+		if (connection.m_failed == true)
+		{
+			return true;
+		}
+
+		// Anything else waits for the replies to be read.
+		if (SocketServerHasRoomToReply(connection) == false)
+		{
+			continue;
+		}
+
+		if (SocketServerFindLineEnd(connection, 0u) != nullptr)
+		{
+			return true;
+		}
+
+		if ((connection.m_finished == true) &&
+			((connection.m_receivedByteCount > 0u) || (connection.m_sendByteCount == 0u)))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Get statistics for the connections that the server has handled.
+//
+// statistics:	(Output) The statistics.
+//
+void SocketServerGetStatistics(SocketServerStatistics& statistics)
+{
+	statistics = s_statistics;
+}
+
+// Write the socket server statistics to the logger.
+//
+void SocketServerLogStatistics()
+{
+	if (s_listeningSocket == kInvalidSocket)
+	{
+		return;
+	}
+
+	Logger::WriteLine("Socket server:");
+	Logger::WriteLine("\t", s_statistics.m_openConnectionCount, " of ",
+							kSocketServerMaxConnectionCount, " connections open, ",
+							s_statistics.m_acceptedConnectionCount, " accepted, ",
+							s_statistics.m_rejectedConnectionCount, " rejected, ",
+							s_statistics.m_overflowedConnectionCount, " closed for overlong commands, ",
+							s_statistics.m_commandCount, " commands handled, ",
+							s_statistics.m_droppedSendCount, " replies dropped.");
+	Logger::WriteLine();
+}
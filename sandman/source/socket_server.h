@@ -0,0 +1,114 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+// Constants
+//
+
+// The most connections that can be open at once. Any more are closed as soon as they are accepted.
+static constexpr unsigned int kSocketServerMaxConnectionCount{ 32u };
+
+// How much can be received from a connection without it being handled. A command must fit in this,
+// including its newline.
+static constexpr unsigned int kSocketServerReceiveBufferCapacity{ 1'024u };
+
+// How much can be waiting to be sent to a connection. Commands from a connection are only handled
+// while at least half of this is free, so that a client that doesn't read its replies stops being
+// served rather than filling up memory.
+static constexpr unsigned int kSocketServerSendBufferCapacity{ 16'384u };
+
+// The largest reply to a command that there is always room for, since commands are only handled
+// while this much of the send buffer is free.
+static constexpr unsigned int kSocketServerMaxReplySize{ kSocketServerSendBufferCapacity / 2u };
+
+// The most commands handled from each connection per tick. Any more wait for the next tick, so a
+// busy connection can't hold up the others or the controls.
+static constexpr unsigned int kSocketServerMaxCommandsPerTick{ 16u };
+
+// Types
+//
+
+// Identifies a connection for as long as it is open. IDs are not reused.
+using SocketServerConnectionID = unsigned int;
+
+// A function that is called with each command that is received. The command does not include the
+// newline, and is only valid for the duration of the call.
+using SocketServerCommandHandler = std::function<void(SocketServerConnectionID connectionID,
+	std::string_view command)>;
+
+// Statistics for the connections that the server has handled.
+struct SocketServerStatistics
+{
+	// The number of connections that are open.
+	unsigned int m_openConnectionCount = 0u;
+
+	// The number of connections that were accepted.
+	unsigned int m_acceptedConnectionCount = 0u;
+
+	// The number of connections that were closed because there were too many open.
+	unsigned int m_rejectedConnectionCount = 0u;
+
+	// The number of connections that were closed because they sent a command that was too long.
+	unsigned int m_overflowedConnectionCount = 0u;
+
+	// The number of commands that were handled.
+	unsigned int m_commandCount = 0u;
+
+	// The number of messages that couldn't be sent because there wasn't room to hold them.
+	unsigned int m_droppedSendCount = 0u;
+};
+
+// Functions
+//
+
+// Start listening for connections on a Unix domain socket. The event loop must be initialized.
+//
+// socketFileName:	The file name of the socket. Any existing file is replaced.
+// commandHandler:	The function to call with each command that is received.
+//
+// Returns:	True on success, false on failure.
+//
+bool SocketServerInitialize(char const* socketFileName,
+	SocketServerCommandHandler const& commandHandler);
+
+// Close all of the connections and stop listening.
+//
+void SocketServerUninitialize();
+
+// Handle the commands that have been received, up to a limit per connection, and close any
+// connections that have finished.
+//
+void SocketServerProcess();
+
+// Send data to a connection. Whatever can't be sent right away is held and sent once the connection
+// is ready for it. Either all of the data is sent or none of it is.
+//
+// connectionID:	The connection to send to.
+// data:				The data to send.
+//
+// Returns:	True if the data was sent or is waiting to be sent, false if the connection is closed or
+//				there isn't room to hold the data.
+//
+bool SocketServerSend(SocketServerConnectionID connectionID, std::string_view data);
+
+// Determine whether a connection is still open.
+//
+// connectionID:	The connection.
+//
+bool SocketServerIsConnectionOpen(SocketServerConnectionID connectionID);
+
+// Determine whether there are commands that have been received but not yet handled, because of the
+// limit per tick, or connections that are ready to be closed.
+//
+bool SocketServerHasPendingCommands();
+
+// Get statistics for the connections that the server has handled.
+//
+// statistics:	(Output) The statistics.
+//
+void SocketServerGetStatistics(SocketServerStatistics& statistics);
+
+// Write the socket server statistics to the logger.
+//
+void SocketServerLogStatistics();
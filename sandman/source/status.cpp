@@ -0,0 +1,629 @@
+#include "status.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "control.h"
+#include "input.h"
+#include "logger.h"
+#include "mqtt.h"
+#include "routines.h"
+
+// Types
+//
+
+// A connection that events are sent to.
+struct StatusSubscriber
+{
+	// The connection.
+	SocketServerConnectionID m_connectionID = 0u;
+
+	// How many events have been dropped since the connection was last sent one.
+	unsigned long long m_droppedEventCount = 0ull;
+};
+
+// Locals
+//
+
+// The input devices.
+static InputManager const* s_inputManager = nullptr;
+
+// The connections that events are sent to.
+static std::vector<StatusSubscriber> s_subscribers;
+
+// The sequence number of the last event.
+static unsigned long long s_lastEventSequence = 0ull;
+
+// The number of control events that had been dropped, before they could be published, when
+// sequence numbers were last skipped for them.
+static unsigned long long s_skippedControlEventCount = 0ull;
+
+// Holds each event while it is sent, so that its room is reused.
+static rapidjson::StringBuffer s_eventBuffer;
+
+// The listener that publishes the control events.
+static ControlEventListenerID s_controlEventListenerID = kInvalidControlEventListenerID;
+
+// The number of times the MQTT host has connected or disconnected, so it is odd while connected.
+// This is written by the MQTT thread, and every change is published, even several in one tick.
+static std::atomic<unsigned int> s_mqttConnectionChangeCount{ 0u };
+
+// The number of those changes that have been published.
+static unsigned int s_publishedMQTTConnectionChangeCount = 0u;
+
+// Statistics.
+static StatusSubscriptionStatistics s_subscriptionStatistics;
+
+// Functions
+//
+
+// Write the state of a control as a JSON object.
+//
+// writer:			The writer.
+// controlIndex:	The index of the control.
+// currentTime:	The current time.
+//
+static void StatusWriteControlJSON(StatusJSONWriter& writer, unsigned int controlIndex,
+	Time const& currentTime)
+{
+	ControlStatus status;
+
+	if (ControlsGetStatus(status, controlIndex) == false)
+	{
+		return;
+	}
+
+	auto const elapsedMS = std::max(std::chrono::duration_cast<Milliseconds>(currentTime -
+		status.m_stateStartTime).count(), Milliseconds::rep{ 0 });
+
+	writer.StartObject();
+
+	writer.Key("name");
+	writer.String(ControlsGetName(controlIndex));
+
+	writer.Key("state");
+	writer.String(ControlsGetStateName(status.m_state));
+
+	writer.Key("mode");
+	writer.String(ControlsGetModeName(status.m_mode));
+
+	writer.Key("waiting");
+	writer.Bool(status.m_waitingToMove);
+
+	writer.Key("elapsedMS");
+	writer.Int64(elapsedMS);
+
+	// Only states with a set duration have a time remaining.
+	writer.Key("remainingMS");
+
+	if (status.m_stateDurationMS > 0u)
+	{
+		writer.Int64(std::max(Milliseconds::rep{ status.m_stateDurationMS } - elapsedMS,
+			Milliseconds::rep{ 0 }));
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	// The position is only known as of the start of the state, which is current unless it's moving.
+	auto const moving = (status.m_state == Control::kStateMovingUp) ||
+		(status.m_state == Control::kStateMovingDown);
+
+	writer.Key("position");
+
+	if ((status.m_positionKnown == true) && (moving == false))
+	{
+		writer.Int(static_cast<int>(std::lround(status.m_positionPercent)));
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	writer.EndObject();
+}
+
+// Skip a sequence number for each control event that was dropped before it could be published, so
+// that subscribers can tell there is a gap.
+//
+static void StatusSkipDroppedControlEvents()
+{
+	auto const droppedControlEventCount = ControlsGetDroppedEventCount();
+
+	s_lastEventSequence += droppedControlEventCount - s_skippedControlEventCount;
+	s_skippedControlEventCount = droppedControlEventCount;
+}
+
+// Start writing an event, with the next sequence number.
+//
+// writer:		The writer, which writes to the event buffer.
+// eventName:	The type of event, like "control".
+//
+static void StatusStartEvent(StatusJSONWriter& writer, char const* eventName)
+{
+	StatusSkipDroppedControlEvents();
+	s_lastEventSequence++;
+
+	writer.StartObject();
+
+	writer.Key("sequence");
+	writer.Uint64(s_lastEventSequence);
+
+	writer.Key("event");
+	writer.String(eventName);
+}
+
+// Finish writing an event, and send it to every subscriber. Subscribers that can't take it have it
+// dropped.
+//
+// writer:	The writer, which writes to the event buffer.
+//
+static void StatusPublishEvent(StatusJSONWriter& writer)
+{
+	writer.EndObject();
+	s_eventBuffer.Put('\n');
+
+	std::string_view const eventLine(s_eventBuffer.GetString(), s_eventBuffer.GetSize());
+
+	for (auto& subscriber : s_subscribers)
+	{
+		// Let the subscriber know what it missed before anything else.
+		if (subscriber.m_droppedEventCount > 0u)
+		{
+			static constexpr std::size_t kNoticeCapacity{ 64u };
+			char notice[kNoticeCapacity];
+			auto const noticeLength = std::snprintf(notice, kNoticeCapacity,
+				"{\"event\":\"dropped\",\"count\":%llu}\n", subscriber.m_droppedEventCount);
+
+			if (SocketServerSend(subscriber.m_connectionID, std::string_view(notice,
+				static_cast<std::size_t>(noticeLength))) == false)
+			{
+				subscriber.m_droppedEventCount++;
+				s_subscriptionStatistics.m_droppedEventCount++;
+				continue;
+			}
+
+			subscriber.m_droppedEventCount = 0ull;
+		}
+
+		if (SocketServerSend(subscriber.m_connectionID, eventLine) == false)
+		{
+			subscriber.m_droppedEventCount++;
+			s_subscriptionStatistics.m_droppedEventCount++;
+		}
+	}
+
+	s_subscriptionStatistics.m_publishedEventCount++;
+}
+
+// Send a control event to the subscribers.
+//
+// event:	The event.
+//
+static void StatusPublishControlEvent(ControlEvent const& event)
+{
+	if (s_subscribers.empty() == true)
+	{
+		return;
+	}
+
+	s_eventBuffer.Clear();
+	StatusJSONWriter writer(s_eventBuffer);
+
+	if (event.m_type == ControlEvent::kTypeMoveWaiting)
+	{
+		StatusStartEvent(writer, "control waiting");
+
+		writer.Key("control");
+		writer.String(ControlsGetName(event.m_controlIndex));
+
+		StatusPublishEvent(writer);
+		return;
+	}
+
+	StatusStartEvent(writer, "control");
+
+	writer.Key("control");
+	writer.String(ControlsGetName(event.m_controlIndex));
+
+	writer.Key("state");
+	writer.String(ControlsGetStateName(event.m_newState));
+
+	writer.Key("previousState");
+	writer.String(ControlsGetStateName(event.m_oldState));
+
+	writer.Key("mode");
+	writer.String(ControlsGetModeName(event.m_mode));
+
+	writer.Key("durationMS");
+
+	if (event.m_stateDurationMS > 0u)
+	{
+		writer.Uint(event.m_stateDurationMS);
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	writer.Key("position");
+
+	if (event.m_positionKnown == true)
+	{
+		writer.Int(static_cast<int>(std::lround(event.m_positionPercent)));
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	StatusPublishEvent(writer);
+}
+
+// Send the MQTT host connecting or disconnecting to the subscribers, for every change that has
+// been recorded since the last time.
+//
+static void StatusPublishMQTTChanges()
+{
+	auto const changeCount = s_mqttConnectionChangeCount.load(std::memory_order_acquire);
+
+	while (s_publishedMQTTConnectionChangeCount != changeCount)
+	{
+		s_publishedMQTTConnectionChangeCount++;
+
+		if (s_subscribers.empty() == true)
+		{
+			continue;
+		}
+
+		s_eventBuffer.Clear();
+		StatusJSONWriter writer(s_eventBuffer);
+		StatusStartEvent(writer, "mqtt");
+
+		writer.Key("connected");
+		writer.Bool((s_publishedMQTTConnectionChangeCount & 1u) != 0u);
+
+		StatusPublishEvent(writer);
+	}
+}
+
+// Initialize the status.
+//
+// inputManager:	The input devices.
+//
+void StatusInitialize(InputManager const& inputManager)
+{
+	s_inputManager = &inputManager;
+	s_subscribers.clear();
+	s_lastEventSequence = 0ull;
+	s_skippedControlEventCount = ControlsGetDroppedEventCount();
+	s_subscriptionStatistics = StatusSubscriptionStatistics{};
+
+	// Only changes from here on are published.
+	s_publishedMQTTConnectionChangeCount = s_mqttConnectionChangeCount.load(
+		std::memory_order_acquire);
+
+	s_controlEventListenerID = ControlsAddEventListener(StatusPublishControlEvent);
+}
+
+// Uninitialize the status.
+//
+void StatusUninitialize()
+{
+	ControlsRemoveEventListener(s_controlEventListenerID);
+
+	s_inputManager = nullptr;
+	s_subscribers.clear();
+}
+
+// Forget subscribers that have gone away, and send the MQTT host connecting or disconnecting to
+// the rest. This must be called from the main thread once per tick.
+//
+void StatusProcess()
+{
+	// Forget the subscribers that have gone away.
+	s_subscribers.erase(std::remove_if(s_subscribers.begin(), s_subscribers.end(),
+		[](StatusSubscriber const& subscriber)
+		{
+			return SocketServerIsConnectionOpen(subscriber.m_connectionID) == false;
+		}), s_subscribers.end());
+
+	// Even if nothing else is published for a while, replies show the gap.
+	StatusSkipDroppedControlEvents();
+
+	StatusPublishMQTTChanges();
+}
+
+// Send the routine moving to a step to subscribers. This must be called from the main thread.
+//
+// stepIndex:	The index of the step the routine will perform next, or UINT_MAX if it stopped.
+//
+void StatusPublishRoutineStep(unsigned int stepIndex)
+{
+	if (s_subscribers.empty() == true)
+	{
+		return;
+	}
+
+	s_eventBuffer.Clear();
+	StatusJSONWriter writer(s_eventBuffer);
+	StatusStartEvent(writer, "routine");
+
+	writer.Key("running");
+	writer.Bool(stepIndex != UINT_MAX);
+
+	writer.Key("step");
+
+	if (stepIndex != UINT_MAX)
+	{
+		writer.Uint(stepIndex);
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	StatusPublishEvent(writer);
+}
+
+// Send an input device connecting or disconnecting to subscribers. This must be called from the
+// main thread.
+//
+// deviceIndex:	The index of the device, in the order it was configured.
+// connected:		Whether the device is now connected.
+//
+void StatusPublishInputConnection(unsigned int deviceIndex, bool connected)
+{
+	if (s_subscribers.empty() == true)
+	{
+		return;
+	}
+
+	s_eventBuffer.Clear();
+	StatusJSONWriter writer(s_eventBuffer);
+	StatusStartEvent(writer, "input");
+
+	writer.Key("device");
+	writer.Uint(deviceIndex);
+
+	writer.Key("connected");
+	writer.Bool(connected);
+
+	StatusPublishEvent(writer);
+}
+
+// Record the MQTT host connecting or disconnecting, to be sent to subscribers by StatusProcess.
+// This may be called from any thread. Recording the state it is already in does nothing.
+//
+// connected:	Whether the host is now connected.
+//
+void StatusRecordMQTTConnection(bool connected)
+{
+	auto changeCount = s_mqttConnectionChangeCount.load(std::memory_order_relaxed);
+
+	// Only count actual changes, so that the count stays odd while connected.
+	while (((changeCount & 1u) != 0u) != connected)
+	{
+		if (s_mqttConnectionChangeCount.compare_exchange_weak(changeCount, changeCount + 1u,
+			std::memory_order_release, std::memory_order_relaxed) == true)
+		{
+			return;
+		}
+	}
+}
+
+// Start sending events to a connection as they happen, one line of JSON each. Every event has a
+// sequence number, one more than the event before it, unless control events were lost before they
+// could be sent, in which case the gap shows how many. If the connection falls too far behind,
+// events are dropped for it, and it is told how many before it is sent anything else.
+//
+// connectionID:	The connection.
+//
+void StatusSubscribe(SocketServerConnectionID connectionID)
+{
+	auto const subscriberIterator = std::find_if(s_subscribers.begin(), s_subscribers.end(),
+		[connectionID](StatusSubscriber const& subscriber)
+		{
+			return subscriber.m_connectionID == connectionID;
+		});
+
+	if (subscriberIterator != s_subscribers.end())
+	{
+		return;
+	}
+
+	StatusSubscriber subscriber;
+	subscriber.m_connectionID = connectionID;
+	s_subscribers.push_back(subscriber);
+
+	Logger::WriteLine("Connection ", connectionID, " subscribed to status events.");
+}
+
+// Stop sending events to a connection.
+//
+// connectionID:	The connection.
+//
+void StatusUnsubscribe(SocketServerConnectionID connectionID)
+{
+	s_subscribers.erase(std::remove_if(s_subscribers.begin(), s_subscribers.end(),
+		[connectionID](StatusSubscriber const& subscriber)
+		{
+			return subscriber.m_connectionID == connectionID;
+		}), s_subscribers.end());
+}
+
+// Get statistics for the events that have been sent to subscribers.
+//
+// statistics:	(Output) The statistics.
+//
+void StatusGetSubscriptionStatistics(StatusSubscriptionStatistics& statistics)
+{
+	statistics = s_subscriptionStatistics;
+	statistics.m_subscriberCount = static_cast<unsigned int>(s_subscribers.size());
+}
+
+// Write the number of controls and the state of the routine, the input and MQTT as members of a
+// JSON object that has been started. This must be called from the main thread.
+//
+// writer:	The writer, inside of an object.
+//
+void StatusWriteJSON(StatusJSONWriter& writer)
+{
+	// Lets subscribers line this up with the events.
+	writer.Key("sequence");
+	writer.Uint64(s_lastEventSequence);
+
+	writer.Key("controlCount");
+	writer.Uint(ControlsGetCount());
+
+	writer.Key("routineRunning");
+	writer.Bool(RoutineIsRunning());
+
+	writer.Key("routineStep");
+
+	if (RoutineIsRunning() == true)
+	{
+		writer.Uint(RoutineGetStepIndex());
+	}
+	else
+	{
+		writer.Null();
+	}
+
+	writer.Key("inputConnected");
+	writer.Bool((s_inputManager != nullptr) && (s_inputManager->IsConnected() == true));
+
+	writer.Key("mqttConnected");
+	writer.Bool(MQTTIsConnected());
+}
+
+// Write the state of each control as members of a JSON object that has been started, stopping at
+// the first control that would take the buffer past a size. If any are left out, the number that
+// were written is also given, so that the reply still fits. This must be called from the main
+// thread.
+//
+// writer:			The writer, inside of an object.
+// buffer:			The buffer the writer writes to.
+// maxSize:			The most the buffer can hold once the controls are written.
+// currentTime:	The current time.
+//
+void StatusWriteControlsJSON(StatusJSONWriter& writer, rapidjson::StringBuffer const& buffer,
+	std::size_t maxSize, Time const& currentTime)
+{
+	// Room for closing the array and the object, and the number of controls written.
+	static constexpr std::size_t kReservedSize{ 64u };
+
+	writer.Key("controls");
+	writer.StartArray();
+
+	auto const controlCount = ControlsGetCount();
+	auto writtenCount = 0u;
+
+	// Each control is written on its own first, to see whether it fits.
+	rapidjson::StringBuffer controlBuffer;
+
+	for (; writtenCount < controlCount; writtenCount++)
+	{
+		controlBuffer.Clear();
+		StatusJSONWriter controlWriter(controlBuffer);
+		StatusWriteControlJSON(controlWriter, writtenCount, currentTime);
+
+		if (controlBuffer.GetSize() == 0u)
+		{
+			continue;
+		}
+
+		// Include the comma before it.
+		if ((buffer.GetSize() + controlBuffer.GetSize() + 1u + kReservedSize) > maxSize)
+		{
+			break;
+		}
+
+		writer.RawValue(controlBuffer.GetString(), controlBuffer.GetSize(), rapidjson::kObjectType);
+	}
+
+	writer.EndArray();
+
+	if (writtenCount < controlCount)
+	{
+		writer.Key("controlsWritten");
+		writer.Uint(writtenCount);
+	}
+}
+
+// Write the result of parsing a message and carrying out its commands as members of a JSON object
+// that has been started.
+//
+// writer:	The writer, inside of an object.
+// result:	The result.
+//
+void StatusWriteCommandResultJSON(StatusJSONWriter& writer, CommandResult const& result)
+{
+	writer.Key("result");
+	writer.String(CommandGetReturnTypeName(result.m_returnType));
+
+	if (result.m_confirmationText != nullptr)
+	{
+		writer.Key("confirmation");
+		writer.String(result.m_confirmationText);
+	}
+
+	if (result.m_controlRequestsDropped == true)
+	{
+		writer.Key("dropped");
+		writer.Bool(true);
+	}
+
+	writer.Key("actions");
+	writer.StartArray();
+
+	for (unsigned int itemIndex = 0u; itemIndex < result.m_count; itemIndex++)
+	{
+		auto const& item = result.m_items[itemIndex];
+
+		writer.StartObject();
+
+		writer.Key("type");
+		writer.String(CommandGetResultItemTypeName(item.m_type));
+
+		if (item.m_controlName != nullptr)
+		{
+			writer.Key("control");
+			writer.String(item.m_controlName);
+		}
+
+		switch (item.m_type)
+		{
+			case CommandResultItem::kTypeMove:
+			{
+				writer.Key("action");
+				writer.String(ControlsGetActionName(item.m_action));
+
+				writer.Key("durationPercent");
+				writer.Uint(item.m_parameter);
+			}
+			break;
+
+			case CommandResultItem::kTypeMoveToPosition:
+			{
+				writer.Key("position");
+				writer.Uint(item.m_parameter);
+			}
+			break;
+
+			default:
+			{
+			}
+			break;
+		}
+
+		writer.EndObject();
+	}
+
+	writer.EndArray();
+}
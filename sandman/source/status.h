@@ -0,0 +1,115 @@
+#pragma once
+
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include "command.h"
+#include "socket_server.h"
+#include "timer.h"
+
+// Types
+//
+
+// Writes compact JSON, all on one line.
+using StatusJSONWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+// Statistics for the events that have been sent to subscribers.
+struct StatusSubscriptionStatistics
+{
+	// The number of connections that are subscribed.
+	unsigned int m_subscriberCount = 0u;
+
+	// The number of events that were published.
+	unsigned long long m_publishedEventCount = 0ull;
+
+	// The number of times an event was dropped for a subscriber that was too far behind.
+	unsigned long long m_droppedEventCount = 0ull;
+};
+
+// Functions
+//
+
+// Initialize the status.
+//
+// inputManager:	The input devices.
+//
+void StatusInitialize(class InputManager const& inputManager);
+
+// Uninitialize the status.
+//
+void StatusUninitialize();
+
+// Forget subscribers that have gone away, and send the MQTT host connecting or disconnecting to
+// the rest. This must be called from the main thread once per tick.
+//
+void StatusProcess();
+
+// Send the routine moving to a step to subscribers. This must be called from the main thread.
+//
+// stepIndex:	The index of the step the routine will perform next, or UINT_MAX if it stopped.
+//
+void StatusPublishRoutineStep(unsigned int stepIndex);
+
+// Send an input device connecting or disconnecting to subscribers. This must be called from the
+// main thread.
+//
+// deviceIndex:	The index of the device, in the order it was configured.
+// connected:		Whether the device is now connected.
+//
+void StatusPublishInputConnection(unsigned int deviceIndex, bool connected);
+
+// Record the MQTT host connecting or disconnecting, to be sent to subscribers by StatusProcess.
+// This may be called from any thread. Recording the state it is already in does nothing.
+//
+// connected:	Whether the host is now connected.
+//
+void StatusRecordMQTTConnection(bool connected);
+
+// Start sending events to a connection as they happen, one line of JSON each. Every event has a
+// sequence number, one more than the event before it, unless control events were lost before they
+// could be sent, in which case the gap shows how many. If the connection falls too far behind,
+// events are dropped for it, and it is told how many before it is sent anything else.
+//
+// connectionID:	The connection.
+//
+void StatusSubscribe(SocketServerConnectionID connectionID);
+
+// Stop sending events to a connection.
+//
+// connectionID:	The connection.
+//
+void StatusUnsubscribe(SocketServerConnectionID connectionID);
+
+// Get statistics for the events that have been sent to subscribers.
+//
+// statistics:	(Output) The statistics.
+//
+void StatusGetSubscriptionStatistics(StatusSubscriptionStatistics& statistics);
+
+// Write the number of controls and the state of the routine, the input and MQTT as members of a
+// JSON object that has been started. This must be called from the main thread.
+//
+// writer:	The writer, inside of an object.
+//
+void StatusWriteJSON(StatusJSONWriter& writer);
+
+// Write the state of each control as members of a JSON object that has been started, stopping at
+// the first control that would take the buffer past a size. If any are left out, the number that
+// were written is also given, so that the reply still fits. This must be called from the main
+// thread.
+//
+// writer:			The writer, inside of an object.
+// buffer:			The buffer the writer writes to.
+// maxSize:			The most the buffer can hold once the controls are written.
+// currentTime:	The current time.
+//
+void StatusWriteControlsJSON(StatusJSONWriter& writer, rapidjson::StringBuffer const& buffer,
+	std::size_t maxSize, Time const& currentTime);
+
+// Write the result of parsing a message and carrying out its commands as members of a JSON object
+// that has been started.
+//
+// writer:	The writer, inside of an object.
+// result:	The result.
+//
+void StatusWriteCommandResultJSON(StatusJSONWriter& writer, CommandResult const& result);
@@ -0,0 +1,341 @@
+#include "status_page.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "input.h"
+#include "logger.h"
+#include "mqtt.h"
+#include "profiler.h"
+#include "routines.h"
+
+// Locals
+//
+
+// The page, as mapped into memory, or null if there isn't one.
+static StatusPage* s_page = nullptr;
+
+// The size of the page, as mapped into memory.
+static std::size_t s_pageSize = 0u;
+
+// The contents and the controls are put together here, so that the page is only being written for
+// as long as it takes to copy them.
+static StatusPageContents s_contents;
+static std::vector<StatusPageControl> s_pageControls;
+
+// Whether controls have been left out because there were more than the page has room for.
+static bool s_controlsLeftOut = false;
+
+// The input devices.
+static InputManager const* s_inputManager = nullptr;
+
+// Wakes the main loop when nothing else has for a heartbeat, so that the page is rewritten.
+static Scheduler* s_scheduler = nullptr;
+static Scheduler::SlotID s_heartbeatSlotID = Scheduler::kInvalidSlotID;
+
+// The latest snapshot of the controls.
+static std::vector<ControlStatus> s_controlStatuses;
+
+// Functions
+//
+
+// Write the contents to the page, so that readers never see half of a write.
+//
+static void StatusPagePublish()
+{
+	auto const sequence = s_page->m_sequence.load(std::memory_order_relaxed);
+
+	// Mark the page as being written before any of the contents change.
+	s_page->m_sequence.store(sequence + 1u, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(&s_page->m_contents, &s_contents, sizeof(StatusPageContents));
+
+	if (s_contents.m_controlCount > 0u)
+	{
+		auto* const pageControls = const_cast<StatusPageControl*>(StatusPageGetControls(*s_page));
+		std::memcpy(pageControls, s_pageControls.data(),
+						s_contents.m_controlCount * sizeof(StatusPageControl));
+	}
+
+	s_page->m_sequence.store(sequence + 2u, std::memory_order_release);
+}
+
+// Put together a control, as it is written to the page.
+//
+// pageControl:		(Output) The control.
+// controlIndex:	The index of the control.
+// status:			The status of the control.
+// currentTime:		The current time.
+//
+static void StatusPageGetControl(StatusPageControl& pageControl, unsigned int controlIndex,
+	ControlStatus const& status, Time const& currentTime)
+{
+	std::strncpy(pageControl.m_name, ControlsGetName(controlIndex),
+					 kStatusPageControlNameCapacity - 1u);
+	pageControl.m_name[kStatusPageControlNameCapacity - 1u] = '\0';
+
+	pageControl.m_state = status.m_state;
+	pageControl.m_desiredAction = status.m_desiredAction;
+	pageControl.m_mode = status.m_mode;
+	pageControl.m_waitingToMove = (status.m_waitingToMove == true) ? 1u : 0u;
+	pageControl.m_stateStartTimeNS = status.m_stateStartTime.time_since_epoch().count();
+
+	// Only states with a set duration have a time remaining.
+	if (status.m_stateDurationMS > 0u)
+	{
+		auto const elapsedMS = std::chrono::duration_cast<Milliseconds>(currentTime -
+			status.m_stateStartTime).count();
+
+		pageControl.m_stateDurationMS = status.m_stateDurationMS;
+		pageControl.m_remainingMS = static_cast<std::uint32_t>(std::clamp(
+			Milliseconds::rep{ status.m_stateDurationMS } - elapsedMS, Milliseconds::rep{ 0 },
+			Milliseconds::rep{ status.m_stateDurationMS }));
+	}
+	else
+	{
+		pageControl.m_stateDurationMS = kStatusPageNone;
+		pageControl.m_remainingMS = kStatusPageNone;
+	}
+
+	pageControl.m_positionPercent = (status.m_positionKnown == true) ?
+		static_cast<std::uint32_t>(std::lround(status.m_positionPercent)) : kStatusPageNone;
+	pageControl.m_padding = 0u;
+}
+
+// Create the status page and map it into memory. Failing to do so isn't fatal; the page just isn't
+// written.
+//
+// fileName:		The file name of the page. Any existing file is replaced.
+// inputManager:	The input devices.
+// scheduler:		Used to rewrite the page even when nothing else wakes the main loop.
+//
+// Returns:	True on success, false on failure.
+//
+bool StatusPageInitialize(char const* fileName, InputManager const& inputManager,
+	Scheduler& scheduler)
+{
+	// Anything still reading an old page keeps it, rather than seeing this one being set up.
+	unlink(fileName);
+
+	auto const fileDescriptor = open(fileName, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+	if (fileDescriptor < 0)
+	{
+		Logger::WriteLine(Shell::Yellow("Failed to create status page \""), fileName,
+								Shell::Yellow("\"."));
+		return false;
+	}
+
+	// Make room for every control.
+	auto const controlCapacity = ControlsGetCount();
+	auto const pageSize = StatusPageGetSize(controlCapacity);
+
+	if (ftruncate(fileDescriptor, static_cast<off_t>(pageSize)) < 0)
+	{
+		Logger::WriteLine(Shell::Yellow("Failed to size status page \""), fileName,
+								Shell::Yellow("\"."));
+		close(fileDescriptor);
+		return false;
+	}
+
+	auto* const address = mmap(nullptr, pageSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+										fileDescriptor, 0);
+
+	// The mapping holds on to the file by itself.
+	close(fileDescriptor);
+
+	if (address == MAP_FAILED)
+	{
+		Logger::WriteLine(Shell::Yellow("Failed to map status page \""), fileName,
+								Shell::Yellow("\"."));
+		return false;
+	}
+
+	s_page = new (address) StatusPage;
+	s_page->m_magic = kStatusPageMagic;
+	s_page->m_version = kStatusPageVersion;
+	s_page->m_sequence.store(0u, std::memory_order_relaxed);
+	s_page->m_controlCapacity = controlCapacity;
+	s_pageSize = pageSize;
+
+	s_inputManager = &inputManager;
+	s_contents = StatusPageContents{};
+	s_pageControls.assign(controlCapacity, StatusPageControl{});
+	s_controlsLeftOut = false;
+	s_contents.m_processID = static_cast<std::uint32_t>(getpid());
+
+	// The page is rewritten at the end of every tick, so waking up is all the heartbeat has to do.
+	s_scheduler = &scheduler;
+	s_heartbeatSlotID = s_scheduler->AddSlot([](Time const&) {});
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	StatusPageUpdate(currentTime);
+
+	return true;
+}
+
+// Mark the page as no longer current, and unmap it. The file is left for readers to find.
+//
+void StatusPageUninitialize()
+{
+	if (s_page == nullptr)
+	{
+		return;
+	}
+
+	s_contents.m_processID = 0u;
+	StatusPagePublish();
+
+	munmap(s_page, s_pageSize);
+	s_page = nullptr;
+	s_pageSize = 0u;
+	s_inputManager = nullptr;
+
+	s_scheduler->RemoveSlot(s_heartbeatSlotID);
+	s_scheduler = nullptr;
+}
+
+// Write the current state to the page. This must be called from the main thread once per tick.
+//
+// currentTime:	The current time.
+//
+void StatusPageUpdate(Time const& currentTime)
+{
+	if (s_page == nullptr)
+	{
+		return;
+	}
+
+	s_contents.m_updateTimeNS = currentTime.time_since_epoch().count();
+
+	// Put off the heartbeat, since the page has just been rewritten.
+	s_scheduler->ArmSlot(s_heartbeatSlotID, currentTime + Milliseconds(kStatusPageHeartbeatMS));
+
+	auto const stepIndex = RoutineGetStepIndex();
+	s_contents.m_routineStepIndex = (stepIndex != UINT_MAX) ? stepIndex : kStatusPageNone;
+
+	s_contents.m_inputConnected = ((s_inputManager != nullptr) &&
+		(s_inputManager->IsConnected() == true)) ? 1u : 0u;
+	s_contents.m_mqttConnected = (MQTTIsConnected() == true) ? 1u : 0u;
+
+	ProfilerTickCounters tickCounters;
+	ProfilerGetTickCounters(tickCounters);
+	s_contents.m_tickCount = tickCounters.m_tickCount;
+	s_contents.m_slowTickCount = tickCounters.m_slowTickCount;
+	s_contents.m_lastTickDurationNS = tickCounters.m_lastTickDuration.count();
+	s_contents.m_maximumTickDurationNS = tickCounters.m_maximumTickDuration.count();
+
+	// Read the controls the same way whether or not they run on their own thread. In the rare case
+	// that the controls kept changing during every read, the page keeps the controls it had.
+	Time snapshotTime;
+	unsigned int snapshotCount = 0u;
+
+	if (ControlsGetSnapshot(s_controlStatuses, snapshotTime, snapshotCount) == false)
+	{
+		StatusPagePublish();
+		return;
+	}
+
+	// The page is sized for the controls when it is created, so this only happens if controls are
+	// added afterwards.
+	auto const controlCount = std::min(static_cast<unsigned int>(s_controlStatuses.size()),
+		s_page->m_controlCapacity);
+
+	if ((controlCount < s_controlStatuses.size()) && (s_controlsLeftOut == false))
+	{
+		Logger::WriteLine(Shell::Yellow("The status page only has room for "), controlCount,
+								Shell::Yellow(" of the "), s_controlStatuses.size(),
+								Shell::Yellow(" controls."));
+		s_controlsLeftOut = true;
+	}
+
+	s_contents.m_controlCount = controlCount;
+
+	for (unsigned int controlIndex = 0u; controlIndex < controlCount; controlIndex++)
+	{
+		StatusPageGetControl(s_pageControls[controlIndex], controlIndex,
+			s_controlStatuses[controlIndex], currentTime);
+	}
+
+	StatusPagePublish();
+}
+
+// Get the size of a status page, including its controls.
+//
+// controlCapacity:	The number of controls that the page has room for.
+//
+// Returns:	The size of the page (in bytes).
+//
+std::size_t StatusPageGetSize(unsigned int controlCapacity)
+{
+	return sizeof(StatusPage) + (controlCapacity * sizeof(StatusPageControl));
+}
+
+// Get the controls of a status page, which follow the StatusPage structure.
+//
+// page:	The page, as mapped into memory, including its controls.
+//
+// Returns:	The first of the page's m_controlCapacity controls.
+//
+StatusPageControl const* StatusPageGetControls(StatusPage const& page)
+{
+	return reinterpret_cast<StatusPageControl const*>(&page + 1);
+}
+
+// Read a consistent copy of the contents of a status page, and its controls, which may be being
+// written by another process.
+//
+// contents:	(Output) The copy of the contents.
+// controls:	(Output) The copy of the controls, one for each of m_controlCount.
+// page:			The page, as mapped into memory, including its controls.
+//
+// Returns:	True on success, false if no consistent copy could be read in kStatusPageMaxReadAttempts
+//				tries, such as when the daemon stopped partway through writing the page. Check
+//				m_processID, or how old m_updateTimeNS is, to tell whether it is still running.
+//
+bool StatusPageRead(StatusPageContents& contents, std::vector<StatusPageControl>& controls,
+	StatusPage const& page)
+{
+	for (unsigned int attemptIndex = 0u; attemptIndex < kStatusPageMaxReadAttempts; attemptIndex++)
+	{
+		auto const sequenceBefore = page.m_sequence.load(std::memory_order_acquire);
+
+		// The writer only holds the page for as long as a copy takes, so just try again.
+		if ((sequenceBefore & 1u) != 0u)
+		{
+			continue;
+		}
+
+		std::memcpy(&contents, &page.m_contents, sizeof(StatusPageContents));
+
+		// The count may be torn, so never trust it past the room the page has.
+		controls.resize(std::min(contents.m_controlCount, page.m_controlCapacity));
+
+		if (controls.empty() == false)
+		{
+			std::memcpy(controls.data(), StatusPageGetControls(page),
+							controls.size() * sizeof(StatusPageControl));
+		}
+
+		// Make sure the copy is finished before looking at the sequence again.
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (page.m_sequence.load(std::memory_order_relaxed) == sequenceBefore)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "scheduler.h"
+#include "timer.h"
+
+class InputManager;
+
+// The status page is a file that the daemon keeps mapped into memory and rewrites every tick, so
+// that local programs can map it too and read the state without a system call or a round trip to
+// the daemon.
+//
+// Every member has a fixed size, so that the layout doesn't depend on the compiler. Times are in
+// nanoseconds on CLOCK_MONOTONIC, the same clock as Clock::now().
+//
+// The page has room for every control: the StatusPage structure is followed straight away by
+// m_controlCapacity StatusPageControl records, so the whole page takes StatusPageGetSize() bytes.
+// Map the structure first to find the capacity, then the whole page.
+//
+// The page is protected by a sequence lock. To read a consistent copy:
+//
+//	1. Read m_sequence. If it is odd, the page is being written, so start again.
+//	2. Copy whatever is needed out of the contents and the controls.
+//	3. Read m_sequence again. If it has changed, the copy may be torn, so start again.
+//
+// StatusPageRead() does this for C++ readers. If the daemon stops in the middle of a write, the
+// sequence stays odd, so readers should give up after a while rather than waiting for it forever.
+//
+// The daemon rewrites the page at least every kStatusPageHeartbeatMS, even when nothing is
+// happening, so a page whose m_updateTimeNS is several heartbeats old belongs to a daemon that is
+// stuck or gone.
+
+// Constants
+//
+
+// Identifies a status page ("SNDM"), and the version of its layout. The version changes whenever
+// the layout does.
+static constexpr std::uint32_t kStatusPageMagic{ 0x4D444E53u };
+static constexpr std::uint32_t kStatusPageVersion{ 2u };
+
+// The room for each control's name, including the terminator.
+static constexpr unsigned int kStatusPageControlNameCapacity{ 32u };
+
+// The longest the daemon goes without rewriting the page (in milliseconds).
+static constexpr unsigned int kStatusPageHeartbeatMS{ 1'000u };
+
+// How many times StatusPageRead() tries to read the page before giving up. The writer only holds
+// the page for as long as a copy takes, so this is only reached if it stopped partway through.
+static constexpr unsigned int kStatusPageMaxReadAttempts{ 100'000u };
+
+// Signifies that something isn't known or doesn't apply, for unsigned members.
+static constexpr std::uint32_t kStatusPageNone{ UINT32_MAX };
+
+// Types
+//
+
+// A control, as it is written to the status page.
+struct StatusPageControl
+{
+	// The name of the control.
+	char m_name[kStatusPageControlNameCapacity];
+
+	// The state (Control::State), the desired action (Control::Actions) and the movement mode
+	// (Control::Modes).
+	std::uint32_t m_state;
+	std::uint32_t m_desiredAction;
+	std::uint32_t m_mode;
+
+	// Whether the control is waiting for the move limits before moving.
+	std::uint32_t m_waitingToMove;
+
+	// When the state started.
+	std::int64_t m_stateStartTimeNS;
+
+	// How long the state is expected to last (in milliseconds), and how much of that was left when
+	// the page was written, or kStatusPageNone for states that last until something changes them.
+	std::uint32_t m_stateDurationMS;
+	std::uint32_t m_remainingMS;
+
+	// The estimated position as of the start of the state (in percent), or kStatusPageNone if it
+	// isn't known.
+	std::uint32_t m_positionPercent;
+
+	std::uint32_t m_padding;
+};
+
+// What the status page holds, apart from its header.
+struct StatusPageContents
+{
+	// The process ID of the daemon, or 0 once it has stopped, after which nothing is current.
+	std::uint32_t m_processID;
+
+	// The number of controls that are current, which is never more than m_controlCapacity.
+	std::uint32_t m_controlCount;
+
+	// When the page was last written.
+	std::int64_t m_updateTimeNS;
+
+	// The index of the routine step that is running, or kStatusPageNone if no routine is running.
+	std::uint32_t m_routineStepIndex;
+
+	// Whether any input device, and the MQTT host, are connected.
+	std::uint32_t m_inputConnected;
+	std::uint32_t m_mqttConnected;
+
+	std::uint32_t m_padding;
+
+	// Tick timing: the number of ticks, how many went over budget, and how long the last and the
+	// longest took.
+	std::uint64_t m_tickCount;
+	std::uint64_t m_slowTickCount;
+	std::int64_t m_lastTickDurationNS;
+	std::int64_t m_maximumTickDurationNS;
+};
+
+// The layout of the status page.
+struct StatusPage
+{
+	// kStatusPageMagic and kStatusPageVersion.
+	std::uint32_t m_magic;
+	std::uint32_t m_version;
+
+	// Odd while the contents are being written. Goes up by two with every write.
+	std::atomic<std::uint32_t> m_sequence;
+
+	// The number of controls that the page has room for. This never changes once the page is
+	// created, so it can be read without the sequence lock.
+	std::uint32_t m_controlCapacity;
+
+	StatusPageContents m_contents;
+
+	// The controls follow.
+};
+
+// Other processes rely on the sequence being a plain 32-bit word that they can read directly.
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free == true);
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+static_assert(std::is_standard_layout_v<StatusPage> == true);
+static_assert(std::is_trivially_copyable_v<StatusPageContents> == true);
+static_assert(std::is_trivially_copyable_v<StatusPageControl> == true);
+static_assert((sizeof(StatusPage) % alignof(StatusPageControl)) == 0u);
+
+// Functions
+//
+
+// Create the status page and map it into memory. Failing to do so isn't fatal; the page just isn't
+// written.
+//
+// fileName:		The file name of the page. Any existing file is replaced.
+// inputManager:	The input devices.
+// scheduler:		Used to rewrite the page even when nothing else wakes the main loop.
+//
+// Returns:	True on success, false on failure.
+//
+bool StatusPageInitialize(char const* fileName, InputManager const& inputManager,
+	Scheduler& scheduler);
+
+// Mark the page as no longer current, and unmap it. The file is left for readers to find.
+//
+void StatusPageUninitialize();
+
+// Write the current state to the page. This must be called from the main thread once per tick.
+//
+// currentTime:	The current time.
+//
+void StatusPageUpdate(Time const& currentTime);
+
+// Get the size of a status page, including its controls.
+//
+// controlCapacity:	The number of controls that the page has room for.
+//
+// Returns:	The size of the page (in bytes).
+//
+std::size_t StatusPageGetSize(unsigned int controlCapacity);
+
+// Get the controls of a status page, which follow the StatusPage structure.
+//
+// page:	The page, as mapped into memory, including its controls.
+//
+// Returns:	The first of the page's m_controlCapacity controls.
+//
+StatusPageControl const* StatusPageGetControls(StatusPage const& page);
+
+// Read a consistent copy of the contents of a status page, and its controls, which may be being
+// written by another process.
+//
+// contents:	(Output) The copy of the contents.
+// controls:	(Output) The copy of the controls, one for each of m_controlCount.
+// page:			The page, as mapped into memory, including its controls.
+//
+// Returns:	True on success, false if no consistent copy could be read in kStatusPageMaxReadAttempts
+//				tries, such as when the daemon stopped partway through writing the page. Check
+//				m_processID, or whether m_updateTimeNS is more than a few kStatusPageHeartbeatMS
+//				old, to tell whether it is still running.
+//
+bool StatusPageRead(StatusPageContents& contents, std::vector<StatusPageControl>& controls,
+	StatusPage const& page);
@@ -1,36 +1,36 @@
 #pragma once
 
-#include <stdint.h>
+#include <chrono>
+#include <cstdint>
 
 // Types
 //
 
-// Represents a point in time useful for elapsed time.
-struct Time
+// A monotonic clock counting whole nanoseconds. Unlike the system time, it never jumps, so
+// elapsed times measured with it can't be thrown off by NTP or by someone setting the clock.
+struct Clock
 {
-	// The portion of the time in seconds.
-	uint64_t m_seconds = 0;
-	
-	// The portion of the time in nanoseconds.
-	uint64_t m_nanoseconds = 0;	
-
-	friend auto operator<(const Time& left, const Time& right)
-	{
-		if (left.m_seconds != right.m_seconds)
-		{
-			return left.m_seconds < right.m_seconds;
-		}
-
-		return left.m_nanoseconds < right.m_nanoseconds;
-	}
-
-	friend auto operator>(const Time& left, const Time& right)
-	{
-		return right < left;
-	}
+	using rep = int64_t;
+	using period = std::nano;
+	using duration = std::chrono::duration<rep, period>;
+	using time_point = std::chrono::time_point<Clock>;
+
+	static constexpr bool is_steady = true;
 
+	// Get the current time.
+	//
+	static time_point now() noexcept;
 };
 
+// Represents a point in time useful for elapsed time.
+using Time = Clock::time_point;
+
+// Integer durations.
+using Nanoseconds = Clock::duration;
+using Microseconds = std::chrono::microseconds;
+using Milliseconds = std::chrono::milliseconds;
+using Seconds = std::chrono::seconds;
+
 // Functions
 //
 
@@ -39,11 +39,3 @@ struct Time
 // time:	(Output) The current time.
 //
 void TimerGetCurrent(Time& time);
-
-// Get the elapsed time in milliseconds between two times.
-// Note: Will return -1 if the end time is less than the start time.
-//
-// startTime:	Start time.
-// endTime:		End time.
-//
-float TimerGetElapsedMilliseconds(Time const& startTime, Time const& endTime);
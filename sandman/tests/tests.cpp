@@ -1,9 +1,39 @@
 #include "catch_amalgamated.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "command.h"
 #include "config.h"
+#include "control_queue.h"
+#include "control_thread.h"
+#include "event_loop.h"
 #include "gpio.h"
+#include "input.h"
 #include "logger.h"
+#include "profiler.h"
 #include "routines.h"
+#include "scheduler.h"
+#include "socket_server.h"
+#include "status.h"
+#include "status_page.h"
 
 class TestRunListener : public Catch::EventListenerBase
 {
@@ -27,6 +57,45 @@ public:
 
 CATCH_REGISTER_LISTENER(TestRunListener)
 
+// Count heap allocations, so that tests can check that something doesn't allocate.
+static std::atomic<unsigned int> s_allocationCount{ 0u };
+
+void* operator new(std::size_t size)
+{
+	s_allocationCount.fetch_add(1u, std::memory_order_relaxed);
+
+	if (auto* const memory = std::malloc((size > 0u) ? size : 1u))
+	{
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
 
 TEST_CASE("Test missing config", "[config]")
 {
@@ -67,8 +136,23 @@ TEST_CASE("Test default config", "[config]")
 
 	REQUIRE(config.GetControlMaxMovingDurationMS() == 100000);
 	REQUIRE(config.GetControlCoolDownDurationMS() == 25);
+	REQUIRE(config.GetControlMaxMovingControls() == 2);
+	REQUIRE(config.GetControlStartStaggerMS() == 250);
 
-	std::vector<InputBinding> const& inputBindings = config.GetInputBindings();
+	// The controls run on the main thread by default.
+	REQUIRE(config.GetControlThreadConfig().m_enabled == false);
+
+	REQUIRE(config.GetSimulateGPIO() == false);
+	REQUIRE(config.GetGPIOTimelineFormat() == kGPIOTimelineFormatCSV);
+
+	std::vector<InputDeviceConfig> const& inputDeviceConfigs = config.GetInputDeviceConfigs();
+	REQUIRE(inputDeviceConfigs.size() == 1);
+	if (inputDeviceConfigs.empty() == true)
+	{
+		return;
+	}
+
+	std::vector<InputBinding> const& inputBindings = inputDeviceConfigs[0].m_bindings;
 	REQUIRE(inputBindings.size() == 6);
 	if (inputBindings.size() > 5)
 	{
@@ -148,6 +232,297 @@ TEST_CASE("Test example routine", "[routines]")
 	}
 }
 
+TEST_CASE("Test command tokenizer", "[command]")
+{
+	CommandTokenBuffer commandTokens;
+
+	// Names are matched regardless of case, and alternatives map to the same token.
+	auto const allocationCountBefore = s_allocationCount.load();
+	CommandTokenizeString(commandTokens, "Back UP 50");
+	CommandTokenizeString(commandTokens, "legs to 30 percent");
+	REQUIRE(s_allocationCount.load() == allocationCountBefore);
+
+	REQUIRE(commandTokens.m_count == 4u);
+	REQUIRE(commandTokens.m_tokens[0].m_type == CommandToken::kTypeLegs);
+	REQUIRE(commandTokens.m_tokens[1].m_type == CommandToken::kTypeTo);
+	REQUIRE(commandTokens.m_tokens[2].m_type == CommandToken::kTypeInteger);
+	REQUIRE(commandTokens.m_tokens[2].m_parameter == 30u);
+	REQUIRE(commandTokens.m_tokens[3].m_type == CommandToken::kTypePercent);
+
+	CommandTokenizeString(commandTokens, "Back UP 50");
+	REQUIRE(commandTokens.m_count == 3u);
+	REQUIRE(commandTokens.m_tokens[0].m_type == CommandToken::kTypeBack);
+	REQUIRE(commandTokens.m_tokens[1].m_type == CommandToken::kTypeRaise);
+	REQUIRE(commandTokens.m_tokens[2].m_parameter == 50u);
+
+	// Anything else is invalid, including names with something extra.
+	CommandTokenizeString(commandTokens, "elevations 12a stop");
+	REQUIRE(commandTokens.m_count == 3u);
+	REQUIRE(commandTokens.m_tokens[0].m_type == CommandToken::kTypeInvalid);
+	REQUIRE(commandTokens.m_tokens[1].m_type == CommandToken::kTypeInvalid);
+	REQUIRE(commandTokens.m_tokens[2].m_type == CommandToken::kTypeStop);
+
+	// Tokens past the capacity are ignored.
+	std::string longCommand;
+
+	for (unsigned int tokenIndex = 0u; tokenIndex < CommandTokenBuffer::kCapacity + 4u; tokenIndex++)
+	{
+		longCommand += (tokenIndex == 0u) ? "status" : " status";
+	}
+
+	CommandTokenizeString(commandTokens, longCommand);
+	REQUIRE(commandTokens.m_count == CommandTokenBuffer::kCapacity);
+}
+
+TEST_CASE("Test command batches", "[command]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	InputManager inputManager;
+	CommandInitialize(inputManager, scheduler);
+
+	Control* backControl = Control::GetByName("back");
+	Control* legsControl = Control::GetByName("legs");
+	Control* elevationControl = Control::GetByName("elev");
+	REQUIRE(backControl != nullptr);
+	REQUIRE(legsControl != nullptr);
+	REQUIRE(elevationControl != nullptr);
+
+	if ((backControl != nullptr) && (legsControl != nullptr) && (elevationControl != nullptr))
+	{
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		CommandTokenBuffer commandTokens;
+
+		// Nothing happens until a reboot is confirmed, including the commands before it.
+		CommandTokenizeString(commandTokens, "back up reboot");
+		REQUIRE(CommandParseTokens(commandTokens) ==
+				  CommandParseTokensReturnTypes::kMissingConfirmation);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		CommandTokenizeString(commandTokens, "please");
+		REQUIRE(CommandParseTokens(commandTokens) == CommandParseTokensReturnTypes::kInvalid);
+
+		// Every command in the message starts in the same tick. An incomplete command is dropped
+		// without losing the ones after it.
+		CommandTokenizeString(commandTokens, "back up 50 legs elevation down 30 legs to 40 percent");
+		REQUIRE(CommandParseTokens(commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+		REQUIRE(elevationControl->GetState() == Control::kStateMovingDown);
+		REQUIRE(legsControl->GetState() != Control::kStateIdle);
+
+		ControlQueueStatistics statistics;
+		ControlQueueGetStatistics(statistics);
+		REQUIRE(statistics.m_queuedCount == 3u);
+		REQUIRE(statistics.m_takenCount == 3u);
+
+		// A stop in the same message comes after the moves before it.
+		CommandTokenizeString(commandTokens, "back up stop");
+		REQUIRE(CommandParseTokens(commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(elevationControl->GetState() == Control::kStateCoolDown);
+
+		currentTime += Milliseconds(config.GetControlCoolDownDurationMS());
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		// A stop is never dropped, even when the queue is full, and still comes after the moves
+		// queued before it.
+		ControlRequestBatch batch;
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		REQUIRE(batch.Submit() == true);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+
+		while (batch.Submit() == true)
+		{
+			batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		}
+
+		ControlsStopAll();
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+
+		currentTime += Milliseconds(config.GetControlCoolDownDurationMS());
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		// The same goes for a stop in a message, even though the moves with it are dropped.
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		REQUIRE(batch.Submit() == true);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+
+		while (batch.Submit() == true)
+		{
+			batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		}
+
+		CommandResult result;
+		CommandTokenizeString(commandTokens, "elevation up stop");
+		REQUIRE(CommandParseTokens(result, commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+		REQUIRE(result.m_controlRequestsDropped == true);
+
+		// Only what was carried out is reported.
+		REQUIRE(result.m_count == 1u);
+		REQUIRE(result.m_items[0].m_type == CommandResultItem::kTypeStopAll);
+
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(elevationControl->GetState() == Control::kStateIdle);
+
+		// And so does stopping a single control, such as when its key is released.
+		currentTime += Milliseconds(config.GetControlCoolDownDurationMS());
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		REQUIRE(batch.Submit() == true);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+
+		while (batch.Submit() == true)
+		{
+			batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		}
+
+		backControl->SetDesiredAction(Control::kActionStopped, Control::kModeManual);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+	}
+
+	CommandUninitialize();
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test command results and status", "[command]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	InputManager inputManager;
+	CommandInitialize(inputManager, scheduler);
+	StatusInitialize(inputManager);
+
+	CommandTokenBuffer commandTokens;
+	CommandResult result;
+
+	CommandTokenizeString(commandTokens, "reboot");
+	REQUIRE(CommandParseTokens(result, commandTokens) ==
+			  CommandParseTokensReturnTypes::kMissingConfirmation);
+	REQUIRE(result.m_confirmationText != nullptr);
+	REQUIRE(result.m_count == 0u);
+
+	// Only the commands that were carried out are reported.
+	CommandTokenizeString(commandTokens, "back up 50 legs to 40 percent elevation to 200");
+	REQUIRE(CommandParseTokens(result, commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+	REQUIRE(result.m_count == 2u);
+	REQUIRE(result.m_items[0].m_type == CommandResultItem::kTypeMove);
+	REQUIRE(std::strcmp(result.m_items[0].m_controlName, "back") == 0);
+	REQUIRE(result.m_items[0].m_action == Control::kActionMovingUp);
+	REQUIRE(result.m_items[0].m_parameter == 50u);
+	REQUIRE(result.m_items[1].m_type == CommandResultItem::kTypeMoveToPosition);
+	REQUIRE(result.m_items[1].m_parameter == 40u);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	ControlsProcess(currentTime);
+	ControlsDispatchEvents();
+
+	rapidjson::StringBuffer buffer;
+	StatusJSONWriter writer(buffer);
+	writer.StartObject();
+	StatusWriteCommandResultJSON(writer, result);
+	StatusWriteJSON(writer);
+	StatusWriteControlsJSON(writer, buffer, kSocketServerMaxReplySize, currentTime);
+	writer.EndObject();
+
+	rapidjson::Document document;
+	document.Parse(buffer.GetString());
+	REQUIRE(document.HasParseError() == false);
+	REQUIRE(std::string(document["result"].GetString()) == "success");
+	REQUIRE(document["actions"].Size() == 2u);
+	REQUIRE(std::string(document["actions"][0]["control"].GetString()) == "back");
+	REQUIRE(document["actions"][0]["durationPercent"].GetUint() == 50u);
+	REQUIRE(document["routineRunning"].GetBool() == false);
+
+	// The back was the first control configured.
+	auto const& backStatus = document["controls"][0];
+	REQUIRE(std::string(backStatus["name"].GetString()) == "back");
+	REQUIRE(std::string(backStatus["state"].GetString()) == "moving up");
+	REQUIRE(backStatus["remainingMS"].GetInt64() > 0);
+	REQUIRE(backStatus["position"].IsNull() == true);
+	REQUIRE(document["controlCount"].GetUint() == 3u);
+	REQUIRE(document.HasMember("controlsWritten") == false);
+
+	// Controls that don't fit are left out, and the rest still make a whole object.
+	buffer.Clear();
+	writer.Reset(buffer);
+	writer.StartObject();
+	StatusWriteJSON(writer);
+	auto const maxSize = buffer.GetSize() + 200u;
+	StatusWriteControlsJSON(writer, buffer, maxSize, currentTime);
+	writer.EndObject();
+	REQUIRE(buffer.GetSize() <= maxSize);
+
+	document.Parse(buffer.GetString());
+	REQUIRE(document.HasParseError() == false);
+	REQUIRE(document["controlsWritten"].GetUint() == document["controls"].Size());
+	REQUIRE(document["controls"].Size() < 3u);
+
+	StatusUninitialize();
+	CommandUninitialize();
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Benchmark command tokenizer", "[.][benchmark]")
+{
+	CommandTokenBuffer commandTokens;
+
+	// That tokenizing doesn't allocate is checked in "Test command tokenizer", since Catch's own
+	// bookkeeping allocates while benchmarking.
+	BENCHMARK("tokenize a command")
+	{
+		CommandTokenizeString(commandTokens, "elevation lower 75");
+		return commandTokens.m_count;
+	};
+}
+
 TEST_CASE("Test controls", "[control]")
 {
 	Config config;
@@ -162,7 +537,8 @@ TEST_CASE("Test controls", "[control]")
 		static constexpr bool kEnableGPIO = false;
 		GPIOInitialize(kEnableGPIO);
 
-		ControlsInitialize(controlConfigs);
+		Scheduler scheduler;
+		ControlsInitialize(controlConfigs, scheduler);
 
 		Control::SetDurations(config.GetControlMaxMovingDurationMS(), 
 									 config.GetControlCoolDownDurationMS());
@@ -173,6 +549,25 @@ TEST_CASE("Test controls", "[control]")
 			REQUIRE(control == nullptr);
 		}
 
+		// Handles are looked up once and refer to the same controls.
+		{
+			auto const invalidHandle = ControlHandle::Resolve("chicken");
+			REQUIRE(invalidHandle.IsValid() == false);
+			REQUIRE(invalidHandle.GetControl() == nullptr);
+
+			auto const legsHandle = ControlHandle::Resolve("legs");
+			REQUIRE(legsHandle.IsValid() == true);
+			REQUIRE(legsHandle.GetControl() == Control::GetByName("legs"));
+
+			ControlAction action("elev", Control::kActionMovingUp);
+			REQUIRE(action.GetControl() == nullptr);
+			REQUIRE(action.ResolveControl() == true);
+			REQUIRE(action.GetControl() == Control::GetByName("elev"));
+
+			ControlAction unknownAction("chicken", Control::kActionMovingUp);
+			REQUIRE(unknownAction.ResolveControl() == false);
+		}
+
 		Control* legControl = Control::GetByName("legs");
 		REQUIRE(legControl != nullptr);
 		if (legControl != nullptr)
@@ -193,5 +588,1800 @@ TEST_CASE("Test controls", "[control]")
 		{
 			REQUIRE(elevationControl->GetState() == Control::kStateIdle);
 		}
+
+		// Only a control with a new desired action is processed, and it schedules its own timer.
+		Control::Enable(true);
+
+		if (backControl != nullptr)
+		{
+			backControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+
+			Time currentTime;
+			TimerGetCurrent(currentTime);
+			ControlsProcess(currentTime);
+
+			REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+			REQUIRE(scheduler.GetTimerCount() == 1u);
+
+			// The state timer works from the tick's time, not whatever the clock says.
+			auto const movingDuration = Milliseconds(controlConfigs[0].m_movingDurationMS);
+
+			scheduler.Process(currentTime + movingDuration - Milliseconds(1));
+			REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+			scheduler.Process(currentTime + movingDuration);
+			REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+			REQUIRE(ControlsGetActiveCount() == 1u);
+
+			// Stopping everything stops the controls that were just asked to move as well.
+			if ((legControl != nullptr) && (elevationControl != nullptr))
+			{
+				legControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+				ControlsProcess(currentTime + movingDuration);
+				REQUIRE(legControl->GetState() == Control::kStateMovingUp);
+
+				elevationControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+				ControlsStopAll();
+				ControlsProcess(currentTime + movingDuration);
+				REQUIRE(legControl->GetState() == Control::kStateCoolDown);
+				REQUIRE(elevationControl->GetState() == Control::kStateIdle);
+				REQUIRE(ControlsGetActiveCount() == 2u);
+			}
+		}
+
+		Control::Enable(false);
+		ControlsUninitialize();
+		GPIOUninitialize();
+
+		REQUIRE(scheduler.GetTimerCount() == 0u);
+	}
+}
+
+TEST_CASE("Test control positions", "[control]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	if (backControl != nullptr)
+	{
+		auto const movingDuration = Milliseconds(config.GetControlConfigs()[0].m_movingDurationMS);
+		auto const coolDownDuration = Milliseconds(config.GetControlCoolDownDurationMS());
+
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		// The position isn't known yet, so the control finds the nearer end first.
+		REQUIRE(backControl->IsPositionKnown() == false);
+		backControl->SetDesiredPosition(30u);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingDown);
+
+		currentTime += movingDuration;
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(backControl->IsPositionKnown() == true);
+		REQUIRE(std::lround(backControl->EstimatePositionPercent(currentTime)) == 0l);
+
+		// Then it carries on to the position once it has cooled down.
+		currentTime += coolDownDuration;
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+		auto const positionPercent =
+			backControl->EstimatePositionPercent(currentTime + movingDuration / 10);
+		REQUIRE(std::lround(positionPercent) == 10l);
+
+		currentTime += movingDuration * 3 / 10;
+		scheduler.Process(currentTime - Milliseconds(1));
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(std::lround(backControl->EstimatePositionPercent(currentTime)) == 30l);
+
+		// Moving to where it already is does nothing.
+		currentTime += coolDownDuration;
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		backControl->SetDesiredPosition(30u);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		// Moving down only takes as long as the distance needs.
+		backControl->SetDesiredPosition(20u);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingDown);
+
+		currentTime += movingDuration / 10;
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(std::lround(backControl->EstimatePositionPercent(currentTime)) == 20l);
+
+		// A timed move in a direction only lasts until the end, plus the overrun.
+		currentTime += coolDownDuration;
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		backControl->SetDesiredAction(Control::kActionMovingDown, Control::kModeTimed);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingDown);
+
+		currentTime += movingDuration * 3 / 10;
+		scheduler.Process(currentTime - Milliseconds(1));
+		REQUIRE(backControl->GetState() == Control::kStateMovingDown);
+		scheduler.Process(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(std::lround(backControl->EstimatePositionPercent(currentTime)) == 0l);
+	}
+
+	// Positions can be read from routine steps.
+	{
+		rapidjson::Document document;
+		document.Parse(R"({ "control" : "back", "position" : 30 })");
+
+		ControlAction action;
+		REQUIRE(action.ReadFromJSON(document) == true);
+		REQUIRE(action.HasTargetPosition() == true);
+		REQUIRE(action.m_targetPercent == 30u);
+
+		document.Parse(R"({ "control" : "back", "position" : 130 })");
+		REQUIRE(action.ReadFromJSON(document) == false);
+
+		document.Parse(R"({ "control" : "back", "action" : "up" })");
+		REQUIRE(action.ReadFromJSON(document) == true);
+		REQUIRE(action.HasTargetPosition() == false);
+	}
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test control move limits", "[control]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::SetMoveLimits(config.GetControlMaxMovingControls(), config.GetControlStartStaggerMS());
+	Control::Enable(true);
+
+	std::vector<ControlEvent> events;
+	auto listenerID = ControlsAddEventListener([&events](ControlEvent const& event)
+	{
+		events.push_back(event);
+	});
+
+	Control* backControl = Control::GetByName("back");
+	Control* legsControl = Control::GetByName("legs");
+	Control* elevationControl = Control::GetByName("elev");
+	REQUIRE(backControl != nullptr);
+	REQUIRE(legsControl != nullptr);
+	REQUIRE(elevationControl != nullptr);
+
+	if ((backControl != nullptr) && (legsControl != nullptr) && (elevationControl != nullptr))
+	{
+		auto const startStagger = Milliseconds(config.GetControlStartStaggerMS());
+		auto const& legsConfig = config.GetControlConfigs()[1];
+		auto const legsMovingDuration = Milliseconds(legsConfig.m_movingDurationMS);
+
+		Time startTime;
+		TimerGetCurrent(startTime);
+
+		// Only the first control starts, the others wait in line.
+		backControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+		legsControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+		elevationControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+		ControlsProcess(startTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+		REQUIRE(legsControl->GetState() == Control::kStateIdle);
+		REQUIRE(elevationControl->GetState() == Control::kStateIdle);
+		REQUIRE(ControlsGetActiveCount() == 1u);
+
+		// The next one starts once the stagger has passed, and the last one hits the limit.
+		auto const legsStartTime = startTime + startStagger;
+		scheduler.Process(legsStartTime - Milliseconds(1));
+		REQUIRE(legsControl->GetState() == Control::kStateIdle);
+		scheduler.Process(legsStartTime);
+		REQUIRE(legsControl->GetState() == Control::kStateMovingUp);
+		REQUIRE(elevationControl->GetState() == Control::kStateIdle);
+
+		// The last one starts as soon as another stops.
+		auto const legsStopTime = legsStartTime + legsMovingDuration;
+		scheduler.Process(legsStopTime);
+		REQUIRE(legsControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(elevationControl->GetState() == Control::kStateMovingUp);
+		REQUIRE(ControlsGetActiveCount() == 3u);
+
+		// How long each move waited is kept once it's been reported.
+		REQUIRE(events.empty() == true);
+		ControlsDispatchEvents();
+
+		// The waiting controls were reported before their moves, and only the last one hit the limit.
+		auto waitingCount = 0u;
+
+		for (auto const& event : events)
+		{
+			if (event.m_type == ControlEvent::kTypeMoveWaiting)
+			{
+				waitingCount++;
+			}
+		}
+
+		REQUIRE(waitingCount == 2u);
+		REQUIRE(events.back().m_type == ControlEvent::kTypeStateChanged);
+		REQUIRE(std::string(ControlsGetName(events.back().m_controlIndex)) == "elev");
+		REQUIRE(events.back().m_oldState == Control::kStateIdle);
+		REQUIRE(events.back().m_newState == Control::kStateMovingUp);
+		REQUIRE(events.back().m_moveStartDelay == legsStopTime - startTime);
+
+		ProfilerStatistics statistics;
+		ControlsGetMoveStartDelayStatistics(statistics);
+		REQUIRE(statistics.m_sampleCount == 3u);
+		REQUIRE(statistics.m_minimum == Nanoseconds{ 0 });
+		REQUIRE(statistics.m_maximum == legsStopTime - startTime);
+
+		// A control that no longer wants to move leaves the line.
+		auto const legsIdleTime = legsStopTime + Milliseconds(config.GetControlCoolDownDurationMS());
+		scheduler.Process(legsIdleTime);
+		REQUIRE(legsControl->GetState() == Control::kStateIdle);
+
+		legsControl->SetDesiredAction(Control::kActionMovingDown, Control::kModeTimed);
+		ControlsProcess(legsIdleTime);
+		REQUIRE(legsControl->GetState() == Control::kStateIdle);
+
+		legsControl->SetDesiredAction(Control::kActionStopped, Control::kModeManual);
+		ControlsProcess(legsIdleTime);
+
+		scheduler.Process(legsStopTime + legsMovingDuration);
+		REQUIRE(elevationControl->GetState() == Control::kStateCoolDown);
+		REQUIRE(legsControl->GetState() == Control::kStateIdle);
+	}
+
+	ControlsRemoveEventListener(listenerID);
+	REQUIRE(listenerID == kInvalidControlEventListenerID);
+
+	Control::SetMoveLimits(0u, 0u);
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Benchmark controls scaling", "[.][benchmark]")
+{
+	static constexpr bool kEnableGPIO = false;
+	static constexpr unsigned int kMovingDurationMS{ 1'000u };
+	static constexpr unsigned int kCoolDownDurationMS{ 25u };
+
+	// How many moves are timed in each run, and how many runs the fastest is taken from.
+	static constexpr unsigned int kTimedMoveCount{ 1'000u };
+	static constexpr unsigned int kTimedRunCount{ 5u };
+
+	// Moving one control shouldn't get much slower however many others sit idle. Work that grew with
+	// the number of controls would be hundreds of times slower at the most.
+	static constexpr double kMaxMoveTimeRatio{ 3.0 };
+
+	std::vector<Nanoseconds> moveTimes;
+
+	for (auto const controlCount : { 3u, 10u, 100u, 1'000u })
+	{
+		GPIOInitialize(kEnableGPIO);
+
+		// Only the first control is moved, the rest sit idle.
+		std::vector<ControlConfig> controlConfigs(controlCount);
+
+		for (unsigned int controlIndex = 0u; controlIndex < controlCount; controlIndex++)
+		{
+			auto& controlConfig = controlConfigs[controlIndex];
+			std::snprintf(controlConfig.m_name, ControlConfig::kControlNameCapacity, "control%u",
+							  controlIndex);
+			controlConfig.m_upGPIOPin = (controlIndex == 0u) ? 5 : -1;
+			controlConfig.m_downGPIOPin = (controlIndex == 0u) ? 19 : -1;
+			controlConfig.m_movingDurationMS = kMovingDurationMS;
+		}
+
+		Scheduler scheduler;
+		ControlsInitialize(controlConfigs, scheduler);
+		Control::SetDurations(kMovingDurationMS, kCoolDownDurationMS);
+		Control::Enable(true);
+
+		Control* control = Control::GetByName("control0");
+		REQUIRE(control != nullptr);
+
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		auto const countText = std::to_string(controlCount);
+
+		// A whole move, from the request through to the control being idle again.
+		BENCHMARK("move one of " + countText + " controls")
+		{
+			control->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+			ControlsProcess(currentTime);
+
+			currentTime += Milliseconds(kMovingDurationMS);
+			scheduler.Process(currentTime);
+			currentTime += Milliseconds(kCoolDownDurationMS);
+			scheduler.Process(currentTime);
+
+			ControlsDispatchEvents();
+			return control->GetState();
+		};
+
+		BENCHMARK("stop all of " + countText + " controls")
+		{
+			ControlsStopAll();
+			ControlsProcess(currentTime);
+			return ControlsGetActiveCount();
+		};
+
+		auto fastestRunTime = Nanoseconds::max();
+
+		for (unsigned int runIndex = 0u; runIndex < kTimedRunCount; runIndex++)
+		{
+			Time runStartTime;
+			TimerGetCurrent(runStartTime);
+
+			for (unsigned int moveIndex = 0u; moveIndex < kTimedMoveCount; moveIndex++)
+			{
+				control->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+				ControlsProcess(currentTime);
+
+				currentTime += Milliseconds(kMovingDurationMS);
+				scheduler.Process(currentTime);
+				currentTime += Milliseconds(kCoolDownDurationMS);
+				scheduler.Process(currentTime);
+
+				ControlsDispatchEvents();
+			}
+
+			Time runEndTime;
+			TimerGetCurrent(runEndTime);
+			fastestRunTime = std::min(fastestRunTime, Nanoseconds(runEndTime - runStartTime));
+		}
+
+		moveTimes.push_back(fastestRunTime / kTimedMoveCount);
+
+		Control::Enable(false);
+		ControlsUninitialize();
+		GPIOUninitialize();
+	}
+
+	auto const [fastestMoveTime, slowestMoveTime] = std::minmax_element(moveTimes.begin(),
+		moveTimes.end());
+	auto const moveTimeRatio = static_cast<double>(slowestMoveTime->count()) /
+		static_cast<double>(std::max(fastestMoveTime->count(), Nanoseconds::rep{ 1 }));
+	INFO("Moving one control took " << fastestMoveTime->count() << " ns at best and "
+		  << slowestMoveTime->count() << " ns at worst.");
+	REQUIRE(moveTimeRatio < kMaxMoveTimeRatio);
+}
+
+TEST_CASE("Test simulated GPIO timeline", "[gpio]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	static constexpr bool kSimulateGPIO = true;
+	GPIOInitialize(kEnableGPIO, kSimulateGPIO);
+	REQUIRE(GPIOIsSimulated() == true);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	// Acquiring the pins turns them off, which isn't a change.
+	std::vector<GPIOTransition> timeline;
+	GPIOGetTimeline(timeline);
+	REQUIRE(timeline.empty() == true);
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	if (backControl != nullptr)
+	{
+		auto const& backConfig = config.GetControlConfigs()[0];
+		auto const movingDuration = Milliseconds(backConfig.m_movingDurationMS);
+		auto const coolDownDuration = Milliseconds(config.GetControlCoolDownDurationMS());
+
+		Time startTime;
+		TimerGetCurrent(startTime);
+
+		// Raise, then lower part way through.
+		backControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeManual);
+		ControlsProcess(startTime);
+		REQUIRE(GPIOIsPinOn(backConfig.m_upGPIOPin) == true);
+
+		auto const reverseTime = startTime + Milliseconds(500);
+		backControl->SetDesiredAction(Control::kActionMovingDown, Control::kModeTimed);
+		ControlsProcess(reverseTime);
+		REQUIRE(GPIOIsPinOn(backConfig.m_upGPIOPin) == false);
+		REQUIRE(GPIOIsPinOn(backConfig.m_downGPIOPin) == true);
+
+		// Run the timers out.
+		scheduler.Process(reverseTime + movingDuration);
+		scheduler.Process(reverseTime + movingDuration + coolDownDuration);
+		REQUIRE(backControl->GetState() == Control::kStateIdle);
+
+		// The direction change happens in one commit, and the cool down to idle changes nothing.
+		GPIOGetTimeline(timeline);
+		REQUIRE(timeline.size() == 4u);
+
+		if (timeline.size() == 4u)
+		{
+			REQUIRE(timeline[0].m_pin == backConfig.m_upGPIOPin);
+			REQUIRE(timeline[0].m_on == true);
+			REQUIRE(timeline[0].m_decisionTime == startTime);
+
+			REQUIRE(timeline[1].m_pin == backConfig.m_upGPIOPin);
+			REQUIRE(timeline[1].m_on == false);
+			REQUIRE(timeline[2].m_pin == backConfig.m_downGPIOPin);
+			REQUIRE(timeline[2].m_on == true);
+			REQUIRE(timeline[1].m_decisionTime == reverseTime);
+			REQUIRE(timeline[2].m_decisionTime == reverseTime);
+			REQUIRE(timeline[1].m_writeTime == timeline[2].m_writeTime);
+
+			REQUIRE(timeline[3].m_pin == backConfig.m_downGPIOPin);
+			REQUIRE(timeline[3].m_on == false);
+			REQUIRE(timeline[3].m_decisionTime == reverseTime + movingDuration);
+		}
+
+		// One header line and one line for each transition.
+		auto const timelineFileName = SANDMAN_TEST_BUILD_DIR "gpio_timeline.csv";
+		REQUIRE(GPIOWriteTimeline(timelineFileName, kGPIOTimelineFormatCSV) == true);
+
+		std::ifstream timelineFile(timelineFileName);
+		unsigned int lineCount = 0u;
+		for (std::string line; std::getline(timelineFile, line); )
+		{
+			lineCount++;
+		}
+
+		REQUIRE(lineCount == 5u);
 	}
-}
\ No newline at end of file
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test GPIO redundant writes", "[gpio]")
+{
+	static constexpr bool kEnableGPIO = false;
+	static constexpr bool kSimulateGPIO = true;
+	GPIOInitialize(kEnableGPIO, kSimulateGPIO);
+
+	GPIOAcquireOutputPin(5);
+	GPIOAcquireOutputPin(19);
+
+	// Pins outside of the table can't be acquired.
+	GPIOAcquireOutputPin(-1);
+	GPIOAcquireOutputPin(1'000);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	// Nothing has been set, so there is nothing to write.
+	GPIOCommit(currentTime);
+
+	GPIOStatistics statistics;
+	GPIOGetStatistics(statistics);
+	REQUIRE(statistics.m_commitCount == 0ull);
+	REQUIRE(statistics.m_skippedCommitCount == 1ull);
+
+	// Turning a pin on is written once, and turning it on again is skipped.
+	GPIOSetPinOn(5);
+	GPIOSetPinOff(19);
+	GPIOCommit(currentTime);
+	GPIOSetPinOn(5);
+	GPIOCommit(currentTime);
+	REQUIRE(GPIOIsPinOn(5) == true);
+	REQUIRE(GPIOIsPinOn(19) == false);
+
+	GPIOGetStatistics(statistics);
+	REQUIRE(statistics.m_commitCount == 1ull);
+	REQUIRE(statistics.m_skippedCommitCount == 2ull);
+	REQUIRE(statistics.m_pinChangeCount == 1ull);
+	REQUIRE(statistics.m_skippedPinChangeCount == 2ull);
+
+	std::vector<GPIOTransition> timeline;
+	GPIOGetTimeline(timeline);
+	REQUIRE(timeline.size() == 1u);
+
+	GPIOResetStatistics();
+	GPIOGetStatistics(statistics);
+	REQUIRE(statistics.m_commitCount == 0ull);
+	REQUIRE(statistics.m_skippedPinChangeCount == 0ull);
+
+	GPIOUninitialize();
+	REQUIRE(GPIOIsPinOn(5) == false);
+}
+
+TEST_CASE("Test control request queue", "[control]")
+{
+	ControlQueueReset();
+
+	// Requests come out in the order they went in, until the queue fills up.
+	for (unsigned int requestIndex = 0u; requestIndex < kControlQueueCapacity + 1u; requestIndex++)
+	{
+		ControlRequest const request{ 0u, Control::kActionMovingUp, Control::kModeTimed,
+			requestIndex };
+		REQUIRE(ControlQueuePush(request) == (requestIndex < kControlQueueCapacity));
+	}
+
+	ControlQueueEntry entry;
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	for (unsigned int requestIndex = 0u; requestIndex < kControlQueueCapacity; requestIndex++)
+	{
+		REQUIRE(ControlQueuePop(entry, currentTime) == true);
+		REQUIRE(entry.m_request.m_movingDurationMS == requestIndex);
+		REQUIRE(entry.m_sequenceNumber == requestIndex);
+	}
+
+	REQUIRE(ControlQueuePop(entry, currentTime) == false);
+
+	ControlQueueStatistics statistics;
+	ControlQueueGetStatistics(statistics);
+	REQUIRE(statistics.m_queuedCount == kControlQueueCapacity);
+	REQUIRE(statistics.m_droppedCount == 1u);
+	REQUIRE(statistics.m_takenCount == kControlQueueCapacity);
+	REQUIRE(statistics.m_maxDepth == kControlQueueCapacity);
+
+	// A batch is queued whole or not at all.
+	std::vector<ControlRequest> requests(kControlQueueCapacity,
+		ControlRequest{ 0u, Control::kActionMovingUp, Control::kModeTimed, 0u });
+	REQUIRE(ControlQueuePushBatch(requests.data(), kControlQueueCapacity - 1u) == true);
+	REQUIRE(ControlQueuePushBatch(requests.data(), 2u) == false);
+	REQUIRE(ControlQueuePushBatch(requests.data(), 1u) == true);
+
+	for (unsigned int requestIndex = 0u; requestIndex < kControlQueueCapacity; requestIndex++)
+	{
+		REQUIRE(ControlQueuePop(entry, currentTime) == true);
+		REQUIRE(entry.m_batchRemainingCount == ((requestIndex < kControlQueueCapacity - 1u) ?
+			kControlQueueCapacity - 2u - requestIndex : 0u));
+	}
+
+	ControlQueueGetStatistics(statistics);
+	REQUIRE(statistics.m_droppedCount == 3u);
+
+	// Several producers at once, each waiting for room when the queue is full. Each producer's
+	// requests must come out in order, with none lost.
+	ControlQueueReset();
+
+	static constexpr unsigned int kProducerCount{ 4u };
+	static constexpr unsigned int kRequestsPerProducer{ 5'000u };
+
+	std::vector<std::thread> producers;
+
+	for (unsigned int producerIndex = 0u; producerIndex < kProducerCount; producerIndex++)
+	{
+		producers.emplace_back([producerIndex]()
+		{
+			for (unsigned int requestIndex = 0u; requestIndex < kRequestsPerProducer; requestIndex++)
+			{
+				ControlRequest const request{ producerIndex, Control::kActionMovingUp,
+					Control::kModeTimed, requestIndex };
+
+				while (ControlQueuePush(request) == false)
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::vector<unsigned int> nextRequestIndices(kProducerCount, 0u);
+	unsigned int takenCount = 0u;
+	bool inOrder = true;
+	std::size_t lastSequenceNumber = 0u;
+
+	while (takenCount < kProducerCount * kRequestsPerProducer)
+	{
+		if (ControlQueuePop(entry, currentTime) == false)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		auto& nextRequestIndex = nextRequestIndices[entry.m_request.m_controlIndex];
+		inOrder = inOrder && (entry.m_request.m_movingDurationMS == nextRequestIndex) &&
+			((takenCount == 0u) || (entry.m_sequenceNumber == lastSequenceNumber + 1u));
+
+		nextRequestIndex++;
+		lastSequenceNumber = entry.m_sequenceNumber;
+		takenCount++;
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+
+	REQUIRE(inOrder == true);
+	REQUIRE(ControlQueuePop(entry, currentTime) == false);
+
+	ControlQueueGetStatistics(statistics);
+	REQUIRE(statistics.m_queuedCount == kProducerCount * kRequestsPerProducer);
+	REQUIRE(statistics.m_takenCount == kProducerCount * kRequestsPerProducer);
+	REQUIRE(statistics.m_maxDepth <= kControlQueueCapacity);
+
+	ControlQueueReset();
+}
+
+TEST_CASE("Test control thread", "[control]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	// The control timers have to run on the control thread.
+	ControlsInitialize(config.GetControlConfigs(), ControlThreadGetScheduler());
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	// Don't depend on having permission to lock memory or use real-time scheduling here. Failing to
+	// get a real-time priority is only logged.
+	ControlThreadConfig threadConfig;
+	threadConfig.m_enabled = true;
+	threadConfig.m_lockMemory = false;
+
+	bool const started = ControlThreadStart(threadConfig);
+	REQUIRE(started == true);
+	REQUIRE(ControlThreadIsRunning() == true);
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	if (backControl != nullptr)
+	{
+		// The request is handed to the control thread, which should act on it right away.
+		backControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+
+		// Watch for the move through the snapshot, since the control itself belongs to the thread.
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+		auto const deadline = currentTime + Milliseconds(5'000);
+
+		std::vector<ControlStatus> statuses;
+		Time snapshotTime;
+		unsigned int snapshotCount = 0u;
+		bool sawMove = false;
+
+		while ((sawMove == false) && (currentTime < deadline))
+		{
+			std::this_thread::sleep_for(Milliseconds(1));
+			TimerGetCurrent(currentTime);
+
+			sawMove = (ControlsGetSnapshot(statuses, snapshotTime, snapshotCount) == true) &&
+				(statuses[0].m_state == Control::kStateMovingUp);
+		}
+
+		REQUIRE(sawMove == true);
+	}
+
+	// Once the thread has stopped, the controls can be looked at from here again.
+	ControlThreadStop();
+	REQUIRE(ControlThreadIsRunning() == false);
+
+	if (backControl != nullptr)
+	{
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+	}
+
+	// The transition is passed on from this thread.
+	ControlsDispatchEvents();
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+
+	REQUIRE(ControlThreadGetScheduler().GetTimerCount() == 0u);
+}
+
+TEST_CASE("Test control snapshots", "[control]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	ControlsInitialize(config.GetControlConfigs(), ControlThreadGetScheduler());
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	auto const controlCount = ControlsGetCount();
+
+	std::vector<ControlStatus> statuses;
+	Time snapshotTime;
+	unsigned int firstSnapshotCount = 0u;
+	REQUIRE(ControlsGetSnapshot(statuses, snapshotTime, firstSnapshotCount) == true);
+	REQUIRE(statuses.size() == controlCount);
+	REQUIRE(statuses[0].m_state == Control::kStateIdle);
+
+	// Ticks in which nothing changes don't take a snapshot.
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	ControlsProcess(currentTime);
+	unsigned int snapshotCount = 0u;
+	REQUIRE(ControlsGetSnapshot(statuses, snapshotTime, snapshotCount) == true);
+	REQUIRE(snapshotCount == firstSnapshotCount);
+
+	ControlThreadConfig threadConfig;
+	threadConfig.m_enabled = true;
+	threadConfig.m_lockMemory = false;
+	REQUIRE(ControlThreadStart(threadConfig) == true);
+
+	// Read the snapshots from other threads while the controls change.
+	std::atomic<bool> stopReading{ false };
+	std::atomic<unsigned int> badSnapshotCount{ 0u };
+	std::vector<std::thread> readers;
+
+	for (auto readerIndex = 0u; readerIndex < 2u; readerIndex++)
+	{
+		readers.emplace_back([&stopReading, &badSnapshotCount, controlCount]()
+		{
+			std::vector<ControlStatus> readerStatuses;
+			Time readerSnapshotTime;
+			unsigned int lastSnapshotCount = 0u;
+
+			while (stopReading == false)
+			{
+				unsigned int readerSnapshotCount = 0u;
+				auto const read = ControlsGetSnapshot(readerStatuses, readerSnapshotTime,
+					readerSnapshotCount);
+
+				if ((read == false) || (readerSnapshotCount < lastSnapshotCount) ||
+					 (readerStatuses.size() != controlCount))
+				{
+					badSnapshotCount++;
+				}
+
+				lastSnapshotCount = readerSnapshotCount;
+			}
+		});
+	}
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	if (backControl != nullptr)
+	{
+		backControl->SetDesiredAction(Control::kActionMovingUp, Control::kModeTimed);
+	}
+
+	// The snapshot shows the move without stopping the thread.
+	bool sawMove = false;
+
+	for (auto attemptIndex = 0u; (attemptIndex < 100u) && (sawMove == false); attemptIndex++)
+	{
+		std::this_thread::sleep_for(Milliseconds(10));
+		sawMove = (ControlsGetSnapshot(statuses, snapshotTime, snapshotCount) == true) &&
+			(statuses[0].m_state == Control::kStateMovingUp);
+	}
+
+	REQUIRE(sawMove == true);
+	REQUIRE(statuses[0].m_desiredAction == Control::kActionMovingUp);
+	REQUIRE(statuses[0].m_mode == Control::kModeTimed);
+	REQUIRE(statuses[0].m_stateDurationMS > 0u);
+	REQUIRE(snapshotCount > firstSnapshotCount);
+
+	stopReading = true;
+
+	for (auto& reader : readers)
+	{
+		reader.join();
+	}
+
+	REQUIRE(badSnapshotCount == 0u);
+
+	ControlThreadStop();
+	ControlsDispatchEvents();
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test input manager", "[input]")
+{
+	// Two devices that can't be opened.
+	std::vector<InputDeviceConfig> inputDeviceConfigs(2);
+	std::strcpy(inputDeviceConfigs[0].m_deviceName, "/nonexistent/pendant");
+	std::strcpy(inputDeviceConfigs[1].m_deviceName, "/nonexistent/gamepad");
+
+	Scheduler scheduler;
+	InputManager inputManager;
+	inputManager.Initialize(inputDeviceConfigs, scheduler);
+
+	REQUIRE(inputManager.GetDeviceCount() == 2u);
+	REQUIRE(inputManager.IsConnected() == false);
+	REQUIRE(inputManager.IsDeviceConnected(0u) == false);
+	REQUIRE(inputManager.IsDeviceConnected(1u) == false);
+	REQUIRE(inputManager.IsDeviceConnected(2u) == false);
+
+	// Without the event loop, new device nodes can't be watched for, so one timer looks for both.
+	REQUIRE(inputManager.IsWatchingForDevices() == false);
+	REQUIRE(scheduler.GetTimerCount() == 1u);
+
+	inputManager.Uninitialize();
+	REQUIRE(inputManager.GetDeviceCount() == 0u);
+	REQUIRE(scheduler.GetTimerCount() == 0u);
+}
+
+TEST_CASE("Test input key dispatch", "[input]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	// Two keys raise the back and another lowers it.
+	InputDeviceConfig inputDeviceConfig;
+	inputDeviceConfig.m_bindings.emplace_back(310, ControlAction("back", Control::kActionMovingUp));
+	inputDeviceConfig.m_bindings.emplace_back(311, ControlAction("back", Control::kActionMovingUp));
+	inputDeviceConfig.m_bindings.emplace_back(312,
+		ControlAction("back", Control::kActionMovingDown));
+
+	Input input;
+	input.Initialize(inputDeviceConfig, 0u, nullptr);
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	if (backControl != nullptr)
+	{
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+
+		input.HandleKeyEvent(310, 1);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		// Autorepeat keeps it going.
+		input.HandleKeyEvent(310, 2);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		// Releasing one of two held keys keeps it going.
+		input.HandleKeyEvent(311, 1);
+		input.HandleKeyEvent(310, 0);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+
+		// Releasing the last one stops it.
+		input.HandleKeyEvent(311, 0);
+		ControlsProcess(currentTime);
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+
+		// A release for a key that isn't held is ignored, as are unbound and out of range keys.
+		input.HandleKeyEvent(312, 0);
+		input.HandleKeyEvent(313, 1);
+		input.HandleKeyEvent(KEY_CNT + 10, 1);
+	}
+
+	input.Uninitialize();
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test input event filtering", "[input]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	InputDeviceConfig inputDeviceConfig;
+	inputDeviceConfig.m_grab = true;
+	inputDeviceConfig.m_bindings.emplace_back(310, ControlAction("back", Control::kActionMovingUp));
+	inputDeviceConfig.m_bindings.emplace_back(312,
+		ControlAction("back", Control::kActionMovingDown));
+
+	Input input;
+	input.Initialize(inputDeviceConfig, 0u, nullptr);
+
+	// The kernel is only asked for reports and the bound keys.
+	InputEventMaskBits maskBits;
+	input.GetEventMaskBits(maskBits);
+
+	auto const isBitSet = [](auto const& bits, unsigned int bitIndex)
+	{
+		return ((bits[bitIndex / 8u] >> (bitIndex % 8u)) & 1u) != 0u;
+	};
+
+	REQUIRE(isBitSet(maskBits.m_typeBits, EV_SYN) == true);
+	REQUIRE(isBitSet(maskBits.m_typeBits, EV_KEY) == true);
+	REQUIRE(isBitSet(maskBits.m_typeBits, EV_REL) == false);
+	REQUIRE(isBitSet(maskBits.m_typeBits, EV_ABS) == false);
+	REQUIRE(isBitSet(maskBits.m_typeBits, EV_MSC) == false);
+
+	unsigned int keyBitCount = 0u;
+
+	for (unsigned int keyCode = 0u; keyCode < KEY_CNT; keyCode++)
+	{
+		keyBitCount += isBitSet(maskBits.m_keyBits, keyCode) ? 1u : 0u;
+	}
+
+	REQUIRE(keyBitCount == 2u);
+	REQUIRE(isBitSet(maskBits.m_keyBits, 310u) == true);
+	REQUIRE(isBitSet(maskBits.m_keyBits, 312u) == true);
+
+	// A pipe stands in for the device node. It can't be filtered or grabbed, so everything written
+	// to it is read, and the device is kept anyway.
+	REQUIRE(EventLoopInitialize() == true);
+
+	int pipeFileHandles[2];
+	REQUIRE(pipe2(pipeFileHandles, O_NONBLOCK | O_CLOEXEC) == 0);
+
+	auto const writeEvent = [&pipeFileHandles](unsigned short type, unsigned short code, int value)
+	{
+		input_event event{};
+		event.type = type;
+		event.code = code;
+		event.value = value;
+		REQUIRE(write(pipeFileHandles[1], &event, sizeof(event)) == sizeof(event));
+	};
+
+	// A bound press, a movement, and an unbound key, each followed by a report.
+	writeEvent(EV_KEY, 310, 1);
+	writeEvent(EV_SYN, SYN_REPORT, 0);
+	writeEvent(EV_REL, REL_X, 5);
+	writeEvent(EV_SYN, SYN_REPORT, 0);
+	writeEvent(EV_KEY, 311, 1);
+	writeEvent(EV_SYN, SYN_REPORT, 0);
+
+	REQUIRE(input.AttachDevice(pipeFileHandles[0], "/test/pipe") == true);
+	REQUIRE(input.IsConnected() == true);
+	REQUIRE(std::string(input.GetOpenPath()) == "/test/pipe");
+
+	// The open device is recognized by the node itself, whatever path leads to it.
+	struct stat deviceStatus;
+	auto const linkPath = "/proc/self/fd/" + std::to_string(pipeFileHandles[1]);
+	REQUIRE(stat(linkPath.c_str(), &deviceStatus) == 0);
+	REQUIRE(input.IsDeviceOpen(deviceStatus) == true);
+	REQUIRE(stat(SANDMAN_TEST_DATA_DIR "sandman.conf", &deviceStatus) == 0);
+	REQUIRE(input.IsDeviceOpen(deviceStatus) == false);
+	REQUIRE(input.IsEventMaskInstalled() == false);
+	REQUIRE(input.IsGrabbed() == false);
+
+	// Events already waiting are read as the device is attached.
+	auto const& statistics = input.GetStatistics();
+	REQUIRE(statistics.m_wakeUpCount == 1u);
+	REQUIRE(statistics.m_eventCount == 6u);
+	REQUIRE(statistics.m_ignoredEventCount == 2u);
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	ControlsProcess(currentTime);
+
+	if (backControl != nullptr)
+	{
+		REQUIRE(backControl->GetState() == Control::kStateMovingUp);
+	}
+
+	// Later events wake the event loop.
+	writeEvent(EV_KEY, 310, 0);
+	writeEvent(EV_SYN, SYN_REPORT, 0);
+	EventLoopWait();
+
+	REQUIRE(statistics.m_wakeUpCount == 2u);
+	REQUIRE(statistics.m_eventCount == 8u);
+	REQUIRE(statistics.m_ignoredEventCount == 2u);
+
+	ControlsProcess(currentTime);
+
+	if (backControl != nullptr)
+	{
+		REQUIRE(backControl->GetState() == Control::kStateCoolDown);
+	}
+
+	// The input owns the read end.
+	input.Uninitialize();
+	REQUIRE(input.IsConnected() == false);
+	close(pipeFileHandles[1]);
+
+	EventLoopUninitialize();
+
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test input device matching", "[input]")
+{
+	rapidjson::Document document;
+	document.Parse(R"({ "name" : "Pendant", "vendorID" : "0x045e", "productID" : 654,
+		"grab" : true, "bindings" : [] })");
+	REQUIRE(document.HasParseError() == false);
+
+	InputDeviceConfig config;
+	REQUIRE(config.CanMatch() == false);
+	REQUIRE(config.ReadFromJSON(document) == true);
+	REQUIRE(config.CanMatch() == true);
+	REQUIRE(config.m_vendorID == 0x045e);
+	REQUIRE(config.m_productID == 654);
+	REQUIRE(config.m_grab == true);
+
+	// Any node will do, as long as the name and IDs match.
+	REQUIRE(config.Matches("/dev/input/event3", "Pendant", 0x045e, 654) == true);
+	REQUIRE(config.Matches("/dev/input/event7", "Pendant", 0x045e, 654) == true);
+	REQUIRE(config.Matches("/dev/input/event3", "Gamepad", 0x045e, 654) == false);
+	REQUIRE(config.Matches("/dev/input/event3", "Pendant", 0x045f, 654) == false);
+	REQUIRE(config.Matches("/dev/input/event3", "Pendant", 0x045e, 655) == false);
+
+	// A path narrows it down to one node.
+	std::strcpy(config.m_deviceName, "/dev/input/event3");
+	REQUIRE(config.Matches("/dev/input/event3", "Pendant", 0x045e, 654) == true);
+	REQUIRE(config.Matches("/dev/input/event7", "Pendant", 0x045e, 654) == false);
+
+	// IDs must fit in 16 bits.
+	document.Parse(R"({ "vendorID" : "0x10000", "bindings" : [] })");
+	InputDeviceConfig badConfig;
+	REQUIRE(badConfig.ReadFromJSON(document) == false);
+}
+
+TEST_CASE("Test socket server", "[socket]")
+{
+	REQUIRE(EventLoopInitialize() == true);
+
+	static constexpr char const* kSocketFileName{ SANDMAN_TEST_BUILD_DIR "tests.sock" };
+
+	std::vector<std::string> commands;
+	bool const initialized = SocketServerInitialize(kSocketFileName,
+		[&commands](SocketServerConnectionID, std::string_view command)
+		{ commands.emplace_back(command); });
+	REQUIRE(initialized == true);
+
+	auto connectClient = []()
+	{
+		auto const clientSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		std::strncpy(address.sun_path, kSocketFileName, sizeof(address.sun_path) - 1);
+
+		bool const connected = connect(clientSocket, reinterpret_cast<sockaddr*>(&address),
+			sizeof(sockaddr_un)) == 0;
+		REQUIRE(connected == true);
+		return clientSocket;
+	};
+
+	auto sendToServer = [](int clientSocket, std::string const& data)
+	{
+		REQUIRE(::send(clientSocket, data.data(), data.size(), 0) ==
+			static_cast<ssize_t>(data.size()));
+	};
+
+	// Run ticks until every connection has been closed.
+	auto runUntilClosed = []()
+	{
+		SocketServerStatistics statistics;
+
+		for (auto tickIndex = 0u; tickIndex < 100u; tickIndex++)
+		{
+			EventLoopSetTimeout(10u);
+			EventLoopWait();
+			SocketServerProcess();
+
+			SocketServerGetStatistics(statistics);
+
+			if ((statistics.m_acceptedConnectionCount > 0u) &&
+				(statistics.m_openConnectionCount == 0u))
+			{
+				return;
+			}
+		}
+
+		FAIL("The connections were not closed.");
+	};
+
+	SECTION("Commands split across sends are framed by newlines")
+	{
+		auto const clientSocket = connectClient();
+		sendToServer(clientSocket, "raise back\nlower le");
+		sendToServer(clientSocket, "gs\r\n\nstop");
+
+		// Older clients send one command without a newline and then finish.
+		shutdown(clientSocket, SHUT_WR);
+		runUntilClosed();
+		close(clientSocket);
+
+		REQUIRE(commands == std::vector<std::string>{ "raise back", "lower legs", "stop" });
+	}
+
+	SECTION("Pipelined commands are limited per tick")
+	{
+		static constexpr auto kCommandCount{ kSocketServerMaxCommandsPerTick * 2u + 1u };
+
+		std::string pipeline;
+
+		for (auto commandIndex = 0u; commandIndex < kCommandCount; commandIndex++)
+		{
+			pipeline += "stop\n";
+		}
+
+		auto const clientSocket = connectClient();
+		sendToServer(clientSocket, pipeline);
+
+		// Accept the connection, then receive everything it sent.
+		EventLoopSetTimeout(10u);
+		EventLoopWait();
+		EventLoopSetTimeout(10u);
+		EventLoopWait();
+
+		SocketServerProcess();
+		REQUIRE(commands.size() == kSocketServerMaxCommandsPerTick);
+		REQUIRE(SocketServerHasPendingCommands() == true);
+
+		shutdown(clientSocket, SHUT_WR);
+		runUntilClosed();
+		close(clientSocket);
+
+		REQUIRE(commands.size() == kCommandCount);
+		REQUIRE(SocketServerHasPendingCommands() == false);
+	}
+
+	SECTION("Replies are sent before the connection is closed")
+	{
+		SocketServerUninitialize();
+		commands.clear();
+
+		bool const reinitialized = SocketServerInitialize(kSocketFileName,
+			[&commands](SocketServerConnectionID connectionID, std::string_view command)
+			{
+				commands.emplace_back(command);
+				SocketServerSend(connectionID, std::string(command) + " done\n");
+			});
+		REQUIRE(reinitialized == true);
+
+		auto const clientSocket = connectClient();
+		sendToServer(clientSocket, "back up\nstop\n");
+		shutdown(clientSocket, SHUT_WR);
+		runUntilClosed();
+
+		std::string replies;
+		char receiveBuffer[64];
+		ssize_t receivedByteCount = 0;
+
+		while ((receivedByteCount = recv(clientSocket, receiveBuffer, sizeof(receiveBuffer), 0)) > 0)
+		{
+			replies.append(receiveBuffer, static_cast<std::size_t>(receivedByteCount));
+		}
+
+		close(clientSocket);
+		REQUIRE(replies == "back up done\nstop done\n");
+	}
+
+	SECTION("A command that can't fit closes the connection")
+	{
+		auto const clientSocket = connectClient();
+		sendToServer(clientSocket, std::string(kSocketServerReceiveBufferCapacity, 'x'));
+		runUntilClosed();
+		close(clientSocket);
+
+		SocketServerStatistics statistics;
+		SocketServerGetStatistics(statistics);
+		REQUIRE(statistics.m_overflowedConnectionCount == 1u);
+		REQUIRE(commands.empty() == true);
+	}
+
+	SocketServerUninitialize();
+	EventLoopUninitialize();
+	unlink(kSocketFileName);
+}
+
+TEST_CASE("Test status subscriptions", "[socket]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	InputManager inputManager;
+	CommandInitialize(inputManager, scheduler);
+	StatusInitialize(inputManager);
+	REQUIRE(EventLoopInitialize() == true);
+
+	static constexpr char const* kSocketFileName{ SANDMAN_TEST_BUILD_DIR "tests.sock" };
+
+	SocketServerConnectionID subscriberID = 0u;
+	bool const initialized = SocketServerInitialize(kSocketFileName,
+		[&subscriberID](SocketServerConnectionID connectionID, std::string_view)
+		{
+			subscriberID = connectionID;
+			StatusSubscribe(connectionID);
+		});
+	REQUIRE(initialized == true);
+
+	auto const clientSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	std::strncpy(address.sun_path, kSocketFileName, sizeof(address.sun_path) - 1);
+
+	bool const connected = connect(clientSocket, reinterpret_cast<sockaddr*>(&address),
+		sizeof(sockaddr_un)) == 0;
+	REQUIRE(connected == true);
+	REQUIRE(::send(clientSocket, "subscribe\n", 10u, 0) == 10);
+
+	// Run some ticks, and return everything the client received.
+	auto runTicks = [clientSocket]()
+	{
+		std::string received;
+
+		for (auto tickIndex = 0u; tickIndex < 50u; tickIndex++)
+		{
+			EventLoopSetTimeout(1u);
+			EventLoopWait();
+			SocketServerProcess();
+			StatusProcess();
+
+			char receiveBuffer[4'096];
+			ssize_t receivedByteCount = 0;
+
+			while ((receivedByteCount = recv(clientSocket, receiveBuffer, sizeof(receiveBuffer),
+				MSG_DONTWAIT)) > 0)
+			{
+				received.append(receiveBuffer, static_cast<std::size_t>(receivedByteCount));
+			}
+		}
+
+		return received;
+	};
+
+	// Carry out a command and pass on the control events it caused.
+	auto runCommand = [](char const* command)
+	{
+		CommandTokenBuffer commandTokens;
+		CommandResult result;
+		CommandTokenizeString(commandTokens, command);
+		REQUIRE(CommandParseTokens(result, commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+
+		Time currentTime;
+		TimerGetCurrent(currentTime);
+		ControlsProcess(currentTime);
+		ControlsDispatchEvents();
+	};
+
+	runTicks();
+	REQUIRE(subscriberID != 0u);
+
+	StatusSubscriptionStatistics statistics;
+	StatusGetSubscriptionStatistics(statistics);
+	REQUIRE(statistics.m_subscriberCount == 1u);
+
+	runCommand("back up");
+	auto const received = runTicks();
+
+	rapidjson::Document event;
+	event.Parse(received.c_str());
+	REQUIRE(event.HasParseError() == false);
+	REQUIRE(event["sequence"].GetUint64() == 1u);
+	REQUIRE(std::string(event["event"].GetString()) == "control");
+	REQUIRE(std::string(event["control"].GetString()) == "back");
+	REQUIRE(std::string(event["state"].GetString()) == "moving up");
+	REQUIRE(std::string(event["previousState"].GetString()) == "idle");
+
+	// Fill everything between the daemon and the client, so that the next event is dropped.
+	for (auto chunkIndex = 0u; chunkIndex < 10'000u; chunkIndex++)
+	{
+		if (SocketServerSend(subscriberID, std::string(1'024u, 'x')) == false)
+		{
+			break;
+		}
+	}
+
+	runCommand("stop");
+	StatusGetSubscriptionStatistics(statistics);
+	REQUIRE(statistics.m_droppedEventCount == 1u);
+
+	// Once the client catches up, it is told what it missed before the next event.
+	runTicks();
+	runCommand("back up");
+	auto const receivedAfterDrop = runTicks();
+
+	auto const noticeEnd = receivedAfterDrop.find('\n');
+	REQUIRE(noticeEnd != std::string::npos);
+	REQUIRE(receivedAfterDrop.substr(0u, noticeEnd) == "{\"event\":\"dropped\",\"count\":1}");
+
+	event.Parse(receivedAfterDrop.c_str() + noticeEnd + 1u);
+	REQUIRE(event.HasParseError() == false);
+	REQUIRE(event["sequence"].GetUint64() == 3u);
+
+	// Changes that cancel out before the next tick are each still published, once.
+	StatusRecordMQTTConnection(true);
+	StatusRecordMQTTConnection(false);
+	StatusRecordMQTTConnection(false);
+	auto const receivedMQTT = runTicks();
+
+	auto const connectedEnd = receivedMQTT.find('\n');
+	REQUIRE(connectedEnd != std::string::npos);
+
+	event.Parse(receivedMQTT.substr(0u, connectedEnd).c_str());
+	REQUIRE(event.HasParseError() == false);
+	REQUIRE(event["sequence"].GetUint64() == 4u);
+	REQUIRE(std::string(event["event"].GetString()) == "mqtt");
+	REQUIRE(event["connected"].GetBool() == true);
+
+	event.Parse(receivedMQTT.c_str() + connectedEnd + 1u);
+	REQUIRE(event.HasParseError() == false);
+	REQUIRE(event["sequence"].GetUint64() == 5u);
+	REQUIRE(event["connected"].GetBool() == false);
+
+	// Control events that were dropped before they could be published still take up sequence
+	// numbers, so that subscribers can see the gap.
+	auto getSequence = []()
+	{
+		rapidjson::StringBuffer buffer;
+		StatusJSONWriter writer(buffer);
+		writer.StartObject();
+		StatusWriteJSON(writer);
+		writer.EndObject();
+
+		rapidjson::Document document;
+		document.Parse(buffer.GetString());
+		return document["sequence"].GetUint64();
+	};
+
+	auto const sequenceBefore = getSequence();
+	auto const droppedCountBefore = ControlsGetDroppedEventCount();
+	StatusGetSubscriptionStatistics(statistics);
+	auto const publishedCountBefore = statistics.m_publishedEventCount;
+
+	Control* backControl = Control::GetByName("back");
+	REQUIRE(backControl != nullptr);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+
+	// Move and stop the back, without passing on the events, until some are dropped.
+	for (auto moveIndex = 0u; moveIndex < 100u; moveIndex++)
+	{
+		ControlRequestBatch batch;
+		batch.AddAction(*backControl, Control::kActionMovingUp, Control::kModeTimed);
+		REQUIRE(batch.Submit() == true);
+		ControlsProcess(currentTime);
+
+		ControlsStopAll();
+		ControlsProcess(currentTime);
+
+		currentTime += Milliseconds(config.GetControlCoolDownDurationMS());
+		scheduler.Process(currentTime);
+	}
+
+	ControlsDispatchEvents();
+	StatusProcess();
+
+	auto const droppedCount = ControlsGetDroppedEventCount() - droppedCountBefore;
+	REQUIRE(droppedCount > 0u);
+
+	StatusGetSubscriptionStatistics(statistics);
+	REQUIRE(getSequence() == sequenceBefore + (statistics.m_publishedEventCount -
+			  publishedCountBefore) + droppedCount);
+
+	// Subscribers that have gone away are forgotten.
+	close(clientSocket);
+	runTicks();
+	StatusGetSubscriptionStatistics(statistics);
+	REQUIRE(statistics.m_subscriberCount == 0u);
+
+	SocketServerUninitialize();
+	EventLoopUninitialize();
+	unlink(kSocketFileName);
+
+	StatusUninitialize();
+	CommandUninitialize();
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test status page", "[status]")
+{
+	Config config;
+	bool const loaded = config.ReadFromFile(SANDMAN_TEST_DATA_DIR "sandman.conf");
+	REQUIRE(loaded == true);
+
+	static constexpr bool kEnableGPIO = false;
+	GPIOInitialize(kEnableGPIO);
+
+	Scheduler scheduler;
+	ControlsInitialize(config.GetControlConfigs(), scheduler);
+	Control::SetDurations(config.GetControlMaxMovingDurationMS(),
+								 config.GetControlCoolDownDurationMS());
+	Control::Enable(true);
+
+	InputManager inputManager;
+	CommandInitialize(inputManager, scheduler);
+
+	static constexpr char const* kStatusPageFileName{ SANDMAN_TEST_BUILD_DIR "tests.status" };
+	REQUIRE(StatusPageInitialize(kStatusPageFileName, inputManager, scheduler) == true);
+
+	// Map the page the way another program would.
+	auto const fileDescriptor = open(kStatusPageFileName, O_RDONLY);
+	REQUIRE(fileDescriptor >= 0);
+
+	// The page has room for every control.
+	auto const pageSize = StatusPageGetSize(ControlsGetCount());
+
+	struct stat fileStatus;
+	REQUIRE(fstat(fileDescriptor, &fileStatus) == 0);
+	REQUIRE(static_cast<std::size_t>(fileStatus.st_size) == pageSize);
+
+	auto* const address = mmap(nullptr, pageSize, PROT_READ, MAP_SHARED, fileDescriptor, 0);
+	close(fileDescriptor);
+	REQUIRE(address != MAP_FAILED);
+
+	auto const& page = *static_cast<StatusPage const*>(address);
+	REQUIRE(page.m_magic == kStatusPageMagic);
+	REQUIRE(page.m_version == kStatusPageVersion);
+	REQUIRE(page.m_controlCapacity == ControlsGetCount());
+
+	StatusPageContents contents;
+	std::vector<StatusPageControl> controls;
+	REQUIRE(StatusPageRead(contents, controls, page) == true);
+	REQUIRE(contents.m_processID == static_cast<std::uint32_t>(getpid()));
+	REQUIRE(contents.m_controlCount == ControlsGetCount());
+	REQUIRE(controls.size() == ControlsGetCount());
+	REQUIRE(contents.m_routineStepIndex == kStatusPageNone);
+	REQUIRE(controls[0].m_state == Control::kStateIdle);
+	REQUIRE(controls[0].m_remainingMS == kStatusPageNone);
+	REQUIRE(std::string(controls.back().m_name) ==
+			  ControlsGetName(ControlsGetCount() - 1u));
+
+	CommandTokenBuffer commandTokens;
+	CommandResult result;
+	CommandTokenizeString(commandTokens, "back up");
+	REQUIRE(CommandParseTokens(result, commandTokens) == CommandParseTokensReturnTypes::kSuccess);
+
+	Time currentTime;
+	TimerGetCurrent(currentTime);
+	ControlsProcess(currentTime);
+	ControlsDispatchEvents();
+	StatusPageUpdate(currentTime);
+
+	auto const sequenceBefore = page.m_sequence.load();
+	REQUIRE(StatusPageRead(contents, controls, page) == true);
+	REQUIRE((sequenceBefore % 2u) == 0u);
+
+	// The back was the first control configured.
+	auto const& back = controls[0];
+	REQUIRE(std::string(back.m_name) == "back");
+	REQUIRE(back.m_state == Control::kStateMovingUp);
+	REQUIRE(back.m_desiredAction == Control::kActionMovingUp);
+	REQUIRE(back.m_stateStartTimeNS <= currentTime.time_since_epoch().count());
+	REQUIRE(back.m_remainingMS > 0u);
+	REQUIRE(back.m_remainingMS <= back.m_stateDurationMS);
+	REQUIRE(contents.m_updateTimeNS == currentTime.time_since_epoch().count());
+
+	// The page is rewritten within a heartbeat even if nothing else happens.
+	Time heartbeatTime;
+	REQUIRE(scheduler.GetNextDeadline(heartbeatTime) == true);
+	REQUIRE(heartbeatTime <= currentTime + Milliseconds(kStatusPageHeartbeatMS));
+
+	// Once the page is no longer being written, readers can tell.
+	StatusPageUninitialize();
+	REQUIRE(StatusPageRead(contents, controls, page) == true);
+	REQUIRE(contents.m_processID == 0u);
+	REQUIRE(page.m_sequence.load() == sequenceBefore + 2u);
+
+	munmap(address, pageSize);
+	unlink(kStatusPageFileName);
+
+	// A page left partway through a write gives up rather than waiting forever.
+	StatusPage stuckPage{};
+	stuckPage.m_sequence.store(1u);
+	REQUIRE(StatusPageRead(contents, controls, stuckPage) == false);
+
+	CommandUninitialize();
+	Control::Enable(false);
+	ControlsUninitialize();
+	GPIOUninitialize();
+}
+
+TEST_CASE("Test scheduler ordering", "[scheduler]")
+{
+	Scheduler scheduler;
+	std::vector<int> calls;
+
+	Time now;
+	TimerGetCurrent(now);
+
+	auto const later = now + Seconds(60);
+
+	// Add the timers out of order.
+	scheduler.AddTimer(later, [&calls](Time const&) { calls.push_back(3); });
+	scheduler.AddTimer(now, [&calls](Time const&) { calls.push_back(2); });
+	scheduler.AddTimer(Time{}, [&calls](Time const&) { calls.push_back(1); });
+
+	Time deadline;
+	REQUIRE(scheduler.GetNextDeadline(deadline) == true);
+	REQUIRE(deadline == Time{});
+
+	// Only the expired timers should be called, earliest first.
+	scheduler.Process(now);
+	REQUIRE(calls == std::vector<int>{ 1, 2 });
+	REQUIRE(scheduler.GetTimerCount() == 1u);
+
+	REQUIRE(scheduler.GetNextDeadline(deadline) == true);
+	REQUIRE(deadline == later);
+}
+
+TEST_CASE("Test scheduler cancellation", "[scheduler]")
+{
+	Scheduler scheduler;
+	auto called = false;
+
+	auto timerID = scheduler.AddTimer(0u, [&called](Time const&) { called = true; });
+	REQUIRE(timerID != Scheduler::kInvalidTimerID);
+
+	scheduler.CancelTimer(timerID);
+	REQUIRE(timerID == Scheduler::kInvalidTimerID);
+	REQUIRE(scheduler.GetTimerCount() == 0u);
+
+	Time deadline;
+	REQUIRE(scheduler.GetNextDeadline(deadline) == false);
+
+	Time now;
+	TimerGetCurrent(now);
+
+	scheduler.Process(now);
+	REQUIRE(called == false);
+
+	// A timer added by a callback waits for the next call, even if it is already due.
+	auto rescheduleCount = 0u;
+	Scheduler::Callback reschedule = [&](Time const& currentTime)
+	{
+		rescheduleCount++;
+		scheduler.AddTimer(currentTime, reschedule);
+	};
+
+	scheduler.AddTimer(Time{}, reschedule);
+	scheduler.Process(now);
+	REQUIRE(rescheduleCount == 1u);
+	REQUIRE(scheduler.GetTimerCount() == 1u);
+
+	// Waiting doesn't hold up the timers behind it, even when it would expire first.
+	Scheduler otherScheduler;
+	auto laterCalled = false;
+
+	otherScheduler.AddTimer(Time{}, [&otherScheduler](Time const&)
+		{
+			otherScheduler.AddTimer(Time{}, [](Time const&) {});
+		});
+	otherScheduler.AddTimer(now, [&laterCalled](Time const&) { laterCalled = true; });
+
+	otherScheduler.Process(now);
+	REQUIRE(laterCalled == true);
+	REQUIRE(otherScheduler.GetTimerCount() == 1u);
+
+	REQUIRE(otherScheduler.GetNextDeadline(deadline) == true);
+	REQUIRE(deadline == Time{});
+}
+
+TEST_CASE("Test scheduler slots", "[scheduler]")
+{
+	Scheduler scheduler;
+	std::vector<int> calls;
+
+	Time now;
+	TimerGetCurrent(now);
+
+	auto slotID = scheduler.AddSlot([&calls](Time const&) { calls.push_back(1); });
+	REQUIRE(slotID != Scheduler::kInvalidSlotID);
+	REQUIRE(scheduler.GetTimerCount() == 0u);
+
+	Time deadline;
+	REQUIRE(scheduler.GetNextDeadline(deadline) == false);
+
+	// Arming a slot again only moves its deadline.
+	auto const allocationCountBefore = s_allocationCount.load();
+
+	scheduler.ArmSlot(slotID, now + Seconds(60));
+	scheduler.ArmSlot(slotID, now);
+	REQUIRE(s_allocationCount.load() == allocationCountBefore);
+	REQUIRE(scheduler.GetTimerCount() == 1u);
+
+	REQUIRE(scheduler.GetNextDeadline(deadline) == true);
+	REQUIRE(deadline == now);
+
+	// Slots expire in order with the timers.
+	scheduler.AddTimer(Time{}, [&calls](Time const&) { calls.push_back(0); });
+	scheduler.AddTimer(now, [&calls](Time const&) { calls.push_back(2); });
+
+	scheduler.Process(now);
+	REQUIRE(calls == std::vector<int>{ 0, 1, 2 });
+	REQUIRE(scheduler.GetTimerCount() == 0u);
+
+	// A disarmed slot isn't called.
+	scheduler.ArmSlot(slotID, now);
+	scheduler.DisarmSlot(slotID);
+	REQUIRE(scheduler.GetTimerCount() == 0u);
+
+	scheduler.Process(now);
+	REQUIRE(calls.size() == 3u);
+
+	// Removed slots are reused.
+	scheduler.RemoveSlot(slotID);
+	REQUIRE(slotID == Scheduler::kInvalidSlotID);
+
+	slotID = scheduler.AddSlot([&calls](Time const&) { calls.push_back(3); });
+	REQUIRE(slotID == 0u);
+
+	// Many slots, armed and disarmed out of order, still expire earliest first.
+	Scheduler manyScheduler;
+	static constexpr unsigned int kSlotCount{ 100u };
+	std::vector<Scheduler::SlotID> slotIDs;
+
+	for (unsigned int slotIndex = 0u; slotIndex < kSlotCount; slotIndex++)
+	{
+		slotIDs.push_back(manyScheduler.AddSlot([&calls, slotIndex](Time const&)
+			{
+				calls.push_back(static_cast<int>(slotIndex));
+			}));
+	}
+
+	auto const manyAllocationCountBefore = s_allocationCount.load();
+
+	for (unsigned int slotIndex = 0u; slotIndex < kSlotCount; slotIndex++)
+	{
+		// Scatter the deadlines, then pull every third one back to the start.
+		manyScheduler.ArmSlot(slotIDs[slotIndex], now + Milliseconds((slotIndex * 37u) % kSlotCount));
+	}
+
+	for (unsigned int slotIndex = 0u; slotIndex < kSlotCount; slotIndex += 3u)
+	{
+		manyScheduler.ArmSlot(slotIDs[slotIndex], now - Seconds(1));
+	}
+
+	for (unsigned int slotIndex = 1u; slotIndex < kSlotCount; slotIndex += 3u)
+	{
+		manyScheduler.DisarmSlot(slotIDs[slotIndex]);
+	}
+
+	REQUIRE(s_allocationCount.load() == manyAllocationCountBefore);
+	auto const armedSlotCount = kSlotCount - ((kSlotCount + 1u) / 3u);
+	REQUIRE(manyScheduler.GetTimerCount() == armedSlotCount);
+
+	REQUIRE(manyScheduler.GetNextDeadline(deadline) == true);
+	REQUIRE(deadline == now - Seconds(1));
+
+	calls.clear();
+	manyScheduler.Process(now + Seconds(1));
+	REQUIRE(calls.size() == armedSlotCount);
+	REQUIRE(manyScheduler.GetTimerCount() == 0u);
+
+	// The slots pulled back come first, in the order they were armed, then the rest by deadline.
+	for (unsigned int callIndex = 0u; callIndex < 34u; callIndex++)
+	{
+		REQUIRE(calls[callIndex] == static_cast<int>(callIndex * 3u));
+	}
+
+	for (unsigned int callIndex = 35u; callIndex < calls.size(); callIndex++)
+	{
+		auto const previousSlotIndex = static_cast<unsigned int>(calls[callIndex - 1u]);
+		auto const slotIndex = static_cast<unsigned int>(calls[callIndex]);
+		REQUIRE(((previousSlotIndex * 37u) % kSlotCount) < ((slotIndex * 37u) % kSlotCount));
+	}
+
+	// A slot armed again by its own function waits for the next call, without holding up the rest.
+	auto rearmCount = 0u;
+	auto const rearmSlotID = manyScheduler.AddSlot([&](Time const& currentTime)
+		{
+			rearmCount++;
+			manyScheduler.ArmSlot(slotIDs[0], currentTime - Seconds(1));
+		});
+
+	manyScheduler.ArmSlot(rearmSlotID, now - Seconds(2));
+	manyScheduler.ArmSlot(slotIDs[1], now);
+
+	calls.clear();
+	manyScheduler.Process(now);
+	REQUIRE(rearmCount == 1u);
+	REQUIRE(calls == std::vector<int>{ 1 });
+	REQUIRE(manyScheduler.GetTimerCount() == 1u);
+
+	manyScheduler.Process(now);
+	REQUIRE(calls == std::vector<int>{ 1, 0 });
+	REQUIRE(manyScheduler.GetTimerCount() == 0u);
+}
+TEST_CASE("Test profiler statistics", "[profiler]")
+{
+	ProfilerReset();
+
+	// Controls run in every tick, MQTT only in the first.
+	for (unsigned int tickIndex = 1u; tickIndex <= 100u; tickIndex++)
+	{
+		ProfilerAddStageTime(kProfilerStageControls, Microseconds(tickIndex * 10u));
+
+		if (tickIndex == 1u)
+		{
+			ProfilerAddStageTime(kProfilerStageMQTT, Milliseconds(2));
+			ProfilerAddStageTime(kProfilerStageMQTT, Milliseconds(3));
+		}
+
+		ProfilerEndTick();
+	}
+
+	ProfilerStatistics statistics;
+	ProfilerGetStageStatistics(statistics, kProfilerStageControls);
+	REQUIRE(statistics.m_sampleCount == 100u);
+	REQUIRE(statistics.m_minimum == Microseconds(10));
+	REQUIRE(statistics.m_maximum == Microseconds(1'000));
+	REQUIRE(statistics.m_99thPercentile == Microseconds(990));
+	REQUIRE(statistics.m_average == Microseconds(505));
+
+	// Time spent in a stage more than once during a tick adds up to one sample.
+	ProfilerGetStageStatistics(statistics, kProfilerStageMQTT);
+	REQUIRE(statistics.m_sampleCount == 1u);
+	REQUIRE(statistics.m_maximum == Milliseconds(5));
+
+	ProfilerGetStageStatistics(statistics, kProfilerStageReports);
+	REQUIRE(statistics.m_sampleCount == 0u);
+
+	ProfilerGetTickStatistics(statistics);
+	REQUIRE(statistics.m_sampleCount == 100u);
+
+	ProfilerReset();
+}